@@ -37,6 +37,24 @@ App({
     }
     return newList
   },
+  sfloat2Int: function(raw){ // IEEE 11073 SFLOAT, 4-bit exponent and 12-bit mantissa, special values become 999
+    if (raw >= 0x07FE && raw <= 0x0802) {
+      return 999
+    }
+    let mantissa = raw & 0x0FFF
+    let exponent = raw >> 12
+    if (mantissa >= 0x0800) mantissa -= 0x1000
+    if (exponent >= 8) exponent -= 16
+    return Math.round(mantissa * Math.pow(10, exponent))
+  },
+  buf2Plx: function(buffer){ // PLX Continuous Measurement, the flags byte is followed by SpO2 and pulse rate
+    let intList = this.buf2Int8(buffer)
+    let newList = []
+    for(let i = 1; i + 1 < intList.length && i < 5; i+=2){
+      newList.push(this.sfloat2Int(intList[i] + intList[i+1]*256))
+    }
+    return newList
+  },
   onLaunch: function () {
     this.globalData.SystemInfo = wx.getSystemInfoSync()
     //console.log(this.globalData.SystemInfo)
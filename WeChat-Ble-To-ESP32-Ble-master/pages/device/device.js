@@ -211,20 +211,25 @@ Page({
     let that = this;
     wx.onBLECharacteristicValueChange(function(res) {
       console.log(res)
+      if (res.characteristicId.toUpperCase().startsWith("E3A4C1F0")) { // compressed waveform frames, see waveform_codec.h, not shown here
+        return
+      }
       const idx = app.inArray(that.data.buffer, 'uuid', res.characteristicId)
       // let newbuffer = [...that.data.buffer] // 拓展运算来实现浅复制
       const data = {}
+      // the PLX Continuous Measurement (0x2A5F) carries SFLOAT, the other characteristics Int16
+      const value = res.characteristicId.toUpperCase().startsWith("00002A5F") ? app.buf2Plx(res.value) : app.buf2Int16(res.value)
       if (idx === -1) {
         // newbuffer[that.data.buffer.length] = {
         data[`buffer[${that.data.buffer.length}]`] = {
           uuid: res.characteristicId,
-          value: app.buf2Int16(res.value) // it is a list
+          value: value // it is a list
         }
       } else {
         // newbuffer[idx] = {
         data[`buffer[${idx}]`] = {
           uuid: res.characteristicId,
-          value: app.buf2Int16(res.value) // it is a list
+          value: value // it is a list
         }
       }
       // console.log(newbuffer)
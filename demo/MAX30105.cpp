@@ -147,6 +147,7 @@ boolean MAX30105::begin(TwoWire &wirePort, uint32_t i2cSpeed, uint8_t i2caddr) {
   _i2cPort->setClock(i2cSpeed);
 
   _i2caddr = i2caddr;
+  lostSamples = 0;
 
   // Step 1: Initial Communication and Verification
   // Check that a MAX30105 is connected
@@ -334,6 +335,12 @@ void MAX30105::clearFIFO(void) {
   writeRegister8(_i2caddr, MAX30105_FIFOREADPTR, 0);
 }
 
+//Samples lost since begin(), counted by check(): those the sensor FIFO overwrote
+//(OVF_COUNTER) and those the sense array overwrote before they were read
+uint32_t MAX30105::getLostSamples(void) {
+  return (lostSamples);
+}
+
 //Enable roll over if FIFO over flows
 void MAX30105::enableFIFORollover(void) {
   bitMask(MAX30105_FIFOCONFIG, MAX30105_ROLLOVER_MASK, MAX30105_ROLLOVER_ENABLE);
@@ -626,8 +633,17 @@ uint16_t MAX30105::check(void)
   //Read register FIDO_DATA in (3-byte * number of active LED) chunks
   //Until FIFO_RD_PTR = FIFO_WR_PTR
 
-  byte readPointer = getReadPointer();
-  byte writePointer = getWritePointer();
+  //FIFO_WR_PTR, OVF_COUNTER and FIFO_RD_PTR are consecutive, read them in one burst.
+  //OVF_COUNTER is cleared by the next FIFO_DATA read, so it must be taken right before it.
+  _i2cPort->beginTransmission(_i2caddr);
+  _i2cPort->write(MAX30105_FIFOWRITEPTR);
+  _i2cPort->endTransmission(false);
+  _i2cPort->requestFrom((uint8_t)_i2caddr, (uint8_t)3);
+  if (_i2cPort->available() < 3) return (0);
+  byte writePointer = _i2cPort->read();
+  byte overflow = _i2cPort->read() & 0x1F; //Saturates at 31, a longer stall loses more than it shows
+  byte readPointer = _i2cPort->read();
+  lostSamples += overflow;
 
   int numberOfSamples = 0;
 
@@ -671,6 +687,12 @@ uint16_t MAX30105::check(void)
       {
         sense.head++; //Advance the head of the storage struct
         sense.head %= STORAGE_SIZE; //Wrap condition
+        if (sense.head == sense.tail) //Full, drop the oldest unread sample rather than all of them
+        {
+          sense.tail++;
+          sense.tail %= STORAGE_SIZE;
+          lostSamples++;
+        }
 
         byte temp[sizeof(uint32_t)]; //Array of 4 bytes that we will convert into long
         uint32_t tempLong;
@@ -109,6 +109,7 @@ class MAX30105 {
   uint8_t getWritePointer(void);
   uint8_t getReadPointer(void);
   void clearFIFO(void); //Sets the read/write pointers to zero
+  uint32_t getLostSamples(void); //Samples lost since begin(): sensor FIFO overflows plus sense array overruns
 
   //Proximity Mode Interrupt Threshold
   void setPROXINTTHRESH(uint8_t val);
@@ -150,12 +151,13 @@ class MAX30105 {
   byte activeLEDs; //Gets set during setup. Allows check() to calculate how many bytes to read from FIFO
   
   uint8_t revisionID; 
+  uint32_t lostSamples; //See getLostSamples()
 
   void readRevisionID();
 
   void bitMask(uint8_t reg, uint8_t mask, uint8_t thing);
  
-   #define STORAGE_SIZE 4 //Each long is 4 bytes so limit this to fit on your micro
+  #define STORAGE_SIZE 33 //Holds a whole sensor FIFO (32 samples) plus the slot that tells full from empty
   typedef struct Record
   {
     uint32_t red[STORAGE_SIZE];
@@ -0,0 +1,128 @@
+#include "autocorr_engine.h"
+
+#define HISTORY (AUTOCORR_MAX_WINDOW + AUTOCORR_MAX_LAG + 1)
+#define RAW_SIZE (2 * AUTOCORR_HALF_WIDTH + 1)
+
+AutocorrEngine::AutocorrEngine(int32_t sampling_rate, int32_t window)
+{
+  n_decimation = sampling_rate / AUTOCORR_RATE > 0 ? sampling_rate / AUTOCORR_RATE : 1;
+  n_rate_x100 = (sampling_rate > 0 ? sampling_rate : 1) * 100 / n_decimation;
+  n_window = window / n_decimation;
+  if (n_window > AUTOCORR_MAX_WINDOW) n_window = AUTOCORR_MAX_WINDOW;
+  n_min_lag = n_rate_x100 * 60 / 100 / AUTOCORR_MAX_BPM;
+  if (n_min_lag < 2) n_min_lag = 2;
+  n_max_lag = n_rate_x100 * 60 / 100 / AUTOCORR_MIN_BPM;
+  if (n_max_lag > AUTOCORR_MAX_LAG - 1) n_max_lag = AUTOCORR_MAX_LAG - 1;
+  reset();
+}
+
+int32_t AutocorrEngine::window_for_buffer(int32_t sampling_rate, int32_t buffer_length)
+{
+  AutocorrEngine probe(sampling_rate, 0); // same lag range as the engine that will be used
+  int32_t n_window = buffer_length / probe.n_decimation - 2 * AUTOCORR_HALF_WIDTH - (probe.n_max_lag + 1);
+  return (n_window > 1 ? n_window : 1) * probe.n_decimation;
+}
+
+void AutocorrEngine::reset(void)
+{
+  n_acc = 0;
+  n_acc_count = 0;
+  n_raw_sum = 0;
+  un_raw_count = 0;
+  un_count = 0;
+  for (int32_t i = 0; i < HISTORY; i++)
+    an_x[i] = 0;
+  for (int32_t i = 0; i <= AUTOCORR_MAX_LAG; i++)
+    an_sum[i] = 0;
+  n_energy = 0;
+  n_correlation = 0;
+  n_period = 0;
+}
+
+void AutocorrEngine::set_sampling_rate(int32_t sampling_rate)
+{
+  n_rate_x100 = (sampling_rate > 0 ? sampling_rate : 1) * 100 / n_decimation;
+}
+
+void AutocorrEngine::push(uint32_t un_sample)
+{
+  n_acc += un_sample;
+  if (++n_acc_count == n_decimation) {
+    push_decimated(n_acc / n_decimation);
+    n_acc = 0;
+    n_acc_count = 0;
+  }
+}
+
+void AutocorrEngine::push_decimated(int32_t n_value)
+/**
+* \brief        Add one decimated sample
+* \par          Details
+*               The high-passed output lags the input by AUTOCORR_HALF_WIDTH samples. Its products with the
+*               history enter the lag sums, the products of the sample leaving the window leave them.
+*
+* \param[in]    n_value                 - decimated raw green
+*
+* \retval       None
+*/
+{
+  int32_t n_slot = un_raw_count % RAW_SIZE;
+  n_raw_sum += n_value - (un_raw_count >= RAW_SIZE ? an_raw[n_slot] : 0);
+  an_raw[n_slot] = n_value;
+  un_raw_count++;
+  if (un_raw_count < RAW_SIZE) return;
+  int32_t n_center = an_raw[(un_raw_count - 1 - AUTOCORR_HALF_WIDTH) % RAW_SIZE];
+  int32_t n_x = n_center - (int32_t)(n_raw_sum / RAW_SIZE);
+
+  uint32_t n = un_count++;
+  an_x[n % HISTORY] = n_x;
+  n_energy += (int64_t)n_x * n_x;
+  for (int32_t k = n_min_lag - 1; k <= n_max_lag + 1 && (uint32_t)k <= n; k++) // one extra lag on each side for the interpolation
+    an_sum[k] += (int64_t)n_x * an_x[(n - k) % HISTORY];
+  if (n >= (uint32_t)n_window) { // sample n - n_window leaves the window
+    uint32_t n_old = n - n_window;
+    int32_t n_old_x = an_x[n_old % HISTORY];
+    n_energy -= (int64_t)n_old_x * n_old_x;
+    for (int32_t k = n_min_lag - 1; k <= n_max_lag + 1 && (uint32_t)k <= n_old; k++)
+      an_sum[k] -= (int64_t)n_old_x * an_x[(n_old - k) % HISTORY];
+  }
+}
+
+int32_t AutocorrEngine::heart_rate(void)
+/**
+* \brief        Period of the strongest repetition in the window
+* \par          Details
+*               The lag sums are normalized by the window energy. Among the local maxima the shortest lag
+*               reaching 85 % of the strongest is the period, so multiples of the period are not taken. The
+*               lag is refined by a parabola through its neighbours.
+*
+* \retval       heart rate in bpm, 999 if invalid
+*/
+{
+  n_correlation = 0;
+  n_period = 0;
+  if (un_count < (uint32_t)n_window + n_max_lag + 1 || n_energy <= 0)
+    return 999;
+  q16_t n_best = 0;
+  for (int32_t k = n_min_lag; k <= n_max_lag; k++) {
+    q16_t n_r = q16_ratio(an_sum[k], n_energy);
+    if (n_r > n_best) n_best = n_r;
+  }
+  if (n_best < AUTOCORR_MIN_CORRELATION)
+    return 999;
+  for (int32_t k = n_min_lag; k <= n_max_lag; k++) {
+    q16_t n_r = q16_ratio(an_sum[k], n_energy);
+    if (n_r < q16_mul(n_best, Q16_CONST(0.85f)) || an_sum[k] < an_sum[k - 1] || an_sum[k] < an_sum[k + 1])
+      continue;
+    // vertex of the parabola through the three lags, in 1/100 lag
+    int64_t n_l = an_sum[k - 1], n_c = an_sum[k], n_r2 = an_sum[k + 1];
+    int64_t n_denom = n_l - 2 * n_c + n_r2;
+    int64_t n_offset = n_denom != 0 ? 50 * (n_l - n_r2) / n_denom : 0;
+    int64_t n_lag_x100 = (int64_t)k * 100 + n_offset;
+    n_correlation = n_r;
+    n_period = (int32_t)(n_lag_x100 * n_decimation / 100);
+    // bpm = 60 * rate / lag, both x100, rounded
+    return (int32_t)((60LL * n_rate_x100 + n_lag_x100 / 2) / n_lag_x100);
+  }
+  return 999;
+}
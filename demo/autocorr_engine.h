@@ -0,0 +1,67 @@
+/** \file autocorr_engine.h *************************************************
+*
+* Description: Heart rate from the normalized autocorrelation of the green
+*              channel, Maxim's original periodicity idea without the peak
+*              search. Samples are decimated to AUTOCORR_RATE and high-passed
+*              by subtracting a 1 s centered moving average. For every lag in
+*              the physiological range (30 to 210 bpm) a running sum of
+*              x[n] * x[n - lag] over the last window is kept: each new sample
+*              adds its products and the sample leaving the window subtracts
+*              its own, so a hop of new samples costs O(hop * lags) and the
+*              window is never rescanned.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef AUTOCORR_ENGINE_H_
+#define AUTOCORR_ENGINE_H_
+
+#include <stdint.h>
+#include "fixed_point.h"
+
+#define AUTOCORR_RATE 50          // decimated sampling rate
+#define AUTOCORR_MIN_BPM 30
+#define AUTOCORR_MAX_BPM 210
+#define AUTOCORR_MAX_WINDOW 512   // decimated samples in the correlation window
+#define AUTOCORR_MAX_LAG 128      // covers AUTOCORR_MIN_BPM up to a decimated rate of 63 sps
+#define AUTOCORR_HALF_WIDTH (AUTOCORR_RATE / 2) // of the high-pass moving average
+#define AUTOCORR_MIN_CORRELATION Q16_CONST(0.3f)
+
+class AutocorrEngine {
+ public:
+  AutocorrEngine(int32_t n_sampling_rate = 400, int32_t n_window = 2048);
+
+  // largest window whose lag sums are complete after pushing n_buffer_length samples into a fresh engine
+  static int32_t window_for_buffer(int32_t n_sampling_rate, int32_t n_buffer_length);
+
+  void reset(void);
+  void set_sampling_rate(int32_t n_sampling_rate); // measured rate drift, the decimation and the lag range stay
+  void push(uint32_t un_sample); // raw green sample
+  int32_t heart_rate(void);      // bpm, 999 before a full window or without a clear period
+  q16_t correlation(void) const { return n_correlation; } // normalized correlation at the period of the last heart_rate()
+  int32_t period(void) const { return n_period; }         // in raw samples, 0 if unknown
+
+ private:
+  void push_decimated(int32_t n_value);
+
+  int32_t n_decimation;
+  int32_t n_rate_x100; // actual decimated rate x100
+  int32_t n_window;    // decimated samples
+  int32_t n_min_lag, n_max_lag;
+
+  int32_t n_acc;       // decimation accumulator
+  int32_t n_acc_count;
+  int32_t an_raw[2 * AUTOCORR_HALF_WIDTH + 1]; // decimated samples for the centered moving average
+  int64_t n_raw_sum;
+  uint32_t un_raw_count;
+  int32_t an_x[AUTOCORR_MAX_WINDOW + AUTOCORR_MAX_LAG + 1]; // high-passed history
+  uint32_t un_count;   // high-passed samples so far
+  int64_t an_sum[AUTOCORR_MAX_LAG + 1]; // running sum of x[n] * x[n - lag] over the window
+  int64_t n_energy;    // running sum of x[n]^2 over the window
+  q16_t n_correlation;
+  int32_t n_period;
+};
+
+#endif /* AUTOCORR_ENGINE_H_ */
@@ -0,0 +1,121 @@
+#include "bandpass_filter.h"
+
+// compile-time bilinear Butterworth design, C++11 constexpr (one return statement per function)
+// tan(x) by its Taylor series, x = pi * f / rate stays below 0.32 for 5 Hz at 50 sps, error < 1e-7
+static constexpr double bq_tan(double x)
+{
+  return x + x * x * x / 3 + 2 * x * x * x * x * x / 15 + 17 * x * x * x * x * x * x * x / 315
+         + 62 * x * x * x * x * x * x * x * x * x / 2835;
+}
+static constexpr int32_t bq_q30(double v)
+{
+  return (int32_t)(v * 1073741824.0 + (v >= 0 ? 0.5 : -0.5));
+}
+static constexpr double bq_norm(double k)
+{
+  return 1.0 / (1.0 + 1.41421356237 * k + k * k);
+}
+static constexpr biquad_q30 bq_highpass_k(double k)
+{
+  return { bq_q30(bq_norm(k)), bq_q30(-2 * bq_norm(k)), bq_q30(bq_norm(k)),
+           bq_q30(2 * (k * k - 1) * bq_norm(k)), bq_q30((1 - 1.41421356237 * k + k * k) * bq_norm(k)) };
+}
+static constexpr biquad_q30 bq_lowpass_k(double k)
+{
+  return { bq_q30(k * k * bq_norm(k)), bq_q30(2 * k * k * bq_norm(k)), bq_q30(k * k * bq_norm(k)),
+           bq_q30(2 * (k * k - 1) * bq_norm(k)), bq_q30((1 - 1.41421356237 * k + k * k) * bq_norm(k)) };
+}
+#define BANDPASS_DESIGN(rate) { rate, bq_highpass_k(bq_tan(3.14159265359 * BANDPASS_LOW_HZ / rate)), \
+                                      bq_lowpass_k(bq_tan(3.14159265359 * BANDPASS_HIGH_HZ / rate)) }
+
+// the MAX30105 sampling rates
+static constexpr bandpass_design bandpass_designs[] = {
+  BANDPASS_DESIGN(50), BANDPASS_DESIGN(100), BANDPASS_DESIGN(200), BANDPASS_DESIGN(400),
+  BANDPASS_DESIGN(800), BANDPASS_DESIGN(1000), BANDPASS_DESIGN(1600), BANDPASS_DESIGN(3200)
+};
+#define BANDPASS_DESIGNS (int32_t)(sizeof(bandpass_designs) / sizeof(bandpass_designs[0]))
+
+BandpassFilter::BandpassFilter(int32_t n_sampling_rate)
+{
+  p_design = &bandpass_designs[0];
+  set_sampling_rate(n_sampling_rate);
+  reset();
+}
+
+void BandpassFilter::reset(void)
+{
+  b_primed = false;
+}
+
+void BandpassFilter::save(bandpass_state* p_state) const
+{
+  const biquad_state* ap_sections[2] = { &high, &low };
+  int32_t* apn_out[2] = { p_state->an_high, p_state->an_low };
+  for (int32_t s = 0; s < 2; s++) {
+    apn_out[s][0] = (int32_t)ap_sections[s]->n_x1;
+    apn_out[s][1] = (int32_t)ap_sections[s]->n_x2;
+    apn_out[s][2] = (int32_t)ap_sections[s]->n_y1;
+    apn_out[s][3] = (int32_t)ap_sections[s]->n_y2;
+  }
+  p_state->b_primed = b_primed;
+}
+
+void BandpassFilter::restore(const bandpass_state& state)
+{
+  biquad_state* ap_sections[2] = { &high, &low };
+  const int32_t* apn_in[2] = { state.an_high, state.an_low };
+  for (int32_t s = 0; s < 2; s++) {
+    ap_sections[s]->n_x1 = apn_in[s][0];
+    ap_sections[s]->n_x2 = apn_in[s][1];
+    ap_sections[s]->n_y1 = apn_in[s][2];
+    ap_sections[s]->n_y2 = apn_in[s][3];
+  }
+  b_primed = state.b_primed;
+}
+
+void BandpassFilter::set_sampling_rate(int32_t n_sampling_rate)
+{
+  const bandpass_design* p_best = &bandpass_designs[0];
+  for (int32_t i = 1; i < BANDPASS_DESIGNS; i++) {
+    int32_t n_diff = bandpass_designs[i].n_rate - n_sampling_rate;
+    int32_t n_best_diff = p_best->n_rate - n_sampling_rate;
+    if ((n_diff < 0 ? -n_diff : n_diff) < (n_best_diff < 0 ? -n_best_diff : n_best_diff))
+      p_best = &bandpass_designs[i];
+  }
+  p_design = p_best;
+}
+
+int64_t BandpassFilter::section(const biquad_q30* p_coeffs, biquad_state* p_state, int64_t n_x)
+{
+  int64_t n_acc = (int64_t)p_coeffs->b0 * n_x + (int64_t)p_coeffs->b1 * p_state->n_x1 + (int64_t)p_coeffs->b2 * p_state->n_x2
+                  - (int64_t)p_coeffs->a1 * p_state->n_y1 - (int64_t)p_coeffs->a2 * p_state->n_y2;
+  int64_t n_y = (n_acc + (1 << 29)) >> 30;
+  p_state->n_x2 = p_state->n_x1;
+  p_state->n_x1 = n_x;
+  p_state->n_y2 = p_state->n_y1;
+  p_state->n_y1 = n_y;
+  return n_y;
+}
+
+int32_t BandpassFilter::push(uint32_t un_sample)
+/**
+* \brief        Filter one sample
+* \par          Details
+*               The first sample after reset() fills the state with its own value, the steady state of a constant
+*               signal (zero after the high-pass), so the 18-bit DC does not ring through the window.
+*
+* \param[in]    un_sample               - raw ADC counts
+*
+* \retval       band-passed and inverted sample in ADC counts
+*/
+{
+  int64_t n_x = (int64_t)un_sample << 8;
+  if (!b_primed) {
+    high.n_x1 = high.n_x2 = n_x;
+    high.n_y1 = high.n_y2 = 0;
+    low.n_x1 = low.n_x2 = low.n_y1 = low.n_y2 = 0;
+    b_primed = true;
+  }
+  int64_t n_y = section(&p_design->low, &low, section(&p_design->high, &high, n_x));
+  return (int32_t)(-n_y >> 8);
+}
@@ -0,0 +1,72 @@
+/** \file bandpass_filter.h *************************************************
+*
+* Description: 0.5 to 5 Hz band-pass for the green channel, an alternative to
+*              the DC removal, median and mean filter of preprocessing(). Two
+*              Butterworth biquads (2nd order high-pass, 2nd order low-pass)
+*              in direct form I with Q30 coefficients, 64-bit accumulators and
+*              8 fractional bits on the state, so the slow high-pass poles do
+*              not turn rounding into drift. O(1) state and about ten
+*              multiplications per sample, the state carries over from hop to
+*              hop. The coefficients of every sensor sampling rate are
+*              computed by the compiler (bandpass_filter.cpp), the filter
+*              uses the nearest one to the measured rate.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef BANDPASS_FILTER_H_
+#define BANDPASS_FILTER_H_
+
+#include <stdint.h>
+
+#define BANDPASS_LOW_HZ 0.5
+#define BANDPASS_HIGH_HZ 5.0
+
+typedef struct {
+  int32_t b0, b1, b2, a1, a2; // Q30, a0 = 1
+} biquad_q30;
+
+typedef struct {
+  int32_t n_rate;
+  biquad_q30 high; // high-pass at BANDPASS_LOW_HZ
+  biquad_q30 low;  // low-pass at BANDPASS_HIGH_HZ
+} bandpass_design;
+
+// filter state for a snapshot, 8 fractional bits; inputs stay below 2^26, so 32 bits hold it
+typedef struct {
+  int32_t an_high[4]; // x1, x2, y1, y2 of the high-pass
+  int32_t an_low[4];  // x1, x2, y1, y2 of the low-pass
+  bool b_primed;
+} bandpass_state;
+
+class BandpassFilter {
+ public:
+  BandpassFilter(int32_t n_sampling_rate = 400);
+
+  void reset(void); // the next sample primes the state as if the signal had been constant
+  void set_sampling_rate(int32_t n_sampling_rate); // nearest supported rate, the state is kept
+  int32_t sampling_rate(void) const { return p_design->n_rate; }
+
+  // raw sample in, band-passed sample out, inverted like preprocessing() so the pulse peaks point upwards
+  int32_t push(uint32_t un_sample);
+
+  void save(bandpass_state* p_state) const;
+  void restore(const bandpass_state& state); // continue from a saved state, the sampling rate is not part of it
+
+ private:
+  typedef struct {
+    int64_t n_x1, n_x2; // inputs, 8 fractional bits
+    int64_t n_y1, n_y2; // outputs, 8 fractional bits
+  } biquad_state;
+
+  static int64_t section(const biquad_q30* p_coeffs, biquad_state* p_state, int64_t n_x);
+
+  const bandpass_design* p_design;
+  biquad_state high;
+  biquad_state low;
+  bool b_primed;
+};
+
+#endif /* BANDPASS_FILTER_H_ */
@@ -0,0 +1,177 @@
+#include "beat_detector.h"
+
+BeatDetector::BeatDetector(int32_t sampling_rate, int32_t filter_size) : intervals(BEAT_DETECTOR_INTERVALS)
+{
+  n_filter_size = filter_size < 1 ? 1 : (filter_size > BEAT_DETECTOR_MAX_FILTER ? BEAT_DETECTOR_MAX_FILTER : filter_size);
+  set_sampling_rate(sampling_rate);
+  reset();
+}
+
+void BeatDetector::set_sampling_rate(int32_t sampling_rate)
+{
+  n_sampling_rate = sampling_rate > 0 ? sampling_rate : 1;
+  n_min_interval = n_sampling_rate * 60 / BEAT_DETECTOR_MAX_BPM;
+  n_max_interval = n_sampling_rate * 60 / BEAT_DETECTOR_MIN_BPM;
+  n_latency = n_sampling_rate / 4; // a larger sample within 250 ms replaces the candidate
+}
+
+void BeatDetector::reset(void)
+{
+  for (int32_t i = 0; i < n_filter_size; i++)
+    an_filter[i] = 0;
+  n_filter_sum = 0;
+  b_rising = false;
+  n_min_val = INT32_MAX; un_min_idx = 0;
+  n_max_val = INT32_MIN; un_max_idx = 0;
+  n_post_min_val = INT32_MAX; un_post_min_idx = 0;
+  n_amplitude_avg = 0;
+  b_has_peak = false;
+  un_last_peak = 0;
+  un_last_event = 0;
+  un_index = 0;
+  n_blank = 0;
+  b_prime = false;
+  beat.un_valley = 0; beat.un_peak = 0; beat.n_amplitude = 0; beat.n_interval = 0;
+  intervals.clear();
+}
+
+bool BeatDetector::push(int32_t n_sample)
+/**
+* \brief        Process one sample
+* \par          Details
+*               The sample is inverted and smoothed by an n_filter_size moving average, then a two state
+*               machine alternates between tracking the valley and tracking the peak candidate. The candidate
+*               is confirmed once no larger sample has followed for n_latency samples and it rises above the
+*               valley by a quarter of the running beat amplitude. Confirmed beats outside 30-220 bpm do not
+*               enter the interval median.
+*
+* \param[in]    n_sample                - raw green sample
+*
+* \retval       true if a beat has been confirmed by this sample
+*/
+{
+  uint32_t un_i = un_index++;
+  int32_t n_slot = un_i % n_filter_size;
+  int32_t n_inverted = -n_sample;
+  if (un_i == 0 || b_prime) { // prime the filter with the first sample to avoid a start-up ramp
+    b_prime = false;
+    for (int32_t k = 0; k < n_filter_size; k++)
+      an_filter[k] = n_inverted;
+    n_filter_sum = n_inverted * n_filter_size;
+  }
+  n_filter_sum += n_inverted - an_filter[n_slot];
+  an_filter[n_slot] = n_inverted;
+  int32_t n_x = n_filter_sum / n_filter_size;
+
+  if (n_blank > 0) { // gain step: restart the valley search, the amplitude is learnt again
+    n_blank--;
+    b_rising = false;
+    n_min_val = n_x; un_min_idx = un_i;
+    n_amplitude_avg = 0;
+    b_has_peak = false;
+    un_last_event = un_i;
+    return false;
+  }
+
+  // no beat for too long: the amplitude has dropped, let the hysteresis follow it
+  if (n_amplitude_avg > 0 && un_i - un_last_event > (uint32_t)n_max_interval) {
+    n_amplitude_avg /= 2;
+    un_last_event = un_i;
+  }
+  int32_t n_hysteresis = n_amplitude_avg / 4 > 1 ? n_amplitude_avg / 4 : 1;
+
+  if (!b_rising) {
+    if (n_x < n_min_val) { n_min_val = n_x; un_min_idx = un_i; }
+    else if (n_x > n_min_val + n_hysteresis) { // leaves the valley
+      b_rising = true;
+      n_max_val = n_x; un_max_idx = un_i;
+      n_post_min_val = n_x; un_post_min_idx = un_i;
+    }
+    return false;
+  }
+
+  if (n_x > n_max_val) {
+    n_max_val = n_x; un_max_idx = un_i;
+    n_post_min_val = n_x; un_post_min_idx = un_i;
+    return false;
+  }
+  if (n_x < n_post_min_val) { n_post_min_val = n_x; un_post_min_idx = un_i; }
+  if (n_x < n_min_val) { // fell below the valley before a peak was confirmed, restart from here
+    b_rising = false;
+    n_min_val = n_x; un_min_idx = un_i;
+    return false;
+  }
+  if (un_i - un_max_idx < (uint32_t)n_latency)
+    return false;
+
+  // the candidate has been the maximum for n_latency samples
+  int32_t n_amplitude = n_max_val - n_min_val;
+  uint32_t un_valley_idx = un_min_idx;
+  int32_t n_interval = b_has_peak ? (int32_t)(un_max_idx - un_last_peak) : 0;
+  bool b_valid = n_amplitude > n_hysteresis && (!b_has_peak || n_interval >= n_min_interval);
+
+  // look for the next valley starting from the lowest sample after the candidate
+  b_rising = false;
+  n_min_val = n_post_min_val; un_min_idx = un_post_min_idx;
+  if (!b_valid)
+    return false;
+
+  if (b_has_peak && n_interval <= n_max_interval)
+    intervals.push(n_interval);
+  n_amplitude_avg = n_amplitude_avg == 0 ? n_amplitude : n_amplitude_avg + (n_amplitude - n_amplitude_avg) / 4;
+  b_has_peak = true;
+  un_last_peak = un_max_idx;
+  un_last_event = un_i;
+
+  // report positions of the raw signal, the moving average delays them by half its size
+  uint32_t un_delay = n_filter_size / 2;
+  beat.un_valley = un_valley_idx > un_delay ? un_valley_idx - un_delay : 0;
+  beat.un_peak = un_max_idx > un_delay ? un_max_idx - un_delay : 0;
+  beat.n_amplitude = n_amplitude;
+  beat.n_interval = n_interval > n_max_interval ? 0 : n_interval;
+  return true;
+}
+
+void BeatDetector::blank(int32_t n_samples)
+/**
+* \brief        Skip the samples around a gain step
+* \par          Details
+*               The filter is primed with the first sample after the step, so the step does not ramp
+*               through the moving average, and no beat is confirmed from the n_samples samples. The first
+*               beat after them has no interval, so SpO2Estimator does not pair it with a beat from before
+*               the step. The interval median is kept, the heart rate does not depend on the gain.
+*
+* \param[in]    n_samples               - samples to blank, starting with the next push()
+*/
+{
+  n_blank = n_samples;
+  b_prime = true;
+}
+
+void BeatDetector::resume(const int32_t* pn_intervals, int32_t n_count, int32_t n_amplitude)
+/**
+* \brief        Continue with the beat history of an earlier session
+* \par          Details
+*               The interval median is replaced, so heart_rate() is valid at once, and the hysteresis
+*               starts from the saved beat amplitude. The sample numbering and the state machine are left
+*               as they are; no beat from before is known, so the next one starts a new interval.
+*               resume(NULL, 0, 0) forgets a history that turned out not to match.
+*
+* \param[in]    *pn_intervals           - beat intervals in samples, oldest first
+* \param[in]    n_count                 - number of intervals
+* \param[in]    n_amplitude             - running beat amplitude
+*/
+{
+  intervals.clear();
+  for (int32_t i = 0; i < n_count; i++)
+    intervals.push(pn_intervals[i]);
+  n_amplitude_avg = n_amplitude;
+  b_has_peak = false;
+}
+
+int32_t BeatDetector::heart_rate(void) const
+{
+  if (intervals.count() < 2)
+    return 999; // invalid, same sentinel as HR_calculation
+  return n_sampling_rate * 60 / intervals.median();
+}
@@ -0,0 +1,82 @@
+/** \file beat_detector.h ***************************************************
+*
+* Description: Streaming beat detector. Each green sample is pushed once, a
+*              peak is confirmed a fixed latency after it occurred and the
+*              heart rate is the rolling median of the latest beat intervals.
+*              The work per sample is O(1) and independent of bufferLength,
+*              unlike HR_calculation which re-detects every peak of the
+*              window on each hop.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef BEAT_DETECTOR_H_
+#define BEAT_DETECTOR_H_
+
+#include <stdint.h>
+#include "rolling_median.h"
+
+#define BEAT_DETECTOR_MAX_FILTER 64   // max moving average size
+#define BEAT_DETECTOR_INTERVALS 8     // number of beat intervals in the rolling median
+#define BEAT_DETECTOR_MIN_BPM 30
+#define BEAT_DETECTOR_MAX_BPM 220
+
+typedef struct {
+  uint32_t un_valley;   // raw sample index of the valley before the peak
+  uint32_t un_peak;     // raw sample index of the peak
+  int32_t n_amplitude;  // peak - valley of the inverted, smoothed signal
+  int32_t n_interval;   // samples since the previous peak, 0 for the first beat
+} beat_event;
+
+class BeatDetector {
+ public:
+  BeatDetector(int32_t n_sampling_rate = 400, int32_t n_filter_size = 15);
+
+  void reset(void);
+  void set_sampling_rate(int32_t n_sampling_rate);
+
+  bool push(int32_t n_sample); // raw green sample, true when a new beat has been confirmed
+  void blank(int32_t n_samples); // the next samples follow a gain step: no beat, the next interval starts after them
+  void resume(const int32_t* pn_intervals, int32_t n_count, int32_t n_amplitude); // intervals (oldest first) and beat amplitude of a snapshot
+
+  const beat_event& last_beat(void) const { return beat; }
+  int32_t heart_rate(void) const; // bpm, 999 while fewer than two beat intervals are known
+  int32_t interval_count(void) const { return intervals.count(); } // intervals in the median, up to BEAT_DETECTOR_INTERVALS
+  uint32_t sample_count(void) const { return un_index; }
+  const RollingMedian& interval_median(void) const { return intervals; }
+  int32_t amplitude(void) const { return n_amplitude_avg; } // running beat amplitude, sets the hysteresis
+  int32_t latency(void) const { return n_latency; } // samples between a peak and its confirmation
+
+ private:
+  int32_t n_sampling_rate;
+  int32_t n_filter_size;
+  int32_t n_latency;
+  int32_t n_min_interval;
+  int32_t n_max_interval;
+
+  // moving average of the inverted signal
+  int32_t an_filter[BEAT_DETECTOR_MAX_FILTER];
+  int32_t n_filter_sum;
+
+  bool b_rising;        // false: looking for a valley, true: looking for a peak
+  int32_t n_min_val;    // current valley
+  uint32_t un_min_idx;
+  int32_t n_max_val;    // current peak candidate
+  uint32_t un_max_idx;
+  int32_t n_post_min_val; // lowest sample after the peak candidate, becomes the next valley
+  uint32_t un_post_min_idx;
+  int32_t n_amplitude_avg; // running beat amplitude, sets the detection hysteresis
+  bool b_has_peak;
+  uint32_t un_last_peak;  // sample index of the last confirmed peak
+  uint32_t un_last_event; // last confirmed beat or amplitude decay
+  uint32_t un_index;
+  int32_t n_blank;      // samples left to blank
+  bool b_prime;         // prime the filter with the next sample
+
+  beat_event beat;
+  RollingMedian intervals;
+};
+
+#endif /* BEAT_DETECTOR_H_ */
@@ -32,10 +32,24 @@
 #include <Adafruit_SSD1306.h>
 #include "MAX30105.h"
 #include "spo2_algorithm.h"
+#include "beat_detector.h"
+#include "spo2_estimator.h"
+#include "waveform_codec.h"
+#include "notify_scheduler.h"
+#include "session_recorder.h"
+#include "littlefs_storage.h"
+#include "waveform_plot.h"
+#include "stage_timer.h"
+#include "pipeline_controller.h"
+#include "standby_controller.h"
+#include "gain_controller.h"
+#include "duty_cycle_controller.h"
+#include "pipeline_snapshot.h"
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
+#include <esp_sleep.h>
 
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 32 // OLED display height, in pixels
@@ -53,18 +67,39 @@
 #define CHARACTERISTIC_RED_UUID "84a22700-06e4-4e8b-aa15-11a24bc60201"
 #define CHARACTERISTIC_UNIT_FREQUENCY_UUID "cbcc2722-174b-42f8-bca8-ae5b2fe85d86"
 #define CHARACTERISTIC_UNIT_PERCENTAGE_UUID "02a627AD-6a22-432c-a6d5-b479d44ea3bc"
+#define CHARACTERISTIC_WAVEFORM_UUID "e3a4c1f0-2b7d-4f5e-8a61-9c0d7b3e5f28"
+#define CHARACTERISTIC_DIAGNOSTICS_UUID "5b8d3a52-6f0e-4c38-9d7b-2e41c7a0f1d4"
+#define SERVICE_PLX_UUID ((uint16_t)0x1822) // Pulse Oximeter Service
+#define CHARACTERISTIC_PLX_CONTINUOUS_UUID ((uint16_t)0x2A5F) // PLX Continuous Measurement
+#define CHARACTERISTIC_PLX_FEATURES_UUID ((uint16_t)0x2A60) // PLX Features
 
 // some configuration parameters
-static const byte ledBrightness = 0x1F; //Options: 0=Off to 255=51mA
+static const byte ledBrightness = 0x1F; //Options: 0=Off to 255=51mA, the starting amplitude of all LEDs with autoGain
 static const byte sampleAverage = 1; //Options: 1, 2, 4, 8, 16, 32, it is better to use 4 as we take IR, Red and Green (3 samples here); (don't change this)
 static const byte ledMode = 3; //Options: 1 = Red only, 2 = Red + IR, 3 = Red + IR + Green
 static const int sampleRate = 400; //Options: 50, 100, 200, 400, 800, 1000, 1600, 3200, when sampleRate is 200, the actual frequency is 20
 static const int pulseWidth = 69; //Options: 69, 118, 215, 411, you can change the pulsewidth here to improve the speed
-static const int adcRange = 4096; //Options: 2048, 4096, 8192, 16384, DON'T CHANGE (relate to spo2)
+static const int adcRange = 4096; //Options: 2048, 4096, 8192, 16384, the starting range with autoGain (the SpO2 ratio divides AC by DC per channel, a step between beats does not change it)
+static const bool streamWaveform = true; // notify the raw green, IR and red samples as compressed frames, see waveform_codec.h
+static const bool recordSession = true; // Serial commands r/s/b/c start, stop and export a session recorded to flash, see session_recorder.h
+static const bool streamingMode = true; // true: HR and SpO2 are updated on every beat by the streaming detector, false: window medians of heart_rate_and_oxygen_saturation
+static const bool proximityStandby = true; // no finger: the sensor waits in proximity mode until the PROX interrupt, see standby_controller.h
+static const byte proxAmplitude = 0x0A; // pilot IR LED in standby, 2 mA
+static const byte proxThreshold = 0x08; // PROX interrupt threshold, the 8 MSBs of the 18-bit IR count: 8192 counts at the pilot amplitude
+static const uint32_t standbyPollMs = 100; // INT is not connected, INT1 is read over I2C this often in standby
+static const bool autoGain = true; // LED amplitudes and ADC range follow the signal level between hops, see gain_controller.h
+static const bool spotCheck = false; // true: one burst every spotPeriodMs instead of continuous sampling, see duty_cycle_controller.h
+static const uint32_t spotPeriodMs = 60000; // from the start of one burst to the next
+static const uint32_t spotBurstMs = 15000; // sampling per burst, at least a full window (5.1 s at 400 sps)
+static const uint32_t spotNapMs = 1000; // longest sleep between bursts, BLE and Serial are served after each
+static const bool resumeSession = true; // the pipeline state of the last good window is kept in RTC memory and flash, a session resumes from it, see pipeline_snapshot.h
+static const int32_t resumeDcTolerance = 25; // percent, the IR level of the first hop has to match the snapshot for its results to stand
+static const bool warmUp = true; // the first window is evaluated while it grows, results are provisional (RESULT_QUALITY_EARLY) until it is full
 
 // the length of bufferLength
 static const int32_t bufferLength = 2048; // bufferLength must be a const, should be a postive integer, BUFFER_SIZE refer to "spo2_algorithm.h"
 static const int32_t oneQuaterBuffer = bufferLength/8; // update every 512 data
+static const int32_t warmupLengths[] = { bufferLength / 2, bufferLength * 3 / 4 }; // evaluated during warm-up, 2.6 s and 3.8 s at 400 sps; shorter windows hold too few pulse intervals for signal_quality
 // green, ir and red buffer
 #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
 //Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
@@ -82,24 +117,135 @@ uint32_t greenBuffer[bufferLength]; //green LED sensor data
 // Instantanization peripherals
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET); // OLED
 MAX30105 particleSensor; // MAX30101 (MAX30105)
+WaveformPlot wavePlot(CURVE_WEIGHT, CURVE_HEIGHT, bufferLength / CURVE_WEIGHT); // the whole buffer fits the display width
+BeatDetector beatDetector(sampleRate, 15); // streaming HR, filter size matches filter_size of spo2_algorithm.cpp
+SpO2Estimator spo2Estimator(16); // streaming SpO2, same number of ratios as ratio_size of spo2_algorithm.cpp
+PipelineController pipelineController; // buffers and sizes of heart_rate_and_oxygen_saturation, adapted to the heart rate window by window
+WaveformEncoder waveformEncoder; // BLE waveform frames, sized to the negotiated MTU
+LittleFSStorage sessionStorage("/session.rec"); // flash file of the recorded session
+LittleFSStorage snapshotStorage("/snapshot.bin"); // the pipeline snapshot across power cycles
+SessionRecorder sessionRecorder(&sessionStorage); // RAM ring spilled to sessionStorage by recorder_task
 BLECharacteristic green_characteristic(CHARACTERISTIC_GREEN_UUID, BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_INDICATE);
 BLECharacteristic ir_characteristic(CHARACTERISTIC_IR_UUID, BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_INDICATE);
 BLECharacteristic red_characteristic(CHARACTERISTIC_RED_UUID, BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_INDICATE);
 BLECharacteristic frequency_characteristic(CHARACTERISTIC_UNIT_FREQUENCY_UUID, BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_INDICATE);
 BLECharacteristic percentage_characteristic(CHARACTERISTIC_UNIT_PERCENTAGE_UUID, BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_INDICATE);
+BLECharacteristic waveform_characteristic(CHARACTERISTIC_WAVEFORM_UUID, BLECharacteristic::PROPERTY_NOTIFY); // interleaved green, IR and red frames, see waveform_codec.h
+BLECharacteristic diagnostics_characteristic(CHARACTERISTIC_DIAGNOSTICS_UUID, BLECharacteristic::PROPERTY_READ); // stage timing table, see stage_pack()
+BLECharacteristic plx_characteristic(BLEUUID(CHARACTERISTIC_PLX_CONTINUOUS_UUID), BLECharacteristic::PROPERTY_NOTIFY);
+BLECharacteristic plx_features_characteristic(BLEUUID(CHARACTERISTIC_PLX_FEATURES_UUID), BLECharacteristic::PROPERTY_READ);
 BLEDescriptor green_descriptor(BLEUUID((uint16_t)0x2902));
 BLEDescriptor ir_descriptor(BLEUUID((uint16_t)0x2902));
 BLEDescriptor red_descriptor(BLEUUID((uint16_t)0x2902));
 BLEDescriptor frequency_descriptor(BLEUUID((uint16_t)0x2902));
 BLEDescriptor percentage_descriptor(BLEUUID((uint16_t)0x2902));
+BLEDescriptor waveform_descriptor(BLEUUID((uint16_t)0x2902));
+BLEDescriptor plx_descriptor(BLEUUID((uint16_t)0x2902));
+// PLX Features: measurement status supported (0x0001), then the status bits that are set: ongoing, early, validated, questionable, invalid
+static const uint8_t plxFeatures[4] = { 0x01, 0x00, 0xE0, 0xC0 };
+
+#define PROX_INT_FLAG 0x10 // PROX_INT bit of interrupt status 1
+#define MODE_MULTILED 0x07 // MAX30105_MODE_MULTILED, writing the mode register restarts the proximity mode
+#define ALC_OVF_FLAG 0x20 // ALC_OVF bit of interrupt status 1
+#define ADC_RANGE_STEP 0x20 // ADC range bits of the SpO2 configuration register per doubling from 2048 nA
 
 bool deviceConnected = false; // BLE connection state check
 bool oldDeviceConnected = false; // BLE connection state check
-int32_t spo2; //SPO2 value, negative means invalidation
-int32_t heartRate; //heart rate value, negative means invalidation
+int32_t spo2 = 999; //SPO2 value, 999 means invalidation
+int32_t heartRate = 999; //heart rate value, 999 means invalidation
+uint8_t signalQuality = SIGNAL_UNCHECKED; // signal_quality_code of the newest window, HR and SpO2 are 999 unless SIGNAL_OK
+bool warmingUp = false; // the buffers are not full yet, see warm_up()
 unsigned long startTime; // use to calculate the actual frequency
 float frequency; // real-time frequency
-uint16_t* sendingPointer; // to send data
+uint32_t sampleIndex = 0; // number of samples read since start, numbers the waveform frames
+uint32_t gainStepIndex = 0; // sampleIndex when the current gain setting was applied
+uint32_t lostSamples = 0; // particleSensor.getLostSamples() at the last hop
+enum { RECORDER_SPILL, RECORDER_STOP }; // commands to recorder_task
+QueueHandle_t recorderQueue = NULL; // feeds recorder_task, created in setup() when recordSession
+RTC_DATA_ATTR uint8_t rtcSnapshot[SNAPSHOT_MAX_BYTES]; // serialized pipeline_snapshot, kept through resets and deep sleep
+RTC_DATA_ATTR uint16_t rtcSnapshotLength = 0;
+pipeline_snapshot snapshot; // the last one restored, its IR DC is checked after the first hop
+bool resumed = false; // the pipeline continues from snapshot, see warm_up()
+BLEServer* pServer = NULL; // BLE server, to query the negotiated MTU
+
+// the result packets go to the PLX Continuous Measurement while a client is connected,
+// heart rate and SpO2 still go to frequency_ and percentage_characteristic as Int16 for older clients
+class ResultSink: public NotifySink {
+  public:
+    bool notify(const uint8_t* data, uint16_t length) {
+      if (!deviceConnected) return false; // stays due, sent right after the next connection
+      plx_characteristic.setValue((uint8_t*)data, length);
+      plx_characteristic.notify();
+      int16_t legacy = (int16_t)heartRate; // the values the scheduler packed, 999 when invalid
+      frequency_characteristic.setValue((uint8_t*)&legacy, 2);
+      frequency_characteristic.notify();
+      legacy = (int16_t)spo2;
+      percentage_characteristic.setValue((uint8_t*)&legacy, 2);
+      percentage_characteristic.notify();
+      return true;
+    }
+};
+// session exports are written to Serial
+class SerialOutput: public ByteOutput {
+  public:
+    bool write(const uint8_t* data, uint32_t length) {
+      return Serial.write(data, length) == length;
+    }
+};
+SerialOutput serialOutput;
+
+// standby switches the MAX30105 between proximity mode and the multi-LED acquisition
+class MaxStandbySensor: public StandbySensor {
+  public:
+    void enter_proximity() {
+      particleSensor.setPulseAmplitudeProximity(proxAmplitude);
+      particleSensor.setProximityThreshold(proxThreshold);
+      particleSensor.enablePROXINT();
+      particleSensor.getINT1(); // clear a flag raised before
+      particleSensor.setLEDMode(MODE_MULTILED); // back to proximity mode until the threshold is crossed
+    }
+    void enter_active() {
+      particleSensor.disablePROXINT();
+      particleSensor.clearFIFO(); // nothing sampled in proximity mode belongs to the window
+    }
+    bool proximity_triggered() {
+      return (particleSensor.getINT1() & PROX_INT_FLAG) != 0; // reading INT1 clears it
+    }
+};
+MaxStandbySensor standbySensor;
+StandbyController standby(&standbySensor);
+
+// the gain controller writes the LED amplitudes and the ADC range of the MAX30105
+class MaxGainSensor: public GainSensor {
+  public:
+    void apply(const gain_setting& setting) {
+      particleSensor.setPulseAmplitudeRed(setting.auch_amplitude[GAIN_RED]);
+      particleSensor.setPulseAmplitudeIR(setting.auch_amplitude[GAIN_IR]);
+      particleSensor.setPulseAmplitudeGreen(setting.auch_amplitude[GAIN_GREEN]);
+      uint8_t rangeBits = 0;
+      for (uint16_t range = GAIN_MIN_ADC_RANGE; range < setting.uw_adc_range; range *= 2)
+        rangeBits += ADC_RANGE_STEP;
+      particleSensor.setADCRange(rangeBits);
+      particleSensor.clearFIFO(); // samples taken before the writes would mix both settings
+    }
+    bool ambient_overflow() {
+      return (particleSensor.getINT1() & ALC_OVF_FLAG) != 0; // reading INT1 clears it
+    }
+};
+MaxGainSensor gainSensor;
+GainController gainController(&gainSensor);
+
+// spot checks shut the MAX30105 down between bursts
+class MaxDutyCycleSensor: public DutyCycleSensor {
+  public:
+    void wake() { particleSensor.wakeUp(); }
+    void shut_down() { particleSensor.shutDown(); }
+};
+MaxDutyCycleSensor dutyCycleSensor;
+DutyCycleController dutyCycle(&dutyCycleSensor, spotPeriodMs, spotBurstMs);
+
+ResultSink resultSink;
+NotifyScheduler resultScheduler(&resultSink, 1000, 5000); // on change at most once per second, at least every 5 seconds
 
 class MyServerCallbacks: public BLEServerCallbacks {
     void onConnect(BLEServer* pServer) {
@@ -124,6 +270,7 @@ void setup()
   // the library initializes this with an Adafruit splash screen.
   display.display();
   delay(500); // Pause for 2 seconds
+  wavePlot.attach(display.getBuffer()); // the plot draws into the display buffer, replacing the splash screen
   
   // Initialize sensor
   if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) { //Use default I2C port, 400kHz speed
@@ -132,52 +279,43 @@ void setup()
   }
   // particleSensor.setup();
   particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange); //Configure sensor with these settings
-
-  //Serial.println(F("Initialing the dataBuffer ......"));
-  startTime = millis();
-  for (int32_t i = 0 ; i < bufferLength ; i++) {
-    while (particleSensor.available() == false) //do we have new data?
-      particleSensor.check(); //Check the sensor for new data
-
-    redBuffer[i] = particleSensor.getFIFORed();
-    irBuffer[i] = particleSensor.getFIFOIR();
-    greenBuffer[i] = particleSensor.getFIFOGreen();
-    particleSensor.nextSample(); //We're finished with this sample so move to next sample
-
-    //Serial.println(greenBuffer[i], DEC);
+  if (autoGain) {
+    gainController.begin(ledBrightness, adcRange);
+    particleSensor.enableALCOVF(); // the flag is polled in INT1, INT is not connected
   }
-  frequency = (float) bufferLength / ((millis() - startTime) / 1000.0);
-  Serial.printf("Average sampling rate for collecting %d data: %.2f Hz\n", bufferLength, frequency);
-
-  // update the cruve 
-  drawCruve(greenBuffer, bufferLength);
-
-  // inialize the spo2 and heartRate
-  heart_rate_and_oxygen_saturation(greenBuffer, irBuffer, redBuffer, bufferLength, (int32_t)frequency, &spo2, &heartRate);
+  if (recordSession && !sessionStorage.begin())
+    Serial.println(F("LittleFS mount failed, sessions cannot be recorded"));
+  if (recordSession) {
+    recorderQueue = xQueueCreate(4, sizeof(uint8_t));
+    xTaskCreatePinnedToCore(recorder_task, "recorder", 4096, NULL, tskIDLE_PRIORITY + 1, NULL, 0); // loop() runs on core 1
+  }
+  if (resumeSession && !snapshotStorage.begin())
+    Serial.println(F("LittleFS mount failed, the pipeline snapshot is kept in RTC memory only"));
 
+  // the client can connect and the display runs while the first window fills
   BLE_set_up();
+  standby.begin(millis(), STANDBY_ACTIVE); // a finger may already be on the sensor
+  if (spotCheck) {
+    dutyCycle.begin(millis()); // the first burst starts in loop()
+  } else {
+    resume_pipeline();
+    warm_up();
+  }
 }
 
 void loop()
 {
+  STAGE_SCOPE(STAGE_HOP);
+  if (Serial.available())
+    serial_command(Serial.read());
+
   // firstly send first oneQuaterBuffer data
   // notify changed value
+  // HR and SpO2 are published by resultScheduler from the sampling loop
   if (deviceConnected){
-    // sendingPointer = (uint16_t*) greenBuffer;
-    // green_characteristic.setValue((uint8_t*)(sendingPointer), oneQuaterBuffer*2); // 1 uint16_t will take 2 uint8_t, the mutiple should not exceed 512
-    // green_characteristic.notify();
-    // sendingPointer = (uint16_t*) irBuffer;
-    // ir_characteristic.setValue((uint8_t*)(sendingPointer), oneQuaterBuffer*2); // size_of(uint16_t) = 2, buffer length = 4
-    // ir_characteristic.notify();
-    // sendingPointer = (uint16_t*) redBuffer;
-    // red_characteristic.setValue((uint8_t*)(sendingPointer), oneQuaterBuffer*2); // size_of(uint16_t) = 2, buffer length = 4
-    // red_characteristic.notify();
-    sendingPointer = (uint16_t*) &heartRate;
-    frequency_characteristic.setValue((uint8_t*)(sendingPointer), 2); // size_of(uint8_t) = 1
-    frequency_characteristic.notify();
-    // sendingPointer = (uint16_t*) &spo2;
-    // frequency_characteristic.setValue((uint8_t*)(sendingPointer), 2); // size_of(uint8_t) = 1
-    // frequency_characteristic.notify();
+    STAGE_SCOPE(STAGE_BLE);
+    if (streamWaveform && standby.state() == STANDBY_ACTIVE && (!spotCheck || dutyCycle.capturing())) send_waveform(); // the newest oneQuaterBuffer samples of all three channels
+    update_diagnostics();
   }
   // disconnecting
   if (!deviceConnected && oldDeviceConnected) {
@@ -193,15 +331,36 @@ void loop()
       oldDeviceConnected = deviceConnected;
   }
 
+  // spot check: between bursts only BLE and Serial are served, each burst starts over with a new window
+  if (spotCheck && !spot_check())
+    return;
+
+  // no finger: only BLE and Serial are served until the PROX interrupt, then the window starts over
+  if (proximityStandby && !spotCheck && standby.state() == STANDBY_SENSING) {
+    if (standby.poll(millis())) {
+      restart_acquisition();
+    } else {
+      resultScheduler.poll(millis());
+      delay(standbyPollMs); // the idle task runs, the CPU waits for the next tick
+    }
+    return;
+  }
+
   //Continuously taking samples from MAX30102.  Heart rate and SpO2 are calculated every 1 second
-  for (int32_t i = oneQuaterBuffer; i < bufferLength; i++)
   {
-    redBuffer[i - oneQuaterBuffer] = redBuffer[i];
-    irBuffer[i - oneQuaterBuffer] = irBuffer[i];
-    greenBuffer[i - oneQuaterBuffer] = greenBuffer[i];
+    STAGE_SCOPE(STAGE_SHIFT);
+    for (int32_t i = oneQuaterBuffer; i < bufferLength; i++)
+    {
+      redBuffer[i - oneQuaterBuffer] = redBuffer[i];
+      irBuffer[i - oneQuaterBuffer] = irBuffer[i];
+      greenBuffer[i - oneQuaterBuffer] = greenBuffer[i];
+    }
   }
 
   startTime = millis();
+#if STAGE_TIMING
+  uint32_t acquireStart = stage_clock(); // sampling one hop, including the waits in check()
+#endif
   for (int32_t i = bufferLength - oneQuaterBuffer; i < bufferLength; i++)
   {
     while (particleSensor.available() == false) //do we have new data?
@@ -211,17 +370,79 @@ void loop()
     irBuffer[i] = particleSensor.getFIFOIR();
     greenBuffer[i] = particleSensor.getFIFOGreen();
     particleSensor.nextSample(); //We're finished with this sample so move to next sample
+    sampleIndex++;
+    record_samples(i);
+    pipelineController.push_sample(greenBuffer[i], irBuffer[i], redBuffer[i]); // band-pass and autocorrelation state run across hops
+    if (streamingMode && beatDetector.push(greenBuffer[i])) // confirms each beat once, a fixed 250 ms after its peak
+      update_beat(i);
+    resultScheduler.poll(millis()); // cheap unless a packet is due
 
     //Serial.println(greenBuffer[i], DEC);
   }
+#if STAGE_TIMING
+  stage_record(STAGE_ACQUIRE, stage_clock() - acquireStart);
+#endif
   frequency = (float) oneQuaterBuffer / ((millis() - startTime) / 1000.0);
   Serial.printf("Average sampling rate for collecting %d data: %.2f Hz\n", oneQuaterBuffer, frequency);
+  beatDetector.set_sampling_rate((int32_t)frequency);
+  pipelineController.set_sampling_rate((int32_t)frequency);
 
-  // update the cruve 
-  drawCruve(greenBuffer, bufferLength);
+  // update the cruve with the newest samples
+  {
+    STAGE_SCOPE(STAGE_DISPLAY);
+    drawCruve(&greenBuffer[bufferLength - oneQuaterBuffer], oneQuaterBuffer);
+  }
 
-  //After gathering the newest samples recalculate HR and SP02
-  heart_rate_and_oxygen_saturation(greenBuffer, irBuffer, redBuffer, bufferLength, (int32_t)frequency, &spo2, &heartRate);
+  // samples the sensor FIFO (32 samples, 80 ms) or the sense array lost since the last hop; the session
+  // recorder spills from recorder_task, so a flash write shows up here only if it stalled both cores too long
+  uint32_t lost = particleSensor.getLostSamples();
+  if (lost != lostSamples) {
+    Serial.printf("%u samples lost while sampling\n", lost - lostSamples);
+    lostSamples = lost;
+  }
+
+  //After gathering the newest samples recalculate HR and SP02, the streaming mode has already updated them per beat
+  // after a gain step only the samples with the new setting are evaluated, while they are fewer than a warm-up window the last results stay
+  int32_t windowLength = gain_window_length();
+  int32_t first = bufferLength - windowLength;
+  if (windowLength < warmupLengths[0]) {
+    Serial.printf("gain step %u samples ago, window not evaluated\n", sampleIndex - gainStepIndex);
+  } else if (!streamingMode) {
+    heart_rate_and_oxygen_saturation(&greenBuffer[first], &irBuffer[first], &redBuffer[first], windowLength, (int32_t)frequency, &spo2, &heartRate, &signalQuality, &pipelineController);
+    resultScheduler.update(heartRate, spo2, result_quality());
+    sessionRecorder.set_result(heartRate, spo2);
+  } else {
+    // the beat detector cannot tell a missing finger from a weak pulse, the window check decides if its results are published
+    signal_quality_info qualityInfo;
+    {
+      STAGE_SCOPE(STAGE_QUALITY);
+      signalQuality = signal_quality(&greenBuffer[first], &irBuffer[first], &redBuffer[first], windowLength, (int32_t)frequency, &qualityInfo);
+    }
+    if (signalQuality != SIGNAL_OK && (heartRate != 999 || spo2 != 999)) {
+      heartRate = 999;
+      spo2 = 999;
+      resultScheduler.update(heartRate, spo2, result_quality());
+      sessionRecorder.set_result(heartRate, spo2);
+    }
+  }
+
+  if (resumeSession && windowLength >= warmupLengths[0] && signalQuality == SIGNAL_OK)
+    save_snapshot(); // RTC memory only, flash is written when the acquisition pauses
+  if (proximityStandby && !spotCheck && windowLength >= warmupLengths[0] && standby.update(signalQuality, millis())) {
+    Serial.printf("standby after quality %d, active %u of %u ms\n", signalQuality, standby.active_ms(millis()), standby.elapsed_ms(millis()));
+    store_snapshot();
+  }
+
+  // the next hop is sampled with the new setting, the step must not look like a beat
+  if (autoGain && standby.state() == STANDBY_ACTIVE &&
+      gainController.update(&redBuffer[bufferLength - oneQuaterBuffer], &irBuffer[bufferLength - oneQuaterBuffer], &greenBuffer[bufferLength - oneQuaterBuffer], oneQuaterBuffer)) {
+    gainStepIndex = sampleIndex;
+    beatDetector.blank(GainController::settle_samples((int32_t)frequency));
+    pipelineController.restart_filter();
+    const gain_setting& setting = gainController.setting();
+    Serial.printf("gain step %u: red 0x%02X, IR 0x%02X, green 0x%02X, range %u nA\n", gainController.steps(), setting.auch_amplitude[GAIN_RED],
+                  setting.auch_amplitude[GAIN_IR], setting.auch_amplitude[GAIN_GREEN], setting.uw_adc_range);
+  }
 
   Serial.print(F("HR="));
   Serial.print(heartRate, DEC);
@@ -229,28 +450,325 @@ void loop()
   Serial.println(spo2, DEC);
 }
 
-void drawCruve(uint32_t *dataBuffer, int32_t bufferLength){
-  int16_t i;
-  uint32_t maxValue = dataBuffer[0];
-  uint32_t minValue = dataBuffer[0];
-  for (i=0;i<bufferLength;i++){
-    if (dataBuffer[i] > maxValue) maxValue = dataBuffer[i];
-    if (dataBuffer[i] < minValue) minValue = dataBuffer[i];
+// fill the buffers for the first window, evaluating the first warmupLengths[] samples on the way when warmUp is set
+void warm_up(){
+  int32_t filled = 0;
+  int32_t checkpoints = warmUp ? sizeof(warmupLengths) / sizeof(warmupLengths[0]) : 0;
+  unsigned long acquireTime = 0; // sampling only, the evaluations in between would lower the measured rate
+  warmingUp = checkpoints > 0 || resumed;
+  signalQuality = SIGNAL_UNCHECKED; // update_beat() publishes nothing before the first window check
+  for (int32_t c = resumed ? -1 : 0; c <= checkpoints; c++) {
+    int32_t length = c < 0 ? oneQuaterBuffer : (c < checkpoints ? warmupLengths[c] : bufferLength); // a resumed pipeline is checked after one hop
+    startTime = millis();
+    for (int32_t i = filled; i < length; i++) {
+      while (particleSensor.available() == false) //do we have new data?
+        particleSensor.check(); //Check the sensor for new data
+
+      redBuffer[i] = particleSensor.getFIFORed();
+      irBuffer[i] = particleSensor.getFIFOIR();
+      greenBuffer[i] = particleSensor.getFIFOGreen();
+      particleSensor.nextSample(); //We're finished with this sample so move to next sample
+      sampleIndex++;
+      record_samples(i);
+      pipelineController.push_sample(greenBuffer[i], irBuffer[i], redBuffer[i]); // band-pass and autocorrelation state run across hops
+      if (streamingMode && beatDetector.push(greenBuffer[i])) // confirms each beat once, a fixed 250 ms after its peak
+        update_beat(i);
+      resultScheduler.poll(millis()); // provisional results go out during warm-up
+    }
+    acquireTime += millis() - startTime;
+    frequency = (float) length / (acquireTime / 1000.0);
+    Serial.printf("Average sampling rate for collecting %d data: %.2f Hz\n", length, frequency);
+    beatDetector.set_sampling_rate((int32_t)frequency);
+    pipelineController.set_sampling_rate((int32_t)frequency);
+    drawCruve(&greenBuffer[filled], length - filled);
+    filled = length;
+    warmingUp = length < bufferLength;
+
+    // the window pipeline runs on the samples so far, the streaming detector only needs the window check
+    if (c < 0) {
+      // too few samples for signal_quality: the restored medians stand if the finger sits as before
+      resumed = false;
+      if (resume_matches(length)) {
+        signalQuality = SIGNAL_OK;
+        heartRate = beatDetector.heart_rate();
+        spo2 = spo2Estimator.spo2();
+      } else {
+        beatDetector.resume(NULL, 0, 0);
+        spo2Estimator.resume(NULL, 0);
+        heartRate = 999;
+        spo2 = 999;
+      }
+    } else if (streamingMode) {
+      signal_quality_info qualityInfo;
+      signalQuality = signal_quality(greenBuffer, irBuffer, redBuffer, length, (int32_t)frequency, &qualityInfo);
+      if (signalQuality == SIGNAL_OK) {
+        heartRate = beatDetector.heart_rate();
+        spo2 = spo2Estimator.spo2();
+      } else {
+        heartRate = 999;
+        spo2 = 999;
+      }
+    } else
+      heart_rate_and_oxygen_saturation(greenBuffer, irBuffer, redBuffer, length, (int32_t)frequency, &spo2, &heartRate, &signalQuality, &pipelineController);
+    resultScheduler.update(heartRate, spo2, result_quality());
+    sessionRecorder.set_result(heartRate, spo2);
+    Serial.printf("warm-up %d samples: HR=%d, SPO2=%d%s\n", length, heartRate, spo2, warmingUp ? " (provisional)" : "");
+  }
+}
+
+// a finger came back: the history belongs to the previous measurement, fill a new window
+void restart_acquisition(){
+  beatDetector.reset();
+  spo2Estimator.reset();
+  pipelineController.reset();
+  heartRate = 999;
+  spo2 = 999;
+  resume_pipeline();
+  warm_up();
+}
+
+// serialize the pipeline state of the newest window into RTC memory
+void save_snapshot(){
+  pipeline_snapshot current;
+  snapshot_capture(&current, beatDetector, spo2Estimator, pipelineController, autoGain ? &gainController : NULL);
+  current.un_sampling_rate = (uint32_t)frequency;
+  current.uch_signal_quality = signalQuality;
+  current.aun_dc[GAIN_RED] = hop_mean(redBuffer);
+  current.aun_dc[GAIN_IR] = hop_mean(irBuffer);
+  current.aun_dc[GAIN_GREEN] = hop_mean(greenBuffer);
+  rtcSnapshotLength = snapshot_serialize(&current, rtcSnapshot, sizeof(rtcSnapshot));
+}
+
+// copy the snapshot in RTC memory to flash, once per pause so the flash is not written every hop
+void store_snapshot(){
+  if (!resumeSession || rtcSnapshotLength == 0) return;
+  if (!snapshotStorage.clear() || !snapshotStorage.append(rtcSnapshot, rtcSnapshotLength))
+    Serial.println(F("snapshot not written to flash"));
+}
+
+// restore the newest snapshot, RTC memory first, then flash; true if the pipeline continues from it
+bool resume_pipeline(){
+  resumed = false;
+  if (!resumeSession) return false;
+  bool valid = snapshot_deserialize(rtcSnapshot, rtcSnapshotLength, &snapshot);
+  if (!valid) {
+    static uint8_t stored[SNAPSHOT_MAX_BYTES];
+    uint32_t length = snapshotStorage.size();
+    if (length > sizeof(stored)) length = sizeof(stored);
+    valid = length > 0 && snapshotStorage.read(0, stored, length) && snapshot_deserialize(stored, length, &snapshot);
   }
-  int32_t length = min(bufferLength, CURVE_WEIGHT);
-  int16_t distance = CURVE_WEIGHT/length;
-
-  display.clearDisplay();
-  for(i=1;i<length;i++){ // start from index 1
-    int16_t x0 = (i-1)*distance;
-    int16_t y0 = (int16_t) CURVE_HEIGHT*(dataBuffer[i-1]-minValue)/(maxValue-minValue);
-    int16_t x1 = i*distance;
-    int16_t y1 = (int16_t) CURVE_HEIGHT*(dataBuffer[i]-minValue)/(maxValue-minValue);
-    display.drawLine(x0, y0, x1, y1, SSD1306_WHITE);
+  // the intervals are counted in samples, a snapshot taken at another rate does not apply
+  if (!valid || abs((int32_t)snapshot.un_sampling_rate - sampleRate) > sampleRate / 10) return false;
+  snapshot_restore(snapshot, &beatDetector, &spo2Estimator, &pipelineController, autoGain ? &gainController : NULL);
+  resumed = true;
+  Serial.printf("resumed: %d intervals, %d ratios, HR=%d, SPO2=%d\n", snapshot.n_interval_count, snapshot.n_ratio_count,
+                beatDetector.heart_rate(), spo2Estimator.spo2());
+  return true;
+}
+
+// the first length samples sit at the IR level of the snapshot
+bool resume_matches(int32_t length){
+  uint64_t sum = 0;
+  for (int32_t i = 0; i < length; i++)
+    sum += irBuffer[i];
+  int32_t dc = (int32_t)(sum / length);
+  int32_t expected = (int32_t)snapshot.aun_dc[GAIN_IR];
+  return abs(dc - expected) * 100 <= expected * resumeDcTolerance;
+}
+
+// mean of the newest hop of a buffer
+uint32_t hop_mean(const uint32_t *buffer){
+  uint64_t sum = 0;
+  for (int32_t i = bufferLength - oneQuaterBuffer; i < bufferLength; i++)
+    sum += buffer[i];
+  return (uint32_t)(sum / oneQuaterBuffer);
+}
+
+// run the spot check schedule, true while a burst is sampled
+bool spot_check(){
+  uint32_t now = millis();
+  if (dutyCycle.capturing() && !dutyCycle.burst_done(now))
+    return true;
+  if (dutyCycle.capturing()) {
+    dutyCycle.finish(now);
+    store_snapshot();
+    resultScheduler.update(heartRate, spo2, result_quality()); // stays published until the next burst
+    sessionRecorder.set_result(heartRate, spo2);
+    Serial.printf("spot check %u: HR=%d, SPO2=%d, sensor %u ms/min, MCU awake %u ms/min\n", dutyCycle.bursts(), heartRate, spo2,
+                  DutyCycleController::per_minute(dutyCycle.sensor_ms(now), dutyCycle.elapsed_ms(now)),
+                  DutyCycleController::per_minute(dutyCycle.awake_ms(now), dutyCycle.elapsed_ms(now)));
+  }
+  if (dutyCycle.due(now)) {
+    dutyCycle.start(now);
+    delay(dutyCycle.settle_ms());
+    particleSensor.clearFIFO(); // nothing sampled while the LEDs settled
+    restart_acquisition();
+    return true;
+  }
+  resultScheduler.poll(now);
+  uint32_t idle = dutyCycle.idle_ms(now);
+  nap(idle < spotNapMs ? idle : spotNapMs);
+  return false;
+}
+
+// wait between bursts: light sleep unless a client is connected, the connection needs the radio running
+void nap(uint32_t ms){
+  if (ms == 0) return;
+  if (deviceConnected) {
+    delay(ms); // the idle task runs, the CPU waits for the next tick
+    return;
+  }
+  Serial.flush(); // the UART stops during light sleep
+  unsigned long sleepStart = micros(); // esp_timer keeps counting through light sleep
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+  // advertising pauses too, a client finds the device between naps
+  if (esp_light_sleep_start() != ESP_OK) { // rejected, e.g. by a pending wakeup source: the MCU stayed awake
+    delay(ms);
+    return;
+  }
+  dutyCycle.add_sleep((micros() - sleepStart) / 1000); // the time actually slept, another wakeup source may end it early
+}
+
+// samples at the end of the window recorded with the current gain setting
+int32_t gain_window_length(){
+  uint32_t since = sampleIndex - gainStepIndex;
+  return since < (uint32_t)bufferLength ? (int32_t)since : bufferLength;
+}
+
+// encode the newest oneQuaterBuffer samples into MTU sized frames and notify them
+void send_waveform(){
+  uint16_t mtu = pServer->getPeerMTU(pServer->getConnId());
+  waveformEncoder.set_max_payload(mtu > 3 ? mtu - 3 : 0); // ATT header takes 3 bytes, unknown MTU falls back to 20
+  uint32_t firstIndex = sampleIndex - oneQuaterBuffer; // sample index of buffer position bufferLength - oneQuaterBuffer
+  waveformEncoder.begin_frame(firstIndex);
+  for (int32_t i = bufferLength - oneQuaterBuffer; i < bufferLength; i++) {
+    if (!waveformEncoder.add_sample(greenBuffer[i], irBuffer[i], redBuffer[i])) { // frame is full
+      waveform_characteristic.setValue((uint8_t*)waveformEncoder.frame(), waveformEncoder.frame_length());
+      waveform_characteristic.notify();
+      waveformEncoder.begin_frame(firstIndex + i - (bufferLength - oneQuaterBuffer));
+      waveformEncoder.add_sample(greenBuffer[i], irBuffer[i], redBuffer[i]);
+    }
+  }
+  waveform_characteristic.setValue((uint8_t*)waveformEncoder.frame(), waveformEncoder.frame_length());
+  waveform_characteristic.notify();
+}
+
+// a beat has been confirmed while sample i of the buffers was read
+void update_beat(int32_t i){
+  // buffer position i holds the newest sample, so the buffers start at sample_count() - 1 - i
+  spo2Estimator.add_beat(beatDetector.last_beat(), irBuffer, redBuffer, beatDetector.sample_count() - 1 - i, i + 1);
+  if (signalQuality != SIGNAL_OK) return; // rejected by the last window check, 999 stays published
+  heartRate = beatDetector.heart_rate();
+  spo2 = spo2Estimator.spo2();
+  resultScheduler.update(heartRate, spo2, result_quality());
+  sessionRecorder.set_result(heartRate, spo2);
+}
+
+// append sample i of the buffers to the recorded session, a no-op while no session is recorded
+void record_samples(int32_t i){
+  if (sessionRecorder.append_sample(greenBuffer[i], irBuffer[i], redBuffer[i])) {
+    uint8_t command = RECORDER_SPILL;
+    xQueueSend(recorderQueue, &command, 0); // never waits: a full queue means recorder_task is busy and drains every ready block anyway
+  }
+}
+
+// spills the session recorder to flash, woken by record_samples once per block and by 's' to finish the session;
+// it runs at the lowest priority on the other core, so a slow LittleFS write never holds up the sampling loop
+void recorder_task(void* parameter){
+  uint8_t command;
+  for (;;) {
+    if (xQueueReceive(recorderQueue, &command, portMAX_DELAY) != pdTRUE) continue;
+    if (command == RECORDER_SPILL) {
+      while (sessionRecorder.block_ready()) {
+        STAGE_SCOPE(STAGE_RECORDER);
+        if (!sessionRecorder.service()) Serial.println(F("session write failed"));
+      }
+    } else if (command == RECORDER_STOP) {
+      if (!sessionRecorder.flush()) Serial.println(F("session flush failed"));
+      Serial.printf("recorded %u samples, %u dropped, %u lost while sampling since power-up\n", sessionRecorder.recorded(),
+                    sessionRecorder.dropped(), particleSensor.getLostSamples());
+    }
+  }
+}
+
+// t: print the stage timing table, z: reset it
+// r: start recording, s: stop, b: export the last session as .ppg, c: export it as CSV
+void serial_command(int command){
+  if (command == 't') {
+    static char report[768];
+    stage_report(report, sizeof(report));
+    Serial.print(report);
+  } else if (command == 'z') {
+    stage_reset();
+  } else if (!recordSession) {
+    return;
+  } else if (command == 'r' && !sessionRecorder.active()) {
+    ppg_record_header config;
+    memset(&config, 0, sizeof(config));
+    config.un_sampling_rate = sampleRate;
+    config.uw_pulse_width = pulseWidth;
+    config.uw_adc_range = autoGain ? gainController.setting().uw_adc_range : adcRange;
+    config.uch_led_mode = ledMode;
+    config.uch_led_brightness = autoGain ? gainController.setting().auch_amplitude[GAIN_GREEN] : ledBrightness;
+    config.uch_sample_average = sampleAverage;
+    if (!sessionRecorder.begin(&config)) Serial.println(F("cannot create the session file"));
+    sessionRecorder.set_result(heartRate, spo2);
+  } else if (command == 's' && sessionRecorder.active()) {
+    uint8_t stop = RECORDER_STOP;
+    xQueueSend(recorderQueue, &stop, portMAX_DELAY); // recorder_task flushes and reports
+  } else if (command == 'b' && !sessionRecorder.active()) {
+    sessionRecorder.export_binary(&serialOutput);
+  } else if (command == 'c' && !sessionRecorder.active()) {
+    sessionRecorder.export_csv(&serialOutput);
+  }
+}
+
+// refresh the stage timing table a client can read from the diagnostics characteristic
+void update_diagnostics(){
+  uint8_t packed[STAGE_COUNT * 21];
+  int32_t length = stage_pack(packed, sizeof(packed));
+  diagnostics_characteristic.setValue(packed, length);
+}
+
+// quality code published with the result
+uint8_t result_quality(){
+  if (signalQuality != SIGNAL_OK) return RESULT_QUALITY_INVALID;
+  if (heartRate == 999 && spo2 == 999) return RESULT_QUALITY_INVALID;
+  if (heartRate == 999 || spo2 == 999) return RESULT_QUALITY_QUESTIONABLE;
+  if (warmingUp) return RESULT_QUALITY_EARLY; // window not full yet
+  if (!streamingMode && gain_window_length() < bufferLength) return RESULT_QUALITY_EARLY; // part of the window before a gain step is left out
+  if (streamingMode && beatDetector.interval_count() < BEAT_DETECTOR_INTERVALS) return RESULT_QUALITY_EARLY;
+  return RESULT_QUALITY_VALID;
+}
+
+// add new samples to the plot and send only the changed columns to the display
+void drawCruve(uint32_t *dataBuffer, int32_t bufferLength){
+  for (int32_t i = 0; i < bufferLength; i++)
+    wavePlot.push(dataBuffer[i]);
+  int16_t first, last;
+  while (wavePlot.take_dirty(&first, &last))
+    display_columns(first, last);
+}
+
+// send columns first to last of all pages from the display buffer
+void display_columns(int16_t first, int16_t last){
+  const uint8_t *buffer = display.getBuffer();
+  display.ssd1306_command(SSD1306_PAGEADDR);
+  display.ssd1306_command(0);
+  display.ssd1306_command(SCREEN_HEIGHT / 8 - 1);
+  display.ssd1306_command(SSD1306_COLUMNADDR);
+  display.ssd1306_command(first);
+  display.ssd1306_command(last);
+  // horizontal addressing: the run of each page in turn, in I2C writes of up to 31 data bytes
+  for (int16_t page = 0; page < SCREEN_HEIGHT / 8; page++) {
+    for (int16_t x = first; x <= last; ) {
+      Wire.beginTransmission(SCREEN_ADDRESS);
+      Wire.write(0x40); // data
+      for (int16_t n = 0; n < 31 && x <= last; n++, x++)
+        Wire.write(buffer[x + page * SCREEN_WIDTH]);
+      Wire.endTransmission();
+    }
   }
-  display.display();
-  // refresh display every 0.5 second
-  // delay(500);
 }
 
 void BLE_set_up(){
@@ -260,21 +778,28 @@ void BLE_set_up(){
   BLEDevice::init(BLESERVERNAME);
 
   // 2. Create the BLE Server
-  BLEServer *pServer = BLEDevice::createServer();
+  pServer = BLEDevice::createServer();
   pServer->setCallbacks(new MyServerCallbacks());
 
-  // 3. Create three BLE Services
-  // BLEService *pService_sensor = pServer->createService(SERVICE_SENSOR_UUID);
+  // 3. Create four BLE Services
+  BLEService *pService_sensor = pServer->createService(SERVICE_SENSOR_UUID);
   BLEService *pService_hr = pServer->createService(SERVICE_HR_UUID);
-  // BLEService *pService_spo2 = pServer->createService(SERVICE_SPO2_UUID);
+  BLEService *pService_spo2 = pServer->createService(SERVICE_SPO2_UUID);
+  BLEService *pService_plx = pServer->createService(BLEUUID(SERVICE_PLX_UUID));
 
-  // 4. Create five BLE Characteristics
+  // 4. Create the BLE Characteristics
+  pService_sensor->addCharacteristic(&waveform_characteristic); // carries the interleaved green, IR and red frames
   // pService_sensor->addCharacteristic(&green_characteristic);
+  pService_sensor->addCharacteristic(&diagnostics_characteristic); // per stage timing, read on demand
   // pService_sensor->addCharacteristic(&ir_characteristic);
   // pService_sensor->addCharacteristic(&red_characteristic);
-  pService_hr->addCharacteristic(&frequency_characteristic);
-  // pService_spo2->addCharacteristic(&percentage_characteristic);
+  pService_hr->addCharacteristic(&frequency_characteristic); // heart rate as Int16, for older clients
+  pService_spo2->addCharacteristic(&percentage_characteristic); // SpO2 as Int16, for older clients
+  pService_plx->addCharacteristic(&plx_characteristic); // SpO2, pulse rate and status as SFLOAT, see notify_scheduler.h
+  pService_plx->addCharacteristic(&plx_features_characteristic);
 
+  waveform_descriptor.setValue("frame");
+  waveform_characteristic.addDescriptor(&waveform_descriptor);
   // green_descriptor.setValue("bit");
   // green_characteristic.addDescriptor(&green_descriptor);
   // ir_descriptor.setValue("bit");
@@ -283,19 +808,23 @@ void BLE_set_up(){
   // red_characteristic.addDescriptor(&red_descriptor);
   frequency_descriptor.setValue("Hz");
   frequency_characteristic.addDescriptor(&frequency_descriptor);
-  // percentage_descriptor.setValue("%");
-  // percentage_characteristic.addDescriptor(&percentage_descriptor);
+  percentage_descriptor.setValue("%");
+  percentage_characteristic.addDescriptor(&percentage_descriptor);
+  plx_characteristic.addDescriptor(&plx_descriptor);
+  plx_features_characteristic.setValue((uint8_t*)plxFeatures, sizeof(plxFeatures));
 
   // 5. Start the service
-  // pService_sensor->start();
+  pService_sensor->start();
   pService_hr->start();
-  // pService_spo2->start();
+  pService_spo2->start();
+  pService_plx->start();
 
   // 6. Start advertising
   BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
-  // pAdvertising->addServiceUUID(SERVICE_SENSOR_UUID);
+  pAdvertising->addServiceUUID(SERVICE_SENSOR_UUID);
   pAdvertising->addServiceUUID(SERVICE_HR_UUID);
-  // pAdvertising->addServiceUUID(SERVICE_SPO2_UUID);
+  pAdvertising->addServiceUUID(SERVICE_SPO2_UUID);
+  pAdvertising->addServiceUUID(BLEUUID(SERVICE_PLX_UUID));
   BLEDevice::startAdvertising(); // only pin one device and then stop advertising after connect successfully
   // Serial.println("Waiting a client connection to notify...");
 }
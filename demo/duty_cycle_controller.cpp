@@ -0,0 +1,70 @@
+#include "duty_cycle_controller.h"
+
+DutyCycleController::DutyCycleController(DutyCycleSensor* sensor, uint32_t period_ms, uint32_t burst_ms, uint32_t settle_ms)
+  : p_sensor(sensor), un_period_ms(period_ms), un_burst_ms(burst_ms), un_settle_ms(settle_ms), b_capturing(false), b_started(false),
+    un_begin_ms(0), un_start_ms(0), un_sensor_ms(0), un_sleep_ms(0), un_bursts(0)
+{
+}
+
+void DutyCycleController::begin(uint32_t un_now_ms)
+{
+  un_begin_ms = un_start_ms = un_now_ms;
+  un_sensor_ms = un_sleep_ms = 0;
+  un_bursts = 0;
+  b_capturing = b_started = false;
+  p_sensor->shut_down();
+}
+
+bool DutyCycleController::due(uint32_t un_now_ms) const
+{
+  return !b_capturing && idle_ms(un_now_ms) == 0;
+}
+
+void DutyCycleController::start(uint32_t un_now_ms)
+{
+  if (b_capturing) return;
+  b_capturing = b_started = true;
+  un_start_ms = un_now_ms;
+  un_bursts++;
+  p_sensor->wake();
+}
+
+bool DutyCycleController::burst_done(uint32_t un_now_ms) const
+{
+  return b_capturing && un_now_ms - un_start_ms >= un_settle_ms + un_burst_ms;
+}
+
+void DutyCycleController::finish(uint32_t un_now_ms)
+{
+  if (!b_capturing) return;
+  b_capturing = false;
+  un_sensor_ms += un_now_ms - un_start_ms;
+  p_sensor->shut_down();
+}
+
+uint32_t DutyCycleController::idle_ms(uint32_t un_now_ms) const
+/**
+* \brief        Time left until the next burst
+* \par          Details
+*               Bursts start one period apart. A burst that took longer than the period, e.g. because
+*               the window pipeline ran long, makes the next one due at once instead of skipping it.
+*
+* \param[in]    un_now_ms               - current time in ms (millis())
+*
+* \retval       ms until due(), 0 while a burst runs or once it is due
+*/
+{
+  if (b_capturing || !b_started) return 0;
+  uint32_t un_since = un_now_ms - un_start_ms;
+  return un_since < un_period_ms ? un_period_ms - un_since : 0;
+}
+
+uint32_t DutyCycleController::sensor_ms(uint32_t un_now_ms) const
+{
+  return un_sensor_ms + (b_capturing ? un_now_ms - un_start_ms : 0);
+}
+
+uint32_t DutyCycleController::per_minute(uint32_t un_ms, uint32_t un_elapsed_ms)
+{
+  return un_elapsed_ms > 0 ? (uint32_t)((uint64_t)un_ms * 60000 / un_elapsed_ms) : 0;
+}
@@ -0,0 +1,70 @@
+/** \file duty_cycle_controller.h *******************************************
+*
+* Description: Scheduled spot checks instead of continuous sampling. Every
+*              period the sensor is woken, left to settle, sampled for one
+*              burst, and the result of the burst is published; then the
+*              sensor is shut down and the MCU sleeps until the next
+*              period. The controller keeps the schedule and the energy
+*              proxies: time the sensor was awake and time the MCU was not
+*              in light sleep, both as ms per minute. The sensor side is a
+*              DutyCycleSensor (the MAX30105 in demo.ino, a fake clock in
+*              tools/duty_cycle_sim).
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef DUTY_CYCLE_CONTROLLER_H_
+#define DUTY_CYCLE_CONTROLLER_H_
+
+#include <stdint.h>
+
+#define DUTY_CYCLE_PERIOD_MS 60000 // one spot check per minute
+#define DUTY_CYCLE_BURST_MS 15000  // a full window at 400 sps and 8 beat intervals for the streaming median
+#define DUTY_CYCLE_SETTLE_MS 100   // after wakeUp(), before the first sample is kept
+
+// the sensor side of the schedule
+class DutyCycleSensor {
+ public:
+  virtual ~DutyCycleSensor(void) {}
+  virtual void wake(void) = 0;      // leave shutdown, sampling restarts
+  virtual void shut_down(void) = 0; // LEDs and ADC off, registers kept
+};
+
+class DutyCycleController {
+ public:
+  DutyCycleController(DutyCycleSensor* p_sensor, uint32_t un_period_ms = DUTY_CYCLE_PERIOD_MS,
+                      uint32_t un_burst_ms = DUTY_CYCLE_BURST_MS, uint32_t un_settle_ms = DUTY_CYCLE_SETTLE_MS);
+
+  void begin(uint32_t un_now_ms); // sensor shut down, the first burst is due at once
+  bool due(uint32_t un_now_ms) const; // idle and a period has passed since the last burst started
+  void start(uint32_t un_now_ms); // wake the sensor, samples count after settle_ms()
+  bool burst_done(uint32_t un_now_ms) const; // burst_ms sampled after settling
+  void finish(uint32_t un_now_ms); // shut the sensor down after the burst
+  uint32_t idle_ms(uint32_t un_now_ms) const; // until the next burst is due, 0 while one runs
+  void add_sleep(uint32_t un_ms) { un_sleep_ms += un_ms; } // MCU light sleep, for awake_ms()
+
+  bool capturing(void) const { return b_capturing; }
+  uint32_t settle_ms(void) const { return un_settle_ms; }
+  uint32_t bursts(void) const { return un_bursts; }
+  uint32_t elapsed_ms(uint32_t un_now_ms) const { return un_now_ms - un_begin_ms; }
+  uint32_t sensor_ms(uint32_t un_now_ms) const; // sensor awake since begin()
+  uint32_t awake_ms(uint32_t un_now_ms) const { return elapsed_ms(un_now_ms) - un_sleep_ms; } // MCU not in light sleep since begin()
+  static uint32_t per_minute(uint32_t un_ms, uint32_t un_elapsed_ms); // energy proxy, ms per minute of elapsed time
+
+ private:
+  DutyCycleSensor* p_sensor;
+  uint32_t un_period_ms;
+  uint32_t un_burst_ms;
+  uint32_t un_settle_ms;
+  bool b_capturing;
+  bool b_started;        // a burst has started since begin()
+  uint32_t un_begin_ms;
+  uint32_t un_start_ms;  // start of the newest burst
+  uint32_t un_sensor_ms; // closed bursts
+  uint32_t un_sleep_ms;
+  uint32_t un_bursts;
+};
+
+#endif /* DUTY_CYCLE_CONTROLLER_H_ */
@@ -0,0 +1,74 @@
+/** \file fixed_point.h *****************************************************
+*
+* Description: Q16.16 fixed-point helpers for the SpO2 ratio, the perfusion
+*              index and the autocorrelation engine. All products and
+*              quotients go through 64-bit intermediates and are saturated
+*              to the 32-bit range, so full scale 18-bit samples can be
+*              multiplied together without overflow and cores without an
+*              FPU never touch soft-float.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef FIXED_POINT_H_
+#define FIXED_POINT_H_
+
+#include <stdint.h>
+
+typedef int32_t q16_t; // Q16.16: 16 integer bits (with sign), 16 fractional bits
+
+#define Q16_SHIFT 16
+#define Q16_ONE ((q16_t)1 << Q16_SHIFT)
+#define Q16_MAX ((q16_t)0x7FFFFFFF)
+#define Q16_MIN ((q16_t)0x80000000)
+// compile-time conversion of a constant, e.g. Q16_CONST(0.6f)
+#define Q16_CONST(x) ((q16_t)((x) * 65536.0f + ((x) >= 0 ? 0.5f : -0.5f)))
+
+static inline int32_t fx_saturate(int64_t n_value)
+{
+  if (n_value > INT32_MAX) return INT32_MAX;
+  if (n_value < INT32_MIN) return INT32_MIN;
+  return (int32_t)n_value;
+}
+
+static inline q16_t q16_from_int(int32_t n_value)
+{
+  return fx_saturate((int64_t)n_value << Q16_SHIFT);
+}
+
+// integer part, rounded towards zero
+static inline int32_t q16_to_int(q16_t n_value)
+{
+  return n_value >= 0 ? n_value >> Q16_SHIFT : -((-(int64_t)n_value) >> Q16_SHIFT);
+}
+
+static inline q16_t q16_mul(q16_t n_a, q16_t n_b)
+{
+  return fx_saturate(((int64_t)n_a * n_b) >> Q16_SHIFT);
+}
+
+// n_num / n_den as Q16.16, saturated; a zero denominator saturates towards the sign of the numerator
+static inline q16_t q16_ratio(int64_t n_num, int64_t n_den)
+{
+  if (n_den < 0) { n_num = -n_num; n_den = -n_den; }
+  // keep n_num << 16 inside 64 bits by dropping low bits of both operands
+  while (n_num >= ((int64_t)1 << 46) || n_num <= -((int64_t)1 << 46)) { n_num /= 2; n_den /= 2; }
+  if (n_den == 0) return n_num >= 0 ? Q16_MAX : Q16_MIN;
+  return fx_saturate((n_num << Q16_SHIFT) / n_den);
+}
+
+static inline q16_t q16_div(q16_t n_a, q16_t n_b)
+{
+  return q16_ratio(n_a, n_b);
+}
+
+// n_a * n_b / n_c with a 64-bit intermediate product, saturated
+static inline int32_t fx_mul_div(int32_t n_a, int32_t n_b, int32_t n_c)
+{
+  if (n_c == 0) return ((int64_t)n_a * n_b) >= 0 ? INT32_MAX : INT32_MIN;
+  return fx_saturate((int64_t)n_a * n_b / n_c);
+}
+
+#endif /* FIXED_POINT_H_ */
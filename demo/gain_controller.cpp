@@ -0,0 +1,116 @@
+#include "gain_controller.h"
+
+GainController::GainController(GainSensor* sensor, uint8_t low_hops)
+  : p_sensor(sensor), uch_low_hops(low_hops), un_steps(0)
+{
+  begin(0x1F, 4096);
+}
+
+void GainController::begin(uint8_t uch_amplitude, uint16_t uw_adc_range)
+{
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++) {
+    current.auch_amplitude[c] = uch_amplitude;
+    auch_dark[c] = 0;
+  }
+  current.uw_adc_range = uw_adc_range;
+  un_steps = 0;
+}
+
+void GainController::resume(const gain_setting& setting)
+{
+  current = setting;
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+    auch_dark[c] = 0;
+  p_sensor->apply(current);
+}
+
+// amplitude that moves a DC level to GAIN_TARGET_DC, the counts follow the LED current
+static uint8_t target_amplitude(uint8_t uch_amplitude, uint32_t un_dc)
+{
+  uint32_t un_amplitude = un_dc > 0 ? (uint32_t)uch_amplitude * GAIN_TARGET_DC / un_dc : GAIN_MAX_AMPLITUDE;
+  if (un_amplitude < GAIN_MIN_AMPLITUDE) return GAIN_MIN_AMPLITUDE;
+  if (un_amplitude > GAIN_MAX_AMPLITUDE) return GAIN_MAX_AMPLITUDE;
+  return (uint8_t)un_amplitude;
+}
+
+bool GainController::update(const uint32_t* pun_red, const uint32_t* pun_ir, const uint32_t* pun_green, int32_t n_length)
+/**
+* \brief        Check the newest hop and step the gain
+* \par          Details
+*               A channel whose hop reaches GAIN_CLIP is lowered right away, to at most half its
+*               amplitude; at GAIN_MIN_AMPLITUDE the ADC range is widened instead. A channel below
+*               GAIN_LOW_DC whose hop spans less than GAIN_LOW_SWING for uch_low_hops hops in a row is
+*               raised; at GAIN_MAX_AMPLITUDE the range is narrowed instead, but only if no channel would
+*               then pass GAIN_HIGH_PEAK. Anything in between keeps its setting. The range doubles or
+*               halves the counts of all channels. Without a finger (IR DC below GAIN_CONTACT_DC) the dark
+*               counters stay at zero.
+*
+* \param[in]    *pun_red                - Red samples of the hop
+* \param[in]    *pun_ir                 - IR samples of the hop
+* \param[in]    *pun_green              - Green samples of the hop
+* \param[in]    n_length                - number of samples in the hop
+*
+* \retval       true if the sensor has been given a new setting
+*/
+{
+  const uint32_t* apun_hop[GAIN_CHANNELS] = { pun_red, pun_ir, pun_green };
+  uint32_t aun_dc[GAIN_CHANNELS], aun_max[GAIN_CHANNELS], aun_min[GAIN_CHANNELS];
+  bool b_overflow = p_sensor->ambient_overflow(); // read every hop so an old flag does not linger
+  if (n_length <= 0) return false;
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++) {
+    uint64_t un_sum = 0;
+    uint32_t un_max = 0, un_min = UINT32_MAX;
+    for (int32_t k = 0; k < n_length; k++) {
+      uint32_t un_x = apun_hop[c][k];
+      un_sum += un_x;
+      if (un_x > un_max) un_max = un_x;
+      if (un_x < un_min) un_min = un_x;
+    }
+    aun_dc[c] = (uint32_t)(un_sum / n_length);
+    aun_max[c] = un_max;
+    aun_min[c] = un_min;
+  }
+
+  gain_setting next = current;
+  bool b_widen = b_overflow; // the ambient light cancellation ran out, a wider range leaves room for it
+  bool b_narrow = false;
+  bool b_contact = aun_dc[GAIN_IR] >= GAIN_CONTACT_DC;
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++) {
+    uint8_t uch_amplitude = current.auch_amplitude[c];
+    if (aun_max[c] >= GAIN_CLIP) {
+      auch_dark[c] = 0;
+      if (uch_amplitude > GAIN_MIN_AMPLITUDE) {
+        uint8_t uch_lower = target_amplitude(uch_amplitude, aun_dc[c]);
+        uint8_t uch_half = uch_amplitude / 2 > GAIN_MIN_AMPLITUDE ? uch_amplitude / 2 : GAIN_MIN_AMPLITUDE;
+        next.auch_amplitude[c] = uch_lower < uch_half ? uch_lower : uch_half; // clipped samples hide part of the DC
+      } else
+        b_widen = true;
+    } else if (b_contact && aun_dc[c] < GAIN_LOW_DC && aun_max[c] - aun_min[c] < GAIN_LOW_SWING) {
+      if (++auch_dark[c] < uch_low_hops) continue;
+      auch_dark[c] = 0;
+      if (uch_amplitude < GAIN_MAX_AMPLITUDE)
+        next.auch_amplitude[c] = target_amplitude(uch_amplitude, aun_dc[c]);
+      else
+        b_narrow = true;
+    } else
+      auch_dark[c] = 0;
+  }
+
+  if (b_widen && current.uw_adc_range < GAIN_MAX_ADC_RANGE) {
+    next.uw_adc_range = current.uw_adc_range * 2;
+  } else if (!b_widen && b_narrow && current.uw_adc_range > GAIN_MIN_ADC_RANGE) {
+    bool b_room = true;
+    for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+      if (next.auch_amplitude[c] == current.auch_amplitude[c] && aun_max[c] * 2 >= GAIN_HIGH_PEAK) b_room = false;
+    if (b_room) next.uw_adc_range = current.uw_adc_range / 2;
+  }
+
+  bool b_changed = next.uw_adc_range != current.uw_adc_range;
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+    if (next.auch_amplitude[c] != current.auch_amplitude[c]) b_changed = true;
+  if (!b_changed) return false;
+  current = next;
+  un_steps++;
+  p_sensor->apply(current);
+  return true;
+}
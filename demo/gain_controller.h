@@ -0,0 +1,87 @@
+/** \file gain_controller.h *************************************************
+*
+* Description: Automatic gain of the LEDs and the ADC. After each hop the
+*              DC level and the range of the hop are checked per channel:
+*              a channel that clips at the 18-bit ceiling has its LED
+*              amplitude lowered at once, a channel that stays dark with a
+*              pulse too small for the ADC resolution for GAIN_LOW_HOPS
+*              hops has it raised, both proportionally so the DC lands on
+*              GAIN_TARGET_DC. A signal between the two is left alone even
+*              far from the target: each step costs the samples until the
+*              window pipeline has enough of the new setting. When an LED is already at its limit the
+*              shared ADC range is stepped instead, and an ambient light
+*              cancellation overflow (ALC_OVF) widens the range directly.
+*              Nothing is raised without a finger. The R ratio of SpO2
+*              divides AC by DC per channel, so a gain step does not change
+*              it as long as no beat spans the step: the caller blanks
+*              settle_samples() of the beat detector and evaluates only the
+*              part of the window recorded with the new setting. The
+*              controller only decides, the sensor side is a GainSensor
+*              (the MAX30105 in demo.ino, a simulated sensor in
+*              tools/gain_sim).
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef GAIN_CONTROLLER_H_
+#define GAIN_CONTROLLER_H_
+
+#include <stdint.h>
+
+#define GAIN_CHANNELS 3
+#define GAIN_MIN_AMPLITUDE 0x02          // 0.4 mA
+#define GAIN_MAX_AMPLITUDE 0xFF          // 51 mA
+#define GAIN_MIN_ADC_RANGE 2048          // nA full scale, the most sensitive range
+#define GAIN_MAX_ADC_RANGE 16384
+#define GAIN_LOW_DC (1L << 13)           // 1/32 of full scale, a darker channel with a small pulse is raised
+#define GAIN_LOW_SWING (1L << 7)         // pulse of a hop below 128 counts, 16 steps at the 15-bit resolution of pulse width 69
+#define GAIN_TARGET_DC (1L << 15)        // 1/8 of full scale, where a step lands
+#define GAIN_CLIP ((1L << 18) - 1)       // 18-bit ceiling, a hop reaching it has clipped and is lowered
+#define GAIN_HIGH_PEAK ((1L << 18) / 8 * 7) // the range is only narrowed if no channel would reach 7/8 of full scale
+#define GAIN_CONTACT_DC 5000             // min_ir_dc of spo2_algorithm.cpp, below it nothing is raised
+#define GAIN_LOW_HOPS 4                  // 2.6 s at 400 sps and hop 256
+#define GAIN_SETTLE_MS 50                // samples blanked after a step
+
+enum gain_channel {
+  GAIN_RED = 0,
+  GAIN_IR = 1,
+  GAIN_GREEN = 2
+};
+
+typedef struct {
+  uint8_t auch_amplitude[GAIN_CHANNELS]; // LED pulse amplitude, 0.2 mA per step, indexed by gain_channel
+  uint16_t uw_adc_range;                 // nA full scale: 2048, 4096, 8192 or 16384
+} gain_setting;
+
+// the sensor side of the controller
+class GainSensor {
+ public:
+  virtual ~GainSensor(void) {}
+  virtual void apply(const gain_setting& setting) = 0; // write the amplitudes and the range, later samples use them
+  virtual bool ambient_overflow(void) = 0;             // ALC_OVF raised since the last call
+};
+
+class GainController {
+ public:
+  GainController(GainSensor* p_sensor, uint8_t uch_low_hops = GAIN_LOW_HOPS);
+
+  void begin(uint8_t uch_amplitude, uint16_t uw_adc_range); // setting already written by particleSensor.setup()
+  // the newest hop of each channel, true if a new setting has been applied
+  bool update(const uint32_t* pun_red, const uint32_t* pun_ir, const uint32_t* pun_green, int32_t n_length);
+
+  void resume(const gain_setting& setting); // setting of a snapshot, written to the sensor
+  const gain_setting& setting(void) const { return current; }
+  uint32_t steps(void) const { return un_steps; }
+  static int32_t settle_samples(int32_t n_sampling_rate) { return n_sampling_rate * GAIN_SETTLE_MS / 1000; }
+
+ private:
+  GainSensor* p_sensor;
+  uint8_t uch_low_hops;
+  uint8_t auch_dark[GAIN_CHANNELS]; // consecutive hops below GAIN_LOW_DC with a pulse below GAIN_LOW_SWING
+  gain_setting current;
+  uint32_t un_steps;
+};
+
+#endif /* GAIN_CONTROLLER_H_ */
@@ -0,0 +1,47 @@
+#include <LittleFS.h>
+#include "littlefs_storage.h"
+
+LittleFSStorage::LittleFSStorage(const char* path)
+  : s_path(path), b_mounted(false)
+{
+}
+
+bool LittleFSStorage::begin(void)
+{
+  b_mounted = LittleFS.begin(true);
+  return b_mounted;
+}
+
+bool LittleFSStorage::clear(void)
+{
+  if (!b_mounted) return false;
+  if (file) file.close();
+  file = LittleFS.open(s_path, "w");
+  return (bool)file;
+}
+
+bool LittleFSStorage::append(const uint8_t* puch_data, uint32_t un_length)
+{
+  if (!file) file = LittleFS.open(s_path, "a");
+  if (!file) return false;
+  return file.write(puch_data, un_length) == un_length;
+}
+
+bool LittleFSStorage::read(uint32_t un_offset, uint8_t* puch_data, uint32_t un_length)
+{
+  if (file) file.close(); // a session is exported after it ended, reopen for reading
+  File input = LittleFS.open(s_path, "r");
+  if (!input || !input.seek(un_offset)) return false;
+  bool b_ok = input.read(puch_data, un_length) == un_length;
+  input.close();
+  return b_ok;
+}
+
+uint32_t LittleFSStorage::size(void)
+{
+  if (file) return file.size();
+  File input = LittleFS.open(s_path, "r");
+  uint32_t un_size = input ? input.size() : 0;
+  if (input) input.close();
+  return un_size;
+}
@@ -0,0 +1,34 @@
+/** \file littlefs_storage.h ************************************************
+*
+* Description: RecordStorage on a LittleFS file in the ESP32 flash, used by
+*              the session recorder. Writes arrive in RECORDER_BLOCK_BYTES
+*              blocks, so the file grows by whole flash sectors.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef LITTLEFS_STORAGE_H_
+#define LITTLEFS_STORAGE_H_
+
+#include <FS.h>
+#include "session_recorder.h"
+
+class LittleFSStorage : public RecordStorage {
+ public:
+  LittleFSStorage(const char* s_path);
+
+  bool begin(void); // mounts LittleFS, formats it on the first run
+  virtual bool clear(void);
+  virtual bool append(const uint8_t* puch_data, uint32_t un_length);
+  virtual bool read(uint32_t un_offset, uint8_t* puch_data, uint32_t un_length);
+  virtual uint32_t size(void);
+
+ private:
+  const char* s_path;
+  File file; // open for appending between clear() and read()
+  bool b_mounted;
+};
+
+#endif /* LITTLEFS_STORAGE_H_ */
@@ -0,0 +1,254 @@
+/** \file median_networks.h ************************************************
+*
+* Description: Median selection networks for sizes 1 to 32, generated by
+*              tools/median_network_gen (Batcher's merge-exchange network
+*              pruned to the comparators the middle positions depend on).
+*              Do not edit, regenerate instead. Only small_median.cpp
+*              includes it.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef MEDIAN_NETWORKS_H_
+#define MEDIAN_NETWORKS_H_
+
+#include <stdint.h>
+
+#define MEDIAN_NETWORK_MAX 32
+
+// comparators of size n: median_network_pairs[median_network_start[n]] up to median_network_start[n + 1]
+static const uint16_t median_network_start[MEDIAN_NETWORK_MAX + 2] = {0, 0, 0, 1, 4, 9, 17, 29, 43, 60, 82, 111, 142, 177, 217, 264, 313, 366, 427, 499, 574, 655, 743, 841, 941, 1046, 1159, 1283, 1410, 1543, 1683, 1833, 1985, 2142};
+
+// lower and upper position of each comparator
+static const uint8_t median_network_pairs[2142][2] = {
+  // 2: 1 comparators
+  {0, 1},
+  // 3: 3 comparators
+  {0, 2}, {0, 1}, {1, 2},
+  // 4: 5 comparators
+  {0, 2}, {1, 3}, {0, 1}, {2, 3}, {1, 2},
+  // 5: 8 comparators
+  {0, 4}, {0, 2}, {1, 3}, {2, 4}, {0, 1}, {2, 3}, {1, 4}, {1, 2},
+  // 6: 12 comparators
+  {0, 4}, {1, 5}, {0, 2}, {1, 3}, {2, 4}, {3, 5}, {0, 1}, {2, 3}, {4, 5}, {1, 4}, {1, 2}, {3, 4},
+  // 7: 14 comparators
+  {0, 4}, {1, 5}, {2, 6}, {0, 2}, {1, 3}, {4, 6}, {2, 4}, {3, 5}, {0, 1}, {2, 3}, {4, 5}, {1, 4},
+  {3, 6}, {3, 4},
+  // 8: 17 comparators
+  {0, 4}, {1, 5}, {2, 6}, {3, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {2, 4}, {3, 5}, {0, 1}, {2, 3},
+  {4, 5}, {6, 7}, {1, 4}, {3, 6}, {3, 4},
+  // 9: 22 comparators
+  {0, 8}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {4, 8}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {2, 8}, {2, 4},
+  {3, 5}, {6, 8}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {1, 8}, {1, 4}, {3, 6}, {3, 4},
+  // 10: 29 comparators
+  {0, 8}, {1, 9}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {4, 8}, {5, 9}, {0, 2}, {1, 3}, {4, 6}, {5, 7},
+  {2, 8}, {3, 9}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {1, 8},
+  {1, 4}, {3, 6}, {5, 8}, {3, 4}, {5, 6},
+  // 11: 31 comparators
+  {0, 8}, {1, 9}, {2, 10}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {4, 8}, {5, 9}, {6, 10}, {0, 2}, {1, 3},
+  {4, 6}, {5, 7}, {8, 10}, {2, 8}, {3, 9}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {0, 1}, {2, 3}, {4, 5},
+  {6, 7}, {8, 9}, {1, 8}, {3, 10}, {3, 6}, {5, 8}, {5, 6},
+  // 12: 35 comparators
+  {0, 8}, {1, 9}, {2, 10}, {3, 11}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {4, 8}, {5, 9}, {6, 10}, {7, 11},
+  {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {2, 8}, {3, 9}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+  {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {1, 8}, {3, 10}, {3, 6}, {5, 8}, {5, 6},
+  // 13: 40 comparators
+  {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {4, 8}, {5, 9},
+  {6, 10}, {7, 11}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {2, 8}, {3, 9}, {6, 12}, {2, 4},
+  {3, 5}, {6, 8}, {7, 9}, {10, 12}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {1, 8}, {3, 10},
+  {5, 12}, {3, 6}, {5, 8}, {5, 6},
+  // 14: 47 comparators
+  {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13},
+  {4, 8}, {5, 9}, {6, 10}, {7, 11}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {2, 8}, {3, 9},
+  {6, 12}, {7, 13}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {0, 1}, {2, 3}, {4, 5}, {6, 7},
+  {8, 9}, {10, 11}, {12, 13}, {1, 8}, {3, 10}, {5, 12}, {3, 6}, {5, 8}, {7, 10}, {5, 6}, {7, 8},
+  // 15: 49 comparators
+  {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12},
+  {9, 13}, {10, 14}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11},
+  {12, 14}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {0, 1},
+  {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {1, 8}, {3, 10}, {5, 12}, {7, 14}, {5, 8}, {7, 10},
+  {7, 8},
+  // 16: 53 comparators
+  {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+  {8, 12}, {9, 13}, {10, 14}, {11, 15}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {0, 2}, {1, 3}, {4, 6}, {5, 7},
+  {8, 10}, {9, 11}, {12, 14}, {13, 15}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+  {10, 12}, {11, 13}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {1, 8}, {3, 10},
+  {5, 12}, {7, 14}, {5, 8}, {7, 10}, {7, 8},
+  // 17: 61 comparators
+  {0, 16}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {8, 16}, {0, 4}, {1, 5},
+  {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {4, 16}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16},
+  {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {2, 16}, {2, 8}, {3, 9}, {6, 12},
+  {7, 13}, {10, 16}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {0, 1}, {2, 3}, {4, 5},
+  {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {1, 16}, {1, 8}, {3, 10}, {5, 12}, {7, 14}, {5, 8}, {7, 10},
+  {7, 8},
+  // 18: 72 comparators
+  {0, 16}, {1, 17}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {8, 16}, {9, 17},
+  {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {4, 16}, {5, 17}, {4, 8}, {5, 9},
+  {6, 10}, {7, 11}, {12, 16}, {13, 17}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+  {2, 16}, {3, 17}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+  {10, 12}, {11, 13}, {14, 16}, {15, 17}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15},
+  {16, 17}, {1, 16}, {1, 8}, {3, 10}, {5, 12}, {7, 14}, {9, 16}, {5, 8}, {7, 10}, {9, 12}, {7, 8}, {9, 10},
+  // 19: 75 comparators
+  {0, 16}, {1, 17}, {2, 18}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {8, 16},
+  {9, 17}, {10, 18}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {4, 16}, {5, 17},
+  {6, 18}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {0, 2}, {1, 3}, {4, 6}, {5, 7},
+  {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {2, 16}, {3, 17}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16},
+  {11, 17}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {0, 1}, {2, 3}, {4, 5},
+  {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {1, 16}, {3, 18}, {3, 10}, {5, 12}, {7, 14}, {9, 16},
+  {7, 10}, {9, 12}, {9, 10},
+  // 20: 81 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15},
+  {8, 16}, {9, 17}, {10, 18}, {11, 19}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15},
+  {4, 16}, {5, 17}, {6, 18}, {7, 19}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19},
+  {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {2, 16}, {3, 17},
+  {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13},
+  {14, 16}, {15, 17}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19},
+  {1, 16}, {3, 18}, {3, 10}, {5, 12}, {7, 14}, {9, 16}, {7, 10}, {9, 12}, {9, 10},
+  // 21: 88 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14},
+  {7, 15}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13},
+  {10, 14}, {11, 15}, {16, 20}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16},
+  {13, 17}, {14, 18}, {15, 19}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18},
+  {17, 19}, {2, 16}, {3, 17}, {6, 20}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {2, 4},
+  {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {0, 1}, {2, 3}, {4, 5}, {6, 7},
+  {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19}, {1, 16}, {3, 18}, {5, 20}, {3, 10}, {5, 12}, {7, 14},
+  {9, 16}, {7, 10}, {9, 12}, {9, 10},
+  // 22: 98 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13},
+  {6, 14}, {7, 15}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+  {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {4, 8}, {5, 9},
+  {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11},
+  {12, 14}, {13, 15}, {16, 18}, {17, 19}, {2, 16}, {3, 17}, {6, 20}, {7, 21}, {2, 8}, {3, 9}, {6, 12}, {7, 13},
+  {10, 16}, {11, 17}, {14, 20}, {15, 21}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17},
+  {18, 20}, {19, 21}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19},
+  {20, 21}, {1, 16}, {3, 18}, {5, 20}, {3, 10}, {5, 12}, {7, 14}, {9, 16}, {11, 18}, {7, 10}, {9, 12}, {11, 14},
+  {9, 10}, {11, 12},
+  // 23: 100 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12},
+  {5, 13}, {6, 14}, {7, 15}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {14, 22}, {0, 4}, {1, 5},
+  {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21}, {18, 22}, {4, 16}, {5, 17}, {6, 18},
+  {7, 19}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19}, {0, 2}, {1, 3}, {4, 6},
+  {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22}, {2, 16}, {3, 17}, {6, 20}, {7, 21},
+  {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+  {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {19, 21}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11},
+  {12, 13}, {14, 15}, {16, 17}, {18, 19}, {20, 21}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {5, 12}, {7, 14}, {9, 16},
+  {11, 18}, {9, 12}, {11, 14}, {11, 12},
+  // 24: 105 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {0, 8}, {1, 9}, {2, 10}, {3, 11},
+  {4, 12}, {5, 13}, {6, 14}, {7, 15}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {14, 22}, {15, 23},
+  {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21}, {18, 22}, {19, 23},
+  {4, 16}, {5, 17}, {6, 18}, {7, 19}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19},
+  {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22}, {21, 23},
+  {2, 16}, {3, 17}, {6, 20}, {7, 21}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21},
+  {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {19, 21}, {0, 1}, {2, 3},
+  {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23}, {1, 16}, {3, 18},
+  {5, 20}, {7, 22}, {5, 12}, {7, 14}, {9, 16}, {11, 18}, {9, 12}, {11, 14}, {11, 12},
+  // 25: 113 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {0, 8}, {1, 9}, {2, 10},
+  {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21},
+  {14, 22}, {15, 23}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21},
+  {18, 22}, {19, 23}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {12, 24}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16},
+  {13, 17}, {14, 18}, {15, 19}, {20, 24}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+  {16, 18}, {17, 19}, {20, 22}, {21, 23}, {2, 16}, {3, 17}, {6, 20}, {7, 21}, {10, 24}, {2, 8}, {3, 9}, {6, 12},
+  {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21}, {18, 24}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13},
+  {14, 16}, {15, 17}, {18, 20}, {19, 21}, {22, 24}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13},
+  {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {5, 12}, {7, 14},
+  {9, 16}, {11, 18}, {9, 12}, {11, 14}, {11, 12},
+  // 26: 124 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {0, 8}, {1, 9},
+  {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {17, 25}, {8, 16}, {9, 17}, {10, 18}, {11, 19},
+  {12, 20}, {13, 21}, {14, 22}, {15, 23}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15},
+  {16, 20}, {17, 21}, {18, 22}, {19, 23}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {12, 24}, {13, 25}, {4, 8}, {5, 9},
+  {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19}, {20, 24}, {21, 25}, {0, 2}, {1, 3}, {4, 6}, {5, 7},
+  {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22}, {21, 23}, {2, 16}, {3, 17}, {6, 20}, {7, 21},
+  {10, 24}, {11, 25}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21}, {18, 24}, {19, 25},
+  {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {19, 21}, {22, 24}, {23, 25},
+  {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23},
+  {24, 25}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {5, 12}, {7, 14}, {9, 16}, {11, 18}, {13, 20}, {9, 12},
+  {11, 14}, {13, 16}, {11, 12}, {13, 14},
+  // 27: 127 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {10, 26}, {0, 8},
+  {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {17, 25}, {18, 26}, {8, 16}, {9, 17},
+  {10, 18}, {11, 19}, {12, 20}, {13, 21}, {14, 22}, {15, 23}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13},
+  {10, 14}, {11, 15}, {16, 20}, {17, 21}, {18, 22}, {19, 23}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {12, 24}, {13, 25},
+  {14, 26}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19}, {20, 24}, {21, 25}, {22, 26},
+  {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22}, {21, 23},
+  {24, 26}, {2, 16}, {3, 17}, {6, 20}, {7, 21}, {10, 24}, {11, 25}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16},
+  {11, 17}, {14, 20}, {15, 21}, {18, 24}, {19, 25}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16},
+  {15, 17}, {18, 20}, {19, 21}, {22, 24}, {23, 25}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13},
+  {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23}, {24, 25}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {11, 26},
+  {7, 14}, {9, 16}, {11, 18}, {13, 20}, {11, 14}, {13, 16}, {13, 14},
+  // 28: 133 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {10, 26}, {11, 27},
+  {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {17, 25}, {18, 26}, {19, 27},
+  {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {14, 22}, {15, 23}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+  {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21}, {18, 22}, {19, 23}, {4, 16}, {5, 17}, {6, 18}, {7, 19},
+  {12, 24}, {13, 25}, {14, 26}, {15, 27}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19},
+  {20, 24}, {21, 25}, {22, 26}, {23, 27}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+  {16, 18}, {17, 19}, {20, 22}, {21, 23}, {24, 26}, {25, 27}, {2, 16}, {3, 17}, {6, 20}, {7, 21}, {10, 24}, {11, 25},
+  {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21}, {18, 24}, {19, 25}, {2, 4}, {3, 5},
+  {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {19, 21}, {22, 24}, {23, 25}, {0, 1}, {2, 3},
+  {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23}, {24, 25}, {26, 27},
+  {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {11, 26}, {7, 14}, {9, 16}, {11, 18}, {13, 20}, {11, 14}, {13, 16},
+  {13, 14},
+  // 29: 140 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {10, 26}, {11, 27},
+  {12, 28}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {17, 25}, {18, 26},
+  {19, 27}, {20, 28}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {14, 22}, {15, 23}, {0, 4}, {1, 5},
+  {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21}, {18, 22}, {19, 23}, {24, 28}, {4, 16},
+  {5, 17}, {6, 18}, {7, 19}, {12, 24}, {13, 25}, {14, 26}, {15, 27}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16},
+  {13, 17}, {14, 18}, {15, 19}, {20, 24}, {21, 25}, {22, 26}, {23, 27}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10},
+  {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22}, {21, 23}, {24, 26}, {25, 27}, {2, 16}, {3, 17}, {6, 20},
+  {7, 21}, {10, 24}, {11, 25}, {14, 28}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21},
+  {18, 24}, {19, 25}, {22, 28}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20},
+  {19, 21}, {22, 24}, {23, 25}, {26, 28}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15},
+  {16, 17}, {18, 19}, {20, 21}, {22, 23}, {24, 25}, {26, 27}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {11, 26},
+  {13, 28}, {7, 14}, {9, 16}, {11, 18}, {13, 20}, {11, 14}, {13, 16}, {13, 14},
+  // 30: 150 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {10, 26}, {11, 27},
+  {12, 28}, {13, 29}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {17, 25},
+  {18, 26}, {19, 27}, {20, 28}, {21, 29}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {14, 22}, {15, 23},
+  {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21}, {18, 22}, {19, 23},
+  {24, 28}, {25, 29}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {12, 24}, {13, 25}, {14, 26}, {15, 27}, {4, 8}, {5, 9},
+  {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19}, {20, 24}, {21, 25}, {22, 26}, {23, 27}, {0, 2}, {1, 3},
+  {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22}, {21, 23}, {24, 26}, {25, 27},
+  {2, 16}, {3, 17}, {6, 20}, {7, 21}, {10, 24}, {11, 25}, {14, 28}, {15, 29}, {2, 8}, {3, 9}, {6, 12}, {7, 13},
+  {10, 16}, {11, 17}, {14, 20}, {15, 21}, {18, 24}, {19, 25}, {22, 28}, {23, 29}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+  {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {19, 21}, {22, 24}, {23, 25}, {26, 28}, {27, 29}, {0, 1}, {2, 3},
+  {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23}, {24, 25}, {26, 27},
+  {28, 29}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {11, 26}, {13, 28}, {7, 14}, {9, 16}, {11, 18}, {13, 20},
+  {15, 22}, {11, 14}, {13, 16}, {15, 18}, {13, 14}, {15, 16},
+  // 31: 152 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {10, 26}, {11, 27},
+  {12, 28}, {13, 29}, {14, 30}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24},
+  {17, 25}, {18, 26}, {19, 27}, {20, 28}, {21, 29}, {22, 30}, {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21},
+  {14, 22}, {15, 23}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21},
+  {18, 22}, {19, 23}, {24, 28}, {25, 29}, {26, 30}, {4, 16}, {5, 17}, {6, 18}, {7, 19}, {12, 24}, {13, 25}, {14, 26},
+  {15, 27}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19}, {20, 24}, {21, 25}, {22, 26},
+  {23, 27}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {16, 18}, {17, 19}, {20, 22},
+  {21, 23}, {24, 26}, {25, 27}, {28, 30}, {2, 16}, {3, 17}, {6, 20}, {7, 21}, {10, 24}, {11, 25}, {14, 28}, {15, 29},
+  {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21}, {18, 24}, {19, 25}, {22, 28}, {23, 29},
+  {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17}, {18, 20}, {19, 21}, {22, 24}, {23, 25},
+  {26, 28}, {27, 29}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19},
+  {20, 21}, {22, 23}, {24, 25}, {26, 27}, {28, 29}, {1, 16}, {3, 18}, {5, 20}, {7, 22}, {9, 24}, {11, 26}, {13, 28},
+  {15, 30}, {9, 16}, {11, 18}, {13, 20}, {15, 22}, {13, 16}, {15, 18}, {15, 16},
+  // 32: 157 comparators
+  {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24}, {9, 25}, {10, 26}, {11, 27},
+  {12, 28}, {13, 29}, {14, 30}, {15, 31}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15},
+  {16, 24}, {17, 25}, {18, 26}, {19, 27}, {20, 28}, {21, 29}, {22, 30}, {23, 31}, {8, 16}, {9, 17}, {10, 18}, {11, 19},
+  {12, 20}, {13, 21}, {14, 22}, {15, 23}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15},
+  {16, 20}, {17, 21}, {18, 22}, {19, 23}, {24, 28}, {25, 29}, {26, 30}, {27, 31}, {4, 16}, {5, 17}, {6, 18}, {7, 19},
+  {12, 24}, {13, 25}, {14, 26}, {15, 27}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {12, 16}, {13, 17}, {14, 18}, {15, 19},
+  {20, 24}, {21, 25}, {22, 26}, {23, 27}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+  {16, 18}, {17, 19}, {20, 22}, {21, 23}, {24, 26}, {25, 27}, {28, 30}, {29, 31}, {2, 16}, {3, 17}, {6, 20}, {7, 21},
+  {10, 24}, {11, 25}, {14, 28}, {15, 29}, {2, 8}, {3, 9}, {6, 12}, {7, 13}, {10, 16}, {11, 17}, {14, 20}, {15, 21},
+  {18, 24}, {19, 25}, {22, 28}, {23, 29}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {14, 16}, {15, 17},
+  {18, 20}, {19, 21}, {22, 24}, {23, 25}, {26, 28}, {27, 29}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11},
+  {12, 13}, {14, 15}, {16, 17}, {18, 19}, {20, 21}, {22, 23}, {24, 25}, {26, 27}, {28, 29}, {30, 31}, {1, 16}, {3, 18},
+  {5, 20}, {7, 22}, {9, 24}, {11, 26}, {13, 28}, {15, 30}, {9, 16}, {11, 18}, {13, 20}, {15, 22}, {13, 16}, {15, 18},
+  {15, 16},
+};
+
+#endif /* MEDIAN_NETWORKS_H_ */
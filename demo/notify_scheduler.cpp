@@ -0,0 +1,81 @@
+#include "notify_scheduler.h"
+
+// PLX measurement status bits
+#define PLX_STATUS_MEASUREMENT_ONGOING  (1 << 5)
+#define PLX_STATUS_EARLY_ESTIMATE       (1 << 6)
+#define PLX_STATUS_VALIDATED            (1 << 7)
+#define PLX_STATUS_QUESTIONABLE         (1 << 14)
+#define PLX_STATUS_INVALID              (1 << 15)
+#define PLX_FLAG_MEASUREMENT_STATUS     (1 << 2)
+#define SFLOAT_NAN 0x07FF
+
+// IEEE 11073 16-bit float with exponent 0, 999 (invalid) becomes NaN
+static uint16_t to_sfloat(int32_t n_value)
+{
+  if (n_value < 0 || n_value >= 999) return SFLOAT_NAN;
+  return (uint16_t)(n_value & 0x0FFF);
+}
+
+NotifyScheduler::NotifyScheduler(NotifySink* sink, uint32_t min_interval_ms, uint32_t max_interval_ms)
+  : p_sink(sink), un_min_interval_ms(min_interval_ms), un_max_interval_ms(max_interval_ms),
+    n_heart_rate(999), n_spo2(999), uch_quality(RESULT_QUALITY_INVALID),
+    n_sent_heart_rate(999), n_sent_spo2(999), uch_sent_quality(RESULT_QUALITY_INVALID), b_sent(false), un_last_sent_ms(0)
+{
+}
+
+void NotifyScheduler::update(int32_t heart_rate, int32_t spo2, uint8_t quality)
+{
+  n_heart_rate = heart_rate;
+  n_spo2 = spo2;
+  uch_quality = quality;
+}
+
+bool NotifyScheduler::poll(uint32_t un_now_ms)
+/**
+* \brief        Send the result if it is due
+* \par          Details
+*               Due means changed since the last packet and at least un_min_interval_ms after it, or
+*               un_max_interval_ms after it regardless of changes. The first packet is due at once, the
+*               clock may be anywhere then. A packet the sink refuses stays due.
+*
+* \param[in]    un_now_ms               - current time in ms (millis())
+*
+* \retval       true if a packet has been sent
+*/
+{
+  uint32_t un_elapsed = un_now_ms - un_last_sent_ms;
+  bool b_changed = !b_sent || n_heart_rate != n_sent_heart_rate || n_spo2 != n_sent_spo2 || uch_quality != uch_sent_quality;
+  if (b_sent && !(b_changed && un_elapsed >= un_min_interval_ms) && un_elapsed < un_max_interval_ms)
+    return false;
+
+  uint8_t auch_packet[PLX_PACKET_SIZE];
+  uint16_t uw_length = build_plx_packet(n_heart_rate, n_spo2, uch_quality, auch_packet);
+  if (!p_sink->notify(auch_packet, uw_length))
+    return false;
+  n_sent_heart_rate = n_heart_rate;
+  n_sent_spo2 = n_spo2;
+  uch_sent_quality = uch_quality;
+  b_sent = true;
+  un_last_sent_ms = un_now_ms;
+  return true;
+}
+
+uint16_t NotifyScheduler::build_plx_packet(int32_t heart_rate, int32_t spo2, uint8_t quality, uint8_t* puch_packet)
+{
+  uint16_t uw_status = PLX_STATUS_MEASUREMENT_ONGOING;
+  if (quality == RESULT_QUALITY_VALID) uw_status |= PLX_STATUS_VALIDATED;
+  else if (quality == RESULT_QUALITY_EARLY) uw_status |= PLX_STATUS_EARLY_ESTIMATE;
+  else if (quality == RESULT_QUALITY_QUESTIONABLE) uw_status |= PLX_STATUS_QUESTIONABLE;
+  else uw_status |= PLX_STATUS_INVALID;
+  uint16_t uw_spo2 = to_sfloat(spo2);
+  uint16_t uw_rate = to_sfloat(heart_rate);
+
+  puch_packet[0] = PLX_FLAG_MEASUREMENT_STATUS;
+  puch_packet[1] = (uint8_t)uw_spo2;
+  puch_packet[2] = (uint8_t)(uw_spo2 >> 8);
+  puch_packet[3] = (uint8_t)uw_rate;
+  puch_packet[4] = (uint8_t)(uw_rate >> 8);
+  puch_packet[5] = (uint8_t)uw_status;
+  puch_packet[6] = (uint8_t)(uw_status >> 8);
+  return PLX_PACKET_SIZE;
+}
@@ -0,0 +1,60 @@
+/** \file notify_scheduler.h ************************************************
+*
+* Description: Rate-limited, change-driven publishing of the HR/SpO2 result.
+*              HR, SpO2 and a quality code are coalesced into one Bluetooth
+*              PLX Continuous Measurement packet (SpO2, pulse rate and
+*              measurement status). A packet is sent when the result changed
+*              and the minimum interval has passed, or when the maximum
+*              interval has passed without any packet. poll() only compares
+*              a few integers unless a packet is due, so it can be called
+*              from the sampling loop.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef NOTIFY_SCHEDULER_H_
+#define NOTIFY_SCHEDULER_H_
+
+#include <stdint.h>
+
+#define PLX_PACKET_SIZE 7
+
+enum result_quality {
+  RESULT_QUALITY_VALID = 0,         // validated result
+  RESULT_QUALITY_EARLY = 1,         // result from too few beats, provisional
+  RESULT_QUALITY_QUESTIONABLE = 2,  // result available but the signal is poor
+  RESULT_QUALITY_INVALID = 3        // no result (999)
+};
+
+// where packets go, a BLE characteristic on the device and a fake on the host
+class NotifySink {
+ public:
+  virtual ~NotifySink(void) {}
+  virtual bool notify(const uint8_t* puch_data, uint16_t uw_length) = 0; // false if nothing could be sent (e.g. not connected)
+};
+
+class NotifyScheduler {
+ public:
+  NotifyScheduler(NotifySink* p_sink, uint32_t un_min_interval_ms = 1000, uint32_t un_max_interval_ms = 5000);
+
+  void update(int32_t n_heart_rate, int32_t n_spo2, uint8_t uch_quality); // only stores the result
+  bool poll(uint32_t un_now_ms); // true if a packet has been sent
+
+  // PLX Continuous Measurement: flags, SpO2 (SFLOAT), pulse rate (SFLOAT), measurement status
+  static uint16_t build_plx_packet(int32_t n_heart_rate, int32_t n_spo2, uint8_t uch_quality, uint8_t* puch_packet);
+
+ private:
+  NotifySink* p_sink;
+  uint32_t un_min_interval_ms;
+  uint32_t un_max_interval_ms;
+  int32_t n_heart_rate, n_spo2;
+  uint8_t uch_quality;
+  int32_t n_sent_heart_rate, n_sent_spo2;
+  uint8_t uch_sent_quality;
+  bool b_sent;
+  uint32_t un_last_sent_ms;
+};
+
+#endif /* NOTIFY_SCHEDULER_H_ */
@@ -0,0 +1,78 @@
+#include "peak_valley_detector.h"
+
+PeakValleyDetector::PeakValleyDetector(int32_t n_sampling_rate, bool b_report_ties)
+{
+  b_ties = b_report_ties;
+  if (n_sampling_rate < 1) n_sampling_rate = 1;
+  n_release = PEAK_VALLEY_RELEASE_S * n_sampling_rate;
+  n_warmup = n_sampling_rate / PEAK_VALLEY_WARMUP_DIV;
+  reset();
+}
+
+void PeakValleyDetector::reset(void)
+{
+  un_index = 0;
+  b_rising = true;
+  n_max = n_min = 0;
+  un_max = un_min = 0;
+  b_tied = false;
+  n_warmup_max = n_warmup_min = 0;
+  n_swing_q8 = 0;
+  un_peak = un_valley = 0;
+}
+
+int32_t PeakValleyDetector::threshold(void) const
+{
+  int32_t n_threshold = n_swing_q8 >> 9; // half the swing
+  return n_threshold > 0 ? n_threshold : 1; // a flat signal must not toggle on every sample
+}
+
+uint8_t PeakValleyDetector::push(int32_t n_sample)
+/**
+* \brief        Feed one sample
+* \par          Details
+*               Follows the running extreme of the current state and reports it once the sample is the threshold
+*               away on the other side. The excursion from the previous turn updates the tracked swing before the
+*               check, so the first large pulse after a quiet stretch is not split; during the warm-up the range of
+*               all samples so far does, so the noise before the first pulse does not turn. A tied extreme turns
+*               the state without an event unless b_report_ties was set.
+*
+* \param[in]    n_sample                - filtered sample, peaks upwards
+*
+* \retval       peak_valley_event
+*/
+{
+  uint32_t un_i = un_index++;
+  if (un_i == 0) {
+    n_max = n_min = n_warmup_max = n_warmup_min = n_sample;
+    un_max = un_min = 0;
+    return PV_NONE;
+  }
+  n_swing_q8 -= n_swing_q8 / n_release;
+  if ((int32_t)un_i < n_warmup) {
+    if (n_sample > n_warmup_max) n_warmup_max = n_sample;
+    if (n_sample < n_warmup_min) n_warmup_min = n_sample;
+    if (((n_warmup_max - n_warmup_min) << 8) > n_swing_q8) n_swing_q8 = (n_warmup_max - n_warmup_min) << 8;
+  }
+  uint8_t uch_event = PV_NONE;
+  if (b_rising) {
+    if (n_sample > n_max) { n_max = n_sample; un_max = un_i; b_tied = false; }
+    else if (n_sample == n_max) b_tied = true;
+    if (((n_max - n_min) << 8) > n_swing_q8) n_swing_q8 = (n_max - n_min) << 8;
+    if (n_sample < n_max - threshold()) {
+      if ((int32_t)un_i >= n_warmup && (b_ties || !b_tied)) { un_peak = un_max; uch_event = PV_PEAK; }
+      b_rising = false;
+      n_min = n_sample; un_min = un_i; b_tied = false;
+    }
+  } else {
+    if (n_sample < n_min) { n_min = n_sample; un_min = un_i; b_tied = false; }
+    else if (n_sample == n_min) b_tied = true;
+    if (((n_max - n_min) << 8) > n_swing_q8) n_swing_q8 = (n_max - n_min) << 8;
+    if (n_sample > n_min + threshold()) {
+      if ((int32_t)un_i >= n_warmup && (b_ties || !b_tied)) { un_valley = un_min; uch_event = PV_VALLEY; }
+      b_rising = true;
+      n_max = n_sample; un_max = un_i; b_tied = false;
+    }
+  }
+  return uch_event;
+}
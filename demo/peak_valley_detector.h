@@ -0,0 +1,71 @@
+/** \file peak_valley_detector.h ********************************************
+*
+* Description: Streaming threshold-tracking peak-valley detector, the
+*              method of the *_peak_valley experiments. Two states alternate:
+*              looking for a peak the running maximum is followed until the
+*              signal falls half the tracked swing below it, then the peak is
+*              reported and the valley is followed the same way. The tracked
+*              swing rises at once with every larger peak-to-valley excursion
+*              and decays over PEAK_VALLEY_RELEASE_S seconds, so the threshold
+*              follows the pulse amplitude without a window; during the
+*              warm-up it is primed with the whole range seen so far. An
+*              extreme value that is reached twice before the turn (a flat top
+*              of the integer filters, or a later sample of the same height)
+*              has no single position, the state turns but nothing is
+*              reported, as in the prototype; with b_report_ties the first
+*              sample of the tie is reported instead, like the left edge of a
+*              flat peak in maxim_peaks_above_min_height. O(1) per sample,
+*              a turn is reported as soon as the signal has moved back by the
+*              threshold.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef PEAK_VALLEY_DETECTOR_H_
+#define PEAK_VALLEY_DETECTOR_H_
+
+#include <stdint.h>
+
+#define PEAK_VALLEY_RELEASE_S 2 // decay time of the tracked swing in seconds
+#define PEAK_VALLEY_WARMUP_DIV 4 // no events during the first sampling_rate / 4 samples, the swing is learned from their range
+
+enum peak_valley_event {
+  PV_NONE = 0,
+  PV_PEAK = 1,   // peak_index() holds a new peak
+  PV_VALLEY = 2  // valley_index() holds a new valley
+};
+
+class PeakValleyDetector {
+ public:
+  PeakValleyDetector(int32_t n_sampling_rate = 400, bool b_report_ties = false);
+
+  void reset(void);
+
+  uint8_t push(int32_t n_sample); // filtered sample, peaks upwards; peak_valley_event, peaks and valleys alternate unless a tied extreme is skipped
+
+  uint32_t peak_index(void) const { return un_peak; }
+  uint32_t valley_index(void) const { return un_valley; }
+  uint32_t sample_count(void) const { return un_index; }
+  int32_t threshold(void) const; // current hysteresis in sample units
+
+ private:
+  int32_t n_release;    // samples of the swing decay
+  int32_t n_warmup;     // samples without events
+  bool b_ties;          // report tied extremes at their first sample
+  uint32_t un_index;
+  bool b_rising;        // true: looking for a peak, false: looking for a valley
+  int32_t n_max;        // running maximum since the last valley
+  uint32_t un_max;
+  int32_t n_min;        // running minimum since the last peak
+  uint32_t un_min;
+  bool b_tied;          // the running extreme was reached again since it was set
+  int32_t n_warmup_max; // range of the warm-up samples
+  int32_t n_warmup_min;
+  int32_t n_swing_q8;   // tracked peak-to-valley swing, 8 fractional bits so the decay does not stall
+  uint32_t un_peak;
+  uint32_t un_valley;
+};
+
+#endif /* PEAK_VALLEY_DETECTOR_H_ */
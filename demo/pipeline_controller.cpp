@@ -0,0 +1,198 @@
+#include "pipeline_controller.h"
+
+static int32_t clamp_size(int32_t n_value, int32_t n_min, int32_t n_max)
+{
+  return n_value < n_min ? n_min : (n_value > n_max ? n_max : n_value);
+}
+
+PipelineController::PipelineController(int32_t n_max_peak, int32_t n_max_valley, int32_t n_filter_size, int32_t n_ratio_size)
+{
+  n_initial[0] = clamp_size(n_max_peak, CONTROLLER_MIN_CAPACITY, CONTROLLER_MAX_CAPACITY);
+  n_initial[1] = clamp_size(n_max_valley, CONTROLLER_MIN_CAPACITY, CONTROLLER_MAX_CAPACITY);
+  n_initial[2] = clamp_size(n_filter_size, CONTROLLER_MIN_FILTER, CONTROLLER_MAX_FILTER);
+  n_initial[3] = clamp_size(n_ratio_size, CONTROLLER_MIN_CAPACITY, CONTROLLER_MAX_CAPACITY);
+  pn_filtered = NULL;
+  for (int32_t c = 0; c < FUSION_CHANNELS; c++)
+    ap_autocorr[c] = NULL;
+  reset();
+}
+
+PipelineController::~PipelineController(void)
+{
+  delete[] pn_filtered;
+  for (int32_t c = 0; c < FUSION_CHANNELS; c++)
+    delete ap_autocorr[c];
+}
+
+void PipelineController::reset(void)
+{
+  n_max_peak = n_initial[0];
+  n_max_valley = n_initial[1];
+  n_filter_size = n_initial[2];
+  n_ratio_size = n_initial[3];
+  uch_low_peak = uch_low_valley = uch_low_ratio = 0;
+  uch_filter_windows = 0;
+  ch_filter_direction = 0;
+  ch_filter_last_change = 0;
+  n_filter_before = n_filter_size;
+  un_changes = 0;
+  n_last_interval = 0;
+  uch_jump_windows = 0;
+  bandpass.reset();
+  n_filtered_head = 0;
+  un_filtered_count = 0;
+  for (int32_t c = 0; c < FUSION_CHANNELS; c++) {
+    if (ap_autocorr[c] != NULL) ap_autocorr[c]->reset();
+    aun_autocorr_count[c] = 0;
+  }
+}
+
+void PipelineController::resume(int32_t max_peak, int32_t max_valley, int32_t filter_size, int32_t ratio_size, const bandpass_state& filter_state)
+{
+  n_max_peak = clamp_size(max_peak, CONTROLLER_MIN_CAPACITY, CONTROLLER_MAX_CAPACITY);
+  n_max_valley = clamp_size(max_valley, CONTROLLER_MIN_CAPACITY, CONTROLLER_MAX_CAPACITY);
+  n_filter_size = clamp_size(filter_size, CONTROLLER_MIN_FILTER, CONTROLLER_MAX_FILTER);
+  n_ratio_size = clamp_size(ratio_size, CONTROLLER_MIN_CAPACITY, CONTROLLER_MAX_CAPACITY);
+  n_last_interval = 0; // the rhythm after the gap is accepted as it comes
+  uch_jump_windows = 0;
+  ch_filter_last_change = 0;
+  n_filter_before = n_filter_size;
+  bandpass.restore(filter_state);
+}
+
+int32_t PipelineController::adapt_capacity(int32_t n_size, int32_t n_count, uint8_t* puch_low_windows)
+{
+  if (n_count > 3 * n_size / 4) {
+    *puch_low_windows = 0;
+    return n_size * 2 < CONTROLLER_MAX_CAPACITY ? n_size * 2 : CONTROLLER_MAX_CAPACITY; // at once, the window may have been cut off
+  }
+  if (n_count >= n_size / 4 || n_size <= CONTROLLER_MIN_CAPACITY) {
+    *puch_low_windows = 0;
+    return n_size;
+  }
+  if (++(*puch_low_windows) < CONTROLLER_HOLD_WINDOWS)
+    return n_size;
+  *puch_low_windows = 0;
+  return n_size / 2 > CONTROLLER_MIN_CAPACITY ? n_size / 2 : CONTROLLER_MIN_CAPACITY;
+}
+
+bool PipelineController::update(int32_t n_num_peak, int32_t n_num_val, int32_t n_peak_interval, int32_t n_ratio_count)
+/**
+* \brief        Adapt the sizes to one window
+* \par          Details
+*               Called after every window that passed the signal quality check. The capacities follow the counts
+*               with the 1/4 and 3/4 marks, filter_size follows n_peak_interval / 20 with a dead band of 1 and
+*               CONTROLLER_HOLD_WINDOWS windows of delay, so single outliers of the peak detection cannot move it.
+*               A window whose interval jumped by more than 3/2 from the last accepted one is ignored like a window
+*               without heart rate, a run of such jumps would otherwise move filter_size and undo it right after.
+*
+* \param[in]    n_num_peak              - peaks found in the window
+* \param[in]    n_num_val               - valleys found in the window
+* \param[in]    n_peak_interval         - median peak interval in samples, <= 0 if the window has no heart rate
+* \param[in]    n_ratio_count           - SpO2 ratios collected in the window
+*
+* \retval       true if any size changed
+*/
+{
+  if (n_peak_interval <= 0) // the counts of a failed window say nothing about the heart rate
+    return false;
+  if (n_last_interval > 0 && (2 * n_peak_interval > 3 * n_last_interval || 3 * n_peak_interval < 2 * n_last_interval)
+      && ++uch_jump_windows < CONTROLLER_REANCHOR_WINDOWS)
+    return false;
+  uch_jump_windows = 0;
+  n_last_interval = n_peak_interval;
+  int32_t n_old_peak = n_max_peak, n_old_valley = n_max_valley, n_old_filter = n_filter_size, n_old_ratio = n_ratio_size;
+  n_max_peak = adapt_capacity(n_max_peak, n_num_peak, &uch_low_peak);
+  n_max_valley = adapt_capacity(n_max_valley, n_num_val, &uch_low_valley);
+  n_ratio_size = adapt_capacity(n_ratio_size, n_ratio_count, &uch_low_ratio);
+
+  int32_t n_target = clamp_size(n_peak_interval / 20, CONTROLLER_MIN_FILTER, CONTROLLER_MAX_FILTER);
+  int8_t ch_direction = n_target >= n_filter_size + 2 ? 1 : (n_target <= n_filter_size - 2 ? -1 : 0);
+  if (ch_direction != 0 && ch_direction == -ch_filter_last_change
+      && (ch_direction > 0 ? n_target < n_filter_before + 2 : n_target > n_filter_before - 2))
+    ch_direction = 0; // a reversal has to clear the size before the last change, too
+  if (ch_direction == 0 || ch_direction != ch_filter_direction)
+    uch_filter_windows = 0;
+  ch_filter_direction = ch_direction;
+  if (ch_direction != 0 && ++uch_filter_windows >= CONTROLLER_HOLD_WINDOWS) {
+    n_filter_before = n_filter_size;
+    ch_filter_last_change = ch_direction;
+    n_filter_size = n_target;
+    uch_filter_windows = 0;
+    ch_filter_direction = 0;
+  }
+
+  bool b_changed = n_old_peak != n_max_peak || n_old_valley != n_max_valley || n_old_filter != n_filter_size || n_old_ratio != n_ratio_size;
+  if (b_changed)
+    un_changes++;
+  return b_changed;
+}
+
+void PipelineController::push_sample(uint32_t un_green, uint32_t un_ir, uint32_t un_red)
+{
+  push_green(un_green);
+  const uint32_t aun_sample[FUSION_CHANNELS] = { un_green, un_ir, un_red };
+  for (int32_t c = 0; c < FUSION_CHANNELS; c++)
+    if (ap_autocorr[c] != NULL) {
+      ap_autocorr[c]->push(aun_sample[c]);
+      if (aun_autocorr_count[c] != 0xFFFFFFFFu) aun_autocorr_count[c]++;
+    }
+}
+
+int32_t PipelineController::autocorr_rate(int32_t n_channel, int32_t n_sampling_rate, int32_t n_length)
+/**
+* \brief        Heart rate of a persistent autocorrelation engine
+* \par          Details
+*               The engine is built for the window length and the sampling rate of the first call and is
+*               rebuilt, empty, when the length changes (warm-up) or the rate drifts by more than 10 %; smaller
+*               drifts of the measured rate only rescale its bpm. A fresh engine answers once push_sample() has
+*               given it n_length samples, the caller feeds the window into a temporary engine until then.
+*
+* \param[in]    n_channel               - 0 green, 1 IR, 2 red
+* \param[in]    n_sampling_rate         - the actual sampling rate
+* \param[in]    n_length                - window length in samples
+*
+* \retval       bpm, 999 without a clear period, -1 if the engine has not seen a whole window yet
+*/
+{
+  if (n_channel < 0 || n_channel >= FUSION_CHANNELS || n_sampling_rate <= 0) return -1;
+  int32_t n_drift = n_sampling_rate - an_autocorr_rate[n_channel];
+  if (ap_autocorr[n_channel] == NULL || an_autocorr_length[n_channel] != n_length
+      || n_drift * 10 > an_autocorr_rate[n_channel] || -n_drift * 10 > an_autocorr_rate[n_channel]) {
+    delete ap_autocorr[n_channel];
+    ap_autocorr[n_channel] = new AutocorrEngine(n_sampling_rate, AutocorrEngine::window_for_buffer(n_sampling_rate, n_length));
+    an_autocorr_rate[n_channel] = n_sampling_rate;
+    an_autocorr_length[n_channel] = n_length;
+    aun_autocorr_count[n_channel] = 0;
+    return -1;
+  }
+  if (aun_autocorr_count[n_channel] < (uint32_t)n_length) return -1;
+  ap_autocorr[n_channel]->set_sampling_rate(n_sampling_rate);
+  return ap_autocorr[n_channel]->heart_rate();
+}
+
+void PipelineController::enable_bandpass(void)
+{
+  if (pn_filtered != NULL) return;
+  pn_filtered = new int32_t[2 * CONTROLLER_MAX_WINDOW];
+  bandpass.reset();
+  n_filtered_head = 0;
+  un_filtered_count = 0;
+}
+
+void PipelineController::push_green(uint32_t un_sample)
+{
+  if (pn_filtered == NULL) return; // PREPROCESS_MEDIAN_MEAN filters per window
+  int32_t n_y = bandpass.push(un_sample);
+  pn_filtered[n_filtered_head] = n_y;
+  pn_filtered[n_filtered_head + CONTROLLER_MAX_WINDOW] = n_y;
+  if (++n_filtered_head == CONTROLLER_MAX_WINDOW) n_filtered_head = 0;
+  un_filtered_count++;
+}
+
+const int32_t* PipelineController::filtered_window(int32_t n_length)
+{
+  enable_bandpass();
+  if (n_length <= 0 || n_length > CONTROLLER_MAX_WINDOW || un_filtered_count < (uint32_t)n_length) return NULL;
+  return &pn_filtered[n_filtered_head + CONTROLLER_MAX_WINDOW - n_length];
+}
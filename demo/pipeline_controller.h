@@ -0,0 +1,131 @@
+/** \file pipeline_controller.h *********************************************
+*
+* Description: Per-session sizes of the window pipeline. The peak, valley
+*              and beat arrays of heart_rate_and_oxygen_saturation live here
+*              instead of being allocated per call, and max_n_peak,
+*              max_n_valley, filter_size and ratio_size follow the measured
+*              heart rate:
+*              - a capacity doubles as soon as a window fills more than 3/4
+*                of it (a full array truncates) and halves only after
+*                CONTROLLER_HOLD_WINDOWS windows in a row used less than 1/4,
+*                so a halved capacity is never refilled past the grow mark;
+*              - filter_size tracks 1/20 of the median peak interval, which
+*                gives the 14 to 17 found best for AMPD at 60 to 85 bpm and
+*                400 sps, but only once the target has stayed 2 or more
+*                away for CONTROLLER_HOLD_WINDOWS windows. Against the
+*                direction of its last change it moves only for a target 2
+*                or more beyond the size before that change, so estimates
+*                wandering around a step boundary cannot make it oscillate.
+*              Windows without a heart rate leave everything unchanged, and
+*              so does a window whose peak interval is more than 3/2 or less
+*              than 2/3 of the last accepted one: a (sub)harmonic of the HR
+*              engine, the rhythm cannot jump like that within one hop. Only
+*              CONTROLLER_REANCHOR_WINDOWS such windows in a row are taken as
+*              the new rhythm.
+*              The arrays are sized for the largest capacity once, resizing
+*              only moves the limits handed to the pipeline.
+*              For PREPROCESS_BANDPASS the controller also runs the band-pass
+*              of bandpass_filter.h over every green sample as it arrives and
+*              keeps the last CONTROLLER_MAX_WINDOW results, so the filter
+*              state carries from hop to hop and a window costs one copy. The
+*              16 KB of that history are allocated by enable_bandpass() or the
+*              first filtered_window(), before that green samples are not
+*              filtered at all, so the default PREPROCESS_MEDIAN_MEAN and the
+*              fixed sizes of callers without a controller do not carry them.
+*              For HR_ENGINE_AUTOCORR it keeps one AutocorrEngine per channel
+*              a window asked for, allocated on first use and fed every
+*              sample by push_sample(), so a hop costs its new samples only
+*              instead of a fresh engine over the whole window.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef PIPELINE_CONTROLLER_H_
+#define PIPELINE_CONTROLLER_H_
+
+#include <stdint.h>
+#include "spo2_algorithm.h"
+#include "bandpass_filter.h"
+#include "autocorr_engine.h"
+
+#define CONTROLLER_MIN_CAPACITY 8   // peaks, valleys and ratios
+#define CONTROLLER_MAX_CAPACITY 64  // 2048 samples at 400 sps hold 11 beats at 220 bpm, 64 leaves room for 800 sps
+#define CONTROLLER_MIN_FILTER 5
+#define CONTROLLER_MAX_FILTER 25
+#define CONTROLLER_HOLD_WINDOWS 4   // windows a shrink or a filter change has to persist
+#define CONTROLLER_MAX_WINDOW 2048  // longest window of band-passed samples
+#define CONTROLLER_REANCHOR_WINDOWS (2 * CONTROLLER_HOLD_WINDOWS) // jumps in a row that are accepted as a new rhythm
+
+class PipelineController {
+ public:
+  PipelineController(int32_t n_max_peak = 16, int32_t n_max_valley = 16, int32_t n_filter_size = 15, int32_t n_ratio_size = 16);
+  ~PipelineController(void);
+
+  void reset(void); // back to the initial sizes and an empty band-pass history, e.g. for a new session
+
+  int32_t max_peak(void) const { return n_max_peak; }
+  int32_t max_valley(void) const { return n_max_valley; }
+  int32_t filter_size(void) const { return n_filter_size; }
+  int32_t ratio_size(void) const { return n_ratio_size; }
+
+  // pooled arrays, valid for max_peak(), max_valley() and max_valley() entries
+  int32_t* peak_locs(void) { return an_peak_locs; }
+  int32_t* valley_locs(void) { return an_valley_locs; }
+  Beat* beats(void) { return a_beats; }
+
+  // feed the counts of one window, n_peak_interval <= 0 (no heart rate) is ignored; true if a size changed
+  bool update(int32_t n_num_peak, int32_t n_num_val, int32_t n_peak_interval, int32_t n_ratio_count);
+  uint32_t changes(void) const { return un_changes; } // number of updates that changed a size
+
+  // every sample in acquisition order: the band-pass of the green channel and the autocorrelation engines
+  void push_sample(uint32_t un_green, uint32_t un_ir, uint32_t un_red);
+  // band-pass preprocessing, fed with every green sample in acquisition order; ignored until enable_bandpass()
+  void push_green(uint32_t un_sample);
+  void enable_bandpass(void); // allocates the band-passed history, the filter runs from the next sample on
+  // heart rate of the persistent engine of channel n_channel (0 green, 1 IR, 2 red, as FUSION_CHANNELS) over the newest
+  // n_length samples; -1 until it has been pushed that many, the first call allocates it
+  int32_t autocorr_rate(int32_t n_channel, int32_t n_sampling_rate, int32_t n_length);
+  void set_sampling_rate(int32_t n_sampling_rate) { bandpass.set_sampling_rate(n_sampling_rate); }
+  void restart_filter(void) { bandpass.reset(); } // gain step: the next sample primes the band-pass, the step does not ring through it
+  const BandpassFilter& filter(void) const { return bandpass; }
+  // sizes and band-pass state of a snapshot, the band-passed history stays empty
+  void resume(int32_t n_max_peak, int32_t n_max_valley, int32_t n_filter_size, int32_t n_ratio_size, const bandpass_state& filter_state);
+  // newest n_length band-passed samples, NULL until that many were pushed; the first call enables the band-pass
+  const int32_t* filtered_window(int32_t n_length);
+
+ private:
+  PipelineController(const PipelineController&);            // owns the engines, not copyable
+  PipelineController& operator=(const PipelineController&);
+  int32_t adapt_capacity(int32_t n_size, int32_t n_count, uint8_t* puch_low_windows);
+
+  int32_t an_peak_locs[CONTROLLER_MAX_CAPACITY];
+  int32_t an_valley_locs[CONTROLLER_MAX_CAPACITY];
+  Beat a_beats[CONTROLLER_MAX_CAPACITY];
+  int32_t n_initial[4]; // max_n_peak, max_n_valley, filter_size, ratio_size
+  int32_t n_max_peak;
+  int32_t n_max_valley;
+  int32_t n_filter_size;
+  int32_t n_ratio_size;
+  uint8_t uch_low_peak;   // consecutive windows below the shrink mark
+  uint8_t uch_low_valley;
+  uint8_t uch_low_ratio;
+  uint8_t uch_filter_windows; // consecutive windows with the filter target 2 or more away in the same direction
+  int8_t ch_filter_direction;
+  int8_t ch_filter_last_change; // direction of the last filter_size change, 0 if none
+  int32_t n_filter_before;      // filter_size before that change
+  uint32_t un_changes;
+  int32_t n_last_interval;   // peak interval of the last accepted window, 0 if none yet
+  uint8_t uch_jump_windows;  // consecutive windows rejected as a jump from it
+  BandpassFilter bandpass;
+  int32_t* pn_filtered; // 2 * CONTROLLER_MAX_WINDOW, NULL until enable_bandpass(); every sample is stored twice, the newest window is always contiguous
+  int32_t n_filtered_head; // next write position below CONTROLLER_MAX_WINDOW
+  uint32_t un_filtered_count;
+  AutocorrEngine* ap_autocorr[FUSION_CHANNELS]; // NULL until autocorr_rate() asks for the channel
+  int32_t an_autocorr_rate[FUSION_CHANNELS];    // sampling rate and window length the engine was built for
+  int32_t an_autocorr_length[FUSION_CHANNELS];
+  uint32_t aun_autocorr_count[FUSION_CHANNELS]; // samples pushed since it was built or reset
+};
+
+#endif /* PIPELINE_CONTROLLER_H_ */
@@ -0,0 +1,164 @@
+#include "pipeline_snapshot.h"
+
+// bounded little-endian writer and reader, a write or read past the end sets b_overrun
+typedef struct {
+  uint8_t* puch_out;
+  const uint8_t* puch_in;
+  uint16_t uw_pos;
+  uint16_t uw_max;
+  bool b_overrun;
+} snapshot_cursor;
+
+static void put_bytes(snapshot_cursor* p, uint32_t un_value, int32_t n_bytes)
+{
+  if (p->uw_pos + n_bytes > p->uw_max) { p->b_overrun = true; return; }
+  for (int32_t i = 0; i < n_bytes; i++)
+    p->puch_out[p->uw_pos++] = (uint8_t)(un_value >> (8 * i));
+}
+
+static uint32_t get_bytes(snapshot_cursor* p, int32_t n_bytes)
+{
+  if (p->uw_pos + n_bytes > p->uw_max) { p->b_overrun = true; return 0; }
+  uint32_t un_value = 0;
+  for (int32_t i = 0; i < n_bytes; i++)
+    un_value |= (uint32_t)p->puch_in[p->uw_pos++] << (8 * i);
+  return un_value;
+}
+
+static uint16_t fletcher16(const uint8_t* puch_data, uint16_t uw_length)
+{
+  uint16_t uw_sum1 = 0, uw_sum2 = 0;
+  for (uint16_t i = 0; i < uw_length; i++) {
+    uw_sum1 = (uw_sum1 + puch_data[i]) % 255;
+    uw_sum2 = (uw_sum2 + uw_sum1) % 255;
+  }
+  return (uint16_t)(uw_sum2 << 8 | uw_sum1);
+}
+
+void snapshot_capture(pipeline_snapshot* p_snapshot, const BeatDetector& detector, const SpO2Estimator& estimator,
+                      const PipelineController& controller, const GainController* p_gain)
+{
+  p_snapshot->n_interval_count = detector.interval_median().values(p_snapshot->an_intervals);
+  p_snapshot->n_amplitude = detector.amplitude();
+  p_snapshot->n_ratio_count = estimator.ratio_median().values(p_snapshot->an_ratios);
+  p_snapshot->uch_max_peak = (uint8_t)controller.max_peak();
+  p_snapshot->uch_max_valley = (uint8_t)controller.max_valley();
+  p_snapshot->uch_filter_size = (uint8_t)controller.filter_size();
+  p_snapshot->uch_ratio_size = (uint8_t)controller.ratio_size();
+  controller.filter().save(&p_snapshot->filter);
+  if (p_gain) {
+    p_snapshot->gain = p_gain->setting();
+  } else {
+    for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+      p_snapshot->gain.auch_amplitude[c] = 0;
+    p_snapshot->gain.uw_adc_range = 0; // not restored
+  }
+}
+
+void snapshot_restore(const pipeline_snapshot& snapshot, BeatDetector* p_detector, SpO2Estimator* p_estimator,
+                      PipelineController* p_controller, GainController* p_gain)
+{
+  p_detector->resume(snapshot.an_intervals, snapshot.n_interval_count, snapshot.n_amplitude);
+  p_estimator->resume(snapshot.an_ratios, snapshot.n_ratio_count);
+  p_controller->resume(snapshot.uch_max_peak, snapshot.uch_max_valley, snapshot.uch_filter_size, snapshot.uch_ratio_size, snapshot.filter);
+  if (p_gain && snapshot.gain.uw_adc_range != 0)
+    p_gain->resume(snapshot.gain);
+}
+
+uint16_t snapshot_serialize(const pipeline_snapshot* p_snapshot, uint8_t* puch_out, uint16_t uw_max)
+/**
+* \brief        Write a snapshot in the layout of pipeline_snapshot.h
+*
+* \param[in]    *p_snapshot             - snapshot, the list counts at most their array sizes
+* \param[out]   *puch_out               - output buffer
+* \param[in]    uw_max                  - size of the output buffer, SNAPSHOT_MAX_BYTES always fits
+*
+* \retval       number of bytes written, 0 if they did not fit
+*/
+{
+  snapshot_cursor cursor = { puch_out, NULL, 0, uw_max, false };
+  int32_t n_intervals = p_snapshot->n_interval_count < BEAT_DETECTOR_INTERVALS ? p_snapshot->n_interval_count : BEAT_DETECTOR_INTERVALS;
+  int32_t n_ratios = p_snapshot->n_ratio_count < ROLLING_MEDIAN_MAX_SIZE ? p_snapshot->n_ratio_count : ROLLING_MEDIAN_MAX_SIZE;
+  put_bytes(&cursor, SNAPSHOT_MAGIC, 4);
+  put_bytes(&cursor, SNAPSHOT_VERSION, 2);
+  put_bytes(&cursor, 0, 2); // length, filled in below
+  put_bytes(&cursor, p_snapshot->un_sampling_rate, 4);
+  put_bytes(&cursor, p_snapshot->uch_signal_quality, 1);
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+    put_bytes(&cursor, p_snapshot->gain.auch_amplitude[c], 1);
+  put_bytes(&cursor, p_snapshot->gain.uw_adc_range, 2);
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+    put_bytes(&cursor, p_snapshot->aun_dc[c], 4);
+  put_bytes(&cursor, (uint32_t)n_intervals, 1);
+  for (int32_t i = 0; i < n_intervals; i++)
+    put_bytes(&cursor, (uint32_t)p_snapshot->an_intervals[i], 4);
+  put_bytes(&cursor, (uint32_t)p_snapshot->n_amplitude, 4);
+  put_bytes(&cursor, (uint32_t)n_ratios, 1);
+  for (int32_t i = 0; i < n_ratios; i++)
+    put_bytes(&cursor, (uint32_t)p_snapshot->an_ratios[i], 4);
+  put_bytes(&cursor, p_snapshot->uch_max_peak, 1);
+  put_bytes(&cursor, p_snapshot->uch_max_valley, 1);
+  put_bytes(&cursor, p_snapshot->uch_filter_size, 1);
+  put_bytes(&cursor, p_snapshot->uch_ratio_size, 1);
+  put_bytes(&cursor, p_snapshot->filter.b_primed ? 1 : 0, 1);
+  for (int32_t i = 0; i < 4; i++)
+    put_bytes(&cursor, (uint32_t)p_snapshot->filter.an_high[i], 4);
+  for (int32_t i = 0; i < 4; i++)
+    put_bytes(&cursor, (uint32_t)p_snapshot->filter.an_low[i], 4);
+  if (cursor.b_overrun || cursor.uw_pos + 2 > uw_max) return 0;
+  uint16_t uw_length = cursor.uw_pos + 2;
+  puch_out[6] = (uint8_t)uw_length;
+  puch_out[7] = (uint8_t)(uw_length >> 8);
+  put_bytes(&cursor, fletcher16(puch_out, cursor.uw_pos), 2);
+  return uw_length;
+}
+
+bool snapshot_deserialize(const uint8_t* puch_in, uint16_t uw_length, pipeline_snapshot* p_snapshot)
+/**
+* \brief        Read a snapshot written by snapshot_serialize
+* \par          Details
+*               The header, the list counts and the checksum are checked before anything is trusted,
+*               trailing bytes after the declared length are ignored (e.g. an old flash file).
+*
+* \param[in]    *puch_in                - serialized snapshot
+* \param[in]    uw_length               - bytes available
+* \param[out]   *p_snapshot             - snapshot, only valid if true is returned
+*
+* \retval       true if the snapshot is complete and of SNAPSHOT_VERSION
+*/
+{
+  snapshot_cursor cursor = { NULL, puch_in, 0, uw_length, false };
+  if (get_bytes(&cursor, 4) != SNAPSHOT_MAGIC || get_bytes(&cursor, 2) != SNAPSHOT_VERSION) return false;
+  uint16_t uw_declared = (uint16_t)get_bytes(&cursor, 2);
+  if (cursor.b_overrun || uw_declared < cursor.uw_pos + 2 || uw_declared > uw_length) return false;
+  uint16_t uw_checksum = puch_in[uw_declared - 2] | (uint16_t)puch_in[uw_declared - 1] << 8;
+  if (fletcher16(puch_in, uw_declared - 2) != uw_checksum) return false;
+  cursor.uw_max = uw_declared - 2;
+
+  p_snapshot->un_sampling_rate = get_bytes(&cursor, 4);
+  p_snapshot->uch_signal_quality = (uint8_t)get_bytes(&cursor, 1);
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+    p_snapshot->gain.auch_amplitude[c] = (uint8_t)get_bytes(&cursor, 1);
+  p_snapshot->gain.uw_adc_range = (uint16_t)get_bytes(&cursor, 2);
+  for (int32_t c = 0; c < GAIN_CHANNELS; c++)
+    p_snapshot->aun_dc[c] = get_bytes(&cursor, 4);
+  p_snapshot->n_interval_count = (int32_t)get_bytes(&cursor, 1);
+  if (p_snapshot->n_interval_count > BEAT_DETECTOR_INTERVALS) return false;
+  for (int32_t i = 0; i < p_snapshot->n_interval_count; i++)
+    p_snapshot->an_intervals[i] = (int32_t)get_bytes(&cursor, 4);
+  p_snapshot->n_amplitude = (int32_t)get_bytes(&cursor, 4);
+  p_snapshot->n_ratio_count = (int32_t)get_bytes(&cursor, 1);
+  if (p_snapshot->n_ratio_count > ROLLING_MEDIAN_MAX_SIZE) return false;
+  for (int32_t i = 0; i < p_snapshot->n_ratio_count; i++)
+    p_snapshot->an_ratios[i] = (int32_t)get_bytes(&cursor, 4);
+  p_snapshot->uch_max_peak = (uint8_t)get_bytes(&cursor, 1);
+  p_snapshot->uch_max_valley = (uint8_t)get_bytes(&cursor, 1);
+  p_snapshot->uch_filter_size = (uint8_t)get_bytes(&cursor, 1);
+  p_snapshot->uch_ratio_size = (uint8_t)get_bytes(&cursor, 1);
+  p_snapshot->filter.b_primed = get_bytes(&cursor, 1) != 0;
+  for (int32_t i = 0; i < 4; i++)
+    p_snapshot->filter.an_high[i] = (int32_t)get_bytes(&cursor, 4);
+  for (int32_t i = 0; i < 4; i++)
+    p_snapshot->filter.an_low[i] = (int32_t)get_bytes(&cursor, 4);
+  return !cursor.b_overrun && cursor.uw_pos == cursor.uw_max;
+}
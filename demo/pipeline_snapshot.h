@@ -0,0 +1,65 @@
+/** \file pipeline_snapshot.h ***********************************************
+*
+* Description: Compact, versioned snapshot of the pipeline state, so a
+*              session resumed after a reset, a spot check pause or a
+*              standby starts from the last one instead of from zero: beat
+*              intervals and amplitude of the beat detector, R ratios of
+*              the SpO2 estimator, sizes and band-pass state of the
+*              PipelineController, the gain setting of the LEDs and ADC,
+*              the DC level of each channel, the sampling rate and the
+*              signal quality. The sample history is not part of it, the
+*              window is refilled; with the interval and ratio medians
+*              restored, a result is available after the first hop.
+*
+* Layout (little-endian): magic "PPS1", version (16 bits), length of the
+*              whole snapshot (16 bits), the fields in the order of
+*              pipeline_snapshot with the interval and ratio lists prefixed
+*              by their count, then a Fletcher-16 checksum of everything
+*              before it. A snapshot of another version is rejected and the
+*              session starts from zero.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef PIPELINE_SNAPSHOT_H_
+#define PIPELINE_SNAPSHOT_H_
+
+#include <stdint.h>
+#include "beat_detector.h"
+#include "bandpass_filter.h"
+#include "gain_controller.h"
+#include "pipeline_controller.h"
+#include "rolling_median.h"
+#include "spo2_estimator.h"
+
+#define SNAPSHOT_MAGIC 0x31535050 // "PPS1" in little-endian
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_MAX_BYTES 256    // largest serialized snapshot, both lists full
+
+typedef struct {
+  uint32_t un_sampling_rate;       // measured rate the intervals were counted at
+  uint8_t uch_signal_quality;      // signal_quality_code of the last window
+  gain_setting gain;               // LED amplitudes and ADC range
+  uint32_t aun_dc[GAIN_CHANNELS];  // mean of the last hop, indexed by gain_channel
+  int32_t n_interval_count;
+  int32_t an_intervals[BEAT_DETECTOR_INTERVALS]; // beat intervals in samples, oldest first
+  int32_t n_amplitude;             // running beat amplitude of the detector
+  int32_t n_ratio_count;
+  int32_t an_ratios[ROLLING_MEDIAN_MAX_SIZE];    // R ratios multiplied by 100, oldest first
+  uint8_t uch_max_peak, uch_max_valley, uch_filter_size, uch_ratio_size; // PipelineController sizes
+  bandpass_state filter;
+} pipeline_snapshot;
+
+// state of the objects, the caller fills un_sampling_rate, uch_signal_quality and aun_dc; p_gain may be NULL
+void snapshot_capture(pipeline_snapshot* p_snapshot, const BeatDetector& detector, const SpO2Estimator& estimator,
+                      const PipelineController& controller, const GainController* p_gain);
+// continue from a snapshot, the objects have been reset by the caller; p_gain may be NULL
+void snapshot_restore(const pipeline_snapshot& snapshot, BeatDetector* p_detector, SpO2Estimator* p_estimator,
+                      PipelineController* p_controller, GainController* p_gain);
+
+uint16_t snapshot_serialize(const pipeline_snapshot* p_snapshot, uint8_t* puch_out, uint16_t uw_max); // bytes written, 0 if uw_max is too small
+bool snapshot_deserialize(const uint8_t* puch_in, uint16_t uw_length, pipeline_snapshot* p_snapshot); // false for a wrong magic, version, length or checksum
+
+#endif /* PIPELINE_SNAPSHOT_H_ */
@@ -0,0 +1,86 @@
+/** \file ppg_record.h ******************************************************
+*
+* Description: Binary PPG recording format shared by the on-device recorder
+*              and the host replay tools (see tools/).
+*
+* A recording is one fixed-size header, followed by un_channel_count channel
+* descriptors, followed by the samples stored column-major: all samples of
+* channel 0, then all samples of channel 1, ... Each sample is one 32-bit
+* little-endian word, so any window of a channel can be handed to the
+* algorithm as a plain uint32_t pointer without copying or parsing.
+* Raw ADC channels only use the low 18 bits (uch_sample_bits = 18), derived
+* channels such as the filtered signals use the full 32 bits.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef PPG_RECORD_H_
+#define PPG_RECORD_H_
+
+#include <stdint.h>
+
+#define PPG_RECORD_MAGIC        0x31475050 // "PPG1" in little-endian
+#define PPG_RECORD_VERSION      1
+#define PPG_RECORD_MAX_CHANNELS 64 // uch_channel_count; six filter-size captures merged need 25
+
+// what a channel holds, the order follows the columns of the data/ CSV captures
+enum ppg_channel_kind {
+  PPG_CHANNEL_GREEN = 0,          // raw green ADC counts
+  PPG_CHANNEL_IR = 1,             // raw IR ADC counts
+  PPG_CHANNEL_RED = 2,            // raw red ADC counts
+  PPG_CHANNEL_MEDIAN_FILTERED = 3, // inverted, DC removed and median filtered green
+  PPG_CHANNEL_MEAN_FILTERED = 4,  // median filtered green passed through the mean filter
+  PPG_CHANNEL_PEAK_MARKER = 5,    // 1 at detected peaks, 0 elsewhere
+  PPG_CHANNEL_VALLEY_MARKER = 6,  // 1 at detected valleys, 0 elsewhere
+  PPG_CHANNEL_HEART_RATE = 7,     // computed heart rate, latest value at every sample
+  PPG_CHANNEL_SPO2 = 8            // computed SpO2, latest value at every sample
+};
+
+// peak detection method used to produce a derived channel
+enum ppg_detector_kind {
+  PPG_DETECTOR_NONE = 0,
+  PPG_DETECTOR_AMPD = 1,
+  PPG_DETECTOR_INCREASING_SLOPE = 2,
+  PPG_DETECTOR_PEAK_VALLEY = 3
+};
+
+typedef struct {
+  uint32_t un_magic;              // PPG_RECORD_MAGIC
+  uint16_t uw_version;            // PPG_RECORD_VERSION
+  uint16_t uw_header_size;        // sizeof(ppg_record_header), lets readers skip unknown fields
+  uint32_t un_sampling_rate;      // samples per second
+  uint32_t un_sample_count;       // samples per channel
+  uint32_t un_first_sample;       // index of the first sample within the original capture
+  uint16_t uw_pulse_width;        // LED pulse width in us
+  uint16_t uw_adc_range;          // ADC full scale in nA
+  uint8_t uch_led_mode;           // 1 = Red, 2 = Red + IR, 3 = Red + IR + Green
+  uint8_t uch_led_brightness;     // LED pulse amplitude register value
+  uint8_t uch_sample_average;     // FIFO averaging
+  uint8_t uch_channel_count;      // number of ppg_channel_desc following the header
+} ppg_record_header;
+
+typedef struct {
+  uint8_t uch_kind;               // ppg_channel_kind
+  uint8_t uch_sample_bits;        // significant bits per sample, 18 for raw ADC channels
+  uint8_t uch_detector;           // ppg_detector_kind, PPG_DETECTOR_NONE for raw channels
+  uint8_t uch_reserved;
+  uint16_t uw_filter_size;        // median/mean filter size, 0 if not filtered
+  uint16_t uw_flags;              // reserved, written as 0
+} ppg_channel_desc;
+
+// byte offset of the first sample of channel n_channel, 64 bits so a corrupt sample count cannot wrap
+static inline uint64_t ppg_record_channel_offset(const ppg_record_header* p_header, uint32_t n_channel)
+{
+  return p_header->uw_header_size + p_header->uch_channel_count * (uint64_t)sizeof(ppg_channel_desc)
+         + n_channel * (uint64_t)p_header->un_sample_count * sizeof(uint32_t);
+}
+
+// total file size implied by the header
+static inline uint64_t ppg_record_size(const ppg_record_header* p_header)
+{
+  return ppg_record_channel_offset(p_header, p_header->uch_channel_count);
+}
+
+#endif /* PPG_RECORD_H_ */
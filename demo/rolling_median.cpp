@@ -0,0 +1,62 @@
+#include "rolling_median.h"
+
+RollingMedian::RollingMedian(int32_t n_window)
+{
+  n_size = n_window < 1 ? 1 : (n_window > ROLLING_MEDIAN_MAX_SIZE ? ROLLING_MEDIAN_MAX_SIZE : n_window);
+  clear();
+}
+
+void RollingMedian::clear(void)
+{
+  n_count = 0;
+  n_head = 0;
+}
+
+void RollingMedian::push(int32_t n_value)
+/**
+* \brief        Insert a value
+* \par          Details
+*               When the window is full the oldest value is removed from the sorted array first,
+*               then the new value is inserted at its place; both steps shift at most n_size entries.
+*
+* \param[in]    n_value                 - new value
+*
+* \retval       None
+*/
+{
+  int32_t i, n_len = n_count;
+  if (n_count == n_size) { // remove the oldest value
+    int32_t n_old = an_ring[n_head];
+    for (i = 0; an_sorted[i] != n_old; i++);
+    for (; i < n_len - 1; i++)
+      an_sorted[i] = an_sorted[i + 1];
+    n_len--;
+  } else
+    n_count++;
+  an_ring[n_head] = n_value;
+  n_head = n_head + 1 == n_size ? 0 : n_head + 1;
+
+  for (i = n_len; i > 0 && an_sorted[i - 1] > n_value; i--) // insertion from the right end
+    an_sorted[i] = an_sorted[i - 1];
+  an_sorted[i] = n_value;
+}
+
+int32_t RollingMedian::median(void) const
+{
+  if (n_count == 0) return 0;
+  return n_count % 2 ? an_sorted[(n_count - 1) / 2] : (an_sorted[n_count / 2 - 1] + an_sorted[n_count / 2]) / 2;
+}
+
+int32_t RollingMedian::values(int32_t* pn_values) const
+{
+  int32_t n_oldest = n_count == n_size ? n_head : 0;
+  for (int32_t i = 0; i < n_count; i++)
+    pn_values[i] = an_ring[(n_oldest + i) % n_size];
+  return n_count;
+}
+
+int32_t RollingMedian::newest(void) const
+{
+  if (n_count == 0) return 0;
+  return an_ring[n_head == 0 ? n_size - 1 : n_head - 1];
+}
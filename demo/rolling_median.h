@@ -0,0 +1,40 @@
+/** \file rolling_median.h **************************************************
+*
+* Description: Median of the last N values, updated in O(N) per insertion
+*              without re-sorting. The values are kept twice: in arrival
+*              order (ring) to know which one leaves the window, and in
+*              ascending order so the median is a direct read.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef ROLLING_MEDIAN_H_
+#define ROLLING_MEDIAN_H_
+
+#include <stdint.h>
+
+#define ROLLING_MEDIAN_MAX_SIZE 32
+
+class RollingMedian {
+ public:
+  RollingMedian(int32_t n_window = ROLLING_MEDIAN_MAX_SIZE);
+
+  void clear(void);
+  void push(int32_t n_value); // the oldest value leaves once the window is full
+  int32_t median(void) const; // mean of the two middle values for an even count, 0 when empty
+  int32_t count(void) const { return n_count; }
+  int32_t size(void) const { return n_size; }
+  int32_t newest(void) const; // 0 when empty
+  int32_t values(int32_t* pn_values) const; // copies the values oldest first, returns count()
+
+ private:
+  int32_t an_ring[ROLLING_MEDIAN_MAX_SIZE];   // arrival order
+  int32_t an_sorted[ROLLING_MEDIAN_MAX_SIZE]; // ascending order
+  int32_t n_size;
+  int32_t n_count;
+  int32_t n_head; // next write position in an_ring
+};
+
+#endif /* ROLLING_MEDIAN_H_ */
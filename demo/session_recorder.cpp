@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include "session_recorder.h"
+
+#define RING_WORDS (RECORDER_RING_BYTES / 4)
+#define BLOCK_WORDS (RECORDER_BLOCK_BYTES / 4)
+#define EXPORT_CHUNK 64 // records read from storage at a time during export
+
+SessionRecorder::SessionRecorder(RecordStorage* storage)
+  : p_storage(storage), un_head(0), un_tail(0), un_result(0), un_recorded(0), un_dropped(0), b_active(false)
+{
+  memset(&header, 0, sizeof(header));
+}
+
+bool SessionRecorder::begin(const ppg_record_header* p_config)
+{
+  header = *p_config;
+  un_head = un_tail = 0;
+  un_recorded = un_dropped = 0;
+  set_result(999, 999);
+  b_active = p_storage->clear();
+  return b_active;
+}
+
+void SessionRecorder::set_result(int32_t n_heart_rate, int32_t n_spo2)
+{
+  un_result = ((uint32_t)n_heart_rate & 0xFFFF) | ((uint32_t)n_spo2 << 16);
+}
+
+bool SessionRecorder::append_sample(uint32_t un_green, uint32_t un_ir, uint32_t un_red)
+/**
+* \brief        Append one sample to the ring
+* \par          Details
+*               Producer side: the free space is checked against un_tail, the record written, and only then
+*               un_head advanced, with a memory barrier in between each so a consumer in another task never
+*               reads a slot before it is complete or has the slot overwritten before it is spilled.
+*
+* \param[in]    un_green, un_ir, un_red - raw samples
+*
+* \retval       true if the sample completed a block, service() has something to spill
+*/
+{
+  if (!b_active) return false;
+  uint32_t un_words = un_head;
+  if (un_words - un_tail + RECORDER_RECORD_WORDS > RING_WORDS) { un_dropped++; return false; } // storage fell behind
+  __sync_synchronize(); // un_tail read before the slot is reused
+  uint32_t* pun_record = &aun_ring[un_words % RING_WORDS]; // records never straddle the end of the ring
+  pun_record[0] = un_green;
+  pun_record[1] = un_ir;
+  pun_record[2] = un_red;
+  pun_record[3] = un_result;
+  __sync_synchronize(); // the record is complete before the consumer can see it
+  un_head = un_words + RECORDER_RECORD_WORDS;
+  un_recorded++;
+  return (un_words + RECORDER_RECORD_WORDS) % BLOCK_WORDS == 0;
+}
+
+bool SessionRecorder::service(void)
+{
+  uint32_t un_words = un_tail;
+  if (!b_active || un_head - un_words < BLOCK_WORDS) return true;
+  __sync_synchronize(); // un_head read before the block
+  // blocks start at multiples of BLOCK_WORDS and RING_WORDS is a multiple of BLOCK_WORDS, so a block is contiguous
+  if (!p_storage->append((const uint8_t*)&aun_ring[un_words % RING_WORDS], RECORDER_BLOCK_BYTES)) { b_active = false; return false; }
+  __sync_synchronize(); // the block is stored before the producer may overwrite it
+  un_tail = un_words + BLOCK_WORDS;
+  return true;
+}
+
+bool SessionRecorder::flush(void)
+{
+  while (block_ready())
+    if (!service()) return false;
+  uint32_t un_words = un_tail, un_end = un_head;
+  __sync_synchronize();
+  if (b_active && un_end != un_words) { // partial block, contiguous for the same reason
+    if (!p_storage->append((const uint8_t*)&aun_ring[un_words % RING_WORDS], (un_end - un_words) * 4)) { b_active = false; return false; }
+    un_tail = un_end;
+  }
+  b_active = false;
+  return true;
+}
+
+bool SessionRecorder::export_binary(ByteOutput* p_output)
+/**
+* \brief        Export the stored session as a binary recording
+* \par          Details
+*               Storage holds whole records, the export transposes them into one column per channel
+*               by reading the storage once per channel in EXPORT_CHUNK record pieces.
+*
+* \param[in]    *p_output               - destination
+*
+* \retval       false on storage or output error
+*/
+{
+  static const uint8_t auch_kinds[RECORDER_CHANNELS] = { PPG_CHANNEL_GREEN, PPG_CHANNEL_IR, PPG_CHANNEL_RED, PPG_CHANNEL_HEART_RATE, PPG_CHANNEL_SPO2 };
+  uint32_t un_records = p_storage->size() / (RECORDER_RECORD_WORDS * 4);
+  ppg_record_header hdr = header;
+  hdr.un_magic = PPG_RECORD_MAGIC;
+  hdr.uw_version = PPG_RECORD_VERSION;
+  hdr.uw_header_size = sizeof(ppg_record_header);
+  hdr.un_sample_count = un_records;
+  hdr.un_first_sample = 0;
+  hdr.uch_channel_count = RECORDER_CHANNELS;
+  if (!p_output->write((const uint8_t*)&hdr, sizeof(hdr))) return false;
+  for (int32_t c = 0; c < RECORDER_CHANNELS; c++) {
+    ppg_channel_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.uch_kind = auch_kinds[c];
+    desc.uch_sample_bits = c < 3 ? 18 : 16;
+    if (!p_output->write((const uint8_t*)&desc, sizeof(desc))) return false;
+  }
+
+  uint32_t aun_records[EXPORT_CHUNK * RECORDER_RECORD_WORDS];
+  uint32_t aun_column[EXPORT_CHUNK];
+  for (int32_t c = 0; c < RECORDER_CHANNELS; c++) {
+    for (uint32_t i = 0; i < un_records; i += EXPORT_CHUNK) {
+      uint32_t un_n = un_records - i < EXPORT_CHUNK ? un_records - i : EXPORT_CHUNK;
+      if (!p_storage->read(i * RECORDER_RECORD_WORDS * 4, (uint8_t*)aun_records, un_n * RECORDER_RECORD_WORDS * 4)) return false;
+      for (uint32_t k = 0; k < un_n; k++) {
+        uint32_t* pun_record = &aun_records[k * RECORDER_RECORD_WORDS];
+        if (c < 3) aun_column[k] = pun_record[c];
+        else if (c == 3) aun_column[k] = (uint32_t)(int32_t)(int16_t)(pun_record[3] & 0xFFFF); // heart rate
+        else aun_column[k] = (uint32_t)(int32_t)(int16_t)(pun_record[3] >> 16); // SpO2
+      }
+      if (!p_output->write((const uint8_t*)aun_column, un_n * 4)) return false;
+    }
+  }
+  return true;
+}
+
+bool SessionRecorder::export_csv(ByteOutput* p_output)
+{
+  static const char s_header[] = "Green,IR,Red,HR,SpO2\n";
+  if (!p_output->write((const uint8_t*)s_header, sizeof(s_header) - 1)) return false;
+  uint32_t un_records = p_storage->size() / (RECORDER_RECORD_WORDS * 4);
+  uint32_t aun_records[EXPORT_CHUNK * RECORDER_RECORD_WORDS];
+  char s_line[64];
+  for (uint32_t i = 0; i < un_records; i += EXPORT_CHUNK) {
+    uint32_t un_n = un_records - i < EXPORT_CHUNK ? un_records - i : EXPORT_CHUNK;
+    if (!p_storage->read(i * RECORDER_RECORD_WORDS * 4, (uint8_t*)aun_records, un_n * RECORDER_RECORD_WORDS * 4)) return false;
+    for (uint32_t k = 0; k < un_n; k++) {
+      uint32_t* pun_record = &aun_records[k * RECORDER_RECORD_WORDS];
+      int n_len = snprintf(s_line, sizeof(s_line), "%lu,%lu,%lu,%d,%d\n", (unsigned long)pun_record[0], (unsigned long)pun_record[1],
+                           (unsigned long)pun_record[2], (int16_t)(pun_record[3] & 0xFFFF), (int16_t)(pun_record[3] >> 16));
+      if (!p_output->write((const uint8_t*)s_line, n_len)) return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,84 @@
+/** \file session_recorder.h ************************************************
+*
+* Description: Session recorder. Raw green/IR/red samples and the latest
+*              HR/SpO2 are appended to a preallocated RAM ring in O(1) and
+*              spilled to storage (LittleFS on the device, a file on the host)
+*              in RECORDER_BLOCK_BYTES blocks by service(). The ring has one
+*              producer and one consumer which may run in different tasks:
+*              append_sample() and set_result() in the sampling loop,
+*              service() and flush() in a low-priority task (recorder_task in
+*              demo.ino) woken when append_sample() completes a block, so a
+*              slow flash write never holds up acquisition. When storage
+*              falls behind, samples are dropped and counted rather than
+*              blocking. A finished session can be exported in the binary
+*              recording format (ppg_record.h) or as CSV, both readable by
+*              tools/ppg_convert.
+*
+* Stored layout: one record of RECORDER_RECORD_WORDS 32-bit words per sample:
+*              green, IR, red, HR (low 16 bits) | SpO2 (high 16 bits).
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef SESSION_RECORDER_H_
+#define SESSION_RECORDER_H_
+
+#include <stdint.h>
+#include "ppg_record.h"
+
+#define RECORDER_RECORD_WORDS 4
+#define RECORDER_BLOCK_BYTES 4096  // flash sector size
+#define RECORDER_RING_BYTES 16384  // 1024 samples, 2.5 s at 400 sps
+#define RECORDER_CHANNELS 5        // green, IR, red, HR, SpO2
+
+// append-only byte store holding the spilled blocks
+class RecordStorage {
+ public:
+  virtual ~RecordStorage(void) {}
+  virtual bool clear(void) = 0;
+  virtual bool append(const uint8_t* puch_data, uint32_t un_length) = 0;
+  virtual bool read(uint32_t un_offset, uint8_t* puch_data, uint32_t un_length) = 0;
+  virtual uint32_t size(void) = 0;
+};
+
+// destination of an export, e.g. Serial or a file
+class ByteOutput {
+ public:
+  virtual ~ByteOutput(void) {}
+  virtual bool write(const uint8_t* puch_data, uint32_t un_length) = 0;
+};
+
+class SessionRecorder {
+ public:
+  SessionRecorder(RecordStorage* p_storage);
+
+  // starts a new session, p_config provides sampling rate and LED configuration for the export header
+  bool begin(const ppg_record_header* p_config);
+  void set_result(int32_t n_heart_rate, int32_t n_spo2); // recorded with every following sample
+  bool append_sample(uint32_t un_green, uint32_t un_ir, uint32_t un_red); // true if it completed a block for service()
+  bool block_ready(void) const { return b_active && un_head - un_tail >= RECORDER_BLOCK_BYTES / 4; }
+  bool service(void); // spills at most one full block, false on storage error
+  bool flush(void);   // spills everything including a partial block, ends the session
+
+  uint32_t recorded(void) const { return un_recorded; }
+  uint32_t dropped(void) const { return un_dropped; }
+  bool active(void) const { return b_active; }
+
+  bool export_binary(ByteOutput* p_output);
+  bool export_csv(ByteOutput* p_output);
+
+ private:
+  RecordStorage* p_storage;
+  ppg_record_header header;
+  uint32_t aun_ring[RECORDER_RING_BYTES / 4];
+  volatile uint32_t un_head; // words written into the ring, free running, only the producer writes it
+  volatile uint32_t un_tail; // words spilled to storage, free running, only the consumer writes it
+  uint32_t un_result;
+  uint32_t un_recorded;
+  uint32_t un_dropped;
+  volatile bool b_active;
+};
+
+#endif /* SESSION_RECORDER_H_ */
@@ -0,0 +1,110 @@
+#include "slope_detector.h"
+
+SlopeDetector::SlopeDetector(int32_t n_min_distance) : n_min_distance(n_min_distance < 0 ? 0 : n_min_distance)
+{
+  reset();
+}
+
+void SlopeDetector::reset(void)
+{
+  un_index = 0;
+  n_last = 0;
+  ch_slope = 0;
+  un_turn = 0;
+  peak.b_pending = false;
+  valley.b_pending = false;
+  un_peak = 0;
+  un_valley = 0;
+}
+
+bool SlopeDetector::add(extremum* p_held, uint32_t un_at, int32_t n_value, int8_t ch_sign)
+/**
+* \brief        Hold back a new extremum
+* \par          Details
+*               Within n_min_distance of the held one only the more extreme of the two is kept (ch_sign 1 for
+*               peaks, -1 for valleys), otherwise the held one is confirmed and the new one takes its place.
+*
+* \retval       true if the held extremum was confirmed
+*/
+{
+  if (p_held->b_pending && (int32_t)(un_at - p_held->un_index) <= n_min_distance) {
+    if (ch_sign * (n_value - p_held->n_value) > 0) {
+      p_held->un_index = un_at;
+      p_held->n_value = n_value;
+    }
+    return false;
+  }
+  bool b_confirmed = p_held->b_pending;
+  if (b_confirmed)
+    (ch_sign > 0 ? un_peak : un_valley) = p_held->un_index;
+  p_held->b_pending = true;
+  p_held->un_index = un_at;
+  p_held->n_value = n_value;
+  return b_confirmed;
+}
+
+// confirms the held extremum once nothing can replace it any more
+bool SlopeDetector::expire(extremum* p_held)
+{
+  if (!p_held->b_pending || (int32_t)(un_index - 1 - p_held->un_index) <= n_min_distance)
+    return false;
+  (p_held == &peak ? un_peak : un_valley) = p_held->un_index;
+  p_held->b_pending = false;
+  return true;
+}
+
+uint8_t SlopeDetector::push(int32_t n_sample)
+/**
+* \brief        Feed one sample
+* \par          Details
+*               A turn is found one sample after it ends (the first sample moving the other way), then held for
+*               n_min_distance samples. At most one peak and one valley are confirmed per sample, a second one
+*               follows on the next sample.
+*
+* \param[in]    n_sample                - filtered sample, peaks upwards
+*
+* \retval       slope_event bits
+*/
+{
+  uint8_t uch_events = SLOPE_NONE;
+  uint32_t un_i = un_index++;
+  if (un_i > 0 && n_sample != n_last) {
+    int8_t ch_new = n_sample > n_last ? 1 : -1;
+    if (ch_slope == 1 && ch_new == -1 && add(&peak, un_turn, n_last, 1))
+      uch_events |= SLOPE_PEAK;
+    if (ch_slope == -1 && ch_new == 1 && add(&valley, un_turn, n_last, -1))
+      uch_events |= SLOPE_VALLEY;
+    ch_slope = ch_new;
+    un_turn = un_i;
+  }
+  n_last = n_sample;
+  if (!(uch_events & SLOPE_PEAK) && expire(&peak))
+    uch_events |= SLOPE_PEAK;
+  if (!(uch_events & SLOPE_VALLEY) && expire(&valley))
+    uch_events |= SLOPE_VALLEY;
+  return uch_events;
+}
+
+uint8_t SlopeDetector::finish(void)
+/**
+* \brief        Flush at the end of the data
+* \par          Details
+*               A run ending on a flat top or bottom of two or more samples counts as a turn, a run still moving
+*               on the last sample does not. Then the held extrema are confirmed. Repeated calls walk through
+*               these steps, SLOPE_NONE means everything has been reported.
+*
+* \retval       slope_event bits
+*/
+{
+  if (ch_slope != 0 && un_turn + 1 < un_index) {
+    int8_t ch_sign = ch_slope;
+    ch_slope = 0; // consumed
+    if (add(ch_sign > 0 ? &peak : &valley, un_turn, n_last, ch_sign))
+      return ch_sign > 0 ? SLOPE_PEAK : SLOPE_VALLEY;
+  }
+  ch_slope = 0;
+  uint8_t uch_events = SLOPE_NONE;
+  if (peak.b_pending) { un_peak = peak.un_index; peak.b_pending = false; uch_events |= SLOPE_PEAK; }
+  if (valley.b_pending) { un_valley = valley.un_index; valley.b_pending = false; uch_events |= SLOPE_VALLEY; }
+  return uch_events;
+}
@@ -0,0 +1,65 @@
+/** \file slope_detector.h **************************************************
+*
+* Description: Streaming "increasing slope" peak and valley detector, the
+*              method of data/increasing_slope_against_AMPD. A peak is where
+*              a rising run turns into a falling one, a valley the reverse;
+*              equal samples continue the run and a flat top or bottom is
+*              reported at its first sample. Each sample is pushed once and
+*              costs O(1), against O(N^2) for AMPD over the window.
+*              With a minimum distance, an extremum is held back until no
+*              higher peak (lower valley) follows within that distance, which
+*              replaces maxim_remove_close_peaks for this detector; with 0 the
+*              output is the plain method of the recorded experiments.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef SLOPE_DETECTOR_H_
+#define SLOPE_DETECTOR_H_
+
+#include <stdint.h>
+
+enum slope_event {
+  SLOPE_NONE = 0,
+  SLOPE_PEAK = 1,   // peak_index() holds a newly confirmed peak
+  SLOPE_VALLEY = 2  // valley_index() holds a newly confirmed valley, may come with SLOPE_PEAK
+};
+
+class SlopeDetector {
+ public:
+  SlopeDetector(int32_t n_min_distance = 0);
+
+  void reset(void);
+
+  uint8_t push(int32_t n_sample); // slope_event bits confirmed by this sample
+  // end of the data: confirms what is still held back, call until it returns SLOPE_NONE
+  uint8_t finish(void);
+
+  uint32_t peak_index(void) const { return un_peak; }     // sample index of the last confirmed peak
+  uint32_t valley_index(void) const { return un_valley; } // sample index of the last confirmed valley
+  uint32_t sample_count(void) const { return un_index; }
+
+ private:
+  typedef struct {
+    bool b_pending;
+    uint32_t un_index;
+    int32_t n_value;
+  } extremum;
+
+  bool add(extremum* p_held, uint32_t un_at, int32_t n_value, int8_t ch_sign);
+  bool expire(extremum* p_held);
+
+  int32_t n_min_distance;
+  uint32_t un_index;    // samples pushed so far
+  int32_t n_last;       // previous sample
+  int8_t ch_slope;      // 1 rising, -1 falling, 0 before the first change
+  uint32_t un_turn;     // first sample at the current level, where the run may turn
+  extremum peak;        // held back for n_min_distance
+  extremum valley;
+  uint32_t un_peak;
+  uint32_t un_valley;
+};
+
+#endif /* SLOPE_DETECTOR_H_ */
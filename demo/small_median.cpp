@@ -0,0 +1,81 @@
+#include "small_median.h"
+#include "median_networks.h"
+
+#define COMPARE_EXCHANGE(a, b) { int32_t n_lo = pn_x[a], n_hi = pn_x[b]; \
+  pn_x[a] = n_lo < n_hi ? n_lo : n_hi; pn_x[b] = n_lo < n_hi ? n_hi : n_lo; }
+
+static int32_t middle_value(const int32_t* pn_x, int32_t n_size, int32_t n_lower)
+{
+  return n_size % 2 ? pn_x[n_size / 2] : (n_lower + pn_x[n_size / 2]) / 2;
+}
+
+int32_t median_network(int32_t* pn_x, int32_t n_size)
+/**
+* \brief        Median by a selection network
+* \par          Details
+*               The comparators of size n_size run in table order; afterwards pn_x[n_size / 2] (and
+*               pn_x[n_size / 2 - 1] for an even size) hold the sorted middle values, the other positions
+*               are only partially ordered.
+*
+* \param[in,out] *pn_x                  - values, reordered
+* \param[in]    n_size                  - 1 to MEDIAN_NETWORK_MAX
+*
+* \retval       median, the truncated mean of the two middle values for an even size
+*/
+{
+  const uint8_t (*puch_pair)[2] = median_network_pairs + median_network_start[n_size];
+  const uint8_t (*puch_end)[2] = median_network_pairs + median_network_start[n_size + 1];
+  for (; puch_pair < puch_end; puch_pair++)
+    COMPARE_EXCHANGE((*puch_pair)[0], (*puch_pair)[1]);
+  return middle_value(pn_x, n_size, n_size % 2 ? 0 : pn_x[n_size / 2 - 1]);
+}
+
+int32_t median_quickselect(int32_t* pn_x, int32_t n_size)
+/**
+* \brief        Median by quickselect
+* \par          Details
+*               Hoare partitioning around the median of the first, middle and last value of the active
+*               range, narrowed to the side holding position n_size / 2 until it is in place, O(n) on
+*               average. Everything left of that position is then not greater, so the lower middle value
+*               of an even size is the maximum of the left part.
+*
+* \param[in,out] *pn_x                  - values, reordered
+* \param[in]    n_size                  - number of values, at least 1
+*
+* \retval       median, the truncated mean of the two middle values for an even size
+*/
+{
+  int32_t n_k = n_size / 2, n_left = 0, n_right = n_size - 1;
+  while (n_right > n_left + 1) {
+    int32_t n_mid = (n_left + n_right) / 2, i, j, n_pivot, n_temp;
+    n_temp = pn_x[n_mid]; pn_x[n_mid] = pn_x[n_left + 1]; pn_x[n_left + 1] = n_temp;
+    COMPARE_EXCHANGE(n_left, n_right);     // median of three at n_left + 1, the two others are sentinels
+    COMPARE_EXCHANGE(n_left + 1, n_right);
+    COMPARE_EXCHANGE(n_left, n_left + 1);
+    n_pivot = pn_x[n_left + 1];
+    for (i = n_left + 1, j = n_right;;) {
+      do i++; while (pn_x[i] < n_pivot);
+      do j--; while (pn_x[j] > n_pivot);
+      if (j < i) break;
+      n_temp = pn_x[i]; pn_x[i] = pn_x[j]; pn_x[j] = n_temp;
+    }
+    pn_x[n_left + 1] = pn_x[j];
+    pn_x[j] = n_pivot;
+    if (j >= n_k) n_right = j - 1;
+    if (j <= n_k) n_left = i;
+  }
+  if (n_right == n_left + 1)
+    COMPARE_EXCHANGE(n_left, n_right);
+  if (n_size % 2)
+    return pn_x[n_k];
+  int32_t n_lower = pn_x[0];
+  for (int32_t i = 1; i < n_k; i++)
+    n_lower = pn_x[i] > n_lower ? pn_x[i] : n_lower;
+  return middle_value(pn_x, n_size, n_lower);
+}
+
+int32_t small_median(int32_t* pn_x, int32_t n_size)
+{
+  if (n_size < 1) return 0;
+  return n_size <= MEDIAN_NETWORK_MAX ? median_network(pn_x, n_size) : median_quickselect(pn_x, n_size);
+}
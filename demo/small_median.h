@@ -0,0 +1,31 @@
+/** \file small_median.h ****************************************************
+*
+* Description: Median of a short array without sorting it, shared by the
+*              moving median filter, the peak interval median and the R
+*              ratio median of spo2_algorithm.cpp, which each used a full
+*              insertion sort to read one or two middle values. Up to
+*              MEDIAN_NETWORK_MAX values a selection network of
+*              median_networks.h is applied: a fixed sequence of
+*              compare-exchanges (min and max, no data dependent branch)
+*              after which the middle positions hold the values a sort
+*              would have put there. Larger arrays use quickselect. Both
+*              reorder the array in place and give the same result as
+*              maxim_sort_ascend followed by the middle read, including the
+*              truncated mean of the two middle values for an even count.
+*              tools/median_bench compares them with the insertion sort.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef SMALL_MEDIAN_H_
+#define SMALL_MEDIAN_H_
+
+#include <stdint.h>
+
+int32_t small_median(int32_t* pn_x, int32_t n_size);  // 0 when n_size < 1, pn_x is reordered
+int32_t median_network(int32_t* pn_x, int32_t n_size); // n_size 1 to MEDIAN_NETWORK_MAX only
+int32_t median_quickselect(int32_t* pn_x, int32_t n_size); // any n_size > 0
+
+#endif /* SMALL_MEDIAN_H_ */
@@ -59,21 +59,45 @@
 
 #include "Arduino.h"
 #include "spo2_algorithm.h"
+#include "fixed_point.h"
+#include "stage_timer.h"
+#include "autocorr_engine.h"
+#include "pipeline_controller.h"
+#include "slope_detector.h"
+#include "peak_valley_detector.h"
+#include "small_median.h"
 
-// The hyper-tuning parameter and updated by tested results
+// The hyper-tuning parameter and updated by tested results, the initial sizes of a PipelineController
 const int32_t max_n_peak = 16; // initialize with 16
 const int32_t max_n_valley = 16; // initialize with 16
 const int32_t filter_size = 15; // initalize with 14 to 17 is the best suitable for AMPD
 const int32_t ratio_size = 16; // initalize with 16, the ratio size is at most equal to the number of heart interval
+static PipelineController fixed_sizes(max_n_peak, max_n_valley, filter_size, ratio_size); // for callers without a controller, never updated
+const int32_t hr_engine = HR_ENGINE_SPECTRAL; // hr_engine_kind, chosen with tools/hr_engine_bench -s against the known rate of synthetic recordings
+const int32_t beat_fusion = FUSION_GREEN; // beat_fusion_kind, see tools/fusion_bench for the cost of FUSION_VOTE
+const int32_t preprocess_engine = PREPROCESS_MEDIAN_MEAN; // preprocess_kind, see tools/bandpass_bench; FUSION_VOTE always uses preprocessing()
+
+// spectral HR engine, see spectral_heart_rate()
+const int32_t spectral_rate = 50; // decimated sampling rate, the band ends at 3.5 Hz
+const int32_t spectral_min_bpm = 30;
+const int32_t spectral_max_bpm = 210;
+const int32_t spectral_step_bpm = 3; // grid of the Goertzel bank, refined by parabolic interpolation
+
+// signal quality gate, see signal_quality()
+const int32_t min_ir_dc = 5000; // IR counts without a finger stay far below this
+const int32_t adc_ceiling = (1L << 18) - 64; // 18-bit ADC, samples this high are clipped
+const int32_t max_clipped_permille = 10; // at most 1 % clipped samples
+const int32_t min_perfusion = 2; // 0.02 % in 0.01 % units
+const int32_t max_interval_cv = 35; // percent
 
 #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
 //Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
 //To solve this problem, 16-bit MSB of the sampled data will be truncated.  Samples become 16-bit data.
 void heart_rate_and_oxygen_saturation(uint16_t* pun_green_buffer, uint16_t *pun_ir_buffer, uint16_t* pun_red_buffer, int32_t buffer_length,
-    int32_t sampling_rate, int32_t *pn_spo2, int32_t *pn_heart_rate)
+    int32_t sampling_rate, int32_t *pn_spo2, int32_t *pn_heart_rate, uint8_t* puch_quality, PipelineController* p_controller)
 #else
 void heart_rate_and_oxygen_saturation(uint32_t *pun_green_buffer, uint32_t *pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length,
-    int32_t sampling_rate, int32_t *pn_spo2, int32_t *pn_heart_rate)
+    int32_t sampling_rate, int32_t *pn_spo2, int32_t *pn_heart_rate, uint8_t* puch_quality, PipelineController* p_controller)
 #endif
 /**
 * \brief        Calculate the heart rate and SpO2 level
@@ -89,49 +113,67 @@ void heart_rate_and_oxygen_saturation(uint32_t *pun_green_buffer, uint32_t *pun_
 * \param[in]    sampling_rate            - the actual sampling rate
 * \param[out]    *pn_spo2                - Calculated SpO2 value, -1 represents the value is invalid
 * \param[out]    *pn_heart_rate          - Calculated heart rate value, -1 represents the value is invalid
+* \param[out]    *puch_quality           - signal_quality_code of the window, both values are 999 unless SIGNAL_OK
+* \param[in,out] *p_controller           - buffers and sizes of the session, adapted to this window; NULL keeps the fixed sizes
 *
 * \retval       None
 */
 {
-    Serial.printf("max_n_peak: %d, max_n_valley: %d, filter_size: %d, ratio_size: %d\n", max_n_peak, max_n_valley, filter_size, ratio_size);
-    
-    int32_t* peak_locs = (int32_t*)calloc(max_n_peak, sizeof(int32_t)); // peak location index array
-    int32_t* valley_locs = (int32_t*)calloc(max_n_valley, sizeof(int32_t)); // valley location index array
-    // if (peak_locs == NULL || valley_locs == NULL) { Serial.println(F("Inital Dynamic Memory Allocation Fails !!!")); return; }
+    // gate the expensive stages, a window without a usable pulse would end in 999 anyway
+    signal_quality_info quality_info;
+    {
+        STAGE_SCOPE(STAGE_QUALITY);
+        *puch_quality = signal_quality(pun_green_buffer, pun_ir_buffer, pun_red_buffer, buffer_length, sampling_rate, &quality_info);
+    }
+    if (*puch_quality != SIGNAL_OK) {
+        *pn_spo2 = 999;
+        *pn_heart_rate = 999;
+        return;
+    }
+
+    PipelineController* p_sizes = p_controller != NULL ? p_controller : &fixed_sizes;
+    int32_t n_max_peak = p_sizes->max_peak(), n_max_valley = p_sizes->max_valley();
+    int32_t n_filter_size = p_sizes->filter_size(), n_ratio_size = p_sizes->ratio_size();
+    Serial.printf("max_n_peak: %d, max_n_valley: %d, filter_size: %d, ratio_size: %d\n", n_max_peak, n_max_valley, n_filter_size, n_ratio_size);
+
+    int32_t* peak_locs = p_sizes->peak_locs(); // peak location index array
+    int32_t* valley_locs = p_sizes->valley_locs(); // valley location index array
     int32_t num_peak, num_val; // the actual peak number and valley number
     int32_t n_i_ratio_count; // the actual ratio counter/number
     int32_t n_peak_interval_sum; // used for update the filter_size
 
+    // the band-passed window exists once the controller has been fed a whole window, callers without one filter per window
+    const int32_t* pn_filtered = preprocess_engine == PREPROCESS_BANDPASS ? p_sizes->filtered_window(buffer_length) : NULL;
+    // the autocorrelation engines of the controller are fed hop by hop, -1 until one has seen a whole window
+    int32_t an_streamed_rate[FUSION_CHANNELS] = { -1, -1, -1 };
+    if (hr_engine == HR_ENGINE_AUTOCORR && p_controller != NULL) {
+        STAGE_SCOPE(STAGE_AUTOCORR);
+        for (int32_t c = 0; c < (beat_fusion == FUSION_VOTE ? FUSION_CHANNELS : 1); c++)
+            an_streamed_rate[c] = p_controller->autocorr_rate(c, sampling_rate, buffer_length);
+    }
+
     // HR calculation
-    *pn_heart_rate = HR_calculation(pun_green_buffer, buffer_length, peak_locs, &num_peak, max_n_peak, valley_locs, &num_val, max_n_valley, sampling_rate, &n_peak_interval_sum);
+    if (beat_fusion == FUSION_VOTE)
+        *pn_heart_rate = HR_calculation_fused(hr_engine, pun_green_buffer, pun_ir_buffer, pun_red_buffer, buffer_length, peak_locs, &num_peak, n_max_peak,
+                                              valley_locs, &num_val, n_max_valley, sampling_rate, n_filter_size, an_streamed_rate, &n_peak_interval_sum);
+    else
+        *pn_heart_rate = HR_calculation(pun_green_buffer, buffer_length, peak_locs, &num_peak, n_max_peak, valley_locs, &num_val, n_max_valley, sampling_rate, n_filter_size, pn_filtered, an_streamed_rate[0], &n_peak_interval_sum);
     Serial.printf("The num of peak is %d\n", num_peak);
 
-    // SPO2 Calculation
-    *pn_spo2 = spo2_calculation(pun_ir_buffer, pun_red_buffer, buffer_length, peak_locs, num_peak, valley_locs, num_val, ratio_size, &n_i_ratio_count);
-
-    // update the hyper-tuning parameters
-    // max number of valleys
-    //if (num_peak > 3 * max_n_peak / 4)
-    //    max_n_peak = 2 * max_n_peak;
-    //if (num_peak < max_n_peak / 4 && max_n_peak >= 8)
-    //    max_n_peak = max_n_peak / 2;
-    //// max number of valleys
-    //if (num_val > 3 * max_n_valley / 4)
-    //    max_n_valley = 2 * max_n_valley;
-    //if (num_val < max_n_valley / 4 && max_n_valley >= 8)
-    //    max_n_valley = max_n_valley / 2;
-    //// filter size
-    //filter_size = n_peak_interval_sum > 280 && n_peak_interval_sum < 360 ? n_peak_interval_sum / 20 : 16;
-    //// ratio_size
-    //if (n_i_ratio_count > 3 * ratio_size / 4)
-    //    ratio_size = 2 * ratio_size;
-    //if (n_i_ratio_count < ratio_size / 4 && ratio_size >= 8)
-    //    ratio_size = ratio_size / 2;
-
-    // free the dynamic memory
-    free(peak_locs); free(valley_locs);
-    // avoid wild pointers
-    peak_locs = NULL; valley_locs = NULL;
+    // pair the peaks and valleys into beats once, every later stage works on the beats
+    Beat* beats = p_sizes->beats();
+    {
+        STAGE_SCOPE(STAGE_SPO2);
+        // the HR engines run on the inverted green, their peaks are the troughs of the raw IR/red and their valleys the raw peaks
+        int32_t num_beats = segment_beats(peak_locs, num_peak, valley_locs, num_val, 5 * n_filter_size, beats, n_max_peak);
+
+        // SPO2 Calculation
+        *pn_spo2 = spo2_calculation(pun_ir_buffer, pun_red_buffer, beats, num_beats, n_ratio_size, &n_i_ratio_count);
+    }
+
+    // update the hyper-tuning parameters for the next window, the buffers belong to the controller
+    if (p_controller != NULL)
+        p_controller->update(num_peak, num_val, *pn_heart_rate == 999 ? 0 : n_peak_interval_sum, n_i_ratio_count);
 }
 
 void maxim_find_peaks(int32_t *pn_locs, int32_t *n_npks, int32_t *valley_locs, int32_t *n_vals, int32_t *pn_x, int32_t n_size, int32_t max_threshold, int32_t min_threshold)
@@ -317,169 +359,349 @@ void maxim_sort_indices_descend(int32_t *pn_x, int32_t *pn_indx, int32_t n_size)
   }
 }
 
-void check_valid(int32_t *peak_locs, int32_t *n_npks, int32_t *valley_locs, int32_t *n_vals, int32_t *an_x, int32_t buffer_length, int32_t sampling_rate)
+int32_t segment_beats(int32_t* valley_locs, int32_t num_val, int32_t* peak_locs, int32_t num_peak, int32_t n_min_distance, Beat* beats, int32_t max_num_beats)
+/**
+* \brief        Pair valleys and peaks into beats
+* \par          Details
+*               A beat is the triangle valley[k] < peak[j] < valley[k+1] < peak[j+1], where both the valleys and the
+*               peaks are separated by more than n_min_distance. Both arrays are sorted, so a single forward merge
+*               finds for each valley pair the last peak before valley[k+1] in O(num_val + num_peak).
+*
+* \param[in]    *valley_locs            - valley index array, ascending
+* \param[in]    num_val                 - number of valleys
+* \param[in]    *peak_locs              - peak index array, ascending
+* \param[in]    num_peak                - number of peaks
+* \param[in]    n_min_distance          - min distance of adjacent valleys and adjacent peaks
+* \param[out]   *beats                  - beat array
+* \param[in]    max_num_beats           - size of the beat array
+*
+* \retval       number of beats
+*/
+{
+    int32_t num_beats = 0;
+    int32_t j = 0; // peak pointer, only moves forward
+    for (int32_t k = 0; k < num_val - 1 && num_beats < max_num_beats; k++) { // k is valley pointer
+        while (j + 1 < num_peak && peak_locs[j + 1] < valley_locs[k + 1]) // last peak before valley[k+1]
+            j++;
+        if (j + 1 >= num_peak)
+            break; // no peak after valley[k+1], the remaining valleys can't close a triangle either
+        // distance of adjacent valleys and peaks should exceed five times of filter_size
+        // ensure triangle shape
+        if (valley_locs[k + 1] - valley_locs[k] > n_min_distance && peak_locs[j + 1] - peak_locs[j] > n_min_distance &&
+            valley_locs[k] < peak_locs[j] && valley_locs[k + 1] > peak_locs[j] && valley_locs[k + 1] < peak_locs[j + 1]) {
+            beats[num_beats].n_valley = valley_locs[k];
+            beats[num_beats].n_peak = peak_locs[j];
+            beats[num_beats].n_next_valley = valley_locs[k + 1];
+            num_beats++;
+        }
+    }
+    return num_beats;
+}
+
+void check_valid(Beat* beats, int32_t* n_beats, int32_t* an_x, int32_t sampling_rate)
 /**
 * \brief            check valid of signal waveform
 * \par              Datails
 *                   It consists absolute and relative artifact detection.
-* \param[in\out]    *peak_locs              - peak location index array
-* \param[in\out]    *n_npks                 - number of peaks
-* \param[in\out]    *valley_locs            - valley location index array
-* \param[in\out]    *n_vals                 - number of valleys
+* \param[in\out]    *beats                  - beat array from segment_beats, only the valid beats are kept
+* \param[in\out]    *n_beats                - number of beats
 * \param[in]        *an_x                   - inversed, DC eliminiated, and filtered data buffer
-* \param[in]        buffer_length           - data buffer size
 * \param[in]        sampling_rate           - the sampling frequency
 * 
 * \retval           None
 */
 {
-    Serial.printf("Enter the check_valid stage.\nBefore checking, the number of peaks: %d, the number of valleys: %d\n", *n_npks, *n_vals);
+    Serial.printf("Enter the check_valid stage.\nBefore checking, the number of beats: %d\n", *n_beats);
     
-    int32_t num_npks = *n_npks;
-    int32_t num_vals = *n_vals;
-    *n_npks = 0; // clear again to store the checked valid peak and valley
-    *n_vals = 0;
+    int32_t num_beats = *n_beats;
+    *n_beats = 0; // clear again to store the checked valid beats
 
-    bool piece_valid = false;
     float PWRT, PWD, PWA;
     float pre_PWRT = 0;
     float pre_PWD = 0;
     float pre_PWA = 0;
-    int32_t i, j, k;
-    for (i = 0; i < num_vals - 1; i++) { // i is valley index
-        for (j = 0; j < num_npks - 1; j++) { // j is peak index
-            // distance of adjacent valleys and peaks should exceed five times of filter_size
-            // ensure triangle shape
-            if (valley_locs[k + 1] - valley_locs[k] > 5 * filter_size && peak_locs[j + 1] - peak_locs[j] > 5 * filter_size &&
-                peak_locs[j] > valley_locs[i] && valley_locs[i + 1] > peak_locs[j] && peak_locs[j + 1] > valley_locs[i + 1]) {
-                piece_valid = false; // find a signal segment and firstly assume it is false
-                PWA = (float) an_x[peak_locs[j]] - an_x[valley_locs[i]]; // pulsewave amplitude
-
-                // absolute check starts
-                //1. check pulsewave rising time
-                PWRT = (float) (peak_locs[j] - valley_locs[i]) / sampling_rate;
-                if (PWRT > 0.6f || PWRT < 0.08f) { Serial.printf("Absolute PWRT error. PWRT is %.2f\n", PWRT); break; }
-
-                //2. check pulsewave duration
-                PWD = (float) (valley_locs[i + 1] - valley_locs[i]) / sampling_rate;
-                if (PWD > 2.7f || PWD < 0.27f) { Serial.printf("Absolute PWD error. PWD is %.2f\n", PWD); break; }
-
-                //3. check the ratio of systolic phase time and diastolic phase
-                float PWSDRatio = (float) PWRT / (PWD - PWRT); 
-                if (PWSDRatio > 1.1f) { Serial.printf("Absolute PWSDRatop error. PWSDRatio is %.2f\n", PWSDRatio); break; }
-
-                //4. check the number of peaks at diastolic phase
-                /*int32_t number_of_diastolic_peak = 0; 
-                for (k = peak_locs[j]; k < valley_locs[i + 1]; k++){
-                    if (an_x[k] < an_x[k + 1]) number_of_diastolic_peak++;
-                }
-                if (number_of_diastolic_peak > 3) { Serial.println(F("Number of peaks at diastolic phase is larger than 3")); break; }*/
+    for (int32_t i = 0; i < num_beats; i++) {
+        Beat* p_beat = &beats[i];
+        PWA = (float) an_x[p_beat->n_peak] - an_x[p_beat->n_valley]; // pulsewave amplitude
 
-                //5. check whether the systolic phase is montonical increasing
-                /*bool monotony_increasing = true;
-                for (k = valley_locs[i]; k < peak_locs[j]; k++) {
-                    if (an_x[k] > an_x[k + 1]) { monotony_increasing = false; break; }
-                }
-                if (!monotony_increasing) { Serial.println(F("Not monotonical increasing")); break; }*/
-
-                //6. check whether there are points smaller than the valley
-                /*for (k = peak_locs[j]; k < valley_locs[i + 1]; k++)
-                    if (an_x[k] < an_x[valley_locs[i + 1]]) { Serial.println(F("Exists points smaller than the valley")); break; }*/
-
-                //7. check whether pulse amplitude is distorted
-                float left_right_amplitude_ratio = (float) (an_x[peak_locs[j]] - an_x[valley_locs[i]]) / (an_x[peak_locs[j]] - an_x[valley_locs[i + 1]]);
-                if (left_right_amplitude_ratio < 0.4f || left_right_amplitude_ratio > 2.5f) { Serial.printf("Absolute pulse amplitude is distorted. left_right_amplitude_ratio is %.2f\n", left_right_amplitude_ratio); break; }
-
-                // if it is the first signal segementation
-                if (pre_PWRT == 0 && pre_PWD == 0 && pre_PWA == 0) { piece_valid = true; break; }
-                
-                // the relative checks start
-                //8. check rise time variation validation
-                float rise_time_variation = PWRT / pre_PWRT;
-                if (rise_time_variation > 3.f || rise_time_variation < 0.33f) { Serial.printf("Relative PWRT error. rise time variation is %.2f\n", rise_time_variation); break; }
-
-                // 9. check duration variation validation
-                float duration_variation = PWD / pre_PWD;
-                if (duration_variation > 3.f || duration_variation < 0.33f) { Serial.printf("Relative PWD error. duration variation is %.2f\n", duration_variation); break; }
-
-                // 10. check amplitude variation validation
-                float amplitude_variation = PWA / pre_PWA;
-                if (amplitude_variation > 4.f || amplitude_variation < 0.25f) { Serial.printf("Relative amplitude error. amplitude variation is %.2f\n", amplitude_variation); break; }
-
-                // if past all the checks, then these two peaks and valleys are valid
-                piece_valid = true;
-                break;
-            }
+        // absolute check starts
+        //1. check pulsewave rising time
+        PWRT = (float) (p_beat->n_peak - p_beat->n_valley) / sampling_rate;
+        if (PWRT > 0.6f || PWRT < 0.08f) { Serial.printf("Absolute PWRT error. PWRT is %.2f\n", PWRT); continue; }
+
+        //2. check pulsewave duration
+        PWD = (float) (p_beat->n_next_valley - p_beat->n_valley) / sampling_rate;
+        if (PWD > 2.7f || PWD < 0.27f) { Serial.printf("Absolute PWD error. PWD is %.2f\n", PWD); continue; }
+
+        //3. check the ratio of systolic phase time and diastolic phase
+        float PWSDRatio = (float) PWRT / (PWD - PWRT); 
+        if (PWSDRatio > 1.1f) { Serial.printf("Absolute PWSDRatop error. PWSDRatio is %.2f\n", PWSDRatio); continue; }
+
+        //4. check the number of peaks at diastolic phase
+        /*int32_t number_of_diastolic_peak = 0; 
+        for (k = p_beat->n_peak; k < p_beat->n_next_valley; k++){
+            if (an_x[k] < an_x[k + 1]) number_of_diastolic_peak++;
         }
-        if (piece_valid == true) { 
-            pre_PWRT = PWRT; pre_PWD = PWD; pre_PWA = PWA; // store the value into pre features
-            valley_locs[*n_vals] = valley_locs[i]; peak_locs[*n_npks] = peak_locs[j]; // the valid locs will be stored
-            *n_vals += 1; *n_npks += 1;
-            piece_valid = false; // return to false;
+        if (number_of_diastolic_peak > 3) { Serial.println(F("Number of peaks at diastolic phase is larger than 3")); continue; }*/
+
+        //5. check whether the systolic phase is montonical increasing
+        /*bool monotony_increasing = true;
+        for (k = p_beat->n_valley; k < p_beat->n_peak; k++) {
+            if (an_x[k] > an_x[k + 1]) { monotony_increasing = false; break; }
         }
+        if (!monotony_increasing) { Serial.println(F("Not monotonical increasing")); continue; }*/
+
+        //6. check whether there are points smaller than the valley
+        /*for (k = p_beat->n_peak; k < p_beat->n_next_valley; k++)
+            if (an_x[k] < an_x[p_beat->n_next_valley]) { Serial.println(F("Exists points smaller than the valley")); break; }*/
+
+        //7. check whether pulse amplitude is distorted
+        float left_right_amplitude_ratio = (float) (an_x[p_beat->n_peak] - an_x[p_beat->n_valley]) / (an_x[p_beat->n_peak] - an_x[p_beat->n_next_valley]);
+        if (left_right_amplitude_ratio < 0.4f || left_right_amplitude_ratio > 2.5f) { Serial.printf("Absolute pulse amplitude is distorted. left_right_amplitude_ratio is %.2f\n", left_right_amplitude_ratio); continue; }
+
+        // the relative checks only start after the first valid signal segementation
+        if (pre_PWRT != 0 || pre_PWD != 0 || pre_PWA != 0) {
+            //8. check rise time variation validation
+            float rise_time_variation = PWRT / pre_PWRT;
+            if (rise_time_variation > 3.f || rise_time_variation < 0.33f) { Serial.printf("Relative PWRT error. rise time variation is %.2f\n", rise_time_variation); continue; }
+
+            // 9. check duration variation validation
+            float duration_variation = PWD / pre_PWD;
+            if (duration_variation > 3.f || duration_variation < 0.33f) { Serial.printf("Relative PWD error. duration variation is %.2f\n", duration_variation); continue; }
+
+            // 10. check amplitude variation validation
+            float amplitude_variation = PWA / pre_PWA;
+            if (amplitude_variation > 4.f || amplitude_variation < 0.25f) { Serial.printf("Relative amplitude error. amplitude variation is %.2f\n", amplitude_variation); continue; }
+        }
+
+        // if past all the checks, then this beat is valid
+        pre_PWRT = PWRT; pre_PWD = PWD; pre_PWA = PWA; // store the value into pre features
+        beats[(*n_beats)++] = *p_beat; // the valid beats will be stored
     }
     
-    Serial.printf("After checking, the number of valid peaks is %d, number of valid valley is %d\n", *n_npks, *n_vals);
+    Serial.printf("After checking, the number of valid beats is %d\n", *n_beats);
 
 }
 
-int32_t spo2_calculation(uint32_t* ir_buffer, uint32_t* red_buffer, int32_t buffer_length, int32_t* valley_locs, int32_t num_val, int32_t* peak_locs, int32_t num_peak, int32_t ratio_size, int32_t* n_i_ratio_count) {
-    int32_t* an_ratio = (int32_t*)calloc(ratio_size, sizeof(int32_t)); // don't forget to free
-    *n_i_ratio_count = 0; // must initalize with zero first
-    for (int32_t k = 0; k < num_val - 1; k++) { // k is valley pointer
-        for (int32_t j = 0; j < num_peak - 1; j++) { // j is peak pointer
-            // distance of adjacent valleys and peaks should exceed five times of filter_size
-            // ensure triangle shape
-            if (valley_locs[k + 1] - valley_locs[k] > 5 * filter_size && peak_locs[j + 1] - peak_locs[j] > 5 * filter_size &&
-                valley_locs[k] < peak_locs[j] && valley_locs[k + 1] > peak_locs[j] && valley_locs[k + 1] < peak_locs[j + 1]) { 
-                int32_t n_x_dc_max_idx = peak_locs[j]; // index of ir peak between adjacent valleys
-                int32_t n_y_dc_max_idx = peak_locs[j]; // index of red peak
-                int32_t n_x_dc_max = ir_buffer[peak_locs[j]]; // ir peak value
-                int32_t n_y_dc_max = red_buffer[peak_locs[j]];// red peak value
-                int32_t n_y_ac = (red_buffer[valley_locs[k + 1]] - red_buffer[valley_locs[k]]) * (n_y_dc_max_idx - valley_locs[k]);
-                n_y_ac = red_buffer[valley_locs[k]] + n_y_ac / (valley_locs[k + 1] - valley_locs[k]);
-                n_y_ac = red_buffer[n_y_dc_max_idx] - n_y_ac;  // subracting linear DC compoenents from raw 
-                int32_t n_x_ac = (ir_buffer[valley_locs[k + 1]] - ir_buffer[valley_locs[k]]) * (n_x_dc_max_idx - valley_locs[k]);
-                n_x_ac = ir_buffer[valley_locs[k]] + n_x_ac / (valley_locs[k + 1] - valley_locs[k]);
-                n_x_ac = ir_buffer[n_x_dc_max_idx] - n_x_ac;  // subracting linear DC compoenents from raw 
-                int32_t n_nume = (n_y_ac * n_x_dc_max) >> 7; //formular is (n_y_ac * n_x_dc_max) / ( n_x_ac *n_y_dc_max);
-                int32_t n_denom = (n_x_ac * n_y_dc_max) >> 7; //prepare X100 to preserve floating value, 2^7 = 128
-                if (n_denom > 0 && *n_i_ratio_count < ratio_size && n_nume != 0) {
-                    an_ratio[*n_i_ratio_count] = (n_nume * 100) / n_denom; // multiple by 100
-                    *n_i_ratio_count += 1; // ratio count + 1
-                }
+uint8_t signal_quality(uint32_t* pun_green_buffer, uint32_t* pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length, int32_t sampling_rate, signal_quality_info* p_info)
+/**
+* \brief        Cheap O(N) quality check of a window before peak detection
+* \par          Details
+*               One pass gives the IR DC and peak-to-peak (perfusion index) and counts clipped samples.
+*               The regularity check band-limits the green channel as the difference of a short (50 ms) and
+*               a long (0.8 s) centered moving average, both updated incrementally, and times the rising
+*               crossings of that difference with a hysteresis of half its mean magnitude.
+*               The pulse rate implied by the crossings must be within 30 to 220 bpm with a regular rhythm.
+*
+* \param[in]    *pun_green_buffer        - Green sensor data buffer
+* \param[in]    *pun_ir_buffer           - IR sensor data buffer
+* \param[in]    *pun_red_buffer          - Red sensor data buffer
+* \param[in]    buffer_length            - data buffer length
+* \param[in]    sampling_rate            - the actual sampling rate
+* \param[out]   *p_info                  - the measured values, for logging
+*
+* \retval       signal_quality_code
+*/
+{
+    memset(p_info, 0, sizeof(signal_quality_info));
+    int64_t n_ir_sum = 0;
+    uint32_t un_ir_min = pun_ir_buffer[0], un_ir_max = pun_ir_buffer[0];
+    for (int32_t k = 0; k < buffer_length; k++) {
+        uint32_t un_ir = pun_ir_buffer[k];
+        n_ir_sum += un_ir;
+        if (un_ir < un_ir_min) un_ir_min = un_ir;
+        if (un_ir > un_ir_max) un_ir_max = un_ir;
+        if (un_ir >= (uint32_t)adc_ceiling || pun_red_buffer[k] >= (uint32_t)adc_ceiling || pun_green_buffer[k] >= (uint32_t)adc_ceiling)
+            p_info->n_clipped++;
+    }
+    p_info->n_ir_dc = (int32_t)(n_ir_sum / buffer_length);
+    if (p_info->n_ir_dc > 0)
+        p_info->n_perfusion = fx_mul_div((int32_t)(un_ir_max - un_ir_min), 10000, p_info->n_ir_dc);
+    if (p_info->n_ir_dc < min_ir_dc)
+        return SIGNAL_NO_CONTACT;
+    if (p_info->n_clipped * 1000 > buffer_length * max_clipped_permille)
+        return SIGNAL_CLIPPED;
+    if (p_info->n_perfusion < min_perfusion)
+        return SIGNAL_LOW_PERFUSION;
 
+    // band-limited green: short minus long centered moving average, in sums scaled to a common denominator
+    int32_t n_short = sampling_rate / 20, n_long = sampling_rate * 2 / 5;
+    if (buffer_length <= 2 * n_long + 1 || n_short < 1)
+        return SIGNAL_IRREGULAR;
+    int32_t n_short_len = 2 * n_short + 1, n_long_len = 2 * n_long + 1;
+    int64_t n_short_sum = 0, n_long_sum = 0;
+    for (int32_t k = 0; k < n_long_len; k++)
+        n_long_sum += pun_green_buffer[k];
+    for (int32_t k = n_long - n_short; k <= n_long + n_short; k++)
+        n_short_sum += pun_green_buffer[k];
+    // two passes over the same differences: the first for the hysteresis, the second for the crossings
+    int64_t n_magnitude = 0;
+    int64_t n_hysteresis = 0;
+    int32_t n_last = -1, n_state = 0;
+    int64_t n_interval_sum = 0, n_interval_sq = 0;
+    for (int32_t n_pass = 0; n_pass < 2; n_pass++) {
+        int64_t n_s = n_short_sum, n_l = n_long_sum;
+        for (int32_t k = n_long; k < buffer_length - n_long; k++) {
+            if (k > n_long) { // slide both windows by one sample
+                n_s += (int64_t)pun_green_buffer[k + n_short] - pun_green_buffer[k - n_short - 1];
+                n_l += (int64_t)pun_green_buffer[k + n_long] - pun_green_buffer[k - n_long - 1];
+            }
+            int64_t n_d = n_s * n_long_len - n_l * n_short_len;
+            if (n_pass == 0) {
+                n_magnitude += n_d >= 0 ? n_d : -n_d;
+                continue;
+            }
+            if (n_d < -n_hysteresis)
+                n_state = -1;
+            else if (n_d > n_hysteresis && n_state == -1) { // rising crossing
+                n_state = 1;
+                if (n_last >= 0) {
+                    int64_t n_interval = k - n_last;
+                    n_interval_sum += n_interval;
+                    n_interval_sq += n_interval * n_interval;
+                    p_info->n_intervals++;
+                }
+                n_last = k;
             }
         }
+        n_hysteresis = n_magnitude / (buffer_length - 2 * n_long) / 2;
     }
-    if (*n_i_ratio_count == 0) // no ratio found
+    if (p_info->n_intervals < 2)
+        return SIGNAL_IRREGULAR;
+    int64_t n_mean = n_interval_sum / p_info->n_intervals;
+    int64_t n_variance = n_interval_sq / p_info->n_intervals - n_mean * n_mean;
+    int64_t n_std = 0;
+    while ((n_std + 1) * (n_std + 1) <= n_variance) n_std++; // intervals are at most a few thousand samples
+    p_info->n_rate = (int32_t)(sampling_rate * 60 / n_mean);
+    p_info->n_interval_cv = (int32_t)(n_std * 100 / n_mean);
+    if (p_info->n_rate < 30 || p_info->n_rate > 220 || p_info->n_interval_cv > max_interval_cv)
+        return SIGNAL_IRREGULAR;
+    return SIGNAL_OK;
+}
+
+int32_t spo2_calculation(uint32_t* ir_buffer, uint32_t* red_buffer, Beat* beats, int32_t num_beats, int32_t ratio_size, int32_t* n_i_ratio_count) {
+    int32_t* an_ratio = (int32_t*)calloc(ratio_size, sizeof(int32_t)); // don't forget to free
+    *n_i_ratio_count = 0; // must initalize with zero first
+    for (int32_t k = 0; k < num_beats && *n_i_ratio_count < ratio_size; k++) {
+        int32_t n_ratio;
+        if (spo2_beat_ratio(ir_buffer, red_buffer, beats[k].n_valley, beats[k].n_peak, beats[k].n_next_valley, &n_ratio)) {
+            an_ratio[*n_i_ratio_count] = n_ratio;
+            *n_i_ratio_count += 1; // ratio count + 1
+        }
+    }
+    if (*n_i_ratio_count == 0) { // no ratio found
+        free(an_ratio); an_ratio = NULL;
         return 999;
-    maxim_sort_ascend(an_ratio, *n_i_ratio_count); // choose median value since PPG signal may varies from beat to beat
-    int32_t n_ratio_median = *n_i_ratio_count % 2 ? an_ratio[(*n_i_ratio_count - 1) / 2] : (an_ratio[*n_i_ratio_count / 2 - 1] + an_ratio[*n_i_ratio_count / 2]) / 2;
+    }
+    int32_t n_ratio_median = small_median(an_ratio, *n_i_ratio_count); // choose median value since PPG signal may varies from beat to beat
     free(an_ratio); an_ratio = NULL;// free the dynamic memoery
-    // int32_t int_float_SPO2 = -45.060 * n_ratio_median * n_ratio_median / 10000 + 30.354 * n_ratio_median / 100 + 94.845;
-    return (n_ratio_median > 2 && n_ratio_median < 184) ? uch_spo2_table[n_ratio_median] : 999; // must be a valid index for spo2 table
+    return spo2_from_ratio(n_ratio_median);
 }
 
-int32_t HR_calculation(uint32_t* pun_green_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t* n_peak_interval) {
+bool spo2_beat_ratio(uint32_t* ir_buffer, uint32_t* red_buffer, int32_t n_valley, int32_t n_peak, int32_t n_next_valley, int32_t* pn_ratio)
+/**
+* \brief        Calculate the SpO2 ratio of one beat
+* \par          Details
+*               The AC of each channel is the peak minus the straight line between the two valleys (linear DC),
+*               the ratio is (AC_red / DC_red) / (AC_ir / DC_ir) with the peak value as DC.
+*
+* \param[in]    *ir_buffer              - IR sensor data buffer
+* \param[in]    *red_buffer             - Red sensor data buffer
+* \param[in]    n_valley                - index of the valley before the peak
+* \param[in]    n_peak                  - index of the peak
+* \param[in]    n_next_valley           - index of the valley after the peak
+* \param[out]   *pn_ratio               - ratio multiplied by 100
+*
+* \retval       false if the beat gives no usable ratio
+*/
+{
+    int32_t n_x_dc_max_idx = n_peak; // index of ir peak between adjacent valleys
+    int32_t n_y_dc_max_idx = n_peak; // index of red peak
+    int32_t n_x_dc_max = ir_buffer[n_peak]; // ir peak value
+    int32_t n_y_dc_max = red_buffer[n_peak];// red peak value
+    // subracting linear DC compoenents from raw, the interpolation is done in 64 bits
+    int32_t n_y_ac = (int32_t)red_buffer[n_valley] + fx_mul_div((int32_t)red_buffer[n_next_valley] - (int32_t)red_buffer[n_valley],
+                                                                n_y_dc_max_idx - n_valley, n_next_valley - n_valley);
+    n_y_ac = (int32_t)red_buffer[n_y_dc_max_idx] - n_y_ac;
+    int32_t n_x_ac = (int32_t)ir_buffer[n_valley] + fx_mul_div((int32_t)ir_buffer[n_next_valley] - (int32_t)ir_buffer[n_valley],
+                                                               n_x_dc_max_idx - n_valley, n_next_valley - n_valley);
+    n_x_ac = (int32_t)ir_buffer[n_x_dc_max_idx] - n_x_ac;
+    // formular is (n_y_ac * n_x_dc_max) / (n_x_ac * n_y_dc_max), X100 to preserve the fraction
+    // both products reach 2^36 with 18-bit samples, so they are kept in 64 bits instead of scaling by >>7
+    int64_t n_nume = (int64_t)n_y_ac * n_x_dc_max;
+    int64_t n_denom = (int64_t)n_x_ac * n_y_dc_max;
+    if (n_denom <= 0 || n_nume == 0)
+        return false;
+    *pn_ratio = fx_saturate(n_nume * 100 / n_denom); // multiple by 100
+    return true;
+}
+
+int32_t spo2_from_ratio(int32_t n_ratio)
+{
+    // int32_t int_float_SPO2 = -45.060 * n_ratio * n_ratio / 10000 + 30.354 * n_ratio / 100 + 94.845;
+    return (n_ratio > 2 && n_ratio < 184) ? uch_spo2_table[n_ratio] : 999; // must be a valid index for spo2 table
+}
+
+int32_t HR_calculation(uint32_t* pun_green_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t filter_size, const int32_t* pn_filtered, int32_t n_streamed_rate, int32_t* n_peak_interval) {
+    return HR_calculation_engine(hr_engine, pun_green_buffer, buffer_length, peak_locs, num_peak, max_num_peak, valley_locs, num_val, max_num_valley, sampling_rate, filter_size, pn_filtered, n_streamed_rate, n_peak_interval);
+}
+
+int32_t HR_calculation_engine(uint8_t uch_engine, uint32_t* pun_green_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t filter_size, const int32_t* pn_filtered, int32_t n_streamed_rate, int32_t* n_peak_interval) {
     int32_t* green_buffer = (int32_t*)calloc(buffer_length, sizeof(int32_t));
-    for (int32_t i = 0; i < buffer_length; i++)
-        green_buffer[i] = pun_green_buffer[i];
-    // preprocess signal
-    preprocessing(green_buffer, buffer_length, filter_size);
+    // preprocess signal, unless the window comes band-passed already (PREPROCESS_BANDPASS)
+    {
+        STAGE_SCOPE(STAGE_PREPROCESS);
+        if (pn_filtered != NULL) {
+            memcpy(green_buffer, pn_filtered, buffer_length * sizeof(int32_t));
+        } else {
+            for (int32_t i = 0; i < buffer_length; i++)
+                green_buffer[i] = pun_green_buffer[i];
+            preprocessing(green_buffer, buffer_length, filter_size);
+        }
+    }
 
     int32_t* invertedData = (int32_t*)calloc(buffer_length, sizeof(int32_t));
     for (int32_t k = 0; k < buffer_length; k++)
         invertedData[k] = -1 * green_buffer[k];
+    int32_t n_periodic_rate = 999;
     // find peaks and valleys
-    AMPD(green_buffer, buffer_length, peak_locs, num_peak, max_num_peak);
-    AMPD(invertedData, buffer_length, valley_locs, num_val, max_num_valley);
-    /*maxim_peaks_above_min_height(peak_locs, num_peak, green_buffer, buffer_length, 0, max_num_peak);
-    maxim_peaks_above_min_height(valley_locs, num_val, invertedData, buffer_length, 0, max_num_valley);*/
-    maxim_remove_close_peaks(peak_locs, num_peak, green_buffer, 10*filter_size);
-    *num_peak = min(*num_peak, max_num_peak);
-    maxim_remove_close_peaks(valley_locs, num_val, invertedData, 10*filter_size);
-    *num_val = min(*num_val, max_num_valley);
+    if (uch_engine == HR_ENGINE_SPECTRAL || uch_engine == HR_ENGINE_AUTOCORR) {
+        if (uch_engine == HR_ENGINE_SPECTRAL) {
+            STAGE_SCOPE(STAGE_SPECTRAL);
+            n_periodic_rate = spectral_heart_rate(pun_green_buffer, buffer_length, sampling_rate);
+        } else if (n_streamed_rate >= 0) {
+            n_periodic_rate = n_streamed_rate; // the PipelineController engine has seen the window hop by hop
+        } else {
+            STAGE_SCOPE(STAGE_AUTOCORR);
+            // no persistent engine has a whole window yet, the window is fed into a fresh one
+            AutocorrEngine* p_engine = new AutocorrEngine(sampling_rate, AutocorrEngine::window_for_buffer(sampling_rate, buffer_length));
+            for (int32_t k = 0; k < buffer_length; k++)
+                p_engine->push(pun_green_buffer[k]);
+            n_periodic_rate = p_engine->heart_rate();
+            delete p_engine; p_engine = NULL;
+        }
+        int32_t n_period = n_periodic_rate == 999 ? 0 : sampling_rate * 60 / n_periodic_rate;
+        periodic_find_peaks(green_buffer, buffer_length, n_period, peak_locs, num_peak, max_num_peak);
+        periodic_find_peaks(invertedData, buffer_length, n_period, valley_locs, num_val, max_num_valley);
+    } else if (uch_engine == HR_ENGINE_SLOPE) {
+        STAGE_SCOPE(STAGE_SLOPE);
+        // the detector keeps the highest turn within 10*filter_size, as maxim_remove_close_peaks does for AMPD
+        increasing_slope(green_buffer, buffer_length, peak_locs, num_peak, max_num_peak, 10*filter_size);
+        increasing_slope(invertedData, buffer_length, valley_locs, num_val, max_num_valley, 10*filter_size);
+    } else if (uch_engine == HR_ENGINE_PEAK_VALLEY) {
+        STAGE_SCOPE(STAGE_PEAK_VALLEY);
+        peak_valley(green_buffer, buffer_length, peak_locs, num_peak, max_num_peak, valley_locs, num_val, max_num_valley, sampling_rate);
+    } else {
+        STAGE_SCOPE(STAGE_AMPD);
+        AMPD(green_buffer, buffer_length, peak_locs, num_peak, max_num_peak);
+        AMPD(invertedData, buffer_length, valley_locs, num_val, max_num_valley);
+        /*maxim_peaks_above_min_height(peak_locs, num_peak, green_buffer, buffer_length, 0, max_num_peak);
+        maxim_peaks_above_min_height(valley_locs, num_val, invertedData, buffer_length, 0, max_num_valley);*/
+        maxim_remove_close_peaks(peak_locs, num_peak, green_buffer, 10*filter_size);
+        *num_peak = min(*num_peak, max_num_peak);
+        maxim_remove_close_peaks(valley_locs, num_val, invertedData, 10*filter_size);
+        *num_val = min(*num_val, max_num_valley);
+    }
     Serial.printf("The number of peak is %d\n", *num_peak);
     for (int32_t i = 0; i < *num_peak; i++) {
         Serial.print(peak_locs[i], DEC);
@@ -491,28 +713,327 @@ int32_t HR_calculation(uint32_t* pun_green_buffer, int32_t buffer_length, int32_
         Serial.print("\t");
     }
     Serial.println();
-    delay(1000);
      
     // check and remove artifact
-    //check_valid(peak_locs, num_peak, valley_locs, num_val, green_buffer, buffer_length, sampling_rate);
+    //num_beats = segment_beats(valley_locs, *num_val, peak_locs, *num_peak, 5 * filter_size, beats, max_num_valley);
+    //check_valid(beats, &num_beats, green_buffer, sampling_rate);
     free(invertedData); invertedData = NULL; // release memory on time
     free(green_buffer); green_buffer = NULL; // release memory on time
     
     // calculate HR
     *n_peak_interval = 0;
+    if (uch_engine == HR_ENGINE_SPECTRAL || uch_engine == HR_ENGINE_AUTOCORR) { // finer than the peak positions
+        if (n_periodic_rate != 999)
+            *n_peak_interval = sampling_rate * 60 / n_periodic_rate;
+        return n_periodic_rate;
+    }
     if (*num_peak < 2)
         return 999; // invalid
+    *n_peak_interval = median_peak_interval(peak_locs, *num_peak);
+    return (sampling_rate * 60) / *n_peak_interval;
+}
 
-    int32_t num_interval = *num_peak - 1;
+int32_t median_peak_interval(int32_t* peak_locs, int32_t num_peak) {
+    int32_t num_interval = num_peak - 1;
     int32_t* peak_interval_arr = (int32_t*)calloc(num_interval, sizeof(int32_t)); // DMA
     for (int32_t k = 0; k < num_interval; k++)
         peak_interval_arr[k] = peak_locs[k + 1] - peak_locs[k];
-    maxim_sort_ascend(peak_interval_arr, num_interval); // median (n peaks and n-1 intervals)
-    *n_peak_interval = num_interval % 2 ? peak_interval_arr[(num_interval - 1) / 2] : (peak_interval_arr[num_interval / 2] + peak_interval_arr[num_interval / 2 - 1]) / 2;
+    int32_t n_median = small_median(peak_interval_arr, num_interval); // median (n peaks and n-1 intervals)
     free(peak_interval_arr); peak_interval_arr = NULL; // free memory
+    return n_median;
+}
+
+int32_t HR_calculation_fused(uint8_t uch_engine, uint32_t* pun_green_buffer, uint32_t* pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t filter_size, const int32_t* pn_streamed_rates, int32_t* n_peak_interval)
+/**
+* \brief        Heart rate from peaks and valleys voted over the green, IR and red channels
+* \par          Details
+*               All three channels get the preprocessing of the green one. They are stored one after the other
+*               (structure of arrays), so every filter pass runs unit-stride over one channel and reuses the
+*               single channel filters. Peaks and valleys are searched per channel with uch_engine; the periodic
+*               engines use the median of the per-channel rates. A peak (valley) is kept when at least two
+*               channels have one within sampling_rate / 10 of each other, at the median of their positions, so
+*               an artifact on a single channel neither adds nor removes a beat.
+*               Costs three times the preprocessing and peak search of HR_calculation_engine.
+*
+* \param[in]    uch_engine              - hr_engine_kind used on every channel
+* \param[in]    *pun_green_buffer        - Green sensor data buffer
+* \param[in]    *pun_ir_buffer           - IR sensor data buffer
+* \param[in]    *pun_red_buffer          - Red sensor data buffer
+* \param[in]    buffer_length            - data buffer length
+* \param[out]   *peak_locs               - voted peak index array
+* \param[out]   *num_peak                - number of voted peaks
+* \param[in]    max_num_peak             - the max number of peaks
+* \param[out]   *valley_locs             - voted valley index array
+* \param[out]   *num_val                 - number of voted valleys
+* \param[in]    max_num_valley           - the max number of valleys
+* \param[in]    sampling_rate            - the actual sampling rate
+* \param[in]    filter_size              - median and mean filter width
+* \param[in]    *pn_streamed_rates       - HR_ENGINE_AUTOCORR rate per channel from PipelineController::autocorr_rate(),
+*                                          -1 or NULL to run a fresh engine over the window
+* \param[out]   *n_peak_interval         - beat period in samples, 0 without a heart rate
+*
+* \retval       heart rate in bpm, 999 if invalid
+*/
+{
+    uint32_t* apun_channel[FUSION_CHANNELS] = { pun_green_buffer, pun_ir_buffer, pun_red_buffer };
+    int32_t* an_x = (int32_t*)calloc(FUSION_CHANNELS * buffer_length, sizeof(int32_t)); // channel c starts at c * buffer_length
+    int32_t* an_inverted = (int32_t*)calloc(buffer_length, sizeof(int32_t)); // one channel at a time
+    int32_t* an_peaks = (int32_t*)calloc(FUSION_CHANNELS * max_num_peak, sizeof(int32_t));
+    int32_t* an_valleys = (int32_t*)calloc(FUSION_CHANNELS * max_num_valley, sizeof(int32_t));
+    int32_t an_num_peak[FUSION_CHANNELS], an_num_val[FUSION_CHANNELS];
+    {
+        STAGE_SCOPE(STAGE_PREPROCESS);
+        for (int32_t c = 0; c < FUSION_CHANNELS; c++) {
+            int32_t* pn_x = an_x + c * buffer_length;
+            for (int32_t k = 0; k < buffer_length; k++)
+                pn_x[k] = apun_channel[c][k];
+            preprocessing(pn_x, buffer_length, filter_size);
+        }
+    }
+    int32_t n_periodic_rate = 999;
+    bool b_periodic = uch_engine == HR_ENGINE_SPECTRAL || uch_engine == HR_ENGINE_AUTOCORR;
+    if (b_periodic) {
+        // the channels share one period: the median of their rates, a single failing channel is outvoted
+        int32_t an_rate[FUSION_CHANNELS], n_rates = 0;
+        for (int32_t c = 0; c < FUSION_CHANNELS; c++) {
+            int32_t n_rate;
+            if (uch_engine == HR_ENGINE_SPECTRAL) {
+                STAGE_SCOPE(STAGE_SPECTRAL);
+                n_rate = spectral_heart_rate(apun_channel[c], buffer_length, sampling_rate);
+            } else if (pn_streamed_rates != NULL && pn_streamed_rates[c] >= 0) {
+                n_rate = pn_streamed_rates[c];
+            } else {
+                STAGE_SCOPE(STAGE_AUTOCORR);
+                AutocorrEngine* p_engine = new AutocorrEngine(sampling_rate, AutocorrEngine::window_for_buffer(sampling_rate, buffer_length));
+                for (int32_t k = 0; k < buffer_length; k++)
+                    p_engine->push(apun_channel[c][k]);
+                n_rate = p_engine->heart_rate();
+                delete p_engine; p_engine = NULL;
+            }
+            if (n_rate != 999)
+                an_rate[n_rates++] = n_rate;
+        }
+        if (n_rates > 0)
+            n_periodic_rate = small_median(an_rate, n_rates);
+    }
+    int32_t n_period = n_periodic_rate == 999 ? 0 : sampling_rate * 60 / n_periodic_rate;
+    for (int32_t c = 0; c < FUSION_CHANNELS; c++) {
+        int32_t* pn_x = an_x + c * buffer_length;
+        int32_t* pn_peaks = an_peaks + c * max_num_peak;
+        int32_t* pn_valleys = an_valleys + c * max_num_valley;
+        for (int32_t k = 0; k < buffer_length; k++)
+            an_inverted[k] = -1 * pn_x[k];
+        if (b_periodic) {
+            periodic_find_peaks(pn_x, buffer_length, n_period, pn_peaks, &an_num_peak[c], max_num_peak);
+            periodic_find_peaks(an_inverted, buffer_length, n_period, pn_valleys, &an_num_val[c], max_num_valley);
+        } else if (uch_engine == HR_ENGINE_SLOPE) {
+            STAGE_SCOPE(STAGE_SLOPE);
+            increasing_slope(pn_x, buffer_length, pn_peaks, &an_num_peak[c], max_num_peak, 10*filter_size);
+            increasing_slope(an_inverted, buffer_length, pn_valleys, &an_num_val[c], max_num_valley, 10*filter_size);
+        } else if (uch_engine == HR_ENGINE_PEAK_VALLEY) {
+            STAGE_SCOPE(STAGE_PEAK_VALLEY);
+            peak_valley(pn_x, buffer_length, pn_peaks, &an_num_peak[c], max_num_peak, pn_valleys, &an_num_val[c], max_num_valley, sampling_rate);
+        } else {
+            STAGE_SCOPE(STAGE_AMPD);
+            AMPD(pn_x, buffer_length, pn_peaks, &an_num_peak[c], max_num_peak);
+            AMPD(an_inverted, buffer_length, pn_valleys, &an_num_val[c], max_num_valley);
+            maxim_remove_close_peaks(pn_peaks, &an_num_peak[c], pn_x, 10*filter_size);
+            maxim_remove_close_peaks(pn_valleys, &an_num_val[c], an_inverted, 10*filter_size);
+        }
+    }
+    vote_peaks(an_peaks, an_num_peak, max_num_peak, sampling_rate / 10, peak_locs, num_peak, max_num_peak);
+    vote_peaks(an_valleys, an_num_val, max_num_valley, sampling_rate / 10, valley_locs, num_val, max_num_valley);
+    free(an_x); an_x = NULL;
+    free(an_inverted); an_inverted = NULL;
+    free(an_peaks); an_peaks = NULL;
+    free(an_valleys); an_valleys = NULL;
+
+    *n_peak_interval = 0;
+    if (b_periodic) {
+        if (n_periodic_rate != 999)
+            *n_peak_interval = n_period;
+        return n_periodic_rate;
+    }
+    if (*num_peak < 2)
+        return 999; // invalid
+    *n_peak_interval = median_peak_interval(peak_locs, *num_peak);
     return (sampling_rate * 60) / *n_peak_interval;
 }
 
+void vote_peaks(int32_t* an_locs, int32_t* an_count, int32_t n_stride, int32_t n_tolerance, int32_t* pn_locs, int32_t* pn_npks, int32_t n_max_num)
+/**
+* \brief        Keep the peaks found on at least two channels
+* \par          Details
+*               The ascending peak lists of the FUSION_CHANNELS channels are merged, runs of peaks no more than
+*               n_tolerance apart form one candidate, which is kept at its median position if two or more
+*               channels contributed to the run.
+*
+* \param[in]    *an_locs                - peak index arrays, channel c starts at c * n_stride
+* \param[in]    *an_count               - number of peaks per channel
+* \param[in]    n_stride                - capacity of one channel array
+* \param[in]    n_tolerance             - max distance of peaks of the same beat
+* \param[out]   *pn_locs                - voted peak index array, ascending
+* \param[out]   *pn_npks                - number of voted peaks
+* \param[in]    n_max_num               - the max number of voted peaks
+*
+* \retval       None
+*/
+{
+    // merge by sorting index * FUSION_CHANNELS + channel, at most a few dozen entries
+    int32_t n_total = 0;
+    for (int32_t c = 0; c < FUSION_CHANNELS; c++)
+        n_total += an_count[c];
+    int32_t* an_all = (int32_t*)calloc(n_total > 0 ? n_total : 1, sizeof(int32_t));
+    n_total = 0;
+    for (int32_t c = 0; c < FUSION_CHANNELS; c++)
+        for (int32_t i = 0; i < an_count[c]; i++)
+            an_all[n_total++] = an_locs[c * n_stride + i] * FUSION_CHANNELS + c;
+    maxim_sort_ascend(an_all, n_total);
+    *pn_npks = 0;
+    for (int32_t i = 0; i < n_total && *pn_npks < n_max_num; ) {
+        int32_t j = i + 1;
+        uint8_t uch_channels = 1 << (an_all[i] % FUSION_CHANNELS);
+        while (j < n_total && an_all[j] / FUSION_CHANNELS - an_all[j - 1] / FUSION_CHANNELS <= n_tolerance) {
+            uch_channels |= 1 << (an_all[j] % FUSION_CHANNELS);
+            j++;
+        }
+        if ((uch_channels & (uch_channels - 1)) != 0) // two or more bits
+            pn_locs[(*pn_npks)++] = an_all[(i + j - 1) / 2] / FUSION_CHANNELS;
+        i = j;
+    }
+    free(an_all); an_all = NULL;
+}
+
+int32_t spectral_heart_rate(uint32_t* pun_green_buffer, int32_t buffer_length, int32_t sampling_rate)
+/**
+* \brief        Heart rate from the spectrum of the green channel
+* \par          Details
+*               The raw green is decimated by averaging to spectral_rate, its 2 s moving average is removed and it
+*               is shaped with a Welch window, all in integers. A Goertzel bank evaluates the power every spectral_step_bpm from
+*               spectral_min_bpm to spectral_max_bpm and the strongest bin is refined by parabolic interpolation.
+*               The PPG second harmonic can outgrow the fundamental, so a bin at half the frequency with at least
+*               half the power is taken instead.
+*               Only the Goertzel coefficients 2cos(w) use floats (one cosf per bin), the recursions run in Q14.
+*
+* \param[in]    *pun_green_buffer        - raw green sensor data buffer
+* \param[in]    buffer_length            - data buffer length
+* \param[in]    sampling_rate            - the actual sampling rate
+*
+* \retval       heart rate in bpm, 999 if the window is too short or has no spectral peak inside the band
+*/
+{
+    int32_t n_decimation = sampling_rate / spectral_rate > 0 ? sampling_rate / spectral_rate : 1;
+    int32_t n_size = buffer_length / n_decimation;
+    int32_t n_rate_x100 = sampling_rate * 100 / n_decimation; // decimated rate, x100 to keep 2 decimals
+    if (n_size < 64)
+        return 999;
+    int32_t* an_x = (int32_t*)calloc(n_size, sizeof(int32_t));
+    for (int32_t k = 0; k < n_size; k++) {
+        int32_t n_sum = 0;
+        for (int32_t i = 0; i < n_decimation; i++)
+            n_sum += pun_green_buffer[k * n_decimation + i];
+        an_x[k] = n_sum / n_decimation;
+    }
+    // subtract a centered 2 s moving average: the baseline wander below 0.5 Hz would leak into the band through
+    // the window and outgrow the pulse, the average is taken from prefix sums and shrinks at the window edges
+    int64_t* an_prefix = (int64_t*)calloc(n_size + 1, sizeof(int64_t));
+    for (int32_t k = 0; k < n_size; k++)
+        an_prefix[k + 1] = an_prefix[k] + an_x[k];
+    int32_t n_half_width = spectral_rate;
+    for (int32_t k = 0; k < n_size; k++) {
+        int32_t n_lo = k - n_half_width > 0 ? k - n_half_width : 0;
+        int32_t n_hi = k + n_half_width + 1 < n_size ? k + n_half_width + 1 : n_size;
+        int64_t n_baseline = (an_prefix[n_hi] - an_prefix[n_lo]) / (n_hi - n_lo);
+        int64_t n_w = (int64_t)4 * k * (n_size - 1 - k) * 32767 / ((int64_t)(n_size - 1) * (n_size - 1)); // Welch window, Q15
+        an_x[k] = (int32_t)((an_x[k] - n_baseline) * n_w >> 15);
+    }
+    free(an_prefix); an_prefix = NULL;
+
+    int32_t n_bins = (spectral_max_bpm - spectral_min_bpm) / spectral_step_bpm + 1;
+    int64_t* an_power = (int64_t*)calloc(n_bins, sizeof(int64_t));
+    int32_t n_best = 0;
+    for (int32_t b = 0; b < n_bins; b++) {
+        int32_t n_bpm = spectral_min_bpm + b * spectral_step_bpm;
+        // w = 2 pi f / fs with f = bpm / 60
+        int32_t n_coeff = (int32_t)(2.0f * cosf(6.2831853f * n_bpm * 100 / 60 / n_rate_x100) * 16384.0f); // Q14
+        int64_t n_s1 = 0, n_s2 = 0;
+        for (int32_t k = 0; k < n_size; k++) {
+            int64_t n_s0 = an_x[k] + ((n_coeff * n_s1) >> 14) - n_s2;
+            n_s2 = n_s1;
+            n_s1 = n_s0;
+        }
+        // |X|^2 = s1^2 + s2^2 - 2cos(w) s1 s2, scaled down to stay within 64 bits
+        int64_t n_a = n_s1 >> 8, n_b = n_s2 >> 8;
+        an_power[b] = n_a * n_a + n_b * n_b - ((n_coeff * n_a) >> 14) * n_b;
+    }
+    // strongest local maximum, the edge bins only serve the interpolation since the leakage of the baseline
+    // wander piles up at the low edge and can outgrow the pulse
+    n_best = 0;
+    for (int32_t b = 1; b < n_bins - 1; b++)
+        if (an_power[b] > an_power[b - 1] && an_power[b] >= an_power[b + 1] && (n_best == 0 || an_power[b] > an_power[n_best]))
+            n_best = b;
+    // prefer the fundamental over a dominant second harmonic
+    int32_t n_half = (n_best * spectral_step_bpm + spectral_min_bpm) / 2;
+    if (n_half >= spectral_min_bpm + spectral_step_bpm) {
+        int32_t n_half_bin = (n_half - spectral_min_bpm + spectral_step_bpm / 2) / spectral_step_bpm;
+        int32_t n_candidate = n_half_bin;
+        for (int32_t b = n_half_bin - 1; b <= n_half_bin + 1; b++) // the halved frequency falls between bins
+            if (b >= 1 && b < n_bins - 1 && an_power[b] > an_power[n_candidate]) n_candidate = b;
+        if (n_best != 0 && 2 * an_power[n_candidate] >= an_power[n_best] && an_power[n_candidate] > an_power[n_candidate - 1]
+            && an_power[n_candidate] >= an_power[n_candidate + 1])
+            n_best = n_candidate;
+    }
+    int32_t n_result = 999;
+    if (n_best != 0) { // no local maximum inside the band
+        // vertex of the parabola through the three bins, in 1/100 bin
+        int64_t n_l = an_power[n_best - 1], n_c = an_power[n_best], n_r = an_power[n_best + 1];
+        int64_t n_denom = n_l - 2 * n_c + n_r;
+        int64_t n_offset = n_denom != 0 ? 50 * (n_l - n_r) / n_denom : 0;
+        n_result = (int32_t)(spectral_min_bpm + (n_best * 100 + n_offset) * spectral_step_bpm / 100);
+    }
+    free(an_power); an_power = NULL;
+    free(an_x); an_x = NULL;
+    return n_result;
+}
+
+void periodic_find_peaks(int32_t* pn_x, int32_t n_size, int32_t n_period, int32_t* pn_locs, int32_t* pn_npks, int32_t n_max_num)
+/**
+* \brief        Find one peak per period
+* \par          Details
+*               Each peak is the maximum of the window from half a period to one and a half periods after the
+*               previous one, the first is searched within the first period. A maximum on the window border is a
+*               slope rather than a peak and is skipped, the next window starts where it ended. O(n_size).
+*
+* \param[in]    *pn_x                   - inverted, DC removed and filtered data buffer
+* \param[in]    n_size                  - data buffer size
+* \param[in]    n_period                - beat period in samples, 0 if unknown
+* \param[out]   *pn_locs                - peak index array
+* \param[out]   *pn_npks                - number of peaks
+* \param[in]    n_max_num               - the max number of peaks
+*
+* \retval       None
+*/
+{
+    *pn_npks = 0;
+    if (n_period < 2)
+        return;
+    int32_t n_start = 0, n_end = n_period;
+    while (n_start < n_size && *pn_npks < n_max_num) {
+        if (n_end > n_size) n_end = n_size;
+        int32_t n_max_idx = n_start;
+        for (int32_t i = n_start + 1; i < n_end; i++)
+            if (pn_x[i] > pn_x[n_max_idx]) n_max_idx = i;
+        if (n_max_idx > 0 && n_max_idx < n_size - 1 && n_max_idx > n_start && n_max_idx < n_end - 1) {
+            pn_locs[(*pn_npks)++] = n_max_idx;
+            n_start = n_max_idx + n_period / 2;
+            n_end = n_max_idx + n_period * 3 / 2;
+        } else {
+            n_start = n_end;
+            n_end = n_start + n_period;
+        }
+    }
+}
+
 void preprocessing(int32_t* green_buffer, int32_t buffer_length, int32_t filter_size) {
     DC_removing_inverting_filter(green_buffer, buffer_length);
     median_filter(green_buffer, buffer_length, filter_size);
@@ -539,9 +1060,8 @@ void median_filter(int32_t* green_buffer, int32_t buffer_length, int32_t filter_
         for (int32_t i = 0; i < actual_size; i++) 
             med_filter_copy[i] = med_filter[i]; // copy filter and avoid changing the original order
         if (k == 0)
-            continue; // don't need sort
-        maxim_sort_ascend(med_filter_copy, actual_size);
-        green_buffer[k] = actual_size % 2 ? med_filter_copy[(actual_size - 1) / 2] : (med_filter_copy[actual_size / 2] + med_filter_copy[actual_size / 2 - 1]) / 2;
+            continue; // a single value is its own median
+        green_buffer[k] = small_median(med_filter_copy, actual_size);
     }
     free(med_filter); med_filter = NULL;
     free(med_filter_copy); med_filter_copy = NULL;
@@ -597,6 +1117,71 @@ void AMPD(int32_t* data, int32_t bufferSize, int32_t* index, int32_t* len_index,
     free(arr_rowsum); p_data = NULL;
 }
 
+// peaks by the increasing slope method, streamed through a SlopeDetector
+void increasing_slope(int32_t* data, int32_t bufferSize, int32_t* index, int32_t* len_index, int32_t max_num_index, int32_t n_min_distance)
+/**
+* \brief        Find peaks with the increasing slope method
+* \par          Details
+*               Same output as AMPD(): the peaks of data in ascending order, at most max_num_index; valleys are
+*               the peaks of the inverted data. The window is streamed once through a SlopeDetector, O(bufferSize).
+*
+* \param[in]    *data                   - inverted, DC removed and filtered data buffer
+* \param[in]    bufferSize              - data buffer size
+* \param[out]   *index                  - peak index array
+* \param[out]   *len_index              - number of peaks
+* \param[in]    max_num_index           - the max number of peaks
+* \param[in]    n_min_distance          - peaks closer than this keep only the highest, 0 keeps every turn
+*
+* \retval       None
+*/
+{
+    SlopeDetector detector(n_min_distance);
+    *len_index = 0;
+    for (int32_t i = 0; i < bufferSize && *len_index < max_num_index; i++)
+        if (detector.push(data[i]) & SLOPE_PEAK)
+            index[(*len_index)++] = detector.peak_index();
+    while (*len_index < max_num_index) {
+        uint8_t uch_events = detector.finish();
+        if (uch_events == SLOPE_NONE)
+            break;
+        if (uch_events & SLOPE_PEAK)
+            index[(*len_index)++] = detector.peak_index();
+    }
+}
+
+void peak_valley(int32_t* data, int32_t bufferSize, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate)
+/**
+* \brief        Find peaks and valleys with the peak-valley state machine
+* \par          Details
+*               One pass of a PeakValleyDetector over the window, both lists ascending like AMPD() gives them.
+*               Each list stops at its maximum, the other one continues. The flat tops of the integer filters
+*               are reported at their first sample instead of being skipped like in the prototype. O(bufferSize).
+*
+* \param[in]    *data                   - inverted, DC removed and filtered data buffer
+* \param[in]    bufferSize              - data buffer size
+* \param[out]   *peak_locs              - peak index array
+* \param[out]   *num_peak               - number of peaks
+* \param[in]    max_num_peak            - the max number of peaks
+* \param[out]   *valley_locs            - valley index array
+* \param[out]   *num_val                - number of valleys
+* \param[in]    max_num_valley          - the max number of valleys
+* \param[in]    sampling_rate           - the actual sampling rate, sets the warm-up and the threshold decay
+*
+* \retval       None
+*/
+{
+    PeakValleyDetector detector(sampling_rate, true);
+    *num_peak = 0;
+    *num_val = 0;
+    for (int32_t i = 0; i < bufferSize && (*num_peak < max_num_peak || *num_val < max_num_valley); i++) {
+        uint8_t uch_event = detector.push(data[i]);
+        if (uch_event == PV_PEAK && *num_peak < max_num_peak)
+            peak_locs[(*num_peak)++] = detector.peak_index();
+        else if (uch_event == PV_VALLEY && *num_val < max_num_valley)
+            valley_locs[(*num_val)++] = detector.valley_index();
+    }
+}
+
 // find the index of minmum value in the given array
 int32_t argmin(int32_t* index, int32_t index_len) {
     int32_t min_index = 0;
@@ -64,6 +64,8 @@
 
 #include <Arduino.h>
 
+class PipelineController; // pipeline_controller.h
+
 //uch_spo2_table is approximated as  -45.060*ratioAverage* ratioAverage + 30.354 *ratioAverage + 94.845 ;
 static const uint8_t uch_spo2_table[184]={95, 95, 95, 96, 96, 96, 97, 97, 97, 97, 97, 98, 98, 98, 98, 98, 99, 99, 99, 99, 
               99, 99, 99, 99, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 
@@ -76,13 +78,62 @@ static const uint8_t uch_spo2_table[184]={95, 95, 95, 96, 96, 96, 97, 97, 97, 97
               28, 27, 26, 25, 23, 22, 21, 20, 19, 17, 16, 15, 14, 12, 11, 10, 9, 7, 6, 5, 
               3, 2, 1};
 
+// one pulse wave: valley < peak < next_valley, indices into the data buffer
+typedef struct {
+  int32_t n_valley;
+  int32_t n_peak;
+  int32_t n_next_valley;
+} Beat;
+
+// how HR_calculation finds the heart rate, selected per deployment by hr_engine in spo2_algorithm.cpp
+enum hr_engine_kind {
+  HR_ENGINE_AMPD = 0,     // AMPD peaks and valleys, median peak interval
+  HR_ENGINE_SPECTRAL = 1, // Goertzel bank over 30 to 210 bpm on the decimated green, peaks placed one period apart
+  HR_ENGINE_AUTOCORR = 2, // normalized autocorrelation over the lags of 30 to 210 bpm (autocorr_engine.h), peaks as above
+  HR_ENGINE_SLOPE = 3,    // increasing slope turns (slope_detector.h), single pass, median peak interval like AMPD
+  HR_ENGINE_PEAK_VALLEY = 4 // threshold-tracking peak-valley state machine (peak_valley_detector.h), as above
+};
+
+// which channels the peaks and valleys of heart_rate_and_oxygen_saturation come from, beat_fusion in spo2_algorithm.cpp
+enum beat_fusion_kind {
+  FUSION_GREEN = 0, // green only, IR and red are read at the green positions
+  FUSION_VOTE = 1   // green, IR and red searched alike, a beat needs two channels (HR_calculation_fused)
+};
+#define FUSION_CHANNELS 3
+
+// how the green window is filtered before the peak search, preprocess_engine in spo2_algorithm.cpp
+enum preprocess_kind {
+  PREPROCESS_MEDIAN_MEAN = 0, // preprocessing(): DC removal, filter_size median and mean per window
+  PREPROCESS_BANDPASS = 1     // 0.5 to 5 Hz biquads run sample by sample in the PipelineController (bandpass_filter.h)
+};
+
+// outcome of the signal quality stage, anything but SIGNAL_OK skips peak detection
+enum signal_quality_code {
+  SIGNAL_OK = 0,
+  SIGNAL_NO_CONTACT = 1,     // IR DC too low, no finger on the sensor
+  SIGNAL_CLIPPED = 2,        // samples at the 18-bit ADC ceiling
+  SIGNAL_LOW_PERFUSION = 3,  // IR AC too small compared to its DC
+  SIGNAL_IRREGULAR = 4,      // no regular pulse rhythm, e.g. motion artifact
+  SIGNAL_UNCHECKED = 5       // no window checked yet since the acquisition started, never returned by signal_quality()
+};
+
+typedef struct {
+  int32_t n_ir_dc;           // mean IR
+  int32_t n_perfusion;       // IR peak-to-peak / DC in 0.01 % units
+  int32_t n_clipped;         // samples at the ADC ceiling, all channels
+  int32_t n_intervals;       // intervals between rising zero crossings of the band-limited green
+  int32_t n_rate;            // crossings per minute, 0 without intervals
+  int32_t n_interval_cv;     // interval standard deviation / mean in percent
+} signal_quality_info;
+
 #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
 //Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
 //To solve this problem, 16-bit MSB of the sampled data will be truncated.  Samples become 16-bit data.
-void heart_rate_and_oxygen_saturation(uint16_t* pun_green_buffer, uint16_t* pun_ir_buffer, uint16_t* pun_red_buffer, int32_t buffer_length, int32_t sampling_rate, int32_t* pn_spo2, int32_t* pn_heart_rate);
+void heart_rate_and_oxygen_saturation(uint16_t* pun_green_buffer, uint16_t* pun_ir_buffer, uint16_t* pun_red_buffer, int32_t buffer_length, int32_t sampling_rate, int32_t* pn_spo2, int32_t* pn_heart_rate, uint8_t* puch_quality, PipelineController* p_controller);
 #else
-void heart_rate_and_oxygen_saturation(uint32_t* pun_green_buffer, uint32_t* pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length, int32_t sampling_rate, int32_t* pn_spo2, int32_t* pn_heart_rate);
+void heart_rate_and_oxygen_saturation(uint32_t* pun_green_buffer, uint32_t* pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length, int32_t sampling_rate, int32_t* pn_spo2, int32_t* pn_heart_rate, uint8_t* puch_quality, PipelineController* p_controller);
 #endif
+uint8_t signal_quality(uint32_t* pun_green_buffer, uint32_t* pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length, int32_t sampling_rate, signal_quality_info* p_info);
 
 void maxim_find_peaks(int32_t* pn_locs, int32_t* n_npks, int32_t* valley_locs, int32_t* n_vals, int32_t* pn_x, int32_t n_size, int32_t max_threshold, int32_t min_threshold);
 void maxim_peaks_above_min_height(int32_t* pn_locs, int32_t* n_npks, int32_t* pn_x, int32_t n_size, int32_t max_threshold, int32_t max_n_peaks);
@@ -91,14 +142,25 @@ void maxim_valley_below_max_height(int32_t* valley_locs, int32_t* n_vals, int32_
 void maxim_sort_ascend(int32_t *pn_x, int32_t n_size);
 void maxim_sort_indices_descend(int32_t* pn_x, int32_t* pn_indx, int32_t n_size);
 
-void check_valid(int32_t* peak_locs, int32_t* n_npks, int32_t* valley_locs, int32_t* n_vals, int32_t* an_x, int32_t buffer_length, int32_t sampling_rate);
-int32_t spo2_calculation(uint32_t* ir_buffer, uint32_t* red_buffer, int32_t buffer_length, int32_t* valley_locs, int32_t num_val, int32_t* peak_locs, int32_t num_peak, int32_t ratio_size, int32_t* n_i_ratio_count);
-int32_t HR_calculation(uint32_t* green_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t* n_peak_interval_sum);
+int32_t segment_beats(int32_t* valley_locs, int32_t num_val, int32_t* peak_locs, int32_t num_peak, int32_t n_min_distance, Beat* beats, int32_t max_num_beats);
+void check_valid(Beat* beats, int32_t* n_beats, int32_t* an_x, int32_t sampling_rate);
+int32_t spo2_calculation(uint32_t* ir_buffer, uint32_t* red_buffer, Beat* beats, int32_t num_beats, int32_t ratio_size, int32_t* n_i_ratio_count);
+bool spo2_beat_ratio(uint32_t* ir_buffer, uint32_t* red_buffer, int32_t n_valley, int32_t n_peak, int32_t n_next_valley, int32_t* pn_ratio);
+int32_t spo2_from_ratio(int32_t n_ratio);
+int32_t HR_calculation(uint32_t* green_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t filter_size, const int32_t* pn_filtered, int32_t n_streamed_rate, int32_t* n_peak_interval_sum);
+int32_t HR_calculation_engine(uint8_t uch_engine, uint32_t* green_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t filter_size, const int32_t* pn_filtered, int32_t n_streamed_rate, int32_t* n_peak_interval_sum);
+int32_t HR_calculation_fused(uint8_t uch_engine, uint32_t* pun_green_buffer, uint32_t* pun_ir_buffer, uint32_t* pun_red_buffer, int32_t buffer_length, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate, int32_t filter_size, const int32_t* pn_streamed_rates, int32_t* n_peak_interval_sum);
+int32_t median_peak_interval(int32_t* peak_locs, int32_t num_peak);
+void vote_peaks(int32_t* an_locs, int32_t* an_count, int32_t n_stride, int32_t n_tolerance, int32_t* pn_locs, int32_t* pn_npks, int32_t n_max_num);
+int32_t spectral_heart_rate(uint32_t* pun_green_buffer, int32_t buffer_length, int32_t sampling_rate);
+void periodic_find_peaks(int32_t* pn_x, int32_t n_size, int32_t n_period, int32_t* pn_locs, int32_t* pn_npks, int32_t n_max_num);
 void preprocessing(int32_t* green_buffer, int32_t buffer_length, int32_t filter_size);
 void DC_removing_inverting_filter(int32_t* green_buffer, int32_t buffer_length);
 void median_filter(int32_t* green_buffer, int32_t buffer_length, int32_t filter_size);
 void mean_filter(int32_t* green_buffer, int32_t buffer_length, int32_t filter_size);
 void AMPD(int32_t* data, int32_t bufferSize, int32_t* index, int32_t* len_index, int32_t max_num_index);
+void increasing_slope(int32_t* data, int32_t bufferSize, int32_t* index, int32_t* len_index, int32_t max_num_index, int32_t n_min_distance);
+void peak_valley(int32_t* data, int32_t bufferSize, int32_t* peak_locs, int32_t* num_peak, int32_t max_num_peak, int32_t* valley_locs, int32_t* num_val, int32_t max_num_valley, int32_t sampling_rate);
 int32_t argmin(int32_t* index, int32_t index_len);
 
 #endif
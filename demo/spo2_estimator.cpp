@@ -0,0 +1,62 @@
+#include "spo2_estimator.h"
+#include "spo2_algorithm.h"
+
+SpO2Estimator::SpO2Estimator(int32_t n_ratio_size) : ratios(n_ratio_size)
+{
+  reset();
+}
+
+void SpO2Estimator::reset(void)
+{
+  b_has_beat = false;
+  ratios.clear();
+}
+
+bool SpO2Estimator::add_beat(const beat_event& beat, uint32_t* pun_ir, uint32_t* pun_red, uint32_t un_first_index, int32_t n_length)
+/**
+* \brief        Add the ratio of the beat closed by a new beat
+* \par          Details
+*               The detector runs on the inverted green, its peaks are the troughs of the raw IR/red and its
+*               valleys the raw peaks. The trough of the previous beat, the raw peak (valley) of the new beat and
+*               its trough form the triangle used by spo2_calculation. The beat is skipped if part of it already
+*               left the buffer.
+*
+* \param[in]    beat                    - newly confirmed beat
+* \param[in]    *pun_ir                 - IR sensor data buffer
+* \param[in]    *pun_red                - Red sensor data buffer
+* \param[in]    un_first_index          - sample index of pun_ir[0] and pun_red[0]
+* \param[in]    n_length                - number of valid samples in the buffers
+*
+* \retval       true if a new ratio entered the median
+*/
+{
+  bool b_added = false;
+  if (b_has_beat && beat.n_interval > 0 && previous.un_peak >= un_first_index &&
+      beat.un_peak < un_first_index + (uint32_t)n_length &&
+      previous.un_peak < beat.un_valley && beat.un_valley < beat.un_peak) {
+    int32_t n_ratio;
+    if (spo2_beat_ratio(pun_ir, pun_red, previous.un_peak - un_first_index, beat.un_valley - un_first_index,
+                        beat.un_peak - un_first_index, &n_ratio)) {
+      ratios.push(n_ratio);
+      b_added = true;
+    }
+  }
+  previous = beat;
+  b_has_beat = true;
+  return b_added;
+}
+
+void SpO2Estimator::resume(const int32_t* pn_ratios, int32_t n_count)
+{
+  ratios.clear();
+  for (int32_t i = 0; i < n_count; i++)
+    ratios.push(pn_ratios[i]);
+  b_has_beat = false;
+}
+
+int32_t SpO2Estimator::spo2(void) const
+{
+  if (ratios.count() == 0)
+    return 999;
+  return spo2_from_ratio(ratios.median());
+}
@@ -0,0 +1,42 @@
+/** \file spo2_estimator.h **************************************************
+*
+* Description: Incremental SpO2. The R ratio of a beat is computed once,
+*              when the valley that closes it is confirmed, and kept in a
+*              rolling median of the latest beats; the SpO2 is then a single
+*              uch_spo2_table lookup. spo2_calculation instead re-pairs every
+*              valley and peak of the window on each hop.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef SPO2_ESTIMATOR_H_
+#define SPO2_ESTIMATOR_H_
+
+#include <stdint.h>
+#include "beat_detector.h"
+#include "rolling_median.h"
+
+class SpO2Estimator {
+ public:
+  SpO2Estimator(int32_t n_ratio_size = 16);
+
+  void reset(void);
+
+  // beat: newly confirmed beat, its valley (the raw peak) and peak (the raw trough) close the previous beat
+  // pun_ir/pun_red: the most recent n_length samples, sample un_first_index (same numbering as the beat) at position 0
+  bool add_beat(const beat_event& beat, uint32_t* pun_ir, uint32_t* pun_red, uint32_t un_first_index, int32_t n_length);
+
+  int32_t spo2(void) const; // 999 while no ratio is known
+  int32_t ratio(void) const { return ratios.median(); } // median R multiplied by 100
+  const RollingMedian& ratio_median(void) const { return ratios; }
+  void resume(const int32_t* pn_ratios, int32_t n_count); // R ratios of a snapshot, oldest first; the next beat is not paired
+
+ private:
+  bool b_has_beat;
+  beat_event previous; // beat waiting for its closing valley
+  RollingMedian ratios;
+};
+
+#endif /* SPO2_ESTIMATOR_H_ */
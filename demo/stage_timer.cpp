@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <string.h>
+#include "stage_timer.h"
+
+#define STAGE_BUCKETS 128 // 32 octaves x 4
+
+typedef struct {
+  uint32_t un_count;
+  uint32_t un_min;
+  uint32_t un_max;
+  uint64_t un_sum;
+  uint32_t aun_histogram[STAGE_BUCKETS];
+} stage_entry;
+
+static stage_entry stage_table[STAGE_COUNT];
+static const char* const stage_names[STAGE_COUNT] = { "acquire", "shift", "display", "preprocess", "AMPD", "spo2", "BLE", "recorder", "hop", "quality", "spectral", "autocorr", "slope", "peak-valley" };
+
+// octave and the two bits below the leading one
+static inline uint32_t stage_bucket(uint32_t un_ticks)
+{
+  if (un_ticks < 4) return un_ticks;
+  uint32_t un_octave = 31 - __builtin_clz(un_ticks);
+  return un_octave * 4 + ((un_ticks >> (un_octave - 2)) & 3);
+}
+
+// largest tick count falling into bucket n
+static inline uint32_t stage_bucket_limit(uint32_t n)
+{
+  if (n < 4) return n;
+  uint32_t un_octave = n / 4;
+  return (uint32_t)((((uint64_t)(4 + n % 4 + 1)) << (un_octave - 2)) - 1);
+}
+
+void stage_record(uint8_t uch_stage, uint32_t un_ticks)
+{
+  if (uch_stage >= STAGE_COUNT) return;
+  stage_entry* p = &stage_table[uch_stage];
+  if (p->un_count == 0 || un_ticks < p->un_min) p->un_min = un_ticks;
+  if (un_ticks > p->un_max) p->un_max = un_ticks;
+  p->un_count++;
+  p->un_sum += un_ticks;
+  p->aun_histogram[stage_bucket(un_ticks)]++;
+}
+
+void stage_reset(void)
+{
+  memset(stage_table, 0, sizeof(stage_table));
+}
+
+void stage_get(uint8_t uch_stage, stage_stats* p_stats)
+{
+  memset(p_stats, 0, sizeof(stage_stats));
+  if (uch_stage >= STAGE_COUNT || stage_table[uch_stage].un_count == 0) return;
+  const stage_entry* p = &stage_table[uch_stage];
+  uint32_t un_tpu = stage_ticks_per_us();
+  uint32_t un_rank = p->un_count - p->un_count / 100; // samples at or below p99
+  uint32_t un_seen = 0, n = 0;
+  while (n < STAGE_BUCKETS - 1 && (un_seen += p->aun_histogram[n]) < un_rank) n++;
+  uint32_t un_p99 = stage_bucket_limit(n);
+  p_stats->un_count = p->un_count;
+  p_stats->un_min_us = p->un_min / un_tpu;
+  p_stats->un_avg_us = (uint32_t)(p->un_sum / p->un_count / un_tpu);
+  p_stats->un_max_us = p->un_max / un_tpu;
+  p_stats->un_p99_us = (un_p99 < p->un_max ? un_p99 : p->un_max) / un_tpu; // the bucket limit may pass the max
+}
+
+const char* stage_name(uint8_t uch_stage)
+{
+  return uch_stage < STAGE_COUNT ? stage_names[uch_stage] : "?";
+}
+
+int32_t stage_report(char* s_out, int32_t n_size)
+{
+  int32_t n_len = snprintf(s_out, n_size, "stage          count     min us     avg us     max us     p99 us\n");
+  for (uint8_t s = 0; s < STAGE_COUNT && n_len < n_size; s++) {
+    stage_stats stats;
+    stage_get(s, &stats);
+    n_len += snprintf(s_out + n_len, n_size - n_len, "%-10s %9lu %10lu %10lu %10lu %10lu\n", stage_names[s], (unsigned long)stats.un_count,
+                      (unsigned long)stats.un_min_us, (unsigned long)stats.un_avg_us, (unsigned long)stats.un_max_us, (unsigned long)stats.un_p99_us);
+  }
+  return n_len < n_size ? n_len : n_size - 1;
+}
+
+int32_t stage_pack(uint8_t* puch_out, int32_t n_size)
+{
+  int32_t n_len = 0;
+  for (uint8_t s = 0; s < STAGE_COUNT && n_len + 21 <= n_size; s++) {
+    stage_stats stats;
+    stage_get(s, &stats);
+    const uint32_t aun_values[5] = { stats.un_count, stats.un_min_us, stats.un_avg_us, stats.un_max_us, stats.un_p99_us };
+    puch_out[n_len++] = s;
+    for (int32_t k = 0; k < 5; k++)
+      for (int32_t b = 0; b < 4; b++)
+        puch_out[n_len++] = (uint8_t)(aun_values[k] >> (8 * b));
+  }
+  return n_len;
+}
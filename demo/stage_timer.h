@@ -0,0 +1,91 @@
+/** \file stage_timer.h *****************************************************
+*
+* Description: Per-stage timing of the pipeline. STAGE_SCOPE(stage) times
+*              the rest of the enclosing block with the CPU cycle counter on
+*              the ESP32 (std::chrono on the host) and adds it to a fixed
+*              table holding count, min, max, sum and a log-scale histogram
+*              (4 buckets per octave) from which p99 is estimated to within
+*              one bucket, i.e. about 19%.
+*              Recording one duration is a few integer operations; with
+*              STAGE_TIMING set to 0 the macros expand to nothing.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef STAGE_TIMER_H_
+#define STAGE_TIMER_H_
+
+#include <stdint.h>
+
+#ifndef STAGE_TIMING
+#define STAGE_TIMING 1 // 0 removes every timer from the build
+#endif
+
+enum stage_id {
+  STAGE_ACQUIRE = 0,    // sampling one hop, mostly waiting in check()
+  STAGE_SHIFT = 1,      // moving the buffers by one hop
+  STAGE_DISPLAY = 2,    // drawCruve
+  STAGE_PREPROCESS = 3, // DC removal, median and mean filter, or copying the band-passed window
+  STAGE_AMPD = 4,       // both AMPD calls and removing close peaks
+  STAGE_SPO2 = 5,       // beat segmentation and spo2_calculation
+  STAGE_BLE = 6,        // waveform and result notifications
+  STAGE_RECORDER = 7,   // session recorder flash spill, one block, in recorder_task
+  STAGE_HOP = 8,        // one whole loop()
+  STAGE_QUALITY = 9,    // signal_quality before peak detection
+  STAGE_SPECTRAL = 10,  // spectral HR engine, replaces STAGE_AMPD when selected
+  STAGE_AUTOCORR = 11,  // autocorrelation HR engine, replaces STAGE_AMPD when selected
+  STAGE_SLOPE = 12,     // increasing slope detector, replaces STAGE_AMPD when selected
+  STAGE_PEAK_VALLEY = 13, // peak-valley detector, replaces STAGE_AMPD when selected
+  STAGE_COUNT = 14
+};
+
+typedef struct {
+  uint32_t un_count;
+  uint32_t un_min_us;
+  uint32_t un_avg_us;
+  uint32_t un_max_us;
+  uint32_t un_p99_us;
+} stage_stats;
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Arduino.h>
+static inline uint32_t stage_clock(void) { return ESP.getCycleCount(); }
+static inline uint32_t stage_ticks_per_us(void) { return getCpuFrequencyMhz(); }
+#else
+#include <chrono>
+static inline uint32_t stage_clock(void)
+{
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline uint32_t stage_ticks_per_us(void) { return 1000; }
+#endif
+
+void stage_record(uint8_t uch_stage, uint32_t un_ticks);
+void stage_reset(void);
+void stage_get(uint8_t uch_stage, stage_stats* p_stats);
+const char* stage_name(uint8_t uch_stage);
+int32_t stage_report(char* s_out, int32_t n_size); // text table, returns the length written
+// per stage: stage id, then count, min, avg, max and p99 in us as little-endian 32-bit words
+int32_t stage_pack(uint8_t* puch_out, int32_t n_size);
+
+class StageTimer {
+ public:
+  StageTimer(uint8_t uch_stage) : uch_stage(uch_stage), un_start(stage_clock()) {}
+  ~StageTimer(void) { stage_record(uch_stage, stage_clock() - un_start); }
+
+ private:
+  uint8_t uch_stage;
+  uint32_t un_start;
+};
+
+#define STAGE_CONCAT_(a, b) a##b
+#define STAGE_CONCAT(a, b) STAGE_CONCAT_(a, b)
+#if STAGE_TIMING
+#define STAGE_SCOPE(stage) StageTimer STAGE_CONCAT(stage_timer_, __LINE__)(stage)
+#else
+#define STAGE_SCOPE(stage)
+#endif
+
+#endif /* STAGE_TIMER_H_ */
@@ -0,0 +1,68 @@
+#include "standby_controller.h"
+#include "spo2_algorithm.h"
+
+StandbyController::StandbyController(StandbySensor* sensor, uint8_t no_contact_hops, uint8_t poor_hops)
+  : p_sensor(sensor), uch_no_contact_hops(no_contact_hops), uch_poor_hops(poor_hops), uch_state(STANDBY_ACTIVE),
+    uch_no_contact(0), uch_poor(0), un_wakeups(0), un_begin_ms(0), un_state_ms(0), un_active_ms(0)
+{
+}
+
+void StandbyController::begin(uint32_t un_now_ms, uint8_t uch_new_state)
+{
+  un_begin_ms = un_state_ms = un_now_ms;
+  un_active_ms = 0;
+  un_wakeups = 0;
+  uch_state = uch_new_state == STANDBY_SENSING ? STANDBY_ACTIVE : STANDBY_SENSING; // so enter() switches the sensor
+  enter(uch_new_state, un_now_ms);
+}
+
+void StandbyController::enter(uint8_t uch_new_state, uint32_t un_now_ms)
+{
+  if (uch_new_state == uch_state) return;
+  if (uch_state == STANDBY_ACTIVE) un_active_ms += un_now_ms - un_state_ms;
+  uch_state = uch_new_state;
+  un_state_ms = un_now_ms;
+  uch_no_contact = uch_poor = 0;
+  if (uch_state == STANDBY_ACTIVE)
+    p_sensor->enter_active();
+  else
+    p_sensor->enter_proximity();
+}
+
+bool StandbyController::poll(uint32_t un_now_ms)
+{
+  if (uch_state != STANDBY_SENSING || !p_sensor->proximity_triggered()) return false;
+  un_wakeups++;
+  enter(STANDBY_ACTIVE, un_now_ms);
+  return true;
+}
+
+bool StandbyController::update(uint8_t uch_quality, uint32_t un_now_ms)
+/**
+* \brief        Count the failing hops of the acquisition
+* \par          Details
+*               A good hop clears both counters. No contact and the other failures are counted apart, a no
+*               contact hop also counts as poor, so alternating failures still end in standby after uch_poor_hops.
+*
+* \param[in]    uch_quality             - signal_quality_code of the newest window
+* \param[in]    un_now_ms               - current time in ms (millis())
+*
+* \retval       true if the acquisition fell back to standby
+*/
+{
+  if (uch_state != STANDBY_ACTIVE) return false;
+  if (uch_quality == SIGNAL_OK) {
+    uch_no_contact = uch_poor = 0;
+    return false;
+  }
+  uch_no_contact = uch_quality == SIGNAL_NO_CONTACT ? uch_no_contact + 1 : 0;
+  uch_poor++;
+  if (uch_no_contact < uch_no_contact_hops && uch_poor < uch_poor_hops) return false;
+  enter(STANDBY_SENSING, un_now_ms);
+  return true;
+}
+
+uint32_t StandbyController::active_ms(uint32_t un_now_ms) const
+{
+  return un_active_ms + (uch_state == STANDBY_ACTIVE ? un_now_ms - un_state_ms : 0);
+}
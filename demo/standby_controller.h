@@ -0,0 +1,71 @@
+/** \file standby_controller.h **********************************************
+*
+* Description: Proximity-triggered standby. Without a finger the sensor
+*              only runs its proximity mode (pilot IR LED at a low
+*              amplitude, no FIFO data) and the MCU waits; the PROX
+*              interrupt, raised once the IR count crosses the threshold,
+*              switches to the full multi-LED acquisition. The acquisition
+*              falls back to standby when the window signal quality says
+*              the finger is gone: at once after STANDBY_NO_CONTACT_HOPS
+*              hops of SIGNAL_NO_CONTACT, after STANDBY_POOR_HOPS hops of
+*              any other failure, so motion and short artifacts do not end
+*              a measurement. The controller only decides, the sensor side
+*              is a StandbySensor (the MAX30105 in demo.ino, a simulated
+*              sensor in tools/standby_sim).
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef STANDBY_CONTROLLER_H_
+#define STANDBY_CONTROLLER_H_
+
+#include <stdint.h>
+
+#define STANDBY_NO_CONTACT_HOPS 2 // 1.3 s at 400 sps and hop 256
+#define STANDBY_POOR_HOPS 16      // 10 s of clipped, low perfusion or irregular windows
+
+enum standby_state {
+  STANDBY_SENSING = 0, // proximity mode, waiting for the PROX interrupt
+  STANDBY_ACTIVE = 1   // multi-LED acquisition
+};
+
+// the sensor side of the state machine
+class StandbySensor {
+ public:
+  virtual ~StandbySensor(void) {}
+  virtual void enter_proximity(void) = 0;     // pilot LED only, PROX interrupt armed
+  virtual void enter_active(void) = 0;        // full acquisition, FIFO cleared
+  virtual bool proximity_triggered(void) = 0; // PROX interrupt raised since the last call
+};
+
+class StandbyController {
+ public:
+  StandbyController(StandbySensor* p_sensor, uint8_t uch_no_contact_hops = STANDBY_NO_CONTACT_HOPS, uint8_t uch_poor_hops = STANDBY_POOR_HOPS);
+
+  void begin(uint32_t un_now_ms, uint8_t uch_state); // start in a state, the sensor is switched to it
+  bool poll(uint32_t un_now_ms); // in standby: true once the interrupt switched to active, the caller refills its window
+  bool update(uint8_t uch_quality, uint32_t un_now_ms); // active: signal_quality_code of a hop, true if it fell back to standby
+
+  uint8_t state(void) const { return uch_state; }
+  uint32_t wakeups(void) const { return un_wakeups; }
+  uint32_t active_ms(uint32_t un_now_ms) const; // time spent in STANDBY_ACTIVE since begin()
+  uint32_t elapsed_ms(uint32_t un_now_ms) const { return un_now_ms - un_begin_ms; }
+
+ private:
+  void enter(uint8_t uch_new_state, uint32_t un_now_ms);
+
+  StandbySensor* p_sensor;
+  uint8_t uch_no_contact_hops;
+  uint8_t uch_poor_hops;
+  uint8_t uch_state;
+  uint8_t uch_no_contact; // consecutive SIGNAL_NO_CONTACT hops
+  uint8_t uch_poor;       // consecutive hops with any other failure
+  uint32_t un_wakeups;
+  uint32_t un_begin_ms;
+  uint32_t un_state_ms;   // start of the current state
+  uint32_t un_active_ms;  // closed active periods
+};
+
+#endif /* STANDBY_CONTROLLER_H_ */
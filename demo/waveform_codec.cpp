@@ -0,0 +1,103 @@
+#include "waveform_codec.h"
+
+static inline uint32_t zigzag_encode(int32_t n_value) { return ((uint32_t)n_value << 1) ^ (uint32_t)(n_value >> 31); }
+static inline int32_t zigzag_decode(uint32_t un_value) { return (int32_t)(un_value >> 1) ^ -(int32_t)(un_value & 1); }
+
+static inline uint16_t put_varint(uint8_t* puch_out, uint32_t un_value)
+{
+  uint16_t uw_n = 0;
+  while (un_value >= 0x80) {
+    puch_out[uw_n++] = (uint8_t)(un_value | 0x80);
+    un_value >>= 7;
+  }
+  puch_out[uw_n++] = (uint8_t)un_value;
+  return uw_n;
+}
+
+WaveformEncoder::WaveformEncoder(uint16_t max_payload) : uw_length(WAVEFORM_HEADER_SIZE), uw_sequence(0)
+{
+  set_max_payload(max_payload);
+  auch_frame[7] = 0; // begin_frame() must still be called before the first sample
+}
+
+void WaveformEncoder::set_max_payload(uint16_t max_payload)
+{
+  uw_max_payload = max_payload < WAVEFORM_MIN_PAYLOAD ? WAVEFORM_MIN_PAYLOAD : (max_payload > WAVEFORM_MAX_PAYLOAD ? WAVEFORM_MAX_PAYLOAD : max_payload);
+}
+
+void WaveformEncoder::begin_frame(uint32_t un_first_index)
+{
+  auch_frame[0] = WAVEFORM_FRAME_VERSION;
+  auch_frame[1] = (uint8_t)uw_sequence;
+  auch_frame[2] = (uint8_t)(uw_sequence >> 8);
+  auch_frame[3] = (uint8_t)un_first_index;
+  auch_frame[4] = (uint8_t)(un_first_index >> 8);
+  auch_frame[5] = (uint8_t)(un_first_index >> 16);
+  auch_frame[6] = (uint8_t)(un_first_index >> 24);
+  auch_frame[7] = 0;
+  uw_length = WAVEFORM_HEADER_SIZE;
+  uw_sequence++;
+}
+
+bool WaveformEncoder::add_sample(uint32_t un_green, uint32_t un_ir, uint32_t un_red)
+/**
+* \brief        Append one sample of each channel
+* \par          Details
+*               The sample is encoded into a scratch area first, so a frame is never left half written.
+*
+* \param[in]    un_green, un_ir, un_red - raw samples
+*
+* \retval       false if the frame has no room left (or already holds 255 samples)
+*/
+{
+  if (auch_frame[7] == 255)
+    return false;
+  uint8_t auch_sample[WAVEFORM_MAX_SAMPLE_BYTES];
+  uint32_t aun_value[WAVEFORM_CHANNELS] = { un_green, un_ir, un_red };
+  uint16_t uw_n = 0;
+  for (int32_t i = 0; i < WAVEFORM_CHANNELS; i++) {
+    int32_t n_delta = auch_frame[7] == 0 ? (int32_t)aun_value[i] : (int32_t)(aun_value[i] - aun_previous[i]);
+    uw_n += put_varint(&auch_sample[uw_n], zigzag_encode(n_delta));
+  }
+  if (uw_length + uw_n > uw_max_payload)
+    return false;
+  for (uint16_t i = 0; i < uw_n; i++)
+    auch_frame[uw_length + i] = auch_sample[i];
+  uw_length += uw_n;
+  for (int32_t i = 0; i < WAVEFORM_CHANNELS; i++)
+    aun_previous[i] = aun_value[i];
+  auch_frame[7]++;
+  return true;
+}
+
+int32_t waveform_decode(const uint8_t* puch_frame, uint16_t uw_length, uint32_t* pun_green, uint32_t* pun_ir, uint32_t* pun_red,
+                        int32_t n_max_samples, uint16_t* puw_sequence, uint32_t* pun_first_index)
+{
+  if (uw_length < WAVEFORM_HEADER_SIZE || puch_frame[0] != WAVEFORM_FRAME_VERSION)
+    return -1;
+  int32_t n_samples = puch_frame[7];
+  if (n_samples > n_max_samples)
+    return -1;
+  *puw_sequence = puch_frame[1] | (uint16_t)puch_frame[2] << 8;
+  *pun_first_index = puch_frame[3] | (uint32_t)puch_frame[4] << 8 | (uint32_t)puch_frame[5] << 16 | (uint32_t)puch_frame[6] << 24;
+
+  uint32_t* apun_out[WAVEFORM_CHANNELS] = { pun_green, pun_ir, pun_red };
+  uint32_t aun_previous[WAVEFORM_CHANNELS] = { 0, 0, 0 };
+  uint16_t uw_pos = WAVEFORM_HEADER_SIZE;
+  for (int32_t k = 0; k < n_samples; k++) {
+    for (int32_t i = 0; i < WAVEFORM_CHANNELS; i++) {
+      uint32_t un_value = 0;
+      int32_t n_shift = 0;
+      uint8_t uch_byte;
+      do {
+        if (uw_pos >= uw_length || n_shift > 28) return -1; // truncated frame or overlong varint
+        uch_byte = puch_frame[uw_pos++];
+        un_value |= (uint32_t)(uch_byte & 0x7F) << n_shift;
+        n_shift += 7;
+      } while (uch_byte & 0x80);
+      aun_previous[i] += (uint32_t)zigzag_decode(un_value); // the first sample adds to 0
+      apun_out[i][k] = aun_previous[i];
+    }
+  }
+  return uw_pos == uw_length ? n_samples : -1;
+}
@@ -0,0 +1,60 @@
+/** \file waveform_codec.h **************************************************
+*
+* Description: Framed, compressed raw waveform packets for BLE streaming.
+*
+* Frame layout (little-endian):
+*   byte  0     version (WAVEFORM_FRAME_VERSION)
+*   bytes 1-2   sequence number, +1 per frame, a gap means lost frames
+*   bytes 3-6   index of the first sample since the start of acquisition
+*   byte  7     number of samples per channel in this frame
+*   bytes 8-    samples interleaved green, ir, red. The first sample of each
+*               channel is its raw value, every following one the difference
+*               to the previous sample of the same channel; all values are
+*               zigzag encoded and written as base-128 varints.
+*
+* Each frame starts from raw values, so a lost frame does not corrupt the
+* following ones. Frames never exceed the payload size given to the encoder,
+* which should be the negotiated ATT MTU - 3 (at most 512).
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef WAVEFORM_CODEC_H_
+#define WAVEFORM_CODEC_H_
+
+#include <stdint.h>
+
+#define WAVEFORM_FRAME_VERSION 1
+#define WAVEFORM_HEADER_SIZE 8
+#define WAVEFORM_MAX_PAYLOAD 512 // ATT attribute value limit
+#define WAVEFORM_MIN_PAYLOAD 20  // default ATT MTU 23 - 3
+#define WAVEFORM_CHANNELS 3
+#define WAVEFORM_MAX_SAMPLE_BYTES (WAVEFORM_CHANNELS * 5) // 5 varint bytes hold any 32-bit value
+
+class WaveformEncoder {
+ public:
+  WaveformEncoder(uint16_t uw_max_payload = WAVEFORM_MIN_PAYLOAD);
+
+  void set_max_payload(uint16_t uw_max_payload); // clamped to 20..512
+  void begin_frame(uint32_t un_first_index);     // starts the next frame and takes the next sequence number
+  bool add_sample(uint32_t un_green, uint32_t un_ir, uint32_t un_red); // false if the frame is full, the sample is not added
+
+  const uint8_t* frame(void) const { return auch_frame; }
+  uint16_t frame_length(void) const { return uw_length; }
+  uint8_t sample_count(void) const { return auch_frame[7]; }
+
+ private:
+  uint8_t auch_frame[WAVEFORM_MAX_PAYLOAD];
+  uint16_t uw_length;
+  uint16_t uw_max_payload;
+  uint16_t uw_sequence;
+  uint32_t aun_previous[WAVEFORM_CHANNELS];
+};
+
+// decode one frame, returns the number of samples per channel or -1 if the frame is malformed or too large
+int32_t waveform_decode(const uint8_t* puch_frame, uint16_t uw_length, uint32_t* pun_green, uint32_t* pun_ir, uint32_t* pun_red,
+                        int32_t n_max_samples, uint16_t* puw_sequence, uint32_t* pun_first_index);
+
+#endif /* WAVEFORM_CODEC_H_ */
@@ -0,0 +1,141 @@
+#include <string.h>
+#include "waveform_plot.h"
+
+WaveformPlot::WaveformPlot(int16_t width, int16_t height, int32_t samples_per_column)
+  : puch_buffer(NULL), n_height(height)
+{
+  n_width = width > WAVEFORM_PLOT_MAX_WIDTH ? WAVEFORM_PLOT_MAX_WIDTH : width;
+  n_samples_per_column = samples_per_column < 1 ? 1 : samples_per_column;
+  reset();
+}
+
+void WaveformPlot::attach(uint8_t* buffer)
+{
+  puch_buffer = buffer;
+  reset();
+}
+
+void WaveformPlot::reset(void)
+{
+  n_cursor = 0;
+  n_columns = 0;
+  n_pending = 0;
+  un_min = 0xFFFFFFFF;
+  un_max = 0;
+  un_scale_lo = 0xFFFFFFFF; // the first column always sets the scale
+  un_scale_hi = 0;
+  if (puch_buffer) memset(puch_buffer, 0, n_width * (n_height / 8));
+  memset(aun_dirty, 0xFF, sizeof(aun_dirty));
+}
+
+void WaveformPlot::push(uint32_t un_sample)
+{
+  if (n_pending == 0 || un_sample < un_pending_lo) un_pending_lo = un_sample;
+  if (n_pending == 0 || un_sample > un_pending_hi) un_pending_hi = un_sample;
+  if (++n_pending == n_samples_per_column) {
+    complete_column();
+    n_pending = 0;
+  }
+}
+
+bool WaveformPlot::take_dirty(int16_t* pn_first, int16_t* pn_last)
+{
+  int16_t x = 0;
+  while (x < n_width && !(aun_dirty[x >> 5] & (1UL << (x & 31)))) x++;
+  if (x == n_width) return false;
+  *pn_first = x;
+  while (x < n_width && (aun_dirty[x >> 5] & (1UL << (x & 31)))) {
+    aun_dirty[x >> 5] &= ~(1UL << (x & 31));
+    x++;
+  }
+  *pn_last = x - 1;
+  return true;
+}
+
+void WaveformPlot::complete_column(void)
+/**
+* \brief        Store the collected column at the cursor and advance
+* \par          Details
+*               Once the display is full the column after the cursor becomes the blank gap, its values
+*               leave the running min/max, which is rescanned only if they were the extreme.
+*               Without a scale change only the new column and the gap are redrawn.
+*
+* \retval       None
+*/
+{
+  int16_t x = n_cursor;
+  aun_lo[x] = un_pending_lo;
+  aun_hi[x] = un_pending_hi;
+  n_cursor = (x + 1) % n_width;
+  bool b_rescan = false;
+  if (n_columns == n_width - 1) // the column now under the cursor is evicted
+    b_rescan = aun_lo[n_cursor] <= un_min || aun_hi[n_cursor] >= un_max;
+  else
+    n_columns++;
+  if (b_rescan) {
+    un_min = 0xFFFFFFFF;
+    un_max = 0;
+    for (int16_t k = 1; k <= n_columns; k++) {
+      int16_t c = (n_cursor - k + n_width) % n_width;
+      if (aun_lo[c] < un_min) un_min = aun_lo[c];
+      if (aun_hi[c] > un_max) un_max = aun_hi[c];
+    }
+  } else {
+    if (un_pending_lo < un_min) un_min = un_pending_lo;
+    if (un_pending_hi > un_max) un_max = un_pending_hi;
+  }
+
+  uint32_t un_span = un_scale_hi - un_scale_lo;
+  if (un_min < un_scale_lo || un_max > un_scale_hi || ((un_max - un_min) * 2 < un_span && un_span > (uint32_t)n_height)) {
+    rescale();
+    return;
+  }
+  draw_column(x);
+  clear_column(n_cursor);
+  aun_dirty[x >> 5] |= 1UL << (x & 31);
+  aun_dirty[n_cursor >> 5] |= 1UL << (n_cursor & 31);
+}
+
+void WaveformPlot::rescale(void)
+{
+  uint32_t un_range = un_max - un_min;
+  uint32_t un_margin = un_range / 4;
+  if (un_range + 2 * un_margin < (uint32_t)n_height) un_margin = ((uint32_t)n_height - un_range + 1) / 2; // at least one count per row
+  un_scale_lo = un_min > un_margin ? un_min - un_margin : 0;
+  un_scale_hi = un_max + un_margin;
+  for (int16_t x = 0; x < n_width; x++)
+    draw_column(x);
+  memset(aun_dirty, 0xFF, sizeof(aun_dirty));
+}
+
+int16_t WaveformPlot::to_y(uint32_t un_value) const
+{
+  if (un_value <= un_scale_lo) return 0;
+  if (un_value >= un_scale_hi) return n_height - 1;
+  return (int16_t)((uint64_t)(un_value - un_scale_lo) * (n_height - 1) / (un_scale_hi - un_scale_lo));
+}
+
+void WaveformPlot::clear_column(int16_t x)
+{
+  if (puch_buffer == NULL) return;
+  for (int16_t p = 0; p < n_height / 8; p++)
+    puch_buffer[x + p * n_width] = 0;
+}
+
+void WaveformPlot::draw_column(int16_t x)
+{
+  clear_column(x);
+  int16_t n_age = (n_cursor - x + n_width) % n_width; // 1 for the newest column
+  if (puch_buffer == NULL || n_age == 0 || n_age > n_columns) return; // blank gap or no data yet
+  int16_t y0 = to_y(aun_lo[x]);
+  int16_t y1 = to_y(aun_hi[x]);
+  if (n_age < n_columns) { // join the previous column so the trace stays continuous
+    int16_t n_prev = (x - 1 + n_width) % n_width;
+    int16_t y_prev_lo = to_y(aun_lo[n_prev]);
+    int16_t y_prev_hi = to_y(aun_hi[n_prev]);
+    if (y_prev_hi < y0) y0 = y_prev_hi;
+    if (y_prev_lo > y1) y1 = y_prev_lo;
+  }
+  for (int16_t y = y0; y <= y1; y++)
+    puch_buffer[x + (y >> 3) * n_width] |= 1 << (y & 7);
+}
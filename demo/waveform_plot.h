@@ -0,0 +1,60 @@
+/** \file waveform_plot.h ***************************************************
+*
+* Description: Sweeping waveform plot for the SSD1306 frame buffer. Every
+*              n_samples_per_column samples are decimated into one column
+*              holding their min and max, so the whole window fits the
+*              display width. A new column is drawn at a cursor that sweeps
+*              from left to right and blanks the column after it, so only the
+*              new columns change and only they have to be sent to the display.
+*              The running min/max of the visible columns sets the vertical
+*              scale; the plot is redrawn only when the signal leaves the
+*              scale or shrinks to less than half of it.
+*
+* Frame buffer layout (Adafruit_SSD1306::getBuffer()): one byte per column
+* and page of 8 rows, buffer[x + (y / 8) * width], bit y & 7.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the naming conventions of spo2_algorithm.h
+*
+* ------------------------------------------------------------------------- */
+#ifndef WAVEFORM_PLOT_H_
+#define WAVEFORM_PLOT_H_
+
+#include <stdint.h>
+
+#define WAVEFORM_PLOT_MAX_WIDTH 128
+
+class WaveformPlot {
+ public:
+  WaveformPlot(int16_t n_width, int16_t n_height, int32_t n_samples_per_column);
+
+  void attach(uint8_t* puch_buffer); // frame buffer of n_width x n_height pixels, cleared and marked dirty
+  void reset(void);
+  void push(uint32_t un_sample); // draws a column every n_samples_per_column samples
+  // next run of changed columns since the last call, false when nothing is left to send
+  bool take_dirty(int16_t* pn_first, int16_t* pn_last);
+
+ private:
+  void complete_column(void);
+  void rescale(void);
+  void draw_column(int16_t x);
+  void clear_column(int16_t x);
+  int16_t to_y(uint32_t un_value) const;
+
+  uint8_t* puch_buffer;
+  int16_t n_width;
+  int16_t n_height;
+  int32_t n_samples_per_column;
+  uint32_t aun_lo[WAVEFORM_PLOT_MAX_WIDTH]; // per column min
+  uint32_t aun_hi[WAVEFORM_PLOT_MAX_WIDTH]; // per column max
+  uint32_t aun_dirty[WAVEFORM_PLOT_MAX_WIDTH / 32];
+  int16_t n_cursor;  // column written next
+  int16_t n_columns; // columns holding data, up to n_width - 1 (one stays blank behind the cursor)
+  int32_t n_pending; // samples in the column being collected
+  uint32_t un_pending_lo, un_pending_hi;
+  uint32_t un_min, un_max;             // running min/max of the columns holding data
+  uint32_t un_scale_lo, un_scale_hi;   // value range mapped onto the display height
+};
+
+#endif /* WAVEFORM_PLOT_H_ */
@@ -0,0 +1,158 @@
+/** \file bandpass_bench.cpp ************************************************
+*
+* Description: Compare the two preprocess_kind engines of
+*              demo/spo2_algorithm.h: preprocessing() (DC removal, median
+*              and mean filter over the window) against the band-pass of
+*              demo/bandpass_filter.h run sample by sample in a
+*              PipelineController. The windows slide like in demo.ino
+*              (bufferLength 2048, hop 256), so the window chain runs over
+*              2048 samples every 256 new ones while the band-pass filters
+*              each sample once and copies the window.
+*              - cost: TSC cycles (x86 hosts) and ns per new sample;
+*              - accuracy: HR_calculation_engine on either input for the
+*                peak search engines, against the streaming beat detector;
+*              - delay: lag of the band-pass window against the median+mean
+*                window with the largest cross-correlation, positive is
+*                later, averaged over the windows.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o bandpass_bench bandpass_bench.cpp ppg_record_reader.cpp ../demo/autocorr_engine.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/stage_timer.cpp ../demo/beat_detector.cpp ../demo/rolling_median.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   bandpass_bench recording.ppg [recording.ppg ...]
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0ULL // no cycle counter, the ns columns still hold
+#endif
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "pipeline_controller.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define FILTER_SIZE 15
+#define TOLERANCE_BPM 5
+#define ENGINES 4
+#define MAX_LAG_DIV 4 // lags up to a quarter second
+
+struct accuracy {
+  uint32_t un_invalid;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_error;
+};
+
+static void score(accuracy* p, int32_t n_hr, int32_t n_reference)
+{
+  if (n_hr == 999) { p->un_invalid++; return; }
+  if (n_reference == 999) return;
+  int32_t n_error = abs(n_hr - n_reference);
+  p->un_compared++;
+  p->f_abs_error += n_error;
+  if (n_error <= TOLERANCE_BPM) p->un_within++;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  const char* s_names[ENGINES] = { "AMPD", "slope", "peak-valley", "spectral" };
+  const uint8_t uch_engines[ENGINES] = { HR_ENGINE_AMPD, HR_ENGINE_SLOPE, HR_ENGINE_PEAK_VALLEY, HR_ENGINE_SPECTRAL };
+  accuracy results[ENGINES][2];
+  memset(results, 0, sizeof(results));
+  uint64_t un_chain_cycles = 0, un_bandpass_cycles = 0;
+  double f_chain_seconds = 0, f_bandpass_seconds = 0;
+  uint64_t un_new_samples = 0; // samples whose window was evaluated
+  uint32_t un_windows = 0;
+  int64_t n_lag_sum = 0;
+  int32_t n_rate = 0;
+  int32_t an_peaks[16], an_valleys[16];
+  for (int i = 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    ppg_span green = reader.window(n_green, 0, un_count);
+    BeatDetector detector(n_rate, FILTER_SIZE);
+    PipelineController* p_controller = new PipelineController();
+    p_controller->set_sampling_rate(n_rate);
+    p_controller->enable_bandpass(); // as with PREPROCESS_BANDPASS, the history is filled from the first sample
+    std::vector<uint32_t> window(WINDOW);
+    std::vector<int32_t> chain(WINDOW), filtered(WINDOW);
+    for (uint32_t un_end = HOP - 1; un_end < un_count; un_end += HOP) {
+      for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+        detector.push(green.pun_data[k]);
+      // the band-pass side of one hop: every new sample once, then the copy HR_calculation_engine makes
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      uint64_t un_c0 = CYCLES();
+      for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+        p_controller->push_green(green.pun_data[k]);
+      const int32_t* pn_filtered = p_controller->filtered_window(WINDOW);
+      if (pn_filtered != NULL) memcpy(&filtered[0], pn_filtered, WINDOW * sizeof(int32_t));
+      uint64_t un_c1 = CYCLES();
+      double f_hop = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      if (pn_filtered == NULL) continue;
+
+      // the window side: preprocessing() over the whole window, as HR_calculation_engine does per hop
+      for (int32_t k = 0; k < WINDOW; k++)
+        chain[k] = green.pun_data[un_end + 1 - WINDOW + k];
+      t0 = std::chrono::steady_clock::now();
+      uint64_t un_c2 = CYCLES();
+      preprocessing(&chain[0], WINDOW, FILTER_SIZE);
+      uint64_t un_c3 = CYCLES();
+      f_chain_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      f_bandpass_seconds += f_hop;
+      un_bandpass_cycles += un_c1 - un_c0;
+      un_chain_cycles += un_c3 - un_c2;
+      un_new_samples += HOP;
+      un_windows++;
+
+      int32_t n_reference = detector.heart_rate();
+      window.assign(green.pun_data + un_end + 1 - WINDOW, green.pun_data + un_end + 1);
+      for (int e = 0; e < ENGINES; e++) {
+        int32_t n_num_peak, n_num_val, n_interval;
+        score(&results[e][0], HR_calculation_engine(uch_engines[e], &window[0], WINDOW, an_peaks, &n_num_peak, 16, an_valleys, &n_num_val, 16,
+                                                    n_rate, FILTER_SIZE, NULL, -1, &n_interval), n_reference);
+        score(&results[e][1], HR_calculation_engine(uch_engines[e], &window[0], WINDOW, an_peaks, &n_num_peak, 16, an_valleys, &n_num_val, 16,
+                                                    n_rate, FILTER_SIZE, pn_filtered, -1, &n_interval), n_reference);
+      }
+
+      int32_t n_max_lag = n_rate / MAX_LAG_DIV, n_best_lag = 0;
+      double f_best = 0;
+      for (int32_t n_lag = -n_max_lag; n_lag <= n_max_lag; n_lag++) {
+        double f_sum = 0;
+        for (int32_t k = n_max_lag; k < WINDOW - n_max_lag; k++)
+          f_sum += (double)chain[k] * filtered[k + n_lag];
+        if (n_lag == -n_max_lag || f_sum > f_best) { f_best = f_sum; n_best_lag = n_lag; }
+      }
+      n_lag_sum += n_best_lag;
+    }
+    delete p_controller; p_controller = NULL;
+  }
+  if (un_windows == 0) { fprintf(stderr, "no complete window\n"); return 1; }
+  printf("%u windows, %llu new samples\n\n", un_windows, (unsigned long long)un_new_samples);
+  printf("preprocessing   cycles/sample  ns/sample\n");
+  printf("%-15s %13.1f %10.1f\n", "median+mean", (double)un_chain_cycles / un_new_samples, f_chain_seconds * 1e9 / un_new_samples);
+  printf("%-15s %13.1f %10.1f\n", "band-pass", (double)un_bandpass_cycles / un_new_samples, f_bandpass_seconds * 1e9 / un_new_samples);
+  printf("\nband-pass delay against median+mean: %.1f ms\n\n", 1000.0 * n_lag_sum / un_windows / n_rate);
+  printf("engine       input        invalid  mean |error|  within %d bpm\n", TOLERANCE_BPM);
+  for (int e = 0; e < ENGINES; e++)
+    for (int m = 0; m < 2; m++) {
+      const accuracy* p = &results[e][m];
+      printf("%-12s %-12s %7u %13.1f %13.0f%%\n", m ? "" : s_names[e], m ? "band-pass" : "median+mean", p->un_invalid,
+             p->un_compared ? p->f_abs_error / p->un_compared : 0.0, p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0);
+    }
+  return 0;
+}
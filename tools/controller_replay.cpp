@@ -0,0 +1,156 @@
+/** \file controller_replay.cpp *********************************************
+*
+* Description: Replay recordings through heart_rate_and_oxygen_saturation
+*              twice, with the fixed sizes (no controller) and with one
+*              PipelineController per recording (demo/pipeline_controller.h),
+*              and show how the adapted sizes settle. The windows slide like
+*              in demo.ino (bufferLength 2048, hop 256). Per window the sizes
+*              and both results are printed next to the streaming beat
+*              detector as the reference; the summary counts size changes,
+*              reversals (a change of a size in the opposite direction of its
+*              previous change, i.e. oscillation) and the run time per window.
+*              The exit status is 1 if any size of any recording reversed, or
+*              changed later than SETTLE_WINDOWS windows into the recording.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o controller_replay controller_replay.cpp ppg_record_reader.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp ../demo/stage_timer.cpp
+*              ../demo/beat_detector.cpp ../demo/rolling_median.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   controller_replay recording.ppg [recording.ppg ...]
+*
+* Recordings without IR/red channels reuse the green channel for them, the
+* SpO2 columns are then only a consistency check between the two runs.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "pipeline_controller.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define TOLERANCE_BPM 5
+#define SETTLE_WINDOWS 16 // the last size change of a recording must come within this many windows
+#define SIZES 4           // max_peak, max_valley, filter_size, ratio_size
+
+struct run_result {
+  const char* s_name;
+  uint32_t un_windows;
+  uint32_t un_invalid;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_error;
+  double f_seconds;
+};
+
+static void add_window(run_result* p, int32_t n_hr, int32_t n_reference, double f_seconds)
+{
+  p->un_windows++;
+  p->f_seconds += f_seconds;
+  if (n_hr == 999) { p->un_invalid++; return; }
+  if (n_reference == 999) return;
+  int32_t n_error = abs(n_hr - n_reference);
+  p->un_compared++;
+  p->f_abs_error += n_error;
+  if (n_error <= TOLERANCE_BPM) p->un_within++;
+}
+
+static void read_sizes(const PipelineController& controller, int32_t* pn_sizes)
+{
+  pn_sizes[0] = controller.max_peak();
+  pn_sizes[1] = controller.max_valley();
+  pn_sizes[2] = controller.filter_size();
+  pn_sizes[3] = controller.ratio_size();
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  run_result results[2] = { { "fixed", 0, 0, 0, 0, 0, 0 }, { "adaptive", 0, 0, 0, 0, 0, 0 } };
+  uint32_t un_changes = 0, un_reversals = 0, un_unsettled = 0;
+  const char* as_size_names[SIZES] = { "max_peak", "max_valley", "filter_size", "ratio_size" };
+  int32_t n_filter_min = CONTROLLER_MAX_FILTER, n_filter_max = CONTROLLER_MIN_FILTER;
+  printf("%-40s %6s %5s %6s %6s %5s %5s  %4s %4s %4s %4s\n", "recording", "sample", "ref", "HR", "HR*", "SpO2", "SpO2*",
+         "peak", "val", "filt", "rat");
+  for (int i = 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR), n_red = reader.find_channel(PPG_CHANNEL_RED);
+    int32_t n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = reader.window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = reader.window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+    BeatDetector detector(n_rate, 15);
+    PipelineController controller; // one session per recording
+    int32_t an_last[SIZES], an_last_step[SIZES] = { 0, 0, 0, 0 };
+    read_sizes(controller, an_last);
+    uint32_t un_window = 0, un_last_change = 0;
+    const char* s_name = strrchr(argv[i], '/');
+    s_name = s_name ? s_name + 1 : argv[i];
+    std::vector<uint32_t> green(WINDOW), ir(WINDOW), red(WINDOW);
+    for (uint32_t un_end = HOP - 1; un_end < un_count; un_end += HOP) {
+      for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+        detector.push(pun_green[k]);
+      if (un_end + 1 < WINDOW) continue;
+      int32_t n_reference = detector.heart_rate();
+      uint32_t un_first = un_end + 1 - WINDOW;
+      int32_t an_hr[2], an_spo2[2];
+      for (int r = 0; r < 2; r++) {
+        // the pipeline takes non-const buffers, each run gets its own copy of the window
+        green.assign(pun_green + un_first, pun_green + un_end + 1);
+        ir.assign(pun_ir + un_first, pun_ir + un_end + 1);
+        red.assign(pun_red + un_first, pun_red + un_end + 1);
+        uint8_t uch_quality;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        heart_rate_and_oxygen_saturation(&green[0], &ir[0], &red[0], WINDOW, n_rate, &an_spo2[r], &an_hr[r], &uch_quality,
+                                         r == 0 ? NULL : &controller);
+        add_window(&results[r], an_hr[r], n_reference, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+      }
+      un_window++;
+      int32_t an_sizes[SIZES];
+      read_sizes(controller, an_sizes);
+      for (int s = 0; s < SIZES; s++) {
+        int32_t n_step = an_sizes[s] - an_last[s];
+        if (n_step == 0) continue;
+        if (an_last_step[s] != 0 && (n_step > 0) != (an_last_step[s] > 0)) {
+          un_reversals++;
+          fprintf(stderr, "%s: %s reversed %d -> %d at sample %u\n", s_name, as_size_names[s], an_last[s], an_sizes[s], un_end + 1);
+        }
+        an_last_step[s] = n_step;
+        an_last[s] = an_sizes[s];
+        un_last_change = un_window;
+      }
+      if (controller.filter_size() < n_filter_min) n_filter_min = controller.filter_size();
+      if (controller.filter_size() > n_filter_max) n_filter_max = controller.filter_size();
+      printf("%-40.40s %6u %5d %6d %6d %5d %5d  %4d %4d %4d %4d\n", s_name, un_end + 1, n_reference,
+             an_hr[0], an_hr[1], an_spo2[0], an_spo2[1], controller.max_peak(), controller.max_valley(), controller.filter_size(),
+             controller.ratio_size());
+    }
+    un_changes += controller.changes();
+    if (un_last_change > SETTLE_WINDOWS) {
+      un_unsettled++;
+      fprintf(stderr, "%s: sizes still changing at window %u of %u, not settled within %d\n", s_name, un_last_change, un_window, SETTLE_WINDOWS);
+    }
+  }
+  printf("\n* adapted by the controller: %u size changes, %u reversals, %u recordings not settled within %d windows, filter_size %d to %d\n",
+         un_changes, un_reversals, un_unsettled, SETTLE_WINDOWS, n_filter_min, n_filter_max);
+  printf("run       windows  invalid  mean |error|  within %d bpm  us/window\n", TOLERANCE_BPM);
+  for (int r = 0; r < 2; r++) {
+    const run_result* p = &results[r];
+    printf("%-9s %7u %8u %13.1f %13.0f%% %10.0f\n", p->s_name, p->un_windows, p->un_invalid,
+           p->un_compared ? p->f_abs_error / p->un_compared : 0.0, p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0,
+           p->un_windows ? p->f_seconds * 1e6 / p->un_windows : 0.0);
+  }
+  bool b_ok = un_reversals == 0 && un_unsettled == 0;
+  printf("%s\n", b_ok ? "sizes settled without reversal" : "SIZES OSCILLATE OR DO NOT SETTLE");
+  return b_ok ? 0 : 1;
+}
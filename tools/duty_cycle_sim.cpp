@@ -0,0 +1,168 @@
+/** \file duty_cycle_sim.cpp ************************************************
+*
+* Description: How short a spot check burst can be, and what the schedule
+*              of demo/duty_cycle_controller.h costs. Each burst starts a
+*              fresh beat detector on a recording (every hop of 256 samples
+*              is a start), fills the window as warm_up() does and adds
+*              hops until the burst length has passed; its result is the
+*              streaming heart rate gated by signal_quality on the last
+*              window, compared with a detector that ran continuously up to
+*              the same sample. The schedule is then run on a fake clock for
+*              an hour per period and burst: sensor awake and MCU awake in
+*              ms per minute, against 60000 for continuous sampling. The
+*              MCU is counted asleep between bursts, the time to compute
+*              and publish after a burst is not included.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o duty_cycle_sim duty_cycle_sim.cpp ppg_record_reader.cpp
+*              ../demo/duty_cycle_controller.cpp ../demo/beat_detector.cpp ../demo/rolling_median.cpp ../demo/spo2_algorithm.cpp ../demo/small_median.cpp
+*              ../demo/autocorr_engine.cpp ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/stage_timer.cpp
+*              ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   duty_cycle_sim [-b burst_s,...] [-p period_s,...] recording.ppg [recording.ppg ...]
+*
+* Recordings without IR/red channels reuse the green channel for them.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "duty_cycle_controller.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define TOLERANCE_BPM 5
+#define SIM_HOURS_MS 3600000
+
+struct burst_result {
+  uint32_t un_bursts;
+  uint32_t un_invalid;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_diff;
+};
+
+class FakeSensor: public DutyCycleSensor {
+ public:
+  FakeSensor(): un_wakes(0), b_awake(true) {}
+  void wake(void) { un_wakes++; b_awake = true; }
+  void shut_down(void) { b_awake = false; }
+  uint32_t un_wakes;
+  bool b_awake;
+};
+
+static std::vector<double> parse_list(char* p_text)
+{
+  std::vector<double> values;
+  for (char* p = strtok(p_text, ","); p; p = strtok(NULL, ","))
+    values.push_back(atof(p));
+  return values;
+}
+
+// samples a burst really takes: the first window is always filled, then whole hops until the length has passed
+static uint32_t burst_samples(double f_burst_s, int32_t n_rate)
+{
+  uint32_t un_wanted = (uint32_t)(f_burst_s * n_rate);
+  if (un_wanted <= WINDOW) return WINDOW;
+  return WINDOW + (un_wanted - WINDOW + HOP - 1) / HOP * HOP;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<double> bursts, periods;
+  int i = 1;
+  while (i + 1 < argc && argv[i][0] == '-') {
+    if (strcmp(argv[i], "-b") == 0) bursts = parse_list(argv[i + 1]);
+    else if (strcmp(argv[i], "-p") == 0) periods = parse_list(argv[i + 1]);
+    else break;
+    i += 2;
+  }
+  if (bursts.empty()) { double d[] = { 6, 8, 10, 15, 20 }; bursts.assign(d, d + 5); }
+  if (periods.empty()) { double d[] = { 30, 60, 120, 300 }; periods.assign(d, d + 4); }
+  if (i >= argc) { fprintf(stderr, "usage: %s [-b burst_s,...] [-p period_s,...] recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+
+  std::vector<burst_result> results(bursts.size());
+  memset(&results[0], 0, results.size() * sizeof(burst_result));
+  int32_t n_rate = 400;
+  for (; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR), n_red = reader.find_channel(PPG_CHANNEL_RED);
+    n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = reader.window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = reader.window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+
+    std::vector<int32_t> reference(un_count + 1, 999); // continuous detector after each sample
+    BeatDetector continuous(n_rate, 15);
+    for (uint32_t k = 0; k < un_count; k++) {
+      continuous.push(pun_green[k]);
+      reference[k + 1] = continuous.heart_rate();
+    }
+    std::vector<uint32_t> green, ir, red;
+    signal_quality_info quality_info;
+    for (size_t b = 0; b < bursts.size(); b++) {
+      uint32_t un_length = burst_samples(bursts[b], n_rate);
+      for (uint32_t un_start = 0; un_start + un_length <= un_count; un_start += HOP) {
+        uint32_t un_end = un_start + un_length;
+        if (reference[un_end] == 999) continue;
+        BeatDetector detector(n_rate, 15);
+        for (uint32_t k = un_start; k < un_end; k++)
+          detector.push(pun_green[k]);
+        green.assign(pun_green + un_end - WINDOW, pun_green + un_end);
+        ir.assign(pun_ir + un_end - WINDOW, pun_ir + un_end);
+        red.assign(pun_red + un_end - WINDOW, pun_red + un_end);
+        uint8_t uch_quality = signal_quality(&green[0], &ir[0], &red[0], WINDOW, n_rate, &quality_info);
+        int32_t n_hr = uch_quality == SIGNAL_OK ? detector.heart_rate() : 999;
+        burst_result* p = &results[b];
+        p->un_bursts++;
+        if (n_hr == 999) { p->un_invalid++; continue; }
+        int32_t n_diff = abs(n_hr - reference[un_end]);
+        p->un_compared++;
+        p->f_abs_diff += n_diff;
+        if (n_diff <= TOLERANCE_BPM) p->un_within++;
+      }
+    }
+  }
+
+  printf("burst s  sampled s  bursts  invalid  mean |diff to continuous|  within %d bpm\n", TOLERANCE_BPM);
+  for (size_t b = 0; b < bursts.size(); b++) {
+    const burst_result* p = &results[b];
+    printf("%7.1f %10.2f %7u %8u %26.1f %13.0f%%\n", bursts[b], (double)burst_samples(bursts[b], n_rate) / n_rate, p->un_bursts, p->un_invalid,
+           p->un_compared ? p->f_abs_diff / p->un_compared : 0.0, p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0);
+  }
+
+  printf("\nperiod s  burst s  wakes/h  sensor ms/min  MCU awake ms/min  (continuous: 60000)\n");
+  for (size_t p = 0; p < periods.size(); p++)
+    for (size_t b = 0; b < bursts.size(); b++) {
+      FakeSensor sensor;
+      uint32_t un_period_ms = (uint32_t)(periods[p] * 1000);
+      uint32_t un_capture_ms = burst_samples(bursts[b], n_rate) * 1000 / n_rate;
+      DutyCycleController schedule(&sensor, un_period_ms, un_capture_ms);
+      schedule.begin(0);
+      for (uint32_t un_now = 0; un_now < SIM_HOURS_MS; ) {
+        if (schedule.due(un_now)) {
+          schedule.start(un_now);
+          un_now += schedule.settle_ms() + un_capture_ms; // sampling ends with the burst
+          schedule.finish(un_now);
+        } else {
+          uint32_t un_idle = schedule.idle_ms(un_now);
+          if (un_now + un_idle > SIM_HOURS_MS) un_idle = SIM_HOURS_MS - un_now;
+          schedule.add_sleep(un_idle);
+          un_now += un_idle;
+        }
+      }
+      uint32_t un_elapsed = schedule.elapsed_ms(SIM_HOURS_MS);
+      printf("%8.0f %8.1f %8u %14u %17u\n", periods[p], bursts[b], sensor.un_wakes,
+             DutyCycleController::per_minute(schedule.sensor_ms(SIM_HOURS_MS), un_elapsed),
+             DutyCycleController::per_minute(schedule.awake_ms(SIM_HOURS_MS), un_elapsed));
+    }
+  return 0;
+}
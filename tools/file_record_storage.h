@@ -0,0 +1,53 @@
+/** \file file_record_storage.h *********************************************
+*
+* Description: Host RecordStorage backed by a regular file, the stand-in for
+*              the LittleFS storage of the device (demo/littlefs_storage.h),
+*              plus a ByteOutput writing an export to a file.
+*
+* ------------------------------------------------------------------------- */
+#ifndef FILE_RECORD_STORAGE_H_
+#define FILE_RECORD_STORAGE_H_
+
+#include <stdio.h>
+#include "session_recorder.h"
+
+class FileRecordStorage : public RecordStorage {
+ public:
+  FileRecordStorage(const char* path) : s_path(path), fp(NULL) {}
+  ~FileRecordStorage(void) { if (fp) fclose(fp); }
+
+  virtual bool clear(void)
+  {
+    if (fp) fclose(fp);
+    fp = fopen(s_path, "w+b");
+    return fp != NULL;
+  }
+  virtual bool append(const uint8_t* puch_data, uint32_t un_length)
+  {
+    return fp && fseek(fp, 0, SEEK_END) == 0 && fwrite(puch_data, 1, un_length, fp) == un_length;
+  }
+  virtual bool read(uint32_t un_offset, uint8_t* puch_data, uint32_t un_length)
+  {
+    return fp && fseek(fp, un_offset, SEEK_SET) == 0 && fread(puch_data, 1, un_length, fp) == un_length;
+  }
+  virtual uint32_t size(void)
+  {
+    if (fp == NULL || fseek(fp, 0, SEEK_END) != 0) return 0;
+    return (uint32_t)ftell(fp);
+  }
+
+ private:
+  const char* s_path;
+  FILE* fp;
+};
+
+class FileOutput : public ByteOutput {
+ public:
+  FileOutput(FILE* file) : fp(file) {}
+  virtual bool write(const uint8_t* puch_data, uint32_t un_length) { return fwrite(puch_data, 1, un_length, fp) == un_length; }
+
+ private:
+  FILE* fp;
+};
+
+#endif /* FILE_RECORD_STORAGE_H_ */
@@ -0,0 +1,158 @@
+/** \file fixed_point_check.cpp *********************************************
+*
+* Description: Check the Q16.16 helpers of demo/fixed_point.h against a
+*              128-bit integer reference, at the int32 limits and around
+*              the points where a product or quotient leaves the 32-bit
+*              range:
+*              - conversions: q16_from_int saturates outside +-32767,
+*                q16_to_int truncates towards zero down to INT32_MIN;
+*              - q16_mul: floor(a * b / 2^16), saturated;
+*              - q16_ratio and q16_div: (a << 16) / b truncated towards
+*                zero, saturated, and towards the sign of the numerator for
+*                a zero denominator. Numerators of 2^46 and more are halved
+*                with the denominator to keep the shift inside 64 bits, so
+*                there the result may be off by the relative truncation
+*                error of the halved operands, 1/den + 2^-44 of itself;
+*              - fx_mul_div: a * b / c truncated towards zero, saturated.
+*              Fixed cases first, then RANDOM_CASES operand pairs drawn
+*              from the edges (0, +-1, powers of two and their neighbours,
+*              INT32_MIN/MAX) and from the full range.
+*              The exit status is 1 if any result differed.
+*
+* Build:   g++ -O2 -std=c++17 -I../demo -o fixed_point_check fixed_point_check.cpp
+* Usage:   fixed_point_check
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "fixed_point.h"
+
+#define RANDOM_CASES 2000000
+
+typedef __int128 wide_t;
+
+static uint32_t un_checks = 0, un_failures = 0;
+
+static int32_t saturate_wide(wide_t n_value)
+{
+  if (n_value > INT32_MAX) return INT32_MAX;
+  if (n_value < INT32_MIN) return INT32_MIN;
+  return (int32_t)n_value;
+}
+
+static wide_t floor_div(wide_t n_num, wide_t n_den)
+{
+  wide_t n_q = n_num / n_den;
+  return (n_num % n_den != 0 && (n_num < 0) != (n_den < 0)) ? n_q - 1 : n_q;
+}
+
+static void expect(const char* s_what, int64_t n_a, int64_t n_b, int64_t n_c, int32_t n_got, int32_t n_want, int32_t n_slack)
+{
+  un_checks++;
+  int64_t n_diff = (int64_t)n_got - n_want;
+  if (n_diff <= n_slack && n_diff >= -n_slack) return;
+  if (un_failures++ < 20)
+    printf("%s(%lld, %lld, %lld) = %d, expected %d\n", s_what, (long long)n_a, (long long)n_b, (long long)n_c, n_got, n_want);
+}
+
+static void check_mul(q16_t n_a, q16_t n_b)
+{
+  expect("q16_mul", n_a, n_b, 0, q16_mul(n_a, n_b), saturate_wide(floor_div((wide_t)n_a * n_b, Q16_ONE)), 0);
+}
+
+static void check_ratio(int64_t n_num, int64_t n_den)
+{
+  int32_t n_want, n_slack = 0;
+  if (n_den == 0) n_want = n_num >= 0 ? Q16_MAX : Q16_MIN;
+  else {
+    wide_t n_exact = ((wide_t)n_num << Q16_SHIFT) / n_den;
+    n_want = saturate_wide(n_exact);
+    int64_t n_num_k = n_num, n_den_k = n_den < 0 ? -n_den : n_den;
+    while (n_num_k >= ((int64_t)1 << 46) || n_num_k <= -((int64_t)1 << 46)) { n_num_k /= 2; n_den_k /= 2; }
+    // halved operands: the numerator keeps 45 bits, the denominator only what is left of it; a denominator
+    // halved to zero means a quotient beyond 2^29, which saturates either way
+    if (n_den_k != 0 && n_num_k != n_num) {
+      double f_bound = (double)(n_exact < 0 ? -n_exact : n_exact) * (1.0 / n_den_k + 1.0 / ((int64_t)1 << 44)) + 1;
+      n_slack = f_bound > INT32_MAX ? INT32_MAX : (int32_t)f_bound;
+    }
+  }
+  expect("q16_ratio", n_num, n_den, 0, q16_ratio(n_num, n_den), n_want, n_slack);
+}
+
+static void check_mul_div(int32_t n_a, int32_t n_b, int32_t n_c)
+{
+  int32_t n_want;
+  if (n_c == 0) n_want = (int64_t)n_a * n_b >= 0 ? INT32_MAX : INT32_MIN;
+  else n_want = saturate_wide((wide_t)n_a * n_b / n_c);
+  expect("fx_mul_div", n_a, n_b, n_c, fx_mul_div(n_a, n_b, n_c), n_want, 0);
+}
+
+// operands at the edges half of the time, anywhere in the range otherwise
+static int32_t edge_operand(void)
+{
+  uint32_t un_r = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+  if (un_r & 1) return (int32_t)((uint32_t)rand() << 17 ^ (uint32_t)rand() << 2 ^ (un_r >> 30));
+  int32_t n_shift = (un_r >> 1) % 32, n_offset = (int32_t)((un_r >> 6) % 5) - 2;
+  int64_t n_value = ((int64_t)1 << n_shift) + n_offset;
+  if (un_r & 0x800) n_value = -n_value;
+  if ((un_r >> 12) % 16 == 0) n_value = (un_r & 0x10000) ? INT32_MAX - (int64_t)((un_r >> 17) % 3) : INT32_MIN + (int64_t)((un_r >> 17) % 3);
+  return saturate_wide(n_value);
+}
+
+int main(void)
+{
+  // conversions
+  expect("q16_from_int", 0, 0, 0, q16_from_int(0), 0, 0);
+  expect("q16_from_int", 32767, 0, 0, q16_from_int(32767), 32767 * 65536, 0);
+  expect("q16_from_int", 32768, 0, 0, q16_from_int(32768), Q16_MAX, 0);
+  expect("q16_from_int", -32768, 0, 0, q16_from_int(-32768), Q16_MIN, 0);
+  expect("q16_from_int", -32769, 0, 0, q16_from_int(-32769), Q16_MIN, 0);
+  expect("q16_from_int", INT32_MAX, 0, 0, q16_from_int(INT32_MAX), Q16_MAX, 0);
+  expect("q16_from_int", INT32_MIN, 0, 0, q16_from_int(INT32_MIN), Q16_MIN, 0);
+  expect("q16_to_int", Q16_MAX, 0, 0, q16_to_int(Q16_MAX), 32767, 0);
+  expect("q16_to_int", Q16_MIN, 0, 0, q16_to_int(Q16_MIN), -32768, 0);
+  expect("q16_to_int", Q16_MIN + 1, 0, 0, q16_to_int(Q16_MIN + 1), -32767, 0);
+  expect("q16_to_int", -Q16_ONE / 2 * 3, 0, 0, q16_to_int(-Q16_ONE / 2 * 3), -1, 0);
+  expect("q16_to_int", -1, 0, 0, q16_to_int(-1), 0, 0);
+  expect("Q16_CONST", 0, 0, 0, Q16_CONST(0.6f), 39322, 0);
+  expect("Q16_CONST", 0, 0, 0, Q16_CONST(-0.6f), -39322, 0);
+  for (int32_t n = -40000; n <= 40000; n += 7) {
+    expect("q16_from_int", n, 0, 0, q16_from_int(n), saturate_wide((wide_t)n * Q16_ONE), 0);
+    expect("q16_to_int", n * 53, 0, 0, q16_to_int(n * 53), (n * 53) / Q16_ONE, 0);
+  }
+
+  // fixed products, quotients and scalings at the limits
+  const int32_t an_edges[] = { 0, 1, -1, 2, -2, Q16_ONE, -Q16_ONE, Q16_ONE - 1, Q16_ONE + 1, 181 * Q16_ONE, -181 * Q16_ONE,
+                               46340, -46340, 1 << 30, -(1 << 30), INT32_MAX, INT32_MAX - 1, INT32_MIN, INT32_MIN + 1, 262143, -262143 };
+  const int32_t n_edges = sizeof(an_edges) / sizeof(an_edges[0]);
+  for (int32_t i = 0; i < n_edges; i++)
+    for (int32_t j = 0; j < n_edges; j++) {
+      check_mul(an_edges[i], an_edges[j]);
+      check_ratio(an_edges[i], an_edges[j]);
+      expect("q16_div", an_edges[i], an_edges[j], 0, q16_div(an_edges[i], an_edges[j]), q16_ratio(an_edges[i], an_edges[j]), 0);
+      for (int32_t k = 0; k < n_edges; k++)
+        check_mul_div(an_edges[i], an_edges[j], an_edges[k]);
+    }
+  // 64-bit numerators as spo2_beat_ratio forms them, 18-bit AC times 18-bit DC, and beyond the halving point
+  check_ratio((int64_t)262143 * 262143, 262143);
+  check_ratio((int64_t)262143 * 262143, (int64_t)262143 * 262143);
+  check_ratio(-((int64_t)262143 * 262143), (int64_t)262143 * 131071);
+  check_ratio((int64_t)1 << 46, (int64_t)1 << 40);
+  check_ratio(((int64_t)1 << 46) - 1, ((int64_t)1 << 40) + 3);
+  check_ratio(((int64_t)1 << 52) + 12345, ((int64_t)1 << 50) - 777);
+  check_ratio(-((int64_t)1 << 52), 3);
+  check_ratio((int64_t)1 << 52, 0);
+
+  srand(1);
+  for (int32_t r = 0; r < RANDOM_CASES; r++) {
+    int32_t n_a = edge_operand(), n_b = edge_operand(), n_c = edge_operand();
+    check_mul(n_a, n_b);
+    check_ratio(n_a, n_b);
+    check_ratio((int64_t)n_a * n_b, (int64_t)n_c * (rand() % 65536 + 1));
+    check_mul_div(n_a, n_b, n_c);
+  }
+  printf("%u checks, %u failed\n", un_checks, un_failures);
+  return un_failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/** \file fusion_bench.cpp **************************************************
+*
+* Description: Cost and accuracy of the three-channel beat vote
+*              (HR_calculation_fused, FUSION_VOTE in demo/spo2_algorithm.h)
+*              against the green-only HR_calculation_engine, for the AMPD and
+*              the spectral engine. The windows slide like in demo.ino
+*              (bufferLength 2048, hop 256) and the streaming beat detector
+*              on the clean green is the reference.
+*
+*              The captures in data/ hold the green channel only, so IR and
+*              red fall back to it and both paths must agree. With -a a
+*              motion-like artifact (a box of twice the pulse amplitude for
+*              150 ms every 1.7 s) is added to the green channel alone, which
+*              is the case the vote is meant for.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o fusion_bench fusion_bench.cpp ppg_record_reader.cpp ../demo/autocorr_engine.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/stage_timer.cpp ../demo/beat_detector.cpp ../demo/rolling_median.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   fusion_bench [-a] recording.ppg [recording.ppg ...]
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define TOLERANCE_BPM 5
+#define RUNS 4
+
+struct run_result {
+  const char* s_name;
+  uint8_t uch_engine;
+  bool b_fused;
+  uint32_t un_windows;
+  uint32_t un_invalid;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_error;
+  double f_seconds;
+};
+
+int main(int argc, char** argv)
+{
+  bool b_artifact = argc > 1 && strcmp(argv[1], "-a") == 0;
+  int n_first = b_artifact ? 2 : 1;
+  if (argc <= n_first) { fprintf(stderr, "usage: %s [-a] recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  run_result results[RUNS] = { { "AMPD green", HR_ENGINE_AMPD, false, 0, 0, 0, 0, 0, 0 },
+                               { "AMPD vote", HR_ENGINE_AMPD, true, 0, 0, 0, 0, 0, 0 },
+                               { "spectral green", HR_ENGINE_SPECTRAL, false, 0, 0, 0, 0, 0, 0 },
+                               { "spectral vote", HR_ENGINE_SPECTRAL, true, 0, 0, 0, 0, 0, 0 } };
+  int32_t an_peaks[16], an_valleys[16];
+  printf("%-40s %6s %5s %6s %6s %8s %8s\n", "recording", "sample", "ref", "AMPD", "vote", "spectral", "vote");
+  for (int i = n_first; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR), n_red = reader.find_channel(PPG_CHANNEL_RED);
+    int32_t n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = reader.window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = reader.window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+    std::vector<uint32_t> noisy(pun_green, pun_green + un_count);
+    if (b_artifact) {
+      uint32_t un_min = pun_green[0], un_max = pun_green[0];
+      for (uint32_t k = 0; k < un_count && k < (uint32_t)n_rate; k++) {
+        if (pun_green[k] < un_min) un_min = pun_green[k];
+        if (pun_green[k] > un_max) un_max = pun_green[k];
+      }
+      for (uint32_t k = 0; k < un_count; k++)
+        if (k % (n_rate * 17 / 10) < (uint32_t)n_rate * 15 / 100) noisy[k] += 2 * (un_max - un_min);
+    }
+    BeatDetector detector(n_rate, 15);
+    std::vector<uint32_t> green(WINDOW), ir(WINDOW), red(WINDOW);
+    for (uint32_t un_end = HOP - 1; un_end < un_count; un_end += HOP) {
+      for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+        detector.push(pun_green[k]);
+      if (un_end + 1 < WINDOW) continue;
+      int32_t n_reference = detector.heart_rate();
+      uint32_t un_first = un_end + 1 - WINDOW;
+      int32_t an_hr[RUNS];
+      for (int r = 0; r < RUNS; r++) {
+        run_result* p = &results[r];
+        green.assign(noisy.begin() + un_first, noisy.begin() + un_end + 1);
+        ir.assign(pun_ir + un_first, pun_ir + un_end + 1);
+        red.assign(pun_red + un_first, pun_red + un_end + 1);
+        int32_t n_num_peak, n_num_val, n_interval;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        if (p->b_fused)
+          an_hr[r] = HR_calculation_fused(p->uch_engine, &green[0], &ir[0], &red[0], WINDOW, an_peaks, &n_num_peak, 16, an_valleys, &n_num_val, 16,
+                                          n_rate, 15, NULL, &n_interval);
+        else
+          an_hr[r] = HR_calculation_engine(p->uch_engine, &green[0], WINDOW, an_peaks, &n_num_peak, 16, an_valleys, &n_num_val, 16, n_rate, 15, NULL, -1, &n_interval);
+        p->f_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        p->un_windows++;
+        if (an_hr[r] == 999) { p->un_invalid++; continue; }
+        if (n_reference == 999) continue;
+        int32_t n_error = abs(an_hr[r] - n_reference);
+        p->un_compared++;
+        p->f_abs_error += n_error;
+        if (n_error <= TOLERANCE_BPM) p->un_within++;
+      }
+      const char* s_name = strrchr(argv[i], '/');
+      printf("%-40.40s %6u %5d %6d %6d %8d %8d\n", s_name ? s_name + 1 : argv[i], un_end + 1, n_reference, an_hr[0], an_hr[1], an_hr[2], an_hr[3]);
+    }
+  }
+  printf("\nrun             windows  invalid  mean |error|  within %d bpm  us/window\n", TOLERANCE_BPM);
+  for (int r = 0; r < RUNS; r++) {
+    const run_result* p = &results[r];
+    printf("%-15s %7u %8u %13.1f %13.0f%% %10.0f\n", p->s_name, p->un_windows, p->un_invalid,
+           p->un_compared ? p->f_abs_error / p->un_compared : 0.0, p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0,
+           p->un_windows ? p->f_seconds * 1e6 / p->un_windows : 0.0);
+  }
+  return 0;
+}
@@ -0,0 +1,185 @@
+/** \file gain_sim.cpp ******************************************************
+*
+* Description: Automatic gain (demo/gain_controller.h) against the fixed
+*              setting, with a simulated sensor. The recordings were taken
+*              at amplitude 0x1F and range 4096 nA; the sensor scales them
+*              by a perfusion factor, the LED amplitude and the range,
+*              keeps the 15-bit resolution of pulse width 69 (8 counts) and
+*              clips at the 18-bit ceiling. The streaming loop of demo.ino
+*              is replayed: one hop (256 samples) at a time into the beat
+*              detector, signal_quality on the part of the window recorded
+*              with the current setting, and with automatic gain an update
+*              after each hop that blanks the detector on a step. Reported
+*              per factor: share of hops passing signal_quality, mean
+*              |heart rate - detector on the unscaled recording| and share
+*              within 5 bpm over those hops, gain steps and the final
+*              setting. The counts are taken as proportional to the LED
+*              current; a real finger adds ambient light and a nonlinear
+*              LED, so the steps land less exactly.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o gain_sim gain_sim.cpp ppg_record_reader.cpp ../demo/gain_controller.cpp
+*              ../demo/beat_detector.cpp ../demo/rolling_median.cpp ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/stage_timer.cpp ../demo/slope_detector.cpp
+*              ../demo/peak_valley_detector.cpp
+* Usage:   gain_sim [-s factor,factor,...] recording.ppg [recording.ppg ...]
+*
+* Only the green channel is used, IR and red see the same signal.
+*
+* Exits with 1 if automatic gain scores below the fixed setting at any
+* factor: a smaller share of hops passing signal_quality, or of them
+* within 5 bpm.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "gain_controller.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define MIN_EVALUATED (WINDOW / 2) // warmupLengths[0] of demo.ino
+#define TOLERANCE_BPM 5
+#define RECORDED_AMPLITUDE 0x1F
+#define RECORDED_RANGE 4096
+#define ADC_CEILING ((1L << 18) - 1)
+#define ADC_LSB 8 // 15-bit resolution at pulse width 69, left-justified in 18 bits
+
+class SimSensor: public GainSensor {
+ public:
+  SimSensor(): un_applied(0) { setting.uw_adc_range = RECORDED_RANGE; for (int c = 0; c < GAIN_CHANNELS; c++) setting.auch_amplitude[c] = RECORDED_AMPLITUDE; }
+  void apply(const gain_setting& new_setting) { setting = new_setting; un_applied++; }
+  bool ambient_overflow(void) { return false; }
+
+  // counts of a recorded sample under the current setting
+  uint32_t sample(uint32_t un_recorded, double f_factor, int32_t n_channel) const {
+    double f_x = un_recorded * f_factor * setting.auch_amplitude[n_channel] / RECORDED_AMPLITUDE * RECORDED_RANGE / setting.uw_adc_range;
+    if (f_x >= ADC_CEILING) return ADC_CEILING;
+    return (uint32_t)f_x / ADC_LSB * ADC_LSB;
+  }
+
+  gain_setting setting;
+  uint32_t un_applied;
+};
+
+struct run_result {
+  uint32_t un_hops;
+  uint32_t un_ok;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_diff;
+  uint32_t un_steps;
+  gain_setting last;
+};
+
+// streaming loop of demo.ino over one recording, reference: detector heart rate on the unscaled samples after each hop
+static void run(const uint32_t* pun_green, uint32_t un_count, int32_t n_rate, double f_factor, bool b_auto,
+                const std::vector<int32_t>& reference, run_result* p_result)
+{
+  SimSensor sensor;
+  GainController controller(&sensor);
+  controller.begin(RECORDED_AMPLITUDE, RECORDED_RANGE);
+  BeatDetector detector(n_rate, 15);
+  std::vector<uint32_t> green(un_count), ir(un_count), red(un_count);
+  uint32_t un_step_index = 0;
+  signal_quality_info quality_info;
+  for (uint32_t un_end = 0; un_end + HOP <= un_count; ) {
+    uint32_t un_length = un_end == 0 ? WINDOW : HOP; // warm-up fills a whole window first
+    if (un_end + un_length > un_count) break;
+    for (uint32_t k = un_end; k < un_end + un_length; k++) {
+      red[k] = sensor.sample(pun_green[k], f_factor, GAIN_RED);
+      ir[k] = sensor.sample(pun_green[k], f_factor, GAIN_IR);
+      green[k] = sensor.sample(pun_green[k], f_factor, GAIN_GREEN);
+      detector.push(green[k]);
+    }
+    un_end += un_length;
+    uint32_t un_since = un_end - un_step_index;
+    int32_t n_window = un_since < WINDOW ? (int32_t)un_since : WINDOW;
+    if (n_window >= MIN_EVALUATED) {
+      uint32_t un_first = un_end - n_window;
+      uint8_t uch_quality = signal_quality(&green[un_first], &ir[un_first], &red[un_first], n_window, n_rate, &quality_info);
+      p_result->un_hops++;
+      int32_t n_hr = detector.heart_rate();
+      int32_t n_ref = reference[un_end / HOP];
+      if (uch_quality == SIGNAL_OK) {
+        p_result->un_ok++;
+        if (n_hr != 999 && n_ref != 999) {
+          int32_t n_diff = abs(n_hr - n_ref);
+          p_result->un_compared++;
+          p_result->f_abs_diff += n_diff;
+          if (n_diff <= TOLERANCE_BPM) p_result->un_within++;
+        }
+      }
+    } else
+      p_result->un_hops++; // not evaluated, the device keeps its last result
+    if (b_auto && controller.update(&red[un_end - HOP], &ir[un_end - HOP], &green[un_end - HOP], HOP)) {
+      un_step_index = un_end;
+      detector.blank(GainController::settle_samples(n_rate));
+    }
+  }
+  p_result->un_steps += controller.steps();
+  p_result->last = controller.setting();
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<double> factors;
+  int i = 1;
+  if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+    for (char* p = strtok(argv[i + 1], ","); p; p = strtok(NULL, ","))
+      factors.push_back(atof(p));
+    i += 2;
+  }
+  if (factors.empty()) { double d[] = { 0.6, 1, 8, 24, 40 }; factors.assign(d, d + 5); }
+  if (i >= argc) { fprintf(stderr, "usage: %s [-s factor,factor,...] recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+
+  std::vector<run_result> fixed(factors.size()), automatic(factors.size());
+  memset(&fixed[0], 0, fixed.size() * sizeof(run_result));
+  memset(&automatic[0], 0, automatic.size() * sizeof(run_result));
+  for (; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+
+    std::vector<int32_t> reference(un_count / HOP + 1, 999);
+    BeatDetector detector(n_rate, 15);
+    for (uint32_t k = 0; k < un_count; k++) {
+      detector.push(pun_green[k]);
+      if ((k + 1) % HOP == 0) reference[(k + 1) / HOP] = detector.heart_rate();
+    }
+    for (size_t f = 0; f < factors.size(); f++) {
+      run(pun_green, un_count, n_rate, factors[f], false, reference, &fixed[f]);
+      run(pun_green, un_count, n_rate, factors[f], true, reference, &automatic[f]);
+    }
+  }
+
+  printf("factor  gain   hops  signal ok  mean |diff|  within %d bpm  steps  final red/IR/green, range\n", TOLERANCE_BPM);
+  bool b_ok = true;
+  for (size_t f = 0; f < factors.size(); f++) {
+    for (int m = 0; m < 2; m++) {
+      const run_result* p = m ? &automatic[f] : &fixed[f];
+      printf("%6.2f  %-5s %5u %9.0f%% %12.1f %13.0f%% %6u  0x%02X/0x%02X/0x%02X, %u nA\n", factors[f], m ? "auto" : "fixed", p->un_hops,
+             p->un_hops ? 100.0 * p->un_ok / p->un_hops : 0.0, p->un_compared ? p->f_abs_diff / p->un_compared : 0.0,
+             p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0, p->un_steps,
+             p->last.auch_amplitude[GAIN_RED], p->last.auch_amplitude[GAIN_IR], p->last.auch_amplitude[GAIN_GREEN], p->last.uw_adc_range);
+    }
+    // cross-multiplied shares, the hop counts of both runs are equal
+    const run_result* p_fixed = &fixed[f];
+    const run_result* p_auto = &automatic[f];
+    if (p_auto->un_ok < p_fixed->un_ok ||
+        (uint64_t)p_auto->un_within * p_fixed->un_compared < (uint64_t)p_fixed->un_within * p_auto->un_compared) {
+      printf("%6.2f  automatic gain scores below the fixed setting\n", factors[f]);
+      b_ok = false;
+    }
+  }
+  return b_ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+/** \file Arduino.h *********************************************************
+*
+* Description: The few Arduino definitions spo2_algorithm.cpp uses, so the
+*              host tools can build it unchanged: add -Ihost before the
+*              demo directory. Serial output is dropped unless
+*              host_serial_verbose is set, delay() returns at once.
+*
+* ------------------------------------------------------------------------- */
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <algorithm>
+
+#define DEC 10
+#define F(x) x
+typedef uint8_t byte;
+using std::min;
+using std::max;
+
+inline bool host_serial_verbose = false;
+
+class HostSerial {
+ public:
+  void printf(const char* s_format, ...)
+  {
+    if (!host_serial_verbose) return;
+    va_list args;
+    va_start(args, s_format);
+    vprintf(s_format, args);
+    va_end(args);
+  }
+  void print(const char* s) { if (host_serial_verbose) fputs(s, stdout); }
+  void print(long n, int = DEC) { if (host_serial_verbose) ::printf("%ld", n); }
+  void println(const char* s = "") { if (host_serial_verbose) puts(s); }
+  void println(long n, int = DEC) { if (host_serial_verbose) ::printf("%ld\n", n); }
+};
+
+inline HostSerial Serial;
+
+inline void delay(unsigned long) {}
+
+#endif /* HOST_ARDUINO_H_ */
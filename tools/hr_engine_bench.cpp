@@ -0,0 +1,185 @@
+/** \file hr_engine_bench.cpp ***********************************************
+*
+* Description: Compare the HR engines behind HR_calculation (hr_engine_kind
+*              in demo/spo2_algorithm.h) on recordings: run time per window
+*              and agreement with the streaming beat detector, replayed over
+*              the same samples, as the reference. The windows slide like in
+*              demo.ino (bufferLength 2048, hop 256). The captures carry no
+*              ground truth, only the markers of earlier AMPD runs, so the
+*              detector stands in for it. The time per window includes the
+*              preprocessing the window engines share. The last row is the
+*              autocorr engine the way heart_rate_and_oxygen_saturation runs
+*              it with a PipelineController: each hop is pushed into the
+*              controller's persistent engine and the window takes its rate
+*              from autocorr_rate() instead of a fresh engine.
+*              With -s the engines run on synthetic recordings instead,
+*              where the heart rate is known: 40 s of green at 400 sps for
+*              each rate of SYNTH_RATES bpm, a systolic wave with a
+*              dicrotic wave, +-4 % respiratory variation of the beat
+*              intervals, a slow baseline wander and noise of SYNTH_NOISE
+*              counts. The reference of a window is the number of beats it
+*              spans, so the detector is compared like the engines. This
+*              is what hr_engine in spo2_algorithm.cpp is chosen on.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o hr_engine_bench hr_engine_bench.cpp ppg_record_reader.cpp ../demo/autocorr_engine.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/stage_timer.cpp ../demo/beat_detector.cpp ../demo/rolling_median.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   hr_engine_bench recording.ppg [recording.ppg ...]
+*          hr_engine_bench -s
+*
+* ------------------------------------------------------------------------- */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino.h"
+#include "autocorr_engine.h"
+#include "beat_detector.h"
+#include "pipeline_controller.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define TOLERANCE_BPM 5
+#define ENGINES 5
+#define ROWS (ENGINES + 1)
+#define SYNTH_RATE 400 // sps
+#define SYNTH_SECONDS 40
+#define SYNTH_DC 60000
+#define SYNTH_MODULATION 0.03 // AC/DC of the green pulse
+#define SYNTH_NOISE 50 // +- counts
+#define SYNTH_RATES 45, 60, 72, 90, 120, 150, 180 // bpm
+
+struct engine_result {
+  const char* s_name;
+  uint8_t uch_engine;
+  uint32_t un_windows;
+  uint32_t un_invalid;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_error;
+  double f_seconds;
+};
+
+// replays one green channel hop by hop and adds each window to results; pf_phase holds the beat phase at every sample
+// (known heart rate, see synthesize()), NULL takes the streaming detector as the reference
+static void bench(const char* s_name, const uint32_t* pun_green, uint32_t un_count, int32_t n_rate, const double* pf_phase,
+                  engine_result* results)
+{
+  int32_t an_peaks[16], an_valleys[16];
+  BeatDetector detector(n_rate, 15);
+  PipelineController* p_controller = new PipelineController();
+  p_controller->autocorr_rate(0, n_rate, WINDOW); // allocates the green engine
+  std::vector<uint32_t> window(WINDOW);
+  for (uint32_t un_end = HOP - 1; un_end < un_count; un_end += HOP) {
+    for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+      detector.push(pun_green[k]);
+    std::chrono::steady_clock::time_point t_hop = std::chrono::steady_clock::now();
+    for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+      p_controller->push_sample(pun_green[k], pun_green[k], pun_green[k]);
+    double f_hop = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_hop).count();
+    if (un_end + 1 < WINDOW) continue;
+    int32_t an_hr[ROWS + 1];
+    {
+      window.assign(pun_green + un_end + 1 - WINDOW, pun_green + un_end + 1);
+      int32_t n_num_peak, n_num_val, n_interval;
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      an_hr[ENGINES] = HR_calculation_engine(HR_ENGINE_AUTOCORR, &window[0], WINDOW, an_peaks, &n_num_peak, 16, an_valleys, &n_num_val, 16,
+                                             n_rate, 15, NULL, p_controller->autocorr_rate(0, n_rate, WINDOW), &n_interval);
+      f_hop += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    an_hr[ROWS] = detector.heart_rate();
+    int32_t n_reference = an_hr[ROWS];
+    if (pf_phase != NULL) // beats spanned by the window, rounded to bpm
+      n_reference = (int32_t)floor((pf_phase[un_end] - pf_phase[un_end + 1 - WINDOW]) * 60.0 * n_rate / (WINDOW - 1) + 0.5);
+    results[ENGINES].f_seconds += f_hop;
+    for (int e = 0; e < ROWS + (pf_phase != NULL); e++) {
+      if (e < ENGINES) {
+        // HR_calculation works in place on a copy, the engines get the same window
+        window.assign(pun_green + un_end + 1 - WINDOW, pun_green + un_end + 1);
+        int32_t n_num_peak, n_num_val, n_interval;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        an_hr[e] = HR_calculation_engine(results[e].uch_engine, &window[0], WINDOW, an_peaks, &n_num_peak, 16, an_valleys, &n_num_val, 16, n_rate, 15, NULL, -1, &n_interval);
+        results[e].f_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      }
+      results[e].un_windows++;
+      if (an_hr[e] == 999) { results[e].un_invalid++; continue; }
+      if (n_reference == 999) continue;
+      int32_t n_error = abs(an_hr[e] - n_reference);
+      results[e].un_compared++;
+      results[e].f_abs_error += n_error;
+      if (n_error <= TOLERANCE_BPM) results[e].un_within++;
+    }
+    printf("%-40.40s %6u %10d %6d %8d %8d %6d %6d %8d\n", s_name, un_end + 1, n_reference, an_hr[0], an_hr[1], an_hr[2],
+           an_hr[3], an_hr[4], an_hr[5]);
+  }
+  delete p_controller;
+}
+
+// pulse shape at phase 0..1 of a beat: systolic wave and a smaller dicrotic wave
+static double pulse(double f_phase)
+{
+  double f_systolic = (f_phase - 0.2) / 0.08, f_dicrotic = (f_phase - 0.5) / 0.1;
+  return exp(-f_systolic * f_systolic) + 0.4 * exp(-f_dicrotic * f_dicrotic);
+}
+
+// green channel of a recording at n_bpm, the raw samples drop with the blood volume pulse; *p_phase gets the beat phase
+static void synthesize(int32_t n_bpm, std::vector<uint32_t>* p_green, std::vector<double>* p_phase)
+{
+  uint32_t un_count = SYNTH_SECONDS * SYNTH_RATE, un_seed = (uint32_t)n_bpm;
+  p_green->resize(un_count);
+  p_phase->resize(un_count);
+  double f_phase = 0;
+  for (uint32_t k = 0; k < un_count; k++) {
+    double f_t = (double)k / SYNTH_RATE;
+    (*p_phase)[k] = f_phase;
+    un_seed = un_seed * 1103515245u + 12345u;
+    int32_t n_noise = (int32_t)((un_seed >> 16) % (2 * SYNTH_NOISE + 1)) - SYNTH_NOISE;
+    double f_wander = 0.01 * sin(2 * M_PI * 0.05 * f_t);
+    (*p_green)[k] = (uint32_t)(SYNTH_DC * (1 + f_wander - SYNTH_MODULATION * pulse(f_phase - floor(f_phase))) + n_noise);
+    f_phase += n_bpm / 60.0 * (1 + 0.04 * sin(2 * M_PI * 0.25 * f_t)) / SYNTH_RATE; // 15 breaths per minute
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...] | -s\n", argv[0]); return 2; }
+  bool b_synthetic = strcmp(argv[1], "-s") == 0;
+  engine_result results[ROWS + 1] = { { "AMPD", HR_ENGINE_AMPD, 0, 0, 0, 0, 0, 0 }, { "spectral", HR_ENGINE_SPECTRAL, 0, 0, 0, 0, 0, 0 },
+                                      { "autocorr", HR_ENGINE_AUTOCORR, 0, 0, 0, 0, 0, 0 }, { "slope", HR_ENGINE_SLOPE, 0, 0, 0, 0, 0, 0 },
+                                      { "peak-valley", HR_ENGINE_PEAK_VALLEY, 0, 0, 0, 0, 0, 0 },
+                                      { "autocorr/hop", 0, 0, 0, 0, 0, 0, 0 }, { "detector", 0, 0, 0, 0, 0, 0, 0 } };
+  printf("%-40s %6s %10s %6s %8s %8s %6s %6s %8s\n", "recording", "sample", "reference", "AMPD", "spectral", "autocorr", "slope", "pv", "/hop");
+  if (b_synthetic) {
+    const int32_t an_rates[] = { SYNTH_RATES };
+    for (size_t r = 0; r < sizeof(an_rates) / sizeof(an_rates[0]); r++) {
+      std::vector<uint32_t> green;
+      std::vector<double> phase;
+      synthesize(an_rates[r], &green, &phase);
+      char s_name[32];
+      snprintf(s_name, sizeof(s_name), "synthetic %d bpm", an_rates[r]);
+      bench(s_name, &green[0], (uint32_t)green.size(), SYNTH_RATE, &phase[0], results);
+    }
+  }
+  for (int i = b_synthetic ? argc : 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    uint32_t un_count = reader.header()->un_sample_count;
+    const char* s_name = strrchr(argv[i], '/');
+    bench(s_name ? s_name + 1 : argv[i], reader.window(n_green, 0, un_count).pun_data, un_count, reader.header()->un_sampling_rate, NULL, results);
+  }
+  printf("\nengine        windows  invalid  mean |error|  within %d bpm  us/window\n", TOLERANCE_BPM);
+  for (int e = 0; e < ROWS + b_synthetic; e++) {
+    const engine_result* p = &results[e];
+    printf("%-13s %7u %8u %13.1f %13.0f%% %10.0f\n", p->s_name, p->un_windows, p->un_invalid,
+           p->un_compared ? p->f_abs_error / p->un_compared : 0.0, p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0,
+           p->un_windows ? p->f_seconds * 1e6 / p->un_windows : 0.0);
+  }
+  return 0;
+}
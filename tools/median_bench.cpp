@@ -0,0 +1,161 @@
+/** \file median_bench.cpp **************************************************
+*
+* Description: Compare small_median() (demo/small_median.h) with the
+*              insertion sort it replaces, maxim_sort_ascend followed by
+*              the middle read, at every size 1 to 64. Sizes up to 25 are
+*              the median filter (filter_size 5 to 25, the first samples of
+*              a window use 1 to filter_size - 1), the peak interval and R
+*              ratio medians go up to CONTROLLER_MAX_CAPACITY (64, typically
+*              8 to 16); above MEDIAN_NETWORK_MAX quickselect takes over.
+*              Two inputs:
+*              - random: uniform values, the worst case of the insertion
+*                sort;
+*              - recorded: consecutive samples of the recordings in the
+*                rotated order of the median filter ring, nearly sorted
+*                runs, the case the filter actually sees.
+*              Each input is copied and reduced by both, the results must
+*              be equal, ns per median is printed. median_filter itself is
+*              then timed over the recordings against the sort-based
+*              filter it replaces, at the filter sizes of
+*              PipelineController, and both outputs compared.
+*              The exit status is 1 if any result differed.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o median_bench median_bench.cpp ppg_record_reader.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp ../demo/pipeline_controller.cpp
+*              ../demo/bandpass_filter.cpp ../demo/stage_timer.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   median_bench recording.ppg [recording.ppg ...]
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino.h"
+#include "median_networks.h"
+#include "pipeline_controller.h"
+#include "ppg_record_reader.h"
+#include "small_median.h"
+#include "spo2_algorithm.h"
+
+#define MAX_SIZE 64
+#define INPUTS 4096   // inputs per size, cycled
+#define REPEATS 64    // passes over them per timing
+#define WINDOW 2048
+#define FILTER_RUNS 8 // passes of median_filter per recording and size
+
+static int32_t sorted_median(int32_t* pn_x, int32_t n_size)
+{
+  maxim_sort_ascend(pn_x, n_size);
+  return n_size % 2 ? pn_x[(n_size - 1) / 2] : (pn_x[n_size / 2 - 1] + pn_x[n_size / 2]) / 2;
+}
+
+// median_filter as it was, sorting a copy of the ring per sample
+static void sorted_median_filter(int32_t* pn_x, int32_t n_length, int32_t n_filter_size)
+{
+  std::vector<int32_t> ring(n_filter_size), copy(n_filter_size);
+  for (int32_t k = 0; k < n_length; k++) {
+    int32_t n_actual = k + 1 < n_filter_size ? k + 1 : n_filter_size;
+    ring[k % n_filter_size] = pn_x[k];
+    memcpy(&copy[0], &ring[0], n_actual * sizeof(int32_t));
+    if (k > 0) pn_x[k] = sorted_median(&copy[0], n_actual);
+  }
+}
+
+// ns per median of each method over inputs laid out n_size apart; false if a result differs
+static bool time_size(const std::vector<int32_t>& inputs, int32_t n_size, double* pf_sort_ns, double* pf_median_ns)
+{
+  std::vector<int32_t> scratch(n_size);
+  std::vector<int32_t> expected(INPUTS);
+  volatile int32_t n_sink = 0;
+  bool b_same = true;
+  for (int32_t r = 0; r < INPUTS; r++) {
+    memcpy(&scratch[0], &inputs[r * n_size], n_size * sizeof(int32_t));
+    expected[r] = sorted_median(&scratch[0], n_size);
+    memcpy(&scratch[0], &inputs[r * n_size], n_size * sizeof(int32_t));
+    if (small_median(&scratch[0], n_size) != expected[r]) b_same = false;
+  }
+  for (int32_t m = 0; m < 2; m++) {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int32_t p = 0; p < REPEATS; p++)
+      for (int32_t r = 0; r < INPUTS; r++) {
+        memcpy(&scratch[0], &inputs[r * n_size], n_size * sizeof(int32_t));
+        n_sink += m == 0 ? sorted_median(&scratch[0], n_size) : small_median(&scratch[0], n_size);
+      }
+    double f_ns = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() * 1e9 / ((double)REPEATS * INPUTS);
+    *(m == 0 ? pf_sort_ns : pf_median_ns) = f_ns;
+  }
+  return b_same;
+}
+
+static const char* call_sites(int32_t n_size)
+{
+  if (n_size <= CONTROLLER_MAX_FILTER) return "filter, interval, ratio";
+  return n_size <= MEDIAN_NETWORK_MAX ? "interval, ratio" : "interval, ratio (quickselect)";
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  std::vector<uint32_t> samples;
+  for (int i = 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    ppg_span green = reader.window(n_green, 0, reader.header()->un_sample_count);
+    samples.insert(samples.end(), green.pun_data, green.pun_data + green.un_length);
+  }
+  if (samples.size() < WINDOW + MAX_SIZE) { fprintf(stderr, "recordings too short\n"); return 1; }
+
+  bool b_ok = true;
+  srand(1);
+  printf("size  comparators  random: sort ns  median ns  speedup  recorded: sort ns  median ns  speedup  used by\n");
+  for (int32_t n_size = 1; n_size <= MAX_SIZE; n_size++) {
+    std::vector<int32_t> random(INPUTS * n_size), recorded(INPUTS * n_size);
+    for (size_t i = 0; i < random.size(); i++)
+      random[i] = rand() % 65536 - 32768;
+    for (int32_t r = 0; r < INPUTS; r++) { // window at a random position, rotated like the filter ring
+      uint32_t un_first = (uint32_t)(rand() % (samples.size() - n_size));
+      int32_t n_head = rand() % n_size;
+      for (int32_t i = 0; i < n_size; i++)
+        recorded[r * n_size + (n_head + i) % n_size] = 9300 - (int32_t)samples[un_first + i]; // DC removed and inverted
+    }
+    double f_random_sort, f_random_median, f_recorded_sort, f_recorded_median;
+    bool b_same = time_size(random, n_size, &f_random_sort, &f_random_median);
+    b_same = time_size(recorded, n_size, &f_recorded_sort, &f_recorded_median) && b_same;
+    if (!b_same) b_ok = false;
+    char s_comparators[16] = "-";
+    if (n_size <= MEDIAN_NETWORK_MAX) snprintf(s_comparators, sizeof(s_comparators), "%d", median_network_start[n_size + 1] - median_network_start[n_size]);
+    printf("%4d  %11s  %15.1f  %9.1f  %6.2fx  %17.1f  %9.1f  %6.2fx  %s%s\n", n_size, s_comparators, f_random_sort, f_random_median,
+           f_random_sort / f_random_median, f_recorded_sort, f_recorded_median, f_recorded_sort / f_recorded_median, call_sites(n_size),
+           b_same ? "" : "  MISMATCH");
+  }
+
+  printf("\nmedian_filter over %d-sample windows\nfilter  sort us/window  median us/window  speedup\n", WINDOW);
+  const int32_t an_filter_sizes[] = { 5, 9, 15, 21, 25 };
+  for (size_t f = 0; f < sizeof(an_filter_sizes) / sizeof(an_filter_sizes[0]); f++) {
+    int32_t n_filter_size = an_filter_sizes[f];
+    double af_seconds[2] = { 0, 0 };
+    uint32_t un_windows = 0;
+    std::vector<int32_t> before(WINDOW), after(WINDOW);
+    for (int32_t p = 0; p < FILTER_RUNS; p++)
+      for (size_t un_first = 0; un_first + WINDOW <= samples.size(); un_first += WINDOW, un_windows++) {
+        for (int32_t k = 0; k < WINDOW; k++)
+          before[k] = after[k] = 9300 - (int32_t)samples[un_first + k];
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        sorted_median_filter(&before[0], WINDOW, n_filter_size);
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        median_filter(&after[0], WINDOW, n_filter_size);
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+        af_seconds[0] += std::chrono::duration<double>(t1 - t0).count();
+        af_seconds[1] += std::chrono::duration<double>(t2 - t1).count();
+        if (memcmp(&before[0], &after[0], WINDOW * sizeof(int32_t)) != 0) b_ok = false;
+      }
+    printf("%6d  %14.1f  %16.1f  %6.2fx\n", n_filter_size, af_seconds[0] * 1e6 / un_windows, af_seconds[1] * 1e6 / un_windows,
+           af_seconds[0] / af_seconds[1]);
+  }
+  printf("\n%s\n", b_ok ? "all results identical" : "RESULTS DIFFER");
+  return b_ok ? 0 : 1;
+}
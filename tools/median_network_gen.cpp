@@ -0,0 +1,131 @@
+/** \file median_network_gen.cpp ********************************************
+*
+* Description: Generates demo/median_networks.h, the comparator tables of
+*              small_median.h. For each size up to MEDIAN_NETWORK_MAX it
+*              builds Batcher's merge-exchange sorting network (Knuth,
+*              TAOCP 5.2.2, algorithm M, valid for any size) and prunes it
+*              for the median: walking backwards from the middle position
+*              (both middle positions for even sizes), a comparator is kept
+*              only if one of its positions is still needed. Every pruned
+*              network is checked against all 0-1 inputs up to size 20 and
+*              random inputs above (0-1 principle) before anything is
+*              written.
+*
+* Build:   g++ -O2 -std=c++17 -o median_network_gen median_network_gen.cpp
+* Usage:   median_network_gen > ../demo/median_networks.h
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#define MEDIAN_NETWORK_MAX 32
+#define EXHAUSTIVE_MAX 20 // 2^20 0-1 inputs
+#define RANDOM_CHECKS 200000
+
+typedef std::vector<std::pair<int, int> > network;
+
+static network merge_exchange(int n)
+{
+  network pairs;
+  if (n < 2) return pairs;
+  int t = 0;
+  while ((1 << t) < n) t++;
+  for (int p = 1 << (t - 1); p > 0; p /= 2) {
+    int q = 1 << (t - 1), r = 0, d = p;
+    for (;;) {
+      for (int i = 0; i < n - d; i++)
+        if ((i & p) == r) pairs.push_back(std::make_pair(i, i + d));
+      if (q == p) break;
+      d = q - p;
+      q /= 2;
+      r = p;
+    }
+  }
+  return pairs;
+}
+
+static network prune_for_median(int n, const network& pairs)
+{
+  std::vector<bool> needed(n, false);
+  needed[n / 2] = true;
+  if (n % 2 == 0 && n > 0) needed[n / 2 - 1] = true;
+  network kept;
+  for (int k = (int)pairs.size() - 1; k >= 0; k--) {
+    int a = pairs[k].first, b = pairs[k].second;
+    if (!needed[a] && !needed[b]) continue;
+    kept.push_back(pairs[k]);
+    needed[a] = needed[b] = true;
+  }
+  std::reverse(kept.begin(), kept.end());
+  return kept;
+}
+
+static bool selects_median(int n, const network& pairs, const std::vector<int32_t>& input)
+{
+  std::vector<int32_t> x(input), sorted(input);
+  for (size_t k = 0; k < pairs.size(); k++)
+    if (x[pairs[k].first] > x[pairs[k].second]) std::swap(x[pairs[k].first], x[pairs[k].second]);
+  std::sort(sorted.begin(), sorted.end());
+  return x[n / 2] == sorted[n / 2] && (n % 2 || x[n / 2 - 1] == sorted[n / 2 - 1]);
+}
+
+int main(void)
+{
+  std::vector<network> networks(MEDIAN_NETWORK_MAX + 1);
+  srand(1);
+  for (int n = 1; n <= MEDIAN_NETWORK_MAX; n++) {
+    networks[n] = prune_for_median(n, merge_exchange(n));
+    std::vector<int32_t> input(n);
+    if (n <= EXHAUSTIVE_MAX) {
+      for (uint32_t bits = 0; bits < (1u << n); bits++) {
+        for (int i = 0; i < n; i++) input[i] = (bits >> i) & 1;
+        if (!selects_median(n, networks[n], input)) { fprintf(stderr, "size %d fails for 0-1 input %x\n", n, bits); return 1; }
+      }
+    } else {
+      for (int r = 0; r < RANDOM_CHECKS; r++) {
+        for (int i = 0; i < n; i++) input[i] = rand() % 4;
+        if (!selects_median(n, networks[n], input)) { fprintf(stderr, "size %d fails for a random input\n", n); return 1; }
+      }
+    }
+  }
+
+  printf("/** \\file median_networks.h ************************************************\n");
+  printf("*\n");
+  printf("* Description: Median selection networks for sizes 1 to %d, generated by\n", MEDIAN_NETWORK_MAX);
+  printf("*              tools/median_network_gen (Batcher's merge-exchange network\n");
+  printf("*              pruned to the comparators the middle positions depend on).\n");
+  printf("*              Do not edit, regenerate instead. Only small_median.cpp\n");
+  printf("*              includes it.\n");
+  printf("*\n");
+  printf("* --------------------------------------------------------------------\n");
+  printf("*\n");
+  printf("* This code follows the naming conventions of spo2_algorithm.h\n");
+  printf("*\n");
+  printf("* ------------------------------------------------------------------------- */\n");
+  printf("#ifndef MEDIAN_NETWORKS_H_\n#define MEDIAN_NETWORKS_H_\n\n#include <stdint.h>\n\n");
+  printf("#define MEDIAN_NETWORK_MAX %d\n\n", MEDIAN_NETWORK_MAX);
+  printf("// comparators of size n: median_network_pairs[median_network_start[n]] up to median_network_start[n + 1]\n");
+  printf("static const uint16_t median_network_start[MEDIAN_NETWORK_MAX + 2] = {");
+  uint32_t un_start = 0;
+  for (int n = 0; n <= MEDIAN_NETWORK_MAX + 1; n++) {
+    printf("%s%u", n ? ", " : "", un_start);
+    if (n >= 1 && n <= MEDIAN_NETWORK_MAX) un_start += (uint32_t)networks[n].size();
+  }
+  printf("};\n\n");
+  printf("// lower and upper position of each comparator\n");
+  printf("static const uint8_t median_network_pairs[%u][2] = {\n", un_start);
+  for (int n = 1; n <= MEDIAN_NETWORK_MAX; n++) {
+    if (networks[n].empty()) continue;
+    printf("  // %d: %u comparators\n ", n, (unsigned)networks[n].size());
+    for (size_t k = 0; k < networks[n].size(); k++) {
+      if (k > 0 && k % 12 == 0) printf("\n ");
+      printf(" {%d, %d},", networks[n][k].first, networks[n][k].second);
+    }
+    printf("\n");
+  }
+  printf("};\n\n#endif /* MEDIAN_NETWORKS_H_ */\n");
+  return 0;
+}
@@ -0,0 +1,189 @@
+/** \file notify_check.cpp **************************************************
+*
+* Description: Drive NotifyScheduler (demo/notify_scheduler.h) on a fake
+*              clock against a fake BLE characteristic, which records every
+*              notification with its time and bytes, refuses them while
+*              disconnected and rejects any longer than its payload (the
+*              negotiated ATT MTU - 3, 20 by default). poll() is called
+*              every POLL_MS like from the sampling loop. Each scenario
+*              states the notification times and values it expects:
+*              - a result changing every 100 ms: one packet per
+*                min interval, each with the newest result;
+*              - a constant result: the first packet at once, then one per
+*                max interval as keepalive;
+*              - a change after a quiet period: sent at the next poll;
+*              - a client connecting late: nothing while disconnected,
+*                the newest result right after the connection;
+*              - millis() wrapping around during a session;
+*              - the PLX packet layout for every quality code and for 999.
+*              The exit status is 1 if any count, order, time, value or
+*              size differed.
+*
+* Build:   g++ -O2 -std=c++17 -I../demo -o notify_check notify_check.cpp ../demo/notify_scheduler.cpp
+* Usage:   notify_check
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "notify_scheduler.h"
+
+#define MIN_INTERVAL_MS 1000 // the resultScheduler settings of demo.ino
+#define MAX_INTERVAL_MS 5000
+#define POLL_MS 1
+#define DEFAULT_PAYLOAD 20   // ATT MTU 23 - 3
+
+struct notification {
+  uint32_t un_time_ms;
+  std::vector<uint8_t> bytes;
+};
+
+// what the central would see on percentage_characteristic
+class FakeCharacteristic: public NotifySink {
+ public:
+  FakeCharacteristic(void) : b_connected(true), uw_payload(DEFAULT_PAYLOAD), un_now_ms(0), un_oversized(0) {}
+  bool notify(const uint8_t* puch_data, uint16_t uw_length)
+  {
+    if (!b_connected) return false;
+    if (uw_length > uw_payload) { un_oversized++; return false; }
+    notification n;
+    n.un_time_ms = un_now_ms;
+    n.bytes.assign(puch_data, puch_data + uw_length);
+    sent.push_back(n);
+    return true;
+  }
+  bool b_connected;
+  uint16_t uw_payload;
+  uint32_t un_now_ms;
+  uint32_t un_oversized;
+  std::vector<notification> sent;
+};
+
+struct expected {
+  uint32_t un_time_ms;
+  int32_t n_heart_rate, n_spo2;
+  uint8_t uch_quality;
+};
+
+static uint32_t un_failures = 0;
+
+static void fail(const char* s_scenario, const char* s_format, int32_t n_a, int32_t n_b)
+{
+  un_failures++;
+  printf("%s: ", s_scenario);
+  printf(s_format, n_a, n_b);
+  printf("\n");
+}
+
+static void compare(const char* s_scenario, const FakeCharacteristic& sink, const std::vector<expected>& want)
+{
+  uint32_t un_before = un_failures;
+  if (sink.un_oversized) fail(s_scenario, "%d notifications longer than the %d byte payload", sink.un_oversized, sink.uw_payload);
+  if (sink.sent.size() != want.size()) fail(s_scenario, "%d notifications, expected %d", (int32_t)sink.sent.size(), (int32_t)want.size());
+  for (size_t i = 0; i < sink.sent.size() && i < want.size(); i++) {
+    uint8_t auch_packet[PLX_PACKET_SIZE];
+    uint16_t uw_length = NotifyScheduler::build_plx_packet(want[i].n_heart_rate, want[i].n_spo2, want[i].uch_quality, auch_packet);
+    if (sink.sent[i].un_time_ms != want[i].un_time_ms)
+      fail(s_scenario, "notification sent at %d ms, expected %d ms", sink.sent[i].un_time_ms, want[i].un_time_ms);
+    if (sink.sent[i].bytes.size() != uw_length || memcmp(&sink.sent[i].bytes[0], auch_packet, uw_length) != 0)
+      fail(s_scenario, "notification %d does not carry heart rate %d", (int32_t)i, want[i].n_heart_rate);
+  }
+  printf("%-22s %3u notifications%s\n", s_scenario, (unsigned)sink.sent.size(), un_failures != un_before ? "" : ", as expected");
+}
+
+// polls every POLL_MS in [un_from, un_to), pn_rate(t) gives the result at time t
+static void run(NotifyScheduler* p_scheduler, FakeCharacteristic* p_sink, uint32_t un_from, uint32_t un_to,
+                int32_t (*pn_rate)(uint32_t), uint8_t uch_quality)
+{
+  for (uint32_t t = un_from; t != un_to; t += POLL_MS) {
+    p_scheduler->update(pn_rate(t), 97, uch_quality);
+    p_sink->un_now_ms = t;
+    p_scheduler->poll(t);
+  }
+}
+
+static int32_t changing_rate(uint32_t t) { return 60 + (int32_t)(t / 100 % 40); }
+static int32_t constant_rate(uint32_t) { return 72; }
+static int32_t late_change_rate(uint32_t t) { return t < 2500 ? 72 : 75; }
+
+static void check_packet_layout(void)
+{
+  const struct { int32_t n_heart_rate, n_spo2; uint8_t uch_quality; uint8_t auch_bytes[PLX_PACKET_SIZE]; } cases[] = {
+    { 72, 97, RESULT_QUALITY_VALID, { 0x04, 97, 0x00, 72, 0x00, 0xA0, 0x00 } },
+    { 130, 88, RESULT_QUALITY_EARLY, { 0x04, 88, 0x00, 130, 0x00, 0x60, 0x00 } },
+    { 300, 100, RESULT_QUALITY_QUESTIONABLE, { 0x04, 100, 0x00, 0x2C, 0x01, 0x20, 0x40 } },
+    { 999, 999, RESULT_QUALITY_INVALID, { 0x04, 0xFF, 0x07, 0xFF, 0x07, 0x20, 0x80 } },
+    { -1, 97, RESULT_QUALITY_INVALID, { 0x04, 97, 0x00, 0xFF, 0x07, 0x20, 0x80 } } };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    uint8_t auch_packet[PLX_PACKET_SIZE + 1];
+    auch_packet[PLX_PACKET_SIZE] = 0xA5; // must stay untouched
+    uint16_t uw_length = NotifyScheduler::build_plx_packet(cases[i].n_heart_rate, cases[i].n_spo2, cases[i].uch_quality, auch_packet);
+    if (uw_length != PLX_PACKET_SIZE || auch_packet[PLX_PACKET_SIZE] != 0xA5 || memcmp(auch_packet, cases[i].auch_bytes, PLX_PACKET_SIZE) != 0)
+      fail("packet layout", "heart rate %d, quality %d encoded wrongly", cases[i].n_heart_rate, cases[i].uch_quality);
+  }
+  if (PLX_PACKET_SIZE > DEFAULT_PAYLOAD) fail("packet layout", "%d bytes do not fit the %d byte default payload", PLX_PACKET_SIZE, DEFAULT_PAYLOAD);
+  printf("%-22s %3u cases%s\n", "packet layout", (unsigned)(sizeof(cases) / sizeof(cases[0])), un_failures ? "" : ", as expected");
+}
+
+int main(void)
+{
+  check_packet_layout();
+
+  { // changes every 100 ms, paced to one packet per second with the newest value
+    FakeCharacteristic sink;
+    NotifyScheduler scheduler(&sink, MIN_INTERVAL_MS, MAX_INTERVAL_MS);
+    run(&scheduler, &sink, 0, 10001, changing_rate, RESULT_QUALITY_VALID);
+    std::vector<expected> want;
+    for (uint32_t t = 0; t <= 10000; t += MIN_INTERVAL_MS)
+      want.push_back(expected{ t, changing_rate(t), 97, RESULT_QUALITY_VALID });
+    compare("changing result", sink, want);
+  }
+  { // nothing changes: the first packet at once, then keepalives
+    FakeCharacteristic sink;
+    NotifyScheduler scheduler(&sink, MIN_INTERVAL_MS, MAX_INTERVAL_MS);
+    run(&scheduler, &sink, 0, 20001, constant_rate, RESULT_QUALITY_VALID);
+    std::vector<expected> want;
+    for (uint32_t t = 0; t <= 20000; t += MAX_INTERVAL_MS)
+      want.push_back(expected{ t, 72, 97, RESULT_QUALITY_VALID });
+    compare("constant result", sink, want);
+  }
+  { // one change 2.5 s after the last packet goes out at once
+    FakeCharacteristic sink;
+    NotifyScheduler scheduler(&sink, MIN_INTERVAL_MS, MAX_INTERVAL_MS);
+    run(&scheduler, &sink, 0, 8001, late_change_rate, RESULT_QUALITY_EARLY);
+    std::vector<expected> want;
+    want.push_back(expected{ 0, 72, 97, RESULT_QUALITY_EARLY });
+    want.push_back(expected{ 2500, 75, 97, RESULT_QUALITY_EARLY });
+    want.push_back(expected{ 7500, 75, 97, RESULT_QUALITY_EARLY });
+    compare("change after a pause", sink, want);
+  }
+  { // connected at 3.2 s: refused packets stay due and carry the newest value
+    FakeCharacteristic sink;
+    NotifyScheduler scheduler(&sink, MIN_INTERVAL_MS, MAX_INTERVAL_MS);
+    sink.b_connected = false;
+    run(&scheduler, &sink, 0, 3200, changing_rate, RESULT_QUALITY_VALID);
+    sink.b_connected = true;
+    sink.uw_payload = 244; // a larger MTU after the exchange changes nothing for 7 bytes
+    run(&scheduler, &sink, 3200, 5201, changing_rate, RESULT_QUALITY_VALID);
+    std::vector<expected> want;
+    want.push_back(expected{ 3200, changing_rate(3200), 97, RESULT_QUALITY_VALID });
+    want.push_back(expected{ 4200, changing_rate(4200), 97, RESULT_QUALITY_VALID });
+    want.push_back(expected{ 5200, changing_rate(5200), 97, RESULT_QUALITY_VALID });
+    compare("late connection", sink, want);
+  }
+  { // millis() wraps after 49.7 days, the intervals must not
+    FakeCharacteristic sink;
+    NotifyScheduler scheduler(&sink, MIN_INTERVAL_MS, MAX_INTERVAL_MS);
+    uint32_t un_start = 0xFFFFFFFFu - 2499;
+    run(&scheduler, &sink, un_start, un_start + 12000, constant_rate, RESULT_QUALITY_VALID);
+    std::vector<expected> want;
+    for (uint32_t k = 0; k < 3; k++)
+      want.push_back(expected{ un_start + k * MAX_INTERVAL_MS, 72, 97, RESULT_QUALITY_VALID });
+    compare("millis() wrap", sink, want);
+  }
+
+  printf("%s\n", un_failures ? "NOTIFICATIONS DIFFER" : "all notifications as expected");
+  return un_failures ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+/** \file param_sweep.cpp ***************************************************
+*
+* Description: Sweep filter_size and the HR engine (hr_engine_kind in
+*              demo/spo2_algorithm.h) over recordings in one pass, instead
+*              of one run and one CSV per setting as in data/. The windows
+*              slide like in demo.ino (bufferLength 2048, hop 256). Per
+*              window the work is shared as far as the pipeline allows:
+*              - DC removal and inversion once for all configs;
+*              - the median and mean filter once per filter_size, handed to
+*                every engine through the pn_filtered argument of
+*                HR_calculation_engine.
+*              The mean filter of preprocessing() feeds its own output back
+*              and runs on the median output of the same size, so it cannot
+*              come from a prefix sum shared between sizes; sharing it
+*              across engines is what is left. The windows are split across
+*              threads, each thread runs every config on its windows, so the
+*              shared stages never wait for each other.
+*              Per config the table holds HR against the streaming beat
+*              detector, SpO2 and the run time of the config's own stages
+*              (peak search, beat segmentation, spo2_calculation).
+*
+* Build:   g++ -O2 -std=c++17 -pthread -DSTAGE_TIMING=0 -Ihost -I../demo -o param_sweep param_sweep.cpp ppg_record_reader.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/stage_timer.cpp ../demo/autocorr_engine.cpp ../demo/beat_detector.cpp
+*              ../demo/rolling_median.cpp ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/slope_detector.cpp
+*              ../demo/peak_valley_detector.cpp
+* Usage:   param_sweep [-f 1,2,4,...] [-e ampd,spectral,autocorr,slope,pv] [-j threads] recording.ppg [recording.ppg ...]
+*
+* STAGE_TIMING=0 removes the stage timers, their table is not thread safe.
+* Recordings without IR/red channels reuse the green channel for them, the
+* SpO2 column is then only a consistency check between the configs.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define TOLERANCE_BPM 5
+#define MAX_LOCS 64
+#define RATIO_SIZE 16
+
+struct engine_name {
+  const char* s_name;
+  uint8_t uch_engine;
+};
+
+static const engine_name engine_names[] = { { "ampd", HR_ENGINE_AMPD }, { "spectral", HR_ENGINE_SPECTRAL }, { "autocorr", HR_ENGINE_AUTOCORR },
+                                            { "slope", HR_ENGINE_SLOPE }, { "pv", HR_ENGINE_PEAK_VALLEY } };
+#define ENGINE_NAMES (int32_t)(sizeof(engine_names) / sizeof(engine_names[0]))
+
+struct config_result {
+  uint32_t un_windows;
+  uint32_t un_invalid;
+  uint32_t un_compared;
+  uint32_t un_within;
+  double f_abs_error;
+  double f_hr_sum;
+  uint32_t un_spo2;      // windows with a valid SpO2
+  double f_spo2_sum;
+  double f_seconds;
+};
+
+// one hop of one recording, the reference comes from the sequential beat detector pass
+struct window_job {
+  const uint32_t* pun_green;
+  const uint32_t* pun_ir;
+  const uint32_t* pun_red;
+  int32_t n_rate;
+  int32_t n_reference;
+};
+
+struct sweep {
+  std::vector<int32_t> sizes;
+  std::vector<uint8_t> engines;
+  std::vector<window_job> jobs;
+};
+
+// per thread, merged once the threads are done
+struct thread_result {
+  std::vector<config_result> configs; // sizes x engines, size major
+  std::vector<double> size_seconds;   // median and mean filter per size
+  double f_dc_seconds;
+};
+
+static bool parse_list(const char* s_list, std::vector<int32_t>* p_values)
+{
+  p_values->clear();
+  for (const char* s = s_list; *s; ) {
+    char* s_end;
+    long n = strtol(s, &s_end, 10);
+    if (s_end == s || n < 1 || n > WINDOW / 4) return false;
+    p_values->push_back((int32_t)n);
+    s = *s_end == ',' ? s_end + 1 : s_end;
+    if (*s_end != ',' && *s_end != '\0') return false;
+  }
+  return !p_values->empty();
+}
+
+static bool parse_engines(const char* s_list, std::vector<uint8_t>* p_engines)
+{
+  p_engines->clear();
+  char s_copy[128];
+  snprintf(s_copy, sizeof(s_copy), "%s", s_list);
+  for (char* s = strtok(s_copy, ","); s != NULL; s = strtok(NULL, ",")) {
+    int32_t e = 0;
+    while (e < ENGINE_NAMES && strcmp(engine_names[e].s_name, s) != 0) e++;
+    if (e == ENGINE_NAMES) return false;
+    p_engines->push_back(engine_names[e].uch_engine);
+  }
+  return !p_engines->empty();
+}
+
+static const char* engine_name_of(uint8_t uch_engine)
+{
+  for (int32_t e = 0; e < ENGINE_NAMES; e++)
+    if (engine_names[e].uch_engine == uch_engine) return engine_names[e].s_name;
+  return "?";
+}
+
+static void run_windows(const sweep* p_sweep, size_t n_first, size_t n_end, thread_result* p_result)
+{
+  size_t n_sizes = p_sweep->sizes.size(), n_engines = p_sweep->engines.size();
+  p_result->configs.assign(n_sizes * n_engines, config_result());
+  p_result->size_seconds.assign(n_sizes, 0.0);
+  p_result->f_dc_seconds = 0;
+  std::vector<int32_t> dc_free(WINDOW), filtered(WINDOW);
+  std::vector<uint32_t> green(WINDOW), ir(WINDOW), red(WINDOW);
+  int32_t an_peaks[MAX_LOCS], an_valleys[MAX_LOCS];
+  Beat a_beats[MAX_LOCS];
+  for (size_t w = n_first; w < n_end; w++) {
+    const window_job* p_job = &p_sweep->jobs[w];
+    green.assign(p_job->pun_green, p_job->pun_green + WINDOW);
+    ir.assign(p_job->pun_ir, p_job->pun_ir + WINDOW);
+    red.assign(p_job->pun_red, p_job->pun_red + WINDOW);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int32_t k = 0; k < WINDOW; k++)
+      dc_free[k] = green[k];
+    DC_removing_inverting_filter(&dc_free[0], WINDOW);
+    p_result->f_dc_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    for (size_t s = 0; s < n_sizes; s++) {
+      int32_t n_size = p_sweep->sizes[s];
+      t0 = std::chrono::steady_clock::now();
+      filtered = dc_free;
+      median_filter(&filtered[0], WINDOW, n_size);
+      mean_filter(&filtered[0], WINDOW, n_size);
+      p_result->size_seconds[s] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+      for (size_t e = 0; e < n_engines; e++) {
+        config_result* p = &p_result->configs[s * n_engines + e];
+        int32_t n_num_peak, n_num_val, n_interval, n_ratio_count;
+        t0 = std::chrono::steady_clock::now();
+        int32_t n_hr = HR_calculation_engine(p_sweep->engines[e], &green[0], WINDOW, an_peaks, &n_num_peak, MAX_LOCS, an_valleys, &n_num_val, MAX_LOCS,
+                                             p_job->n_rate, n_size, &filtered[0], -1, &n_interval);
+        // the engines run on the inverted green, their peaks are the raw troughs
+        int32_t n_beats = segment_beats(an_peaks, n_num_peak, an_valleys, n_num_val, 5 * n_size, a_beats, MAX_LOCS);
+        int32_t n_spo2 = spo2_calculation(&ir[0], &red[0], a_beats, n_beats, RATIO_SIZE, &n_ratio_count);
+        p->f_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        p->un_windows++;
+        if (n_spo2 != 999) { p->un_spo2++; p->f_spo2_sum += n_spo2; }
+        if (n_hr == 999) { p->un_invalid++; continue; }
+        p->f_hr_sum += n_hr;
+        if (p_job->n_reference == 999) continue;
+        int32_t n_error = abs(n_hr - p_job->n_reference);
+        p->un_compared++;
+        p->f_abs_error += n_error;
+        if (n_error <= TOLERANCE_BPM) p->un_within++;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  sweep job;
+  parse_list("1,2,4,5,6,8,15,20,25,50", &job.sizes); // the sizes of the runs in data/
+  parse_engines("ampd,spectral,autocorr,slope,pv", &job.engines);
+  int32_t n_threads = (int32_t)std::thread::hardware_concurrency();
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (i + 1 >= argc) break;
+    if (strcmp(argv[i], "-f") == 0) {
+      if (!parse_list(argv[++i], &job.sizes)) { fprintf(stderr, "bad filter sizes %s\n", argv[i]); return 2; }
+    } else if (strcmp(argv[i], "-e") == 0) {
+      if (!parse_engines(argv[++i], &job.engines)) { fprintf(stderr, "bad engines %s\n", argv[i]); return 2; }
+    } else if (strcmp(argv[i], "-j") == 0) {
+      n_threads = atoi(argv[++i]);
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) {
+    fprintf(stderr, "usage: %s [-f 1,2,4,...] [-e ampd,spectral,autocorr,slope,pv] [-j threads] recording.ppg [recording.ppg ...]\n", argv[0]);
+    return 2;
+  }
+  if (n_threads < 1) n_threads = 1;
+
+  // the readers stay open, the jobs point into their samples
+  std::vector<PpgRecordReader> readers(argc - i);
+  for (int r = 0; i < argc; i++, r++) {
+    PpgRecordReader* p_reader = &readers[r];
+    if (!p_reader->open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = p_reader->find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_ir = p_reader->find_channel(PPG_CHANNEL_IR), n_red = p_reader->find_channel(PPG_CHANNEL_RED);
+    int32_t n_rate = p_reader->header()->un_sampling_rate;
+    uint32_t un_count = p_reader->header()->un_sample_count;
+    const uint32_t* pun_green = p_reader->window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = p_reader->window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = p_reader->window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+    BeatDetector detector(n_rate, 15);
+    for (uint32_t un_end = HOP - 1; un_end < un_count; un_end += HOP) {
+      for (uint32_t k = un_end + 1 - HOP; k <= un_end; k++)
+        detector.push(pun_green[k]);
+      if (un_end + 1 < WINDOW) continue;
+      uint32_t un_start = un_end + 1 - WINDOW;
+      window_job w = { pun_green + un_start, pun_ir + un_start, pun_red + un_start, n_rate, detector.heart_rate() };
+      job.jobs.push_back(w);
+    }
+  }
+  if (job.jobs.empty()) { fprintf(stderr, "no complete window\n"); return 1; }
+  if ((size_t)n_threads > job.jobs.size()) n_threads = (int32_t)job.jobs.size();
+
+  std::chrono::steady_clock::time_point t_wall = std::chrono::steady_clock::now();
+  std::vector<thread_result> partial(n_threads);
+  std::vector<std::thread> threads;
+  for (int32_t t = 0; t < n_threads; t++) {
+    size_t n_first = job.jobs.size() * t / n_threads, n_end = job.jobs.size() * (t + 1) / n_threads;
+    threads.push_back(std::thread(run_windows, &job, n_first, n_end, &partial[t]));
+  }
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  double f_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_wall).count();
+
+  size_t n_sizes = job.sizes.size(), n_engines = job.engines.size();
+  thread_result total = partial[0];
+  for (int32_t t = 1; t < n_threads; t++) {
+    total.f_dc_seconds += partial[t].f_dc_seconds;
+    for (size_t s = 0; s < n_sizes; s++)
+      total.size_seconds[s] += partial[t].size_seconds[s];
+    for (size_t c = 0; c < total.configs.size(); c++) {
+      config_result* p = &total.configs[c];
+      const config_result* q = &partial[t].configs[c];
+      p->un_windows += q->un_windows; p->un_invalid += q->un_invalid;
+      p->un_compared += q->un_compared; p->un_within += q->un_within;
+      p->f_abs_error += q->f_abs_error; p->f_hr_sum += q->f_hr_sum;
+      p->un_spo2 += q->un_spo2; p->f_spo2_sum += q->f_spo2_sum;
+      p->f_seconds += q->f_seconds;
+    }
+  }
+
+  size_t n_windows = job.jobs.size();
+  printf("%u windows, %u configs, %d threads\n\n", (unsigned)n_windows, (unsigned)(n_sizes * n_engines), n_threads);
+  printf("filter engine    invalid  mean HR  mean |error|  within %d bpm  SpO2 windows  mean SpO2  us/window  +filter us\n", TOLERANCE_BPM);
+  for (size_t s = 0; s < n_sizes; s++)
+    for (size_t e = 0; e < n_engines; e++) {
+      const config_result* p = &total.configs[s * n_engines + e];
+      uint32_t un_valid = p->un_windows - p->un_invalid;
+      printf("%6d %-9s %7u %8.1f %13.1f %13.0f%% %13u %10.1f %10.0f %11.0f\n", job.sizes[s], engine_name_of(job.engines[e]), p->un_invalid,
+             un_valid ? p->f_hr_sum / un_valid : 0.0, p->un_compared ? p->f_abs_error / p->un_compared : 0.0,
+             p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0, p->un_spo2, p->un_spo2 ? p->f_spo2_sum / p->un_spo2 : 0.0,
+             p->f_seconds * 1e6 / n_windows, total.size_seconds[s] * 1e6 / n_windows);
+    }
+
+  // what the same sweep costs when every config preprocesses its own windows
+  double f_configs = 0, f_filters = 0;
+  for (size_t c = 0; c < total.configs.size(); c++)
+    f_configs += total.configs[c].f_seconds;
+  for (size_t s = 0; s < n_sizes; s++)
+    f_filters += total.size_seconds[s];
+  double f_shared = total.f_dc_seconds + f_filters + f_configs;
+  double f_separate = total.f_dc_seconds * n_sizes * n_engines + f_filters * n_engines + f_configs;
+  printf("\nCPU time: %.0f ms shared (DC removal %.1f ms, filters %.0f ms), %.0f ms with separate runs; wall time %.0f ms\n",
+         f_shared * 1e3, total.f_dc_seconds * 1e3, f_filters * 1e3, f_separate * 1e3, f_wall * 1e3);
+  return 0;
+}
@@ -0,0 +1,175 @@
+/** \file peak_valley_check.cpp *********************************************
+*
+* Description: Check the peak-valley state machine (demo/peak_valley_detector.h)
+*              against the recorded runs of the prototype, the *_peak_valley
+*              recordings converted from data/increasing_slope_against_AMPD,
+*              and measure its latency and throughput. The mean filtered
+*              channel is streamed through the detector sample by sample.
+*              The events have to reproduce the recorded markers exactly, a
+*              missing marker and an extra event both count as a difference:
+*              the beats the prototype skipped (at filter size 20 every
+*              valley) are tied extremes, which the detector skips as well.
+*              A recording merged from several CSVs is checked set by set,
+*              the markers of a mean filtered channel are the marker
+*              channels following it up to the next filtered channel.
+*              The same channel is then streamed with b_report_ties (the
+*              mode of the peak-valley HR engine): every recorded marker
+*              must be found, peaks and valleys must alternate, and each
+*              event without a recorded marker must be a tied extreme, a
+*              flat top or a later sample of the same height before the
+*              turn, reported at its first sample.
+*              Latency is the number of samples between an extremum and its
+*              event.
+*
+* Build:   g++ -O2 -std=c++17 -I../demo -o peak_valley_check peak_valley_check.cpp ppg_record_reader.cpp ../demo/peak_valley_detector.cpp
+* Usage:   peak_valley_check recording.ppg [recording.ppg ...]
+*
+* Exits with 1 if any recording differs.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "peak_valley_detector.h"
+#include "ppg_record_reader.h"
+
+#define REPEAT 200 // passes over each recording for the throughput
+
+// markers of a channel kind in the set of mean filtered channel n_mean, as ascending indices
+static std::vector<int32_t> markers(const PpgRecordReader& reader, int32_t n_mean, uint8_t uch_kind)
+{
+  std::vector<int32_t> locs;
+  for (int32_t c = n_mean + 1; c < reader.header()->uch_channel_count; c++) {
+    const ppg_channel_desc* p_desc = reader.channel(c);
+    if (p_desc->uch_kind == PPG_CHANNEL_MEDIAN_FILTERED || p_desc->uch_kind == PPG_CHANNEL_MEAN_FILTERED) break; // next set
+    if (p_desc->uch_kind != uch_kind) continue;
+    ppg_span span = reader.window(c, 0, reader.header()->un_sample_count);
+    for (uint32_t k = 0; k < span.un_length; k++)
+      if (span.pun_data[k] != 0) locs.push_back(k);
+  }
+  return locs;
+}
+
+// recorded markers not found plus events without a recorded marker, both are listed
+static int32_t compare(const char* s_what, const std::vector<int32_t>& recorded, const std::vector<int32_t>& found)
+{
+  std::vector<int32_t> missing, extra;
+  for (size_t i = 0; i < recorded.size(); i++)
+    if (!std::binary_search(found.begin(), found.end(), recorded[i])) missing.push_back(recorded[i]);
+  for (size_t i = 0; i < found.size(); i++)
+    if (!std::binary_search(recorded.begin(), recorded.end(), found[i])) extra.push_back(found[i]);
+  printf("  %-8s recorded %3d found %3d  %s", s_what, (int)recorded.size(), (int)found.size(),
+         missing.empty() && extra.empty() ? "identical" : "DIFFERENT");
+  if (!missing.empty()) printf("  missing:");
+  for (size_t i = 0; i < missing.size(); i++) printf(" %d", missing[i]);
+  if (!extra.empty()) printf("  extra:");
+  for (size_t i = 0; i < extra.size(); i++) printf(" %d", extra[i]);
+  printf("\n");
+  return (int32_t)(missing.size() + extra.size());
+}
+
+// streams x with b_report_ties: the recorded markers plus the tied extremes the prototype skipped, the number of differences
+static int32_t check_ties(const PpgRecordReader& reader, int32_t n_mean, const std::vector<int32_t>& x)
+{
+  PeakValleyDetector detector(reader.header()->un_sampling_rate, true);
+  std::vector<int32_t> recorded[2] = { markers(reader, n_mean, PPG_CHANNEL_PEAK_MARKER), markers(reader, n_mean, PPG_CHANNEL_VALLEY_MARKER) };
+  std::vector<int32_t> found[2];
+  int32_t n_bad = 0, n_flat = 0, n_later = 0;
+  int32_t n_turn = -1; // sample of the previous event, the running extreme starts there
+  uint8_t uch_last = PV_NONE;
+  for (size_t k = 0; k < x.size(); k++) {
+    uint8_t uch_event = detector.push(x[k]);
+    if (uch_event == PV_NONE) continue;
+    bool b_peak = uch_event == PV_PEAK;
+    int32_t n_at = b_peak ? detector.peak_index() : detector.valley_index();
+    if (uch_event == uch_last) { n_bad++; printf("  ties     %s at %d follows another one\n", b_peak ? "peak" : "valley", n_at); }
+    uch_last = uch_event;
+    found[b_peak ? 0 : 1].push_back(n_at);
+    if (!std::binary_search(recorded[b_peak ? 0 : 1].begin(), recorded[b_peak ? 0 : 1].end(), n_at)) {
+      // reached again before the turn at k, never reached since the previous turn
+      bool b_tied = false, b_first = true;
+      for (size_t j = n_at + 1; j < k; j++)
+        if (x[j] == x[n_at]) b_tied = true;
+      for (int32_t j = n_turn; j >= 0 && j < n_at; j++)
+        if (b_peak ? x[j] >= x[n_at] : x[j] <= x[n_at]) b_first = false;
+      if (!b_tied || !b_first) {
+        n_bad++;
+        printf("  ties     %s at %d is %s\n", b_peak ? "peak" : "valley", n_at, b_tied ? "not the first sample of its tie" : "not recorded and not tied");
+      } else if (x[n_at + 1] == x[n_at]) n_flat++;
+      else n_later++;
+    }
+    n_turn = (int32_t)k;
+  }
+  int32_t n_missing = 0;
+  for (int t = 0; t < 2; t++)
+    for (size_t i = 0; i < recorded[t].size(); i++)
+      if (!std::binary_search(found[t].begin(), found[t].end(), recorded[t][i])) {
+        n_missing++;
+        printf("  ties     recorded %s at %d missing\n", t == 0 ? "peak" : "valley", recorded[t][i]);
+      }
+  printf("  ties     recorded %3d found %3d, tied extremes added: %d flat tops, %d later ties  %s\n",
+         (int)(recorded[0].size() + recorded[1].size()), (int)(found[0].size() + found[1].size()), n_flat, n_later,
+         n_bad || n_missing ? "DIFFERENT" : "identical");
+  return n_bad + n_missing;
+}
+
+// streams mean filtered channel n_mean through the detector and compares the events with its markers, 1 if they differ
+static int32_t check_set(const char* s_path, const PpgRecordReader& reader, int32_t n_mean)
+{
+  int32_t n_diff = 0;
+  int32_t n_rate = reader.header()->un_sampling_rate;
+  ppg_span span = reader.window(n_mean, 0, reader.header()->un_sample_count);
+  std::vector<int32_t> x(span.pun_data, span.pun_data + span.un_length); // two's complement samples
+
+  PeakValleyDetector detector(n_rate);
+  std::vector<int32_t> peaks, valleys;
+  int64_t n_latency_sum = 0;
+  int32_t n_latency_max = 0;
+  for (size_t k = 0; k < x.size(); k++) {
+    uint8_t uch_event = detector.push(x[k]);
+    if (uch_event == PV_NONE) continue;
+    int32_t n_at = uch_event == PV_PEAK ? detector.peak_index() : detector.valley_index();
+    (uch_event == PV_PEAK ? peaks : valleys).push_back(n_at);
+    n_latency_sum += (int32_t)k - n_at;
+    n_latency_max = std::max(n_latency_max, (int32_t)k - n_at);
+  }
+  printf("%s (%d samples at %d sps, filter size %d)\n", s_path, (int)x.size(), n_rate, reader.channel(n_mean)->uw_filter_size);
+  n_diff += compare("peaks", markers(reader, n_mean, PPG_CHANNEL_PEAK_MARKER), peaks);
+  n_diff += compare("valleys", markers(reader, n_mean, PPG_CHANNEL_VALLEY_MARKER), valleys);
+  int32_t n_events = (int32_t)(peaks.size() + valleys.size());
+  printf("  latency  mean %.1f ms, max %.1f ms\n", n_events ? 1000.0 * n_latency_sum / n_events / n_rate : 0.0, 1000.0 * n_latency_max / n_rate);
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  uint32_t un_sink = 0;
+  for (int r = 0; r < REPEAT; r++) {
+    detector.reset();
+    for (size_t k = 0; k < x.size(); k++)
+      un_sink += detector.push(x[k]);
+  }
+  double f_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  printf("  speed    %.1f ns/sample (%u events)\n", f_seconds * 1e9 / REPEAT / x.size(), un_sink / REPEAT);
+  n_diff += check_ties(reader, n_mean, x);
+  return n_diff ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  int32_t n_failed = 0;
+  for (int i = 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_sets = 0;
+    for (int32_t n_mean = 0; n_mean < reader.header()->uch_channel_count; n_mean++) {
+      const ppg_channel_desc* p_desc = reader.channel(n_mean);
+      if (p_desc->uch_kind != PPG_CHANNEL_MEAN_FILTERED || p_desc->uch_detector != PPG_DETECTOR_PEAK_VALLEY) continue;
+      n_sets++;
+      n_failed += check_set(argv[i], reader, n_mean);
+    }
+    if (n_sets == 0)
+      printf("%s: no peak-valley run, skipped\n", argv[i]);
+  }
+  return n_failed ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+/** \file ppg_convert.cpp ***************************************************
+*
+* Description: Convert the data/ CSV captures into the binary PPG recording
+*              format (demo/ppg_record.h), or print the layout of a recording.
+*
+* Build:   g++ -O2 -I../demo -o ppg_convert ppg_convert.cpp ppg_record_reader.cpp
+* Usage:   ppg_convert [-r sampling_rate] [-f first_sample] -o out.ppg in.csv [in.csv ...]
+*          ppg_convert -i recording.ppg
+*
+* The CSV columns are raw green, median filtered, mean filtered, peak marker
+* and valley marker (the last two are optional). Session exports from the
+* on-device recorder (demo/session_recorder.h) name their columns instead
+* ("Green,IR,Red,HR,SpO2") and are mapped by name. The filter size and the
+* detector are taken from the file name (..._filter_size_4_..., ..._peak_valley,
+* ..._increasing_slope_method), the capture rate from a "400sps" prefix and
+* the first sample from the trailing range (..._10000_14000).
+* Several CSVs of the same capture can be merged into one recording, the raw
+* green channel they all share is then stored only once.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ppg_record.h"
+#include "ppg_record_reader.h"
+
+struct column {
+  ppg_channel_desc desc;
+  std::vector<uint32_t> samples;
+};
+
+static const uint8_t auch_csv_kinds[5] = { PPG_CHANNEL_GREEN, PPG_CHANNEL_MEDIAN_FILTERED, PPG_CHANNEL_MEAN_FILTERED,
+                                           PPG_CHANNEL_PEAK_MARKER, PPG_CHANNEL_VALLEY_MARKER };
+
+// maps named header columns, returns false for the positional "Channel 1,Channel 2,..." header
+static bool header_kinds(const char* s_line, std::vector<uint8_t>* p_kinds)
+{
+  static const struct { const char* s_name; uint8_t uch_kind; } names[] = {
+    { "Green", PPG_CHANNEL_GREEN }, { "IR", PPG_CHANNEL_IR }, { "Red", PPG_CHANNEL_RED },
+    { "HR", PPG_CHANNEL_HEART_RATE }, { "SpO2", PPG_CHANNEL_SPO2 } };
+  p_kinds->clear();
+  const char* p = s_line;
+  while (*p != '\0' && *p != '\n' && *p != '\r') {
+    size_t n_len = strcspn(p, ",\r\n");
+    size_t k = 0;
+    while (k < sizeof(names) / sizeof(names[0]) && (strlen(names[k].s_name) != n_len || strncmp(p, names[k].s_name, n_len) != 0)) k++;
+    if (k == sizeof(names) / sizeof(names[0])) return false;
+    p_kinds->push_back(names[k].uch_kind);
+    p += n_len;
+    if (*p == ',') p++;
+  }
+  return !p_kinds->empty();
+}
+
+static void describe_file(const char* s_path, uint16_t* puw_filter_size, uint8_t* puch_detector, uint32_t* pun_rate, uint32_t* pun_first)
+{
+  const char* s_name = strrchr(s_path, '/');
+  s_name = s_name ? s_name + 1 : s_path;
+  const char* s_filter = strstr(s_name, "filter_size_");
+  *puw_filter_size = s_filter ? (uint16_t)atoi(s_filter + strlen("filter_size_")) : 0;
+  if (s_filter && *pun_first == 0) { // ..._filter_size_4_10000_14000.csv holds samples 10000 to 14000
+    const char* s_range = strchr(s_filter + strlen("filter_size_"), '_');
+    if (s_range) *pun_first = atoi(s_range + 1);
+  }
+  if (strstr(s_name, "increasing_slope")) *puch_detector = PPG_DETECTOR_INCREASING_SLOPE;
+  else if (strstr(s_name, "peak_valley")) *puch_detector = PPG_DETECTOR_PEAK_VALLEY;
+  else *puch_detector = PPG_DETECTOR_AMPD;
+  if (*pun_rate == 0 && atoi(s_name) > 0 && strstr(s_name, "sps_")) *pun_rate = atoi(s_name);
+}
+
+static bool read_csv(const char* s_path, std::vector<column>* p_columns, uint32_t* pun_rate, uint32_t* pun_first)
+{
+  FILE* fp = fopen(s_path, "r");
+  if (fp == NULL) { fprintf(stderr, "cannot open %s\n", s_path); return false; }
+
+  uint16_t uw_filter_size;
+  uint8_t uch_detector;
+  describe_file(s_path, &uw_filter_size, &uch_detector, pun_rate, pun_first);
+
+  std::vector<std::vector<uint32_t> > cols;
+  std::vector<uint8_t> kinds(auch_csv_kinds, auch_csv_kinds + 5);
+  char s_line[256];
+  bool b_header = true;
+  while (fgets(s_line, sizeof(s_line), fp)) {
+    if (b_header) { // "Channel 1,Channel 2,..." or named columns
+      b_header = false;
+      if (header_kinds(s_line, &kinds)) uch_detector = PPG_DETECTOR_NONE;
+      else kinds.assign(auch_csv_kinds, auch_csv_kinds + 5);
+      continue;
+    }
+    char* p = s_line;
+    size_t i = 0;
+    while (*p != '\0' && *p != '\n' && *p != '\r') {
+      char* p_end;
+      long n_value = strtol(p, &p_end, 10);
+      if (p_end == p) break;
+      if (cols.size() <= i) cols.resize(i + 1);
+      cols[i++].push_back((uint32_t)(int32_t)n_value);
+      p = (*p_end == ',') ? p_end + 1 : p_end;
+    }
+  }
+  fclose(fp);
+  if (cols.empty() || cols.size() > kinds.size()) { fprintf(stderr, "%s: unexpected column count\n", s_path); return false; }
+
+  for (size_t i = 0; i < cols.size(); i++) {
+    bool b_raw = kinds[i] <= PPG_CHANNEL_RED;
+    if (b_raw) { // the raw channel is shared by every filter size variant of a capture
+      bool b_duplicate = false;
+      for (size_t j = 0; j < p_columns->size(); j++) {
+        if ((*p_columns)[j].desc.uch_kind != kinds[i]) continue;
+        if ((*p_columns)[j].samples != cols[i]) { fprintf(stderr, "%s: raw channel differs from the first input\n", s_path); return false; }
+        b_duplicate = true;
+      }
+      if (b_duplicate) continue;
+    }
+    column col;
+    memset(&col.desc, 0, sizeof(col.desc));
+    col.desc.uch_kind = kinds[i];
+    col.desc.uch_sample_bits = b_raw ? 18 : 32;
+    col.desc.uch_detector = b_raw ? (uint8_t)PPG_DETECTOR_NONE : uch_detector;
+    col.desc.uw_filter_size = b_raw ? 0 : uw_filter_size;
+    col.samples.swap(cols[i]);
+    p_columns->push_back(col);
+  }
+  return true;
+}
+
+static int print_info(const char* s_path)
+{
+  PpgRecordReader reader;
+  if (!reader.open(s_path)) { fprintf(stderr, "%s is not a valid recording\n", s_path); return 1; }
+  const ppg_record_header* p_hdr = reader.header();
+  printf("%s: %u samples at %u sps, first sample %u, %u channels\n", s_path, p_hdr->un_sample_count,
+         p_hdr->un_sampling_rate, p_hdr->un_first_sample, p_hdr->uch_channel_count);
+  for (uint32_t i = 0; i < p_hdr->uch_channel_count; i++) {
+    const ppg_channel_desc* p_desc = reader.channel(i);
+    printf("  channel %u: kind %u, %u bits, detector %u, filter size %u\n", i, p_desc->uch_kind,
+           p_desc->uch_sample_bits, p_desc->uch_detector, p_desc->uw_filter_size);
+  }
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  const char* s_out = NULL;
+  uint32_t un_rate = 0;
+  uint32_t un_first = 0;
+  std::vector<const char*> inputs;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) return print_info(argv[i + 1]);
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) s_out = argv[++i];
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) un_rate = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) un_first = atoi(argv[++i]);
+    else inputs.push_back(argv[i]);
+  }
+  if (s_out == NULL || inputs.empty()) {
+    fprintf(stderr, "usage: %s [-r sampling_rate] [-f first_sample] -o out.ppg in.csv [in.csv ...]\n"
+                    "       %s -i recording.ppg\n", argv[0], argv[0]);
+    return 2;
+  }
+
+  std::vector<column> columns;
+  for (size_t i = 0; i < inputs.size(); i++)
+    if (!read_csv(inputs[i], &columns, &un_rate, &un_first)) return 1;
+  if (columns.size() > PPG_RECORD_MAX_CHANNELS) { fprintf(stderr, "too many channels\n"); return 1; }
+  for (size_t i = 1; i < columns.size(); i++)
+    if (columns[i].samples.size() != columns[0].samples.size()) { fprintf(stderr, "inputs differ in length\n"); return 1; }
+
+  ppg_record_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.un_magic = PPG_RECORD_MAGIC;
+  hdr.uw_version = PPG_RECORD_VERSION;
+  hdr.uw_header_size = sizeof(ppg_record_header);
+  hdr.un_sampling_rate = un_rate ? un_rate : 400; // the capture rate of demo.ino
+  hdr.un_sample_count = (uint32_t)columns[0].samples.size();
+  hdr.un_first_sample = un_first;
+  // the data/ captures were taken with the demo.ino configuration
+  hdr.uw_pulse_width = 69;
+  hdr.uw_adc_range = 4096;
+  hdr.uch_led_mode = 3;
+  hdr.uch_led_brightness = 0x1F;
+  hdr.uch_sample_average = 1;
+  hdr.uch_channel_count = (uint8_t)columns.size();
+
+  FILE* fp = fopen(s_out, "wb");
+  if (fp == NULL) { fprintf(stderr, "cannot create %s\n", s_out); return 1; }
+  bool b_ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+  for (size_t i = 0; i < columns.size() && b_ok; i++)
+    b_ok = fwrite(&columns[i].desc, sizeof(ppg_channel_desc), 1, fp) == 1;
+  for (size_t i = 0; i < columns.size() && b_ok; i++)
+    b_ok = fwrite(columns[i].samples.data(), sizeof(uint32_t), columns[i].samples.size(), fp) == columns[i].samples.size();
+  if (fclose(fp) != 0 || !b_ok) { fprintf(stderr, "write to %s failed\n", s_out); return 1; }
+  printf("%s: %u samples x %u channels\n", s_out, hdr.un_sample_count, hdr.uch_channel_count);
+  return 0;
+}
@@ -0,0 +1,70 @@
+#include "ppg_record_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PpgRecordReader::PpgRecordReader(void) : p_map(NULL), n_map_size(0), p_header(NULL), p_channels(NULL) {}
+
+PpgRecordReader::~PpgRecordReader(void) { close(); }
+
+bool PpgRecordReader::open(const char* s_path)
+{
+  close();
+  int fd = ::open(s_path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ppg_record_header)) { ::close(fd); return false; }
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping stays valid after the descriptor is closed
+  if (p == MAP_FAILED) return false;
+  p_map = p;
+  n_map_size = st.st_size;
+
+  const ppg_record_header* p_hdr = (const ppg_record_header*)p_map;
+  if (p_hdr->un_magic != PPG_RECORD_MAGIC || p_hdr->uw_version != PPG_RECORD_VERSION ||
+      p_hdr->uw_header_size < sizeof(ppg_record_header) || p_hdr->uch_channel_count > PPG_RECORD_MAX_CHANNELS ||
+      ppg_record_size(p_hdr) > (uint64_t)n_map_size) { // header, descriptors and un_sample_count samples per channel must fit
+    close();
+    return false;
+  }
+  p_header = p_hdr;
+  p_channels = (const ppg_channel_desc*)((const uint8_t*)p_map + p_hdr->uw_header_size);
+  madvise(p_map, n_map_size, MADV_SEQUENTIAL);
+  return true;
+}
+
+void PpgRecordReader::close(void)
+{
+  if (p_map != NULL) munmap(p_map, n_map_size);
+  p_map = NULL; n_map_size = 0;
+  p_header = NULL; p_channels = NULL;
+}
+
+const ppg_channel_desc* PpgRecordReader::channel(uint32_t n_channel) const
+{
+  if (p_header == NULL || n_channel >= p_header->uch_channel_count) return NULL;
+  return &p_channels[n_channel];
+}
+
+int32_t PpgRecordReader::find_channel(uint8_t uch_kind, uint16_t uw_filter_size) const
+{
+  if (p_header == NULL) return -1;
+  for (int32_t i = 0; i < p_header->uch_channel_count; i++)
+    if (p_channels[i].uch_kind == uch_kind && p_channels[i].uw_filter_size == uw_filter_size)
+      return i;
+  return -1;
+}
+
+ppg_span PpgRecordReader::window(uint32_t n_channel, uint32_t un_first, uint32_t un_length) const
+{
+  ppg_span span = { NULL, 0 };
+  if (p_header == NULL || n_channel >= p_header->uch_channel_count || un_first >= p_header->un_sample_count)
+    return span;
+  if (un_length > p_header->un_sample_count - un_first)
+    un_length = p_header->un_sample_count - un_first; // truncate at the end of the recording
+  span.pun_data = (const uint32_t*)((const uint8_t*)p_map + ppg_record_channel_offset(p_header, n_channel)) + un_first;
+  span.un_length = un_length;
+  return span;
+}
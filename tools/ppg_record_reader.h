@@ -0,0 +1,44 @@
+/** \file ppg_record_reader.h **********************************************
+*
+* Description: Host-side reader for the binary PPG recording format
+*              (demo/ppg_record.h). The file is memory mapped and windows are
+*              returned as pointers into the mapping, so replays never parse
+*              or copy the samples.
+*
+* ------------------------------------------------------------------------- */
+#ifndef PPG_RECORD_READER_H_
+#define PPG_RECORD_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ppg_record.h"
+
+// a read-only view of consecutive samples of one channel
+typedef struct {
+  const uint32_t* pun_data;
+  uint32_t un_length;
+} ppg_span;
+
+class PpgRecordReader {
+ public:
+  PpgRecordReader(void);
+  ~PpgRecordReader(void);
+
+  bool open(const char* s_path); // returns false if the file is missing or not a valid recording
+  void close(void);
+
+  const ppg_record_header* header(void) const { return p_header; }
+  const ppg_channel_desc* channel(uint32_t n_channel) const;
+  int32_t find_channel(uint8_t uch_kind, uint16_t uw_filter_size = 0) const; // -1 if not present
+
+  // window of un_length samples starting at un_first, truncated at the end of the recording
+  ppg_span window(uint32_t n_channel, uint32_t un_first, uint32_t un_length) const;
+
+ private:
+  void* p_map;
+  size_t n_map_size;
+  const ppg_record_header* p_header;
+  const ppg_channel_desc* p_channels;
+};
+
+#endif /* PPG_RECORD_READER_H_ */
@@ -0,0 +1,161 @@
+/** \file recorder_bench.cpp ************************************************
+*
+* Description: Throughput of the session recorder (demo/session_recorder.h)
+*              with the file-backed storage. A recording is replayed in a loop
+*              as a longer session, paced at speedup times the sampling rate.
+*              Like in demo.ino, a spill thread fed by a queue runs service()
+*              whenever append_sample() completes a block, so the sampling
+*              loop only ever appends; the longest append shows whether it
+*              waited on storage. Then the session is exported as .ppg and CSV
+*              and the .ppg export is read back and compared with the input,
+*              which also fails if a sample was dropped.
+*
+* Build:   g++ -O2 -pthread -I../demo -o recorder_bench recorder_bench.cpp ppg_record_reader.cpp ../demo/session_recorder.cpp
+* Usage:   recorder_bench recording.ppg [seconds] [output prefix] [speedup]
+*
+* Recordings without IR/red channels reuse the green channel for them.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "file_record_storage.h"
+#include "ppg_record_reader.h"
+#include "session_recorder.h"
+
+static double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+enum { RECORDER_SPILL, RECORDER_STOP };
+
+// recorderQueue and recorder_task of demo.ino
+struct spill_queue {
+  std::mutex lock;
+  std::condition_variable ready;
+  std::deque<uint8_t> commands;
+  void send(uint8_t uch_command)
+  {
+    { std::lock_guard<std::mutex> guard(lock); commands.push_back(uch_command); }
+    ready.notify_one();
+  }
+  uint8_t receive(void)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    ready.wait(guard, [this] { return !commands.empty(); });
+    uint8_t uch_command = commands.front();
+    commands.pop_front();
+    return uch_command;
+  }
+};
+
+static void spill_task(SessionRecorder* p_recorder, spill_queue* p_queue, double* pf_service, bool* pb_ok)
+{
+  for (;;) {
+    uint8_t uch_command = p_queue->receive();
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    if (uch_command == RECORDER_STOP) {
+      *pb_ok = p_recorder->flush() && *pb_ok;
+      *pf_service += seconds_since(t0);
+      return;
+    }
+    while (p_recorder->block_ready())
+      if (!p_recorder->service()) *pb_ok = false;
+    *pf_service += seconds_since(t0);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [seconds] [output prefix] [speedup]\n", argv[0]); return 2; }
+  PpgRecordReader reader;
+  if (!reader.open(argv[1])) { fprintf(stderr, "%s is not a valid recording\n", argv[1]); return 1; }
+  int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+  if (n_green < 0) { fprintf(stderr, "no green channel\n"); return 1; }
+  int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR);
+  int32_t n_red = reader.find_channel(PPG_CHANNEL_RED);
+  uint32_t un_rate = reader.header()->un_sampling_rate;
+  uint32_t un_count = reader.header()->un_sample_count;
+  ppg_span green = reader.window(n_green, 0, un_count);
+  ppg_span ir = reader.window(n_ir < 0 ? n_green : n_ir, 0, un_count);
+  ppg_span red = reader.window(n_red < 0 ? n_green : n_red, 0, un_count);
+  uint32_t un_session = (argc > 2 ? atoi(argv[2]) : 600) * un_rate;
+  std::string s_prefix = argc > 3 ? argv[3] : "session";
+  double f_speedup = argc > 4 ? atof(argv[4]) : 100;
+
+  FileRecordStorage storage((s_prefix + ".rec").c_str());
+  SessionRecorder* p_recorder = new SessionRecorder(&storage); // the ring is too large for some stacks
+  if (!p_recorder->begin(reader.header())) { fprintf(stderr, "cannot create the storage file\n"); return 1; }
+
+  const uint32_t un_hop = 256; // oneQuaterBuffer in demo.ino
+  double f_append = 0, f_append_max = 0, f_service = 0;
+  bool b_stored = true;
+  spill_queue queue;
+  std::thread spill(spill_task, p_recorder, &queue, &f_service, &b_stored);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < un_session; i += un_hop) {
+    std::this_thread::sleep_until(start + std::chrono::duration<double>(i / (un_rate * f_speedup)));
+    for (uint32_t k = i; k < i + un_hop && k < un_session; k++) {
+      uint32_t j = k % un_count;
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      if (p_recorder->append_sample(green.pun_data[j], ir.pun_data[j], red.pun_data[j]))
+        queue.send(RECORDER_SPILL);
+      double f_seconds = seconds_since(t0);
+      f_append += f_seconds;
+      if (f_seconds > f_append_max) f_append_max = f_seconds;
+    }
+    p_recorder->set_result(60 + (i / un_hop) % 40, 95 + (i / un_hop) % 5);
+  }
+  queue.send(RECORDER_STOP);
+  spill.join();
+  if (!b_stored) { fprintf(stderr, "storage write failed\n"); return 1; }
+  double f_bytes = (double)p_recorder->recorded() * RECORDER_RECORD_WORDS * 4;
+  printf("%u samples (%u s at %u sps), %u dropped, %.1f MB stored\n", p_recorder->recorded(), un_session / un_rate, un_rate,
+         p_recorder->dropped(), f_bytes / 1e6);
+  printf("append   %8.2f ns/sample, longest %.1f us, paced at %.0fx real time\n", f_append * 1e9 / un_session, f_append_max * 1e6, f_speedup);
+  printf("spill    %8.1f MB/s, %.1f ms per %u byte block\n", f_bytes / 1e6 / f_service,
+         f_service * 1e3 / (f_bytes / RECORDER_BLOCK_BYTES), RECORDER_BLOCK_BYTES);
+  printf("required %8.3f MB/s at %u sps\n", (double)un_rate * RECORDER_RECORD_WORDS * 4 / 1e6, un_rate);
+
+  std::string s_ppg = s_prefix + ".ppg", s_csv = s_prefix + ".csv";
+  FILE* fp = fopen(s_ppg.c_str(), "wb");
+  if (fp == NULL) { fprintf(stderr, "cannot create %s\n", s_ppg.c_str()); return 1; }
+  FileOutput ppg_output(fp);
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  bool b_ok = p_recorder->export_binary(&ppg_output);
+  b_ok = fclose(fp) == 0 && b_ok;
+  printf("export   %8.1f MB/s binary", f_bytes / 1e6 / seconds_since(t0));
+  fp = fopen(s_csv.c_str(), "wb");
+  if (fp == NULL || !b_ok) { fprintf(stderr, "\nexport to %s failed\n", s_ppg.c_str()); return 1; }
+  FileOutput csv_output(fp);
+  t0 = std::chrono::steady_clock::now();
+  b_ok = p_recorder->export_csv(&csv_output);
+  b_ok = fclose(fp) == 0 && b_ok;
+  printf(", %.1f MB/s CSV\n", f_bytes / 1e6 / seconds_since(t0));
+  if (!b_ok) { fprintf(stderr, "export to %s failed\n", s_csv.c_str()); return 1; }
+
+  if (p_recorder->dropped()) { fprintf(stderr, "%u samples dropped, the spill thread fell behind\n", p_recorder->dropped()); return 1; }
+  PpgRecordReader session;
+  if (!session.open(s_ppg.c_str()) || session.header()->un_sample_count != un_session) { fprintf(stderr, "%s is not a valid recording\n", s_ppg.c_str()); return 1; }
+  ppg_span g = session.window(session.find_channel(PPG_CHANNEL_GREEN), 0, un_session);
+  ppg_span x = session.window(session.find_channel(PPG_CHANNEL_IR), 0, un_session);
+  ppg_span y = session.window(session.find_channel(PPG_CHANNEL_RED), 0, un_session);
+  for (uint32_t i = 0; i < un_session; i++) {
+    uint32_t j = i % un_count;
+    if (g.pun_data[i] != green.pun_data[j] || x.pun_data[i] != ir.pun_data[j] || y.pun_data[i] != red.pun_data[j]) {
+      fprintf(stderr, "%s differs from the input at sample %u\n", s_ppg.c_str(), i);
+      return 1;
+    }
+  }
+  printf("%s and %s written, round trip ok\n", s_ppg.c_str(), s_csv.c_str());
+  delete p_recorder;
+  return 0;
+}
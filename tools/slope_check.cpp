@@ -0,0 +1,116 @@
+/** \file slope_check.cpp ***************************************************
+*
+* Description: Check increasing_slope() (demo/slope_detector.h) against the
+*              recorded runs of the method, the *_increasing_slope_method
+*              recordings converted from data/increasing_slope_against_AMPD.
+*              Their mean filtered channel is streamed through the detector
+*              without a minimum distance and the peaks and valleys must hit
+*              the recorded markers exactly; the recorded runs stopped at 20
+*              peaks and 20 valleys, so the same limit is applied. The time
+*              of the detector and of AMPD() on the same samples is printed
+*              next to it. A recording merged from several CSVs is checked
+*              set by set: the markers of a mean filtered channel are the
+*              marker channels following it up to the next filtered channel.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o slope_check slope_check.cpp ppg_record_reader.cpp ../demo/slope_detector.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/stage_timer.cpp ../demo/peak_valley_detector.cpp
+* Usage:   slope_check recording.ppg [recording.ppg ...]
+*
+* Exits with 1 if any recording differs.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define RECORDED_MAX 20 // peaks and valleys per recorded run
+#define REPEAT 20       // timing runs per recording
+
+// markers of a channel kind in the set of mean filtered channel n_mean, as ascending indices
+static std::vector<int32_t> markers(const PpgRecordReader& reader, int32_t n_mean, uint8_t uch_kind)
+{
+  std::vector<int32_t> locs;
+  for (int32_t c = n_mean + 1; c < reader.header()->uch_channel_count; c++) {
+    const ppg_channel_desc* p_desc = reader.channel(c);
+    if (p_desc->uch_kind == PPG_CHANNEL_MEDIAN_FILTERED || p_desc->uch_kind == PPG_CHANNEL_MEAN_FILTERED) break; // next set
+    if (p_desc->uch_kind != uch_kind) continue;
+    ppg_span span = reader.window(c, 0, reader.header()->un_sample_count);
+    for (uint32_t k = 0; k < span.un_length; k++)
+      if (span.pun_data[k] != 0) locs.push_back(k);
+  }
+  return locs;
+}
+
+static int32_t compare(const char* s_what, const std::vector<int32_t>& recorded, const int32_t* pn_found, int32_t n_found)
+{
+  int32_t n_diff = n_found == (int32_t)recorded.size() ? 0 : 1;
+  for (int32_t i = 0; i < n_found && n_diff == 0; i++)
+    if (pn_found[i] != recorded[i]) n_diff = 1;
+  printf("  %-8s recorded %3d found %3d  %s\n", s_what, (int)recorded.size(), n_found, n_diff ? "DIFFERENT" : "identical");
+  if (n_diff)
+    for (int32_t i = 0; i < n_found || i < (int32_t)recorded.size(); i++)
+      printf("    %3d: %6d %6d\n", i, i < (int32_t)recorded.size() ? recorded[i] : -1, i < n_found ? pn_found[i] : -1);
+  return n_diff;
+}
+
+// compares the increasing slope run of mean filtered channel n_mean with its markers, 1 if it differs
+static int32_t check_set(const char* s_path, const PpgRecordReader& reader, int32_t n_mean)
+{
+  int32_t n_diff = 0;
+  ppg_span span = reader.window(n_mean, 0, reader.header()->un_sample_count);
+  int32_t n_size = (int32_t)span.un_length;
+  std::vector<int32_t> x(n_size), inverted(n_size);
+  for (int32_t k = 0; k < n_size; k++) {
+    x[k] = (int32_t)span.pun_data[k]; // the filtered channels are stored as two's complement
+    inverted[k] = -x[k];
+  }
+  int32_t an_peaks[RECORDED_MAX], an_valleys[RECORDED_MAX], n_peaks, n_valleys;
+  increasing_slope(&x[0], n_size, an_peaks, &n_peaks, RECORDED_MAX, 0);
+  increasing_slope(&inverted[0], n_size, an_valleys, &n_valleys, RECORDED_MAX, 0);
+  printf("%s (%d samples, filter size %d)\n", s_path, n_size, reader.channel(n_mean)->uw_filter_size);
+  n_diff += compare("peaks", markers(reader, n_mean, PPG_CHANNEL_PEAK_MARKER), an_peaks, n_peaks);
+  n_diff += compare("valleys", markers(reader, n_mean, PPG_CHANNEL_VALLEY_MARKER), an_valleys, n_valleys);
+
+  // cost of one window, both polarities, without the limit of the recorded runs
+  std::vector<int32_t> locs(n_size);
+  int32_t n_num;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < REPEAT; r++) {
+    increasing_slope(&x[0], n_size, &locs[0], &n_num, n_size, 0);
+    increasing_slope(&inverted[0], n_size, &locs[0], &n_num, n_size, 0);
+  }
+  double f_slope = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / REPEAT;
+  t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < REPEAT; r++) {
+    AMPD(&x[0], n_size, &locs[0], &n_num, n_size);
+    AMPD(&inverted[0], n_size, &locs[0], &n_num, n_size);
+  }
+  double f_ampd = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / REPEAT;
+  printf("  time     slope %.1f us, AMPD %.1f us (%.0fx)\n", f_slope * 1e6, f_ampd * 1e6, f_ampd / f_slope);
+  return n_diff ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  int32_t n_failed = 0;
+  for (int i = 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_sets = 0;
+    for (int32_t n_mean = 0; n_mean < reader.header()->uch_channel_count; n_mean++) {
+      const ppg_channel_desc* p_desc = reader.channel(n_mean);
+      if (p_desc->uch_kind != PPG_CHANNEL_MEAN_FILTERED || p_desc->uch_detector != PPG_DETECTOR_INCREASING_SLOPE) continue;
+      n_sets++;
+      n_failed += check_set(argv[i], reader, n_mean);
+    }
+    if (n_sets == 0)
+      printf("%s: no increasing slope run, skipped\n", argv[i]);
+  }
+  return n_failed ? 1 : 0;
+}
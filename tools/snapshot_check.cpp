@@ -0,0 +1,254 @@
+/** \file snapshot_check.cpp ************************************************
+*
+* Description: Round trip of the pipeline snapshot (demo/pipeline_snapshot.h)
+*              and what a resumed session gains. At split points of each
+*              recording the state of a continuous run is captured and
+*              - serialized, deserialized and serialized again: both byte
+*                strings and the restored fields must match, every single
+*                bit flip, every truncation and another version must be
+*                rejected, and a band-pass filter restored from it must
+*                continue bit-exactly like the original;
+*              - restored into fresh objects a gap later in the recording
+*                (GAP_S seconds or -g, shortened to what fits for a short
+*                recording, at least 1 s), as after a pause with the finger
+*                back on: the
+*                heart rate after the first hop (the IR check of warm_up()
+*                decides whether it stands) is compared with the
+*                continuous run, against the samples a fresh start needs
+*                for its first result.
+*              The exit status is 1 if any round trip check failed, no
+*              recording was long enough for a single resume, or the
+*              resumed heart rates miss the continuous run: fewer than
+*              MIN_WITHIN_PERCENT of them within TOLERANCE_BPM, or a mean
+*              |difference| above TOLERANCE_BPM.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o snapshot_check snapshot_check.cpp ppg_record_reader.cpp
+*              ../demo/pipeline_snapshot.cpp ../demo/gain_controller.cpp ../demo/beat_detector.cpp ../demo/rolling_median.cpp
+*              ../demo/spo2_estimator.cpp ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp ../demo/pipeline_controller.cpp
+*              ../demo/bandpass_filter.cpp ../demo/stage_timer.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   snapshot_check [-g gap_seconds] recording.ppg [recording.ppg ...]
+*
+* Recordings without IR/red channels reuse the green channel for them.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "pipeline_controller.h"
+#include "pipeline_snapshot.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+#include "spo2_estimator.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define SPLIT_STEP (8 * HOP)
+#define GAP_S 10 // default pause before a resume
+#define DC_TOLERANCE 25 // resumeDcTolerance of demo.ino
+#define TOLERANCE_BPM 5
+#define MIN_WITHIN_PERCENT 90 // resumed heart rates within TOLERANCE_BPM of the continuous run
+#define FILTER_CHECK 1024 // samples compared after a band-pass restore
+
+struct check_result {
+  uint32_t un_round_trips;
+  uint32_t un_failures;
+  uint32_t un_resumes;
+  double f_gap_seconds;       // sum of the gaps before them
+  uint32_t un_resume_valid;   // IR check passed and a heart rate after one hop
+  uint32_t un_resume_within;
+  double f_resume_diff;
+  uint32_t un_fresh;          // fresh starts that reached a result
+  double f_fresh_samples;     // samples until their first result
+};
+
+static bool same_fields(const pipeline_snapshot& a, const pipeline_snapshot& b)
+{
+  if (a.un_sampling_rate != b.un_sampling_rate || a.uch_signal_quality != b.uch_signal_quality) return false;
+  if (a.gain.uw_adc_range != b.gain.uw_adc_range || memcmp(a.gain.auch_amplitude, b.gain.auch_amplitude, GAIN_CHANNELS) != 0) return false;
+  if (memcmp(a.aun_dc, b.aun_dc, sizeof(a.aun_dc)) != 0) return false;
+  if (a.n_interval_count != b.n_interval_count || memcmp(a.an_intervals, b.an_intervals, a.n_interval_count * sizeof(int32_t)) != 0) return false;
+  if (a.n_ratio_count != b.n_ratio_count || memcmp(a.an_ratios, b.an_ratios, a.n_ratio_count * sizeof(int32_t)) != 0) return false;
+  if (a.n_amplitude != b.n_amplitude) return false;
+  if (a.uch_max_peak != b.uch_max_peak || a.uch_max_valley != b.uch_max_valley || a.uch_filter_size != b.uch_filter_size ||
+      a.uch_ratio_size != b.uch_ratio_size) return false;
+  return a.filter.b_primed == b.filter.b_primed && memcmp(a.filter.an_high, b.filter.an_high, sizeof(a.filter.an_high)) == 0 &&
+         memcmp(a.filter.an_low, b.filter.an_low, sizeof(a.filter.an_low)) == 0;
+}
+
+// serialize, deserialize and tamper with one snapshot, false on the first failed check
+static bool round_trip(const pipeline_snapshot& original, const char** ps_failure)
+{
+  uint8_t auch_bytes[SNAPSHOT_MAX_BYTES], auch_again[SNAPSHOT_MAX_BYTES], auch_tampered[SNAPSHOT_MAX_BYTES];
+  pipeline_snapshot restored;
+  uint16_t uw_length = snapshot_serialize(&original, auch_bytes, sizeof(auch_bytes));
+  *ps_failure = "serialize";
+  if (uw_length == 0) return false;
+  *ps_failure = "short buffer accepted";
+  if (snapshot_serialize(&original, auch_again, uw_length - 1) != 0) return false;
+  *ps_failure = "deserialize";
+  if (!snapshot_deserialize(auch_bytes, uw_length, &restored)) return false;
+  *ps_failure = "fields differ";
+  if (!same_fields(original, restored)) return false;
+  *ps_failure = "bytes differ";
+  if (snapshot_serialize(&restored, auch_again, sizeof(auch_again)) != uw_length || memcmp(auch_bytes, auch_again, uw_length) != 0) return false;
+  *ps_failure = "bit flip accepted";
+  for (uint16_t i = 0; i < uw_length; i++)
+    for (int32_t b = 0; b < 8; b++) {
+      memcpy(auch_tampered, auch_bytes, uw_length);
+      auch_tampered[i] ^= (uint8_t)(1 << b);
+      if (snapshot_deserialize(auch_tampered, uw_length, &restored)) return false;
+    }
+  *ps_failure = "truncation accepted";
+  for (uint16_t n = 0; n < uw_length; n++)
+    if (snapshot_deserialize(auch_bytes, n, &restored)) return false;
+  *ps_failure = "other version accepted";
+  memcpy(auch_tampered, auch_bytes, uw_length);
+  auch_tampered[4]++;
+  return !snapshot_deserialize(auch_tampered, uw_length, &restored);
+}
+
+static uint32_t mean(const uint32_t* pun_x, uint32_t un_length)
+{
+  uint64_t un_sum = 0;
+  for (uint32_t k = 0; k < un_length; k++)
+    un_sum += pun_x[k];
+  return (uint32_t)(un_sum / un_length);
+}
+
+int main(int argc, char** argv)
+{
+  int32_t n_first = 1;
+  double f_gap_s = GAP_S;
+  if (argc > 2 && strcmp(argv[1], "-g") == 0) { f_gap_s = atof(argv[2]); n_first = 3; }
+  if (argc <= n_first || f_gap_s < 1) { fprintf(stderr, "usage: %s [-g gap_seconds >= 1] recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  check_result result;
+  memset(&result, 0, sizeof(result));
+  PipelineController* p_controller = new PipelineController();
+  PipelineController* p_resumed = new PipelineController();
+  p_controller->enable_bandpass(); // the snapshot carries a running band-pass
+  for (int i = n_first; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR), n_red = reader.find_channel(PPG_CHANNEL_RED);
+    int32_t n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = reader.window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = reader.window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+    // the first split point is at WINDOW, its resume needs the gap and another WINDOW after it
+    uint32_t un_gap = (uint32_t)(f_gap_s * n_rate);
+    uint32_t un_room = un_count > 2 * WINDOW ? un_count - 2 * WINDOW : 0;
+    if (un_room < (uint32_t)n_rate)
+      printf("%s: %u samples, too short for a resume after at least 1 s\n", argv[i], un_count);
+    else if (un_gap > un_room) {
+      un_gap = un_room;
+      printf("%s: %u samples, gap shortened to %.1f s\n", argv[i], un_count, (double)un_gap / n_rate);
+    }
+
+    // heart rate of the continuous run after every sample
+    std::vector<int32_t> continuous(un_count + 1, 999);
+    BeatDetector whole(n_rate, 15);
+    for (uint32_t k = 0; k < un_count; k++) {
+      whole.push(pun_green[k]);
+      continuous[k + 1] = whole.heart_rate();
+    }
+
+    BeatDetector detector(n_rate, 15);
+    SpO2Estimator estimator(16);
+    p_controller->reset();
+    std::vector<uint32_t> ir(pun_ir, pun_ir + un_count), red(pun_red, pun_red + un_count);
+    for (uint32_t k = 0; k < un_count; k++) {
+      p_controller->push_green(pun_green[k]);
+      if (detector.push(pun_green[k])) {
+        uint32_t un_first = k + 1 > WINDOW ? k + 1 - WINDOW : 0;
+        estimator.add_beat(detector.last_beat(), &ir[un_first], &red[un_first], un_first, k + 1 - un_first);
+      }
+      if ((k + 1) % SPLIT_STEP != 0 || k + 1 < WINDOW) continue;
+
+      pipeline_snapshot snapshot;
+      snapshot_capture(&snapshot, detector, estimator, *p_controller, NULL);
+      snapshot.un_sampling_rate = n_rate;
+      snapshot.uch_signal_quality = SIGNAL_OK;
+      snapshot.aun_dc[GAIN_RED] = mean(&red[k + 1 - HOP], HOP);
+      snapshot.aun_dc[GAIN_IR] = mean(&ir[k + 1 - HOP], HOP);
+      snapshot.aun_dc[GAIN_GREEN] = mean(pun_green + k + 1 - HOP, HOP);
+      const char* s_failure;
+      result.un_round_trips++;
+      bool b_ok = round_trip(snapshot, &s_failure);
+      if (b_ok) { // the restored band-pass continues exactly like the running one
+        BandpassFilter running = p_controller->filter(), restored(n_rate);
+        restored.restore(snapshot.filter);
+        s_failure = "band-pass differs";
+        for (uint32_t j = k + 1; j < un_count && j < k + 1 + FILTER_CHECK && b_ok; j++)
+          b_ok = running.push(pun_green[j]) == restored.push(pun_green[j]);
+      }
+      if (!b_ok) {
+        result.un_failures++;
+        fprintf(stderr, "%s, sample %u: %s\n", argv[i], k + 1, s_failure);
+      }
+
+      // the finger comes back GAP_S later: one hop with the restored state, then a fresh start for comparison
+      uint32_t un_start = k + 1 + un_gap;
+      if (un_room < (uint32_t)n_rate || un_start + WINDOW > un_count) continue;
+      BeatDetector resumed_detector(n_rate, 15);
+      SpO2Estimator resumed_estimator(16);
+      p_resumed->reset();
+      snapshot_restore(snapshot, &resumed_detector, &resumed_estimator, p_resumed, NULL);
+      for (uint32_t j = un_start; j < un_start + HOP; j++)
+        resumed_detector.push(pun_green[j]);
+      uint32_t un_dc = mean(&ir[un_start], HOP), un_expected = snapshot.aun_dc[GAIN_IR];
+      bool b_matches = (uint32_t)abs((int32_t)un_dc - (int32_t)un_expected) * 100 <= un_expected * DC_TOLERANCE;
+      int32_t n_hr = b_matches ? resumed_detector.heart_rate() : 999;
+      result.un_resumes++;
+      result.f_gap_seconds += (double)un_gap / n_rate;
+      if (n_hr != 999) {
+        int32_t n_ref = continuous[un_start + HOP];
+        if (n_ref != 999) {
+          int32_t n_diff = abs(n_hr - n_ref);
+          result.un_resume_valid++;
+          result.f_resume_diff += n_diff;
+          if (n_diff <= TOLERANCE_BPM) result.un_resume_within++;
+        }
+      }
+      // fresh start: warm-up checkpoints of demo.ino, the first passing signal_quality with a heart rate
+      BeatDetector fresh(n_rate, 15);
+      int32_t an_checkpoints[3] = { WINDOW / 2, WINDOW * 3 / 4, WINDOW };
+      int32_t n_filled = 0;
+      for (int c = 0; c < 3; c++) {
+        for (int32_t j = n_filled; j < an_checkpoints[c]; j++)
+          fresh.push(pun_green[un_start + j]);
+        n_filled = an_checkpoints[c];
+        signal_quality_info quality_info;
+        std::vector<uint32_t> green(pun_green + un_start, pun_green + un_start + n_filled);
+        if (signal_quality(&green[0], &ir[un_start], &red[un_start], n_filled, n_rate, &quality_info) == SIGNAL_OK && fresh.heart_rate() != 999) {
+          result.un_fresh++;
+          result.f_fresh_samples += n_filled;
+          break;
+        }
+      }
+    }
+  }
+  delete p_controller; p_controller = NULL;
+  delete p_resumed; p_resumed = NULL;
+
+  printf("round trips %u, failed %u\n", result.un_round_trips, result.un_failures);
+  printf("resumed after %.1f s mean: %u, result after one hop (%d samples) %u, mean |diff to continuous| %.1f bpm, within %d bpm %.0f%%\n",
+         result.un_resumes ? result.f_gap_seconds / result.un_resumes : 0.0,
+         result.un_resumes, HOP, result.un_resume_valid, result.un_resume_valid ? result.f_resume_diff / result.un_resume_valid : 0.0,
+         TOLERANCE_BPM, result.un_resume_valid ? 100.0 * result.un_resume_within / result.un_resume_valid : 0.0);
+  printf("fresh starts with a result %u of %u, first result after %.0f samples mean\n", result.un_fresh, result.un_resumes,
+         result.un_fresh ? result.f_fresh_samples / result.un_fresh : 0.0);
+  bool b_accurate = result.un_resume_valid > 0 && result.un_resume_within * 100 >= result.un_resume_valid * MIN_WITHIN_PERCENT &&
+                    result.f_resume_diff <= (double)TOLERANCE_BPM * result.un_resume_valid;
+  if (result.un_resumes == 0) fprintf(stderr, "no resume evaluated, the recordings are too short\n");
+  else if (!b_accurate)
+    fprintf(stderr, "resumed heart rates: below %d%% within %d bpm, a mean |diff| above %d bpm or none at all\n", MIN_WITHIN_PERCENT,
+            TOLERANCE_BPM, TOLERANCE_BPM);
+  return result.un_failures || result.un_resumes == 0 || !b_accurate ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/** \file spo2_check.cpp ****************************************************
+*
+* Description: SpO2 of heart_rate_and_oxygen_saturation() and of the
+*              streaming SpO2Estimator on synthetic PPG with a known ratio. Every channel is DC * (1 - m * pulse(t)),
+*              the blood volume pulse lowers the raw samples like on the
+*              MAX30105, with a modulation m of 0.02 for IR and
+*              R/100 * 0.02 for red, so (AC_red/DC_red) / (AC_ir/DC_ir) is R.
+*              The windows slide like in demo.ino (2048 samples, hop 256)
+*              over 40 s at 72 bpm and 400 sps with a little noise.
+*              The streaming estimator is fed each beat of the BeatDetector
+*              like update_beat() in demo.ino and read at the end of each
+*              hop once the detector reports a heart rate.
+*              Each ratio fails if a window that passed the signal quality
+*              check, or a streaming read, reports 999 or an SpO2 outside
+*              the table values of R +- RATIO_TOLERANCE percent.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o spo2_check spo2_check.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp
+*              ../demo/stage_timer.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp ../demo/beat_detector.cpp
+*              ../demo/rolling_median.cpp ../demo/spo2_estimator.cpp
+* Usage:   spo2_check
+*
+* Exits with 1 if any ratio fails.
+*
+* ------------------------------------------------------------------------- */
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "pipeline_controller.h"
+#include "spo2_algorithm.h"
+#include "spo2_estimator.h"
+
+#define RATE 400
+#define SECONDS 40
+#define BPM 72
+#define WINDOW 2048
+#define HOP 256
+#define RATIO_TOLERANCE 5 // percent of R, the table falls by up to 1.5 % SpO2 per 1 % of R
+#define IR_MODULATION 0.02
+
+// blood volume pulse at phase 0..1 of a beat: fast systolic rise, slow diastolic decay, 0 at the foot
+static double pulse(double f_phase)
+{
+  if (f_phase < 0.15) { double s = sin(M_PI / 2 * f_phase / 0.15); return s * s; }
+  double d = (1 - f_phase) / 0.85;
+  return d * d;
+}
+
+// DC * (1 - m * pulse) plus uniform noise of +-un_noise counts
+static void synthesize(std::vector<uint32_t>* p_out, double f_dc, double f_modulation, uint32_t un_noise, uint32_t* pun_seed)
+{
+  p_out->resize(SECONDS * RATE);
+  for (size_t k = 0; k < p_out->size(); k++) {
+    double f_phase = fmod((double)k * BPM / 60.0 / RATE, 1.0);
+    *pun_seed = *pun_seed * 1103515245u + 12345u;
+    int32_t n_noise = (int32_t)((*pun_seed >> 16) % (2 * un_noise + 1)) - (int32_t)un_noise;
+    (*p_out)[k] = (uint32_t)(f_dc * (1 - f_modulation * pulse(f_phase)) + n_noise);
+  }
+}
+
+typedef struct {
+  uint32_t un_reads;    // results checked
+  uint32_t un_invalid;  // 999
+  uint32_t un_off;      // outside the table values of R +- RATIO_TOLERANCE %
+  double f_spo2_sum;
+} check_result;
+
+// the table falls with R, so the lowest accepted SpO2 belongs to the highest ratio
+static void add_spo2(check_result* p_result, int32_t n_spo2, int32_t n_ratio)
+{
+  p_result->un_reads++;
+  if (n_spo2 == 999) { p_result->un_invalid++; return; }
+  p_result->f_spo2_sum += n_spo2;
+  if (n_spo2 < spo2_from_ratio(n_ratio * (100 + RATIO_TOLERANCE) / 100) || n_spo2 > spo2_from_ratio(n_ratio * (100 - RATIO_TOLERANCE) / 100))
+    p_result->un_off++;
+}
+
+// prints one line, true if the path passed
+static bool print_result(const char* s_path, const check_result& result)
+{
+  bool b_ok = result.un_reads > 0 && result.un_invalid == 0 && result.un_off == 0;
+  printf("  %-9s %3u reads, %3u with 999, %3u off by more than %d %% of R, mean SpO2 %5.1f  %s\n", s_path, result.un_reads, result.un_invalid,
+         result.un_off, RATIO_TOLERANCE, result.un_reads > result.un_invalid ? result.f_spo2_sum / (result.un_reads - result.un_invalid) : 0.0,
+         b_ok ? "ok" : "FAILED");
+  return b_ok;
+}
+
+int main(void)
+{
+  const int32_t an_ratios[] = { 50, 100, 140 };
+  int32_t n_failed = 0;
+  for (size_t r = 0; r < sizeof(an_ratios) / sizeof(an_ratios[0]); r++) {
+    int32_t n_ratio = an_ratios[r], n_expected = spo2_from_ratio(n_ratio);
+    uint32_t un_seed = 1;
+    std::vector<uint32_t> green, ir, red;
+    synthesize(&green, 60000, 0.03, 20, &un_seed);
+    synthesize(&ir, 120000, IR_MODULATION, 20, &un_seed);
+    synthesize(&red, 90000, IR_MODULATION * n_ratio / 100, 20, &un_seed);
+
+    PipelineController* p_controller = new PipelineController();
+    BeatDetector detector(RATE, 15);
+    SpO2Estimator estimator(16);
+    check_result window = { 0, 0, 0, 0 }, streaming = { 0, 0, 0, 0 };
+    uint32_t un_windows = 0;
+    for (size_t un_end = 0; un_end < green.size(); un_end += HOP) {
+      for (size_t k = un_end; k < un_end + HOP; k++) {
+        p_controller->push_sample(green[k], ir[k], red[k]);
+        if (detector.push(green[k])) {
+          size_t un_first = k + 1 > WINDOW ? k + 1 - WINDOW : 0;
+          estimator.add_beat(detector.last_beat(), &ir[un_first], &red[un_first], un_first, k + 1 - un_first);
+        }
+      }
+      if (detector.heart_rate() != 999)
+        add_spo2(&streaming, estimator.spo2(), n_ratio);
+      if (un_end + HOP < WINDOW) continue;
+      size_t un_first = un_end + HOP - WINDOW;
+      int32_t n_spo2, n_hr;
+      uint8_t uch_quality;
+      heart_rate_and_oxygen_saturation(&green[un_first], &ir[un_first], &red[un_first], WINDOW, RATE, &n_spo2, &n_hr, &uch_quality, p_controller);
+      un_windows++;
+      if (uch_quality == SIGNAL_OK)
+        add_spo2(&window, n_spo2, n_ratio);
+    }
+    delete p_controller; p_controller = NULL;
+
+    printf("R %3d (SpO2 %3d), %u windows:\n", n_ratio, n_expected, un_windows);
+    bool b_ok = print_result("window", window);
+    b_ok = print_result("streaming", streaming) && b_ok;
+    if (!b_ok) n_failed++;
+  }
+  return n_failed ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/** \file standby_sim.cpp ***************************************************
+*
+* Description: Duty cycle of the proximity standby (demo/standby_controller.h)
+*              with a simulated sensor. The timeline alternates finger-off
+*              stretches (ambient light only, a few hundred counts) with the
+*              recordings as finger-on stretches. The loop of demo.ino is
+*              replayed on it: warm-up over a full window, one hop (256
+*              samples) at a time with signal_quality deciding the
+*              fallback, and in standby a poll of the simulated PROX
+*              interrupt every 100 ms, raised while the finger is on.
+*              Reported: share of time in acquisition against the always-on
+*              sketch, wake-ups, the delay from finger on to acquisition and
+*              from finger off to standby, and acquisition time without a
+*              finger.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o standby_sim standby_sim.cpp ppg_record_reader.cpp ../demo/standby_controller.cpp
+*              ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp
+*              ../demo/stage_timer.cpp ../demo/slope_detector.cpp ../demo/peak_valley_detector.cpp
+* Usage:   standby_sim [-o off_seconds] recording.ppg [recording.ppg ...]
+*
+* Recordings without IR/red channels reuse the green channel for them.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+#include "standby_controller.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define POLL_MS 100          // standbyPollMs of demo.ino
+#define AMBIENT_COUNTS 600   // finger off, far below min_ir_dc
+#define AMBIENT_NOISE 40
+
+struct timeline {
+  std::vector<uint32_t> green, ir, red;
+  std::vector<uint8_t> finger; // 1 while a recording plays
+};
+
+// the sensor sees the timeline at the current sample
+class SimSensor: public StandbySensor {
+ public:
+  SimSensor(const timeline* p_line): p_line(p_line), un_now(0), un_proximity_calls(0), un_active_calls(0) {}
+  void enter_proximity(void) { un_proximity_calls++; }
+  void enter_active(void) { un_active_calls++; }
+  bool proximity_triggered(void) { return un_now < p_line->finger.size() && p_line->finger[un_now]; }
+
+  const timeline* p_line;
+  uint32_t un_now; // sample index
+  uint32_t un_proximity_calls;
+  uint32_t un_active_calls;
+};
+
+static void append_off(timeline* p_line, uint32_t un_samples)
+{
+  for (uint32_t k = 0; k < un_samples; k++) {
+    uint32_t un_value = AMBIENT_COUNTS + rand() % AMBIENT_NOISE;
+    p_line->green.push_back(un_value);
+    p_line->ir.push_back(un_value);
+    p_line->red.push_back(un_value);
+    p_line->finger.push_back(0);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  int32_t n_off_s = 60;
+  int i = 1;
+  if (i + 1 < argc && strcmp(argv[i], "-o") == 0) { n_off_s = atoi(argv[i + 1]); i += 2; }
+  if (i >= argc) { fprintf(stderr, "usage: %s [-o off_seconds] recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+
+  timeline line;
+  int32_t n_rate = 0;
+  srand(1);
+  for (; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    if (n_rate != 0 && n_rate != (int32_t)reader.header()->un_sampling_rate) { fprintf(stderr, "%s: sampling rates differ\n", argv[i]); return 1; }
+    n_rate = reader.header()->un_sampling_rate;
+    int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR), n_red = reader.find_channel(PPG_CHANNEL_RED);
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = reader.window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = reader.window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+    append_off(&line, n_off_s * n_rate);
+    line.green.insert(line.green.end(), pun_green, pun_green + un_count);
+    line.ir.insert(line.ir.end(), pun_ir, pun_ir + un_count);
+    line.red.insert(line.red.end(), pun_red, pun_red + un_count);
+    line.finger.insert(line.finger.end(), un_count, 1);
+  }
+  append_off(&line, n_off_s * n_rate);
+  uint32_t un_total = (uint32_t)line.finger.size();
+#define MS(samples) (uint32_t)((uint64_t)(samples) * 1000 / n_rate)
+
+  SimSensor sensor(&line);
+  StandbyController standby(&sensor);
+  standby.begin(0, STANDBY_ACTIVE); // demo.ino starts sampling right away
+  uint32_t un_window_end = 0; // samples in the window end here, 0: the window has to be filled first
+  uint64_t un_idle_active = 0; // acquisition samples without a finger
+  uint64_t un_on_latency = 0, un_off_latency = 0;
+  uint32_t un_on_events = 0, un_off_events = 0;
+  uint32_t un_last_on = 0, un_last_off = 0; // start of the newest finger-on and finger-off stretch
+  uint32_t un_scanned = 1; // finger edges are known before this sample
+  std::vector<uint32_t> green(WINDOW), ir(WINDOW), red(WINDOW);
+  signal_quality_info quality_info;
+  uint32_t un_poll = n_rate * POLL_MS / 1000;
+  for (uint32_t un_now = 0; un_now < un_total; ) {
+    for (; un_scanned <= un_now && un_scanned < un_total; un_scanned++) {
+      if (line.finger[un_scanned] && !line.finger[un_scanned - 1]) un_last_on = un_scanned;
+      if (!line.finger[un_scanned] && line.finger[un_scanned - 1]) un_last_off = un_scanned;
+    }
+    if (standby.state() == STANDBY_SENSING) {
+      sensor.un_now = un_now;
+      if (standby.poll(MS(un_now))) {
+        un_on_latency += un_now - un_last_on;
+        un_on_events++;
+        un_window_end = 0;
+      } else {
+        un_now += un_poll;
+      }
+    } else {
+      // warm_up() fills a whole window, loop() then adds one hop
+      uint32_t un_step = un_window_end == 0 ? WINDOW : HOP;
+      if (un_now + un_step > un_total) break;
+      for (uint32_t k = un_now; k < un_now + un_step; k++)
+        if (!line.finger[k]) un_idle_active++;
+      un_now += un_step;
+      un_window_end = un_now;
+      uint32_t un_start = un_window_end - WINDOW;
+      green.assign(line.green.begin() + un_start, line.green.begin() + un_window_end);
+      ir.assign(line.ir.begin() + un_start, line.ir.begin() + un_window_end);
+      red.assign(line.red.begin() + un_start, line.red.begin() + un_window_end);
+      uint8_t uch_quality = signal_quality(&green[0], &ir[0], &red[0], WINDOW, n_rate, &quality_info);
+      if (un_step == HOP && standby.update(uch_quality, MS(un_now))) {
+        un_off_latency += un_now - un_last_off;
+        un_off_events++;
+      }
+    }
+  }
+  uint32_t un_end_ms = MS(un_total);
+  uint32_t un_finger = 0;
+  for (uint32_t k = 0; k < un_total; k++)
+    un_finger += line.finger[k];
+
+  printf("timeline %.1f s, finger on %.1f s (%.0f %%)\n", un_total / (double)n_rate, un_finger / (double)n_rate, 100.0 * un_finger / un_total);
+  printf("acquisition %.1f s = %.0f %% of the time, always-on sketch 100 %%\n", standby.active_ms(un_end_ms) / 1000.0,
+         100.0 * standby.active_ms(un_end_ms) / un_end_ms);
+  printf("  without a finger %.1f s\n", un_idle_active / (double)n_rate);
+  printf("wake-ups %u, finger on to acquisition %.0f ms mean\n", standby.wakeups(), un_on_events ? 1000.0 * un_on_latency / un_on_events / n_rate : 0.0);
+  printf("fallbacks %u, finger off to standby %.0f ms mean\n", un_off_events, un_off_events ? 1000.0 * un_off_latency / un_off_events / n_rate : 0.0);
+  printf("sensor calls: proximity %u, active %u\n", sensor.un_proximity_calls, sensor.un_active_calls);
+  return 0;
+}
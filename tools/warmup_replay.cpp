@@ -0,0 +1,119 @@
+/** \file warmup_replay.cpp *************************************************
+*
+* Description: Replay the warm-up of demo.ino (warm_up()) from many start
+*              points of each recording: a fresh PipelineController and
+*              beat detector start every hop (256 samples), the window
+*              pipeline runs on the first 1024, 1536 and 2048 samples and
+*              the streaming detector reports what it has at the same
+*              points. The provisional results are compared with the full
+*              window of the same start, the reading a device without
+*              warm-up would have shown first: invalid count, mean
+*              |difference| and share within 5 bpm, plus the time after
+*              the start at 400 sps.
+*
+* Build:   g++ -O2 -std=c++17 -Ihost -I../demo -o warmup_replay warmup_replay.cpp ppg_record_reader.cpp
+*              ../demo/pipeline_controller.cpp ../demo/bandpass_filter.cpp ../demo/spo2_algorithm.cpp ../demo/small_median.cpp ../demo/autocorr_engine.cpp
+*              ../demo/stage_timer.cpp ../demo/beat_detector.cpp ../demo/rolling_median.cpp ../demo/slope_detector.cpp
+*              ../demo/peak_valley_detector.cpp
+* Usage:   warmup_replay recording.ppg [recording.ppg ...]
+*
+* Recordings without IR/red channels reuse the green channel for them.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "beat_detector.h"
+#include "pipeline_controller.h"
+#include "ppg_record_reader.h"
+#include "spo2_algorithm.h"
+
+#define WINDOW 2048
+#define HOP 256
+#define TOLERANCE_BPM 5
+#define STEPS 3
+
+static const int32_t step_lengths[STEPS] = { WINDOW / 2, WINDOW * 3 / 4, WINDOW }; // warmupLengths of demo.ino, then the full window
+
+struct step_result {
+  uint32_t un_starts;
+  uint32_t un_invalid;
+  uint32_t un_compared; // both this step and the full window valid
+  uint32_t un_within;
+  double f_abs_diff;
+};
+
+static void add_step(step_result* p, int32_t n_hr, int32_t n_full)
+{
+  p->un_starts++;
+  if (n_hr == 999) { p->un_invalid++; return; }
+  if (n_full == 999) return;
+  int32_t n_diff = abs(n_hr - n_full);
+  p->un_compared++;
+  p->f_abs_diff += n_diff;
+  if (n_diff <= TOLERANCE_BPM) p->un_within++;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg [recording.ppg ...]\n", argv[0]); return 2; }
+  step_result window_steps[STEPS], stream_steps[STEPS];
+  memset(window_steps, 0, sizeof(window_steps));
+  memset(stream_steps, 0, sizeof(stream_steps));
+  int32_t n_rate = 400;
+  PipelineController* p_controller = new PipelineController();
+  for (int i = 1; i < argc; i++) {
+    PpgRecordReader reader;
+    if (!reader.open(argv[i])) { fprintf(stderr, "%s is not a valid recording\n", argv[i]); return 1; }
+    int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+    if (n_green < 0) { fprintf(stderr, "%s: no green channel\n", argv[i]); return 1; }
+    int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR), n_red = reader.find_channel(PPG_CHANNEL_RED);
+    n_rate = reader.header()->un_sampling_rate;
+    uint32_t un_count = reader.header()->un_sample_count;
+    const uint32_t* pun_green = reader.window(n_green, 0, un_count).pun_data;
+    const uint32_t* pun_ir = reader.window(n_ir >= 0 ? n_ir : n_green, 0, un_count).pun_data;
+    const uint32_t* pun_red = reader.window(n_red >= 0 ? n_red : n_green, 0, un_count).pun_data;
+    std::vector<uint32_t> green, ir, red;
+    for (uint32_t un_start = 0; un_start + WINDOW <= un_count; un_start += HOP) {
+      p_controller->reset();
+      BeatDetector detector(n_rate, 15);
+      int32_t an_window_hr[STEPS], an_stream_hr[STEPS];
+      int32_t n_filled = 0;
+      for (int s = 0; s < STEPS; s++) {
+        int32_t n_length = step_lengths[s];
+        for (int32_t k = n_filled; k < n_length; k++) {
+          p_controller->push_green(pun_green[un_start + k]);
+          detector.push(pun_green[un_start + k]);
+        }
+        n_filled = n_length;
+        green.assign(pun_green + un_start, pun_green + un_start + n_length);
+        ir.assign(pun_ir + un_start, pun_ir + un_start + n_length);
+        red.assign(pun_red + un_start, pun_red + un_start + n_length);
+        int32_t n_spo2;
+        uint8_t uch_quality;
+        heart_rate_and_oxygen_saturation(&green[0], &ir[0], &red[0], n_length, n_rate, &n_spo2, &an_window_hr[s], &uch_quality, p_controller);
+        signal_quality_info quality_info;
+        uch_quality = signal_quality(&green[0], &ir[0], &red[0], n_length, n_rate, &quality_info); // warm_up() gates the detector with it
+        an_stream_hr[s] = uch_quality == SIGNAL_OK ? detector.heart_rate() : 999;
+      }
+      for (int s = 0; s < STEPS; s++) {
+        add_step(&window_steps[s], an_window_hr[s], an_window_hr[STEPS - 1]);
+        add_step(&stream_steps[s], an_stream_hr[s], an_stream_hr[STEPS - 1]);
+      }
+    }
+  }
+  delete p_controller; p_controller = NULL;
+
+  printf("mode       samples  after s  starts  invalid  mean |diff to full|  within %d bpm\n", TOLERANCE_BPM);
+  for (int m = 0; m < 2; m++)
+    for (int s = 0; s < STEPS; s++) {
+      const step_result* p = m ? &stream_steps[s] : &window_steps[s];
+      printf("%-10s %7d %8.2f %7u %8u %20.1f %13.0f%%\n", m ? "streaming" : "window", step_lengths[s], (double)step_lengths[s] / n_rate,
+             p->un_starts, p->un_invalid, p->un_compared ? p->f_abs_diff / p->un_compared : 0.0,
+             p->un_compared ? 100.0 * p->un_within / p->un_compared : 0.0);
+    }
+  return 0;
+}
@@ -0,0 +1,132 @@
+/** \file waveform_bench.cpp ************************************************
+*
+* Description: Measure the BLE waveform codec (demo/waveform_codec.h) on a
+*              recording: bytes per sample, frames per second of signal and
+*              encode/decode time per sample, for several payload sizes.
+*              Every frame is decoded and compared with the input.
+*              Then the display plot (demo/waveform_plot.h) with the
+*              settings of demo.ino, 128 x 32 pixels, 16 samples per column,
+*              is fed the green channel one hop (256 samples) at a time like
+*              drawCruve: the columns sent to the display per hop (of 128),
+*              their bytes against the 512 of a full frame and the CPU time
+*              of push() and take_dirty() per hop.
+*              The exit status is 1 if a round trip failed.
+*
+* Build:   g++ -O2 -I../demo -o waveform_bench waveform_bench.cpp ppg_record_reader.cpp ../demo/waveform_codec.cpp
+*              ../demo/waveform_plot.cpp
+* Usage:   waveform_bench recording.ppg
+*
+* Recordings without IR/red channels reuse the green channel for them.
+*
+* ------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "ppg_record_reader.h"
+#include "waveform_codec.h"
+#include "waveform_plot.h"
+
+#define PLOT_WIDTH 128 // CURVE_WEIGHT, CURVE_HEIGHT and bufferLength / oneQuaterBuffer of demo.ino
+#define PLOT_HEIGHT 32
+#define PLOT_WINDOW 2048
+#define PLOT_HOP 256
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) { fprintf(stderr, "usage: %s recording.ppg\n", argv[0]); return 2; }
+  PpgRecordReader reader;
+  if (!reader.open(argv[1])) { fprintf(stderr, "%s is not a valid recording\n", argv[1]); return 1; }
+  int32_t n_green = reader.find_channel(PPG_CHANNEL_GREEN);
+  if (n_green < 0) { fprintf(stderr, "no green channel\n"); return 1; }
+  int32_t n_ir = reader.find_channel(PPG_CHANNEL_IR);
+  int32_t n_red = reader.find_channel(PPG_CHANNEL_RED);
+  uint32_t un_count = reader.header()->un_sample_count;
+  ppg_span green = reader.window(n_green, 0, un_count);
+  ppg_span ir = reader.window(n_ir < 0 ? n_green : n_ir, 0, un_count);
+  ppg_span red = reader.window(n_red < 0 ? n_green : n_red, 0, un_count);
+
+  const uint16_t auw_payloads[] = { 20, 182, 244, 509 };
+  const int32_t n_repeat = 200;
+  bool b_all_ok = true;
+  printf("%u samples x 3 channels, %u sps, raw 18-bit packing = 2.25 bytes/sample\n", un_count, reader.header()->un_sampling_rate);
+  printf("payload  bytes/sample  frames/s  encode ns/sample  decode ns/sample\n");
+  for (size_t p = 0; p < sizeof(auw_payloads) / sizeof(auw_payloads[0]); p++) {
+    WaveformEncoder encoder(auw_payloads[p]);
+    std::vector<std::vector<uint8_t> > frames;
+    uint64_t un_bytes = 0;
+    double f_encode_ns = 0;
+    for (int32_t r = 0; r < n_repeat; r++) {
+      frames.clear();
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      encoder.begin_frame(0);
+      for (uint32_t i = 0; i < un_count; i++) {
+        if (!encoder.add_sample(green.pun_data[i], ir.pun_data[i], red.pun_data[i])) {
+          frames.push_back(std::vector<uint8_t>(encoder.frame(), encoder.frame() + encoder.frame_length()));
+          encoder.begin_frame(i);
+          encoder.add_sample(green.pun_data[i], ir.pun_data[i], red.pun_data[i]);
+        }
+      }
+      frames.push_back(std::vector<uint8_t>(encoder.frame(), encoder.frame() + encoder.frame_length()));
+      f_encode_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    }
+    for (size_t i = 0; i < frames.size(); i++)
+      un_bytes += frames[i].size();
+
+    std::vector<uint32_t> g(un_count), x(un_count), y(un_count);
+    double f_decode_ns = 0;
+    bool b_ok = true;
+    for (int32_t r = 0; r < n_repeat; r++) {
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < frames.size(); i++) {
+        uint16_t uw_seq;
+        uint32_t un_first;
+        int32_t n = waveform_decode(frames[i].data(), (uint16_t)frames[i].size(), &g[0], &x[0], &y[0], un_count, &uw_seq, &un_first);
+        if (n < 0 || un_first + n > un_count) { b_ok = false; break; }
+        if (r == 0) // verify once, outside of the hot path afterwards
+          for (int32_t k = 0; k < n; k++)
+            if (g[k] != green.pun_data[un_first + k] || x[k] != ir.pun_data[un_first + k] || y[k] != red.pun_data[un_first + k]) b_ok = false;
+      }
+      f_decode_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    }
+    double f_samples = (double)un_count * 3;
+    printf("%7u  %12.2f  %8.1f  %16.2f  %16.2f%s\n", auw_payloads[p], un_bytes / f_samples,
+           frames.size() * (double)reader.header()->un_sampling_rate / un_count,
+           f_encode_ns / n_repeat / f_samples, f_decode_ns / n_repeat / f_samples, b_ok ? "" : "  ROUND TRIP FAILED");
+    if (!b_ok) b_all_ok = false;
+  }
+
+  // the display plot, hop by hop; the first window fills the display and is not counted
+  std::vector<uint8_t> buffer(PLOT_WIDTH * PLOT_HEIGHT / 8);
+  WaveformPlot plot(PLOT_WIDTH, PLOT_HEIGHT, PLOT_WINDOW / PLOT_WIDTH);
+  uint64_t un_columns = 0;
+  uint32_t un_hops = 0, un_max_columns = 0;
+  double f_plot_ns = 0;
+  for (int32_t r = 0; r < n_repeat; r++) {
+    plot.attach(&buffer[0]);
+    for (uint32_t i = 0; i + PLOT_HOP <= un_count; i += PLOT_HOP) {
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      for (uint32_t k = i; k < i + PLOT_HOP; k++)
+        plot.push(green.pun_data[k]);
+      int16_t n_first, n_last;
+      uint32_t un_hop_columns = 0;
+      while (plot.take_dirty(&n_first, &n_last))
+        un_hop_columns += n_last - n_first + 1;
+      f_plot_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+      if (i < PLOT_WINDOW) continue;
+      un_hops++;
+      un_columns += un_hop_columns;
+      if (un_hop_columns > un_max_columns) un_max_columns = un_hop_columns;
+    }
+  }
+  if (un_hops == 0) {
+    printf("\nplot: the recording is shorter than %d + %d samples, no hop after the first window\n", PLOT_WINDOW, PLOT_HOP);
+    return b_all_ok ? 0 : 1;
+  }
+  double f_columns = (double)un_columns / un_hops;
+  printf("\nplot %dx%d, %d samples per column, %d samples per hop, %u hops\n", PLOT_WIDTH, PLOT_HEIGHT, PLOT_WINDOW / PLOT_WIDTH, PLOT_HOP,
+         un_hops / n_repeat);
+  printf("columns/hop %.1f of %d (max %u), %.0f of %d bytes sent, %.2f us/hop\n", f_columns, PLOT_WIDTH, un_max_columns,
+         f_columns * PLOT_HEIGHT / 8, PLOT_WIDTH * PLOT_HEIGHT / 8, f_plot_ns / 1000 / ((double)n_repeat * (un_count / PLOT_HOP)));
+  return b_all_ok ? 0 : 1;
+}